@@ -20,6 +20,7 @@
 #ifndef GUAC_COMMON_SSH_SFTP_H
 #define GUAC_COMMON_SSH_SFTP_H
 
+#include "common/dircache.h"
 #include "common/json.h"
 #include "ssh.h"
 
@@ -38,6 +39,31 @@
  */
 #define GUAC_COMMON_SSH_SFTP_MAX_DEPTH 1024
 
+/**
+ * The maximum number of bytes of file data to send within each blob of a
+ * download.
+ */
+#define GUAC_COMMON_SSH_SFTP_BLOB_SIZE 4096
+
+/**
+ * The maximum number of blobs of a download which may be awaiting
+ * acknowledgement by the user at any given time. Sending further blobs before
+ * earlier blobs are acknowledged hides the latency of the connection to the
+ * user, such that transfer speed is limited by bandwidth rather than round
+ * trip time.
+ */
+#define GUAC_COMMON_SSH_SFTP_WINDOW 16
+
+/**
+ * The size of the buffer used for each file transfer, in bytes. Downloads
+ * read up to this many bytes from the SFTP server at once, and uploads
+ * accumulate received blobs until this many bytes are available before
+ * writing to the SFTP server. Larger reads and writes allow libssh2 to issue
+ * several SFTP requests in parallel.
+ */
+#define GUAC_COMMON_SSH_SFTP_TRANSFER_BUFFER_SIZE \
+    (GUAC_COMMON_SSH_SFTP_BLOB_SIZE * GUAC_COMMON_SSH_SFTP_WINDOW)
+
 /**
  * Representation of an SFTP-driven filesystem object. Unlike guac_object, this
  * structure is not tied to any particular user.
@@ -70,6 +96,13 @@ typedef struct guac_common_ssh_sftp_filesystem {
      */
     char upload_path[GUAC_COMMON_SSH_SFTP_MAX_PATH];
 
+    /**
+     * Cache of recently-listed directories, keyed by absolute path on the
+     * SFTP server. Listings are invalidated when files are uploaded through
+     * this filesystem.
+     */
+    guac_common_dircache* dircache;
+
 } guac_common_ssh_sftp_filesystem;
 
 /**
@@ -83,8 +116,10 @@ typedef struct guac_common_ssh_sftp_ls_state {
     guac_common_ssh_sftp_filesystem* filesystem;
 
     /**
-     * Reference to the directory currently being listed over SFTP. This
-     * directory must already be open from a call to libssh2_sftp_opendir().
+     * Reference to the directory currently being listed over SFTP, or NULL if
+     * all entries have been read (or the listing was found within the
+     * directory cache). If non-NULL, this directory must already be open
+     * from a call to libssh2_sftp_opendir().
      */
     LIBSSH2_SFTP_HANDLE* directory;
 
@@ -93,6 +128,31 @@ typedef struct guac_common_ssh_sftp_ls_state {
      */
     char directory_name[GUAC_COMMON_SSH_SFTP_MAX_PATH];
 
+    /**
+     * The entries of the directory being listed. If the directory is still
+     * being read, entries are appended to this listing as they are read, and
+     * the listing is added to the directory cache once complete.
+     */
+    guac_common_dircache_listing* listing;
+
+    /**
+     * The index of the next entry within the listing to send to the user.
+     */
+    int index;
+
+    /**
+     * The number of blobs which have been sent to the user but not yet
+     * acknowledged.
+     */
+    int blobs_pending;
+
+    /**
+     * Non-zero if the entire listing has been sent and the stream has been
+     * ended, but acknowledgements for previously-sent blobs are still
+     * expected.
+     */
+    int complete;
+
     /**
      * The current state of the JSON directory object being written.
      */
@@ -100,6 +160,51 @@ typedef struct guac_common_ssh_sftp_ls_state {
 
 } guac_common_ssh_sftp_ls_state;
 
+/**
+ * The current state of a file upload or download.
+ */
+typedef struct guac_common_ssh_sftp_transfer {
+
+    /**
+     * The file being read (download) or written (upload). This file must
+     * already be open from a call to libssh2_sftp_open().
+     */
+    LIBSSH2_SFTP_HANDLE* file;
+
+    /**
+     * Data read from the file which is being sent to the user (download), or
+     * data received from the user which has not yet been written to the file
+     * (upload).
+     */
+    char buffer[GUAC_COMMON_SSH_SFTP_TRANSFER_BUFFER_SIZE];
+
+    /**
+     * The number of bytes of received data currently stored within the
+     * buffer. This is only used for uploads.
+     */
+    int length;
+
+    /**
+     * The number of blobs which have been sent to the user but not yet
+     * acknowledged. This is only used for downloads.
+     */
+    int blobs_pending;
+
+    /**
+     * Non-zero if the end of the transfer has been reached and the stream has
+     * been ended, but acknowledgements for previously-sent blobs are still
+     * expected. This is only used for downloads.
+     */
+    int complete;
+
+    /**
+     * Non-zero if a previous write to the file has failed, in which case all
+     * further data will be rejected. This is only used for uploads.
+     */
+    int failed;
+
+} guac_common_ssh_sftp_transfer;
+
 /**
  * Creates a new Guacamole filesystem object which provides access to files
  * and directories via SFTP using the given SSH session. When the filesystem
@@ -355,11 +355,77 @@ static int guac_ssh_append_path(char* fullpath, const char* path_a,
 
 }
 
+/**
+ * Allocates a new transfer for the given open file. The transfer must
+ * eventually be freed with free(), after the file has been closed.
+ *
+ * @param file
+ *     The file being uploaded or downloaded.
+ *
+ * @return
+ *     A newly-allocated transfer for the given file, or NULL if memory could
+ *     not be allocated.
+ */
+static guac_common_ssh_sftp_transfer* guac_common_ssh_sftp_transfer_alloc(
+        LIBSSH2_SFTP_HANDLE* file) {
+
+    guac_common_ssh_sftp_transfer* transfer =
+        calloc(1, sizeof(guac_common_ssh_sftp_transfer));
+
+    if (transfer != NULL)
+        transfer->file = file;
+
+    return transfer;
+
+}
+
+/**
+ * Writes all data currently buffered for the given upload to its file,
+ * emptying the buffer. As libssh2 splits large writes into several SFTP
+ * requests which are sent in parallel, writing the buffered data at once is
+ * far faster than writing each received blob individually.
+ *
+ * @param transfer
+ *     The upload whose buffered data should be written.
+ *
+ * @return
+ *     Zero if all buffered data was written successfully, non-zero
+ *     otherwise.
+ */
+static int guac_common_ssh_sftp_transfer_flush(
+        guac_common_ssh_sftp_transfer* transfer) {
+
+    char* current = transfer->buffer;
+    int remaining = transfer->length;
+
+    /* Write until all data is written or an error occurs */
+    while (remaining > 0) {
+
+        ssize_t written = libssh2_sftp_write(transfer->file, current,
+                remaining);
+        if (written <= 0) {
+            transfer->failed = 1;
+            return 1;
+        }
+
+        current += written;
+        remaining -= written;
+
+    }
+
+    transfer->length = 0;
+    return 0;
+
+}
+
 /**
  * Handler for blob messages which continue an inbound SFTP data transfer
  * (upload). The data associated with the given stream is expected to be a
- * pointer to an open LIBSSH2_SFTP_HANDLE for the file to which the data
- * should be written.
+ * pointer to the guac_common_ssh_sftp_transfer of the upload, or NULL if the
+ * file could not be opened. Received data is buffered and acknowledged
+ * immediately, being written to the file only once the buffer is full or the
+ * stream ends, thus any failure to write may only be reported in response to
+ * a later blob or to the end of the stream.
  *
  * @param user
  *     The user receiving the blob message.
@@ -379,25 +445,34 @@ static int guac_ssh_append_path(char* fullpath, const char* path_a,
 static int guac_common_ssh_sftp_blob_handler(guac_user* user,
         guac_stream* stream, void* data, int length) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
+    /* Pull transfer from stream */
+    guac_common_ssh_sftp_transfer* transfer =
+        (guac_common_ssh_sftp_transfer*) stream->data;
 
-    /* Attempt write */
-    if (libssh2_sftp_write(file, data, length) == length) {
-        guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes written", length);
-        guac_protocol_send_ack(user->socket, stream, "SFTP: OK",
-                GUAC_PROTOCOL_STATUS_SUCCESS);
-        guac_socket_flush(user->socket);
-    }
+    /* Write out buffered data if there is insufficient space */
+    if (transfer != NULL && !transfer->failed
+            && transfer->length + length > sizeof(transfer->buffer))
+        guac_common_ssh_sftp_transfer_flush(transfer);
 
     /* Inform of any errors */
-    else {
+    if (transfer == NULL || transfer->failed
+            || length > sizeof(transfer->buffer)) {
         guac_user_log(user, GUAC_LOG_INFO, "Unable to write to file");
         guac_protocol_send_ack(user->socket, stream, "SFTP: Write failed",
                 GUAC_PROTOCOL_STATUS_SERVER_ERROR);
         guac_socket_flush(user->socket);
+        return 0;
     }
 
+    /* Buffer received data */
+    memcpy(transfer->buffer + transfer->length, data, length);
+    transfer->length += length;
+
+    guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes buffered", length);
+    guac_protocol_send_ack(user->socket, stream, "SFTP: OK",
+            GUAC_PROTOCOL_STATUS_SUCCESS);
+    guac_socket_flush(user->socket);
+
     return 0;
 
 }
@@ -405,8 +480,9 @@ static int guac_common_ssh_sftp_blob_handler(guac_user* user,
 /**
  * Handler for end messages which terminate an inbound SFTP data transfer
  * (upload). The data associated with the given stream is expected to be a
- * pointer to an open LIBSSH2_SFTP_HANDLE for the file to which the data
- * has been written and which should now be closed.
+ * pointer to the guac_common_ssh_sftp_transfer of the upload, or NULL if the
+ * file could not be opened. Any remaining buffered data is written, and the
+ * file is closed.
  *
  * @param user
  *     The user receiving the end message.
@@ -420,11 +496,34 @@ static int guac_common_ssh_sftp_blob_handler(guac_user* user,
 static int guac_common_ssh_sftp_end_handler(guac_user* user,
         guac_stream* stream) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
+    /* Pull transfer from stream */
+    guac_common_ssh_sftp_transfer* transfer =
+        (guac_common_ssh_sftp_transfer*) stream->data;
+
+    if (transfer == NULL) {
+        guac_user_log(user, GUAC_LOG_INFO, "Unable to close file");
+        guac_protocol_send_ack(user->socket, stream, "SFTP: Close failed",
+                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
+        guac_socket_flush(user->socket);
+        return 0;
+    }
+
+    /* Write any remaining data */
+    if (!transfer->failed)
+        guac_common_ssh_sftp_transfer_flush(transfer);
 
     /* Attempt to close file */
-    if (libssh2_sftp_close(file) == 0) {
+    int closed = (libssh2_sftp_close(transfer->file) == 0);
+
+    /* Report any failure to write buffered data */
+    if (transfer->failed) {
+        guac_user_log(user, GUAC_LOG_INFO, "Unable to write to file");
+        guac_protocol_send_ack(user->socket, stream, "SFTP: Write failed",
+                GUAC_PROTOCOL_STATUS_SERVER_ERROR);
+        guac_socket_flush(user->socket);
+    }
+
+    else if (closed) {
         guac_user_log(user, GUAC_LOG_DEBUG, "File closed");
         guac_protocol_send_ack(user->socket, stream, "SFTP: OK",
                 GUAC_PROTOCOL_STATUS_SUCCESS);
@@ -437,6 +536,8 @@ static int guac_common_ssh_sftp_end_handler(guac_user* user,
         guac_socket_flush(user->socket);
     }
 
+    free(transfer);
+    stream->data = NULL;
     return 0;
 
 }
@@ -470,6 +571,9 @@ int guac_common_ssh_sftp_handle_file_stream(
             LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT | LIBSSH2_FXF_TRUNC,
             S_IRUSR | S_IWUSR);
 
+    /* Any cached listing of the destination directory is now stale */
+    guac_common_dircache_invalidate(filesystem->dircache, fullpath);
+
     /* Inform of status */
     if (file != NULL) {
 
@@ -493,17 +597,50 @@ int guac_common_ssh_sftp_handle_file_stream(
     stream->blob_handler = guac_common_ssh_sftp_blob_handler;
     stream->end_handler = guac_common_ssh_sftp_end_handler;
 
-    /* Store file within stream */
-    stream->data = file;
+    /* Store upload state within stream */
+    stream->data = (file != NULL)
+        ? guac_common_ssh_sftp_transfer_alloc(file) : NULL;
     return 0;
 
 }
 
+/**
+ * Ends the given outbound SFTP data transfer (download), closing its file.
+ * The stream is freed once all blobs sent along the stream have been
+ * acknowledged, such that late acknowledgements are not mistaken for
+ * acknowledgements of a future stream having the same index.
+ *
+ * @param user
+ *     The user receiving the download.
+ *
+ * @param stream
+ *     The Guacamole protocol stream associated with the download.
+ *
+ * @param transfer
+ *     The state of the download.
+ */
+static void guac_common_ssh_sftp_transfer_end(guac_user* user,
+        guac_stream* stream, guac_common_ssh_sftp_transfer* transfer) {
+
+    guac_protocol_send_end(user->socket, stream);
+    transfer->complete = 1;
+
+    /* Close file */
+    if (libssh2_sftp_close(transfer->file) == 0)
+        guac_user_log(user, GUAC_LOG_DEBUG, "File closed");
+    else
+        guac_user_log(user, GUAC_LOG_INFO, "Unable to close file");
+
+}
+
 /**
  * Handler for ack messages which continue an outbound SFTP data transfer
  * (download), signalling the current status and requesting additional data.
- * The data associated with the given stream is expected to be a pointer to an
- * open LIBSSH2_SFTP_HANDLE for the file from which the data is to be read.
+ * The data associated with the given stream is expected to be a pointer to
+ * the guac_common_ssh_sftp_transfer of the download. Rather than waiting for
+ * each blob to be acknowledged before sending the next, up to
+ * GUAC_COMMON_SSH_SFTP_WINDOW blobs may be awaiting acknowledgement at any
+ * one time.
  *
  * @param user
  *     The user receiving the ack message.
@@ -525,58 +662,84 @@ int guac_common_ssh_sftp_handle_file_stream(
 static int guac_common_ssh_sftp_ack_handler(guac_user* user,
         guac_stream* stream, char* message, guac_protocol_status status) {
 
-    /* Pull file from stream */
-    LIBSSH2_SFTP_HANDLE* file = (LIBSSH2_SFTP_HANDLE*) stream->data;
+    /* Pull transfer from stream */
+    guac_common_ssh_sftp_transfer* transfer =
+        (guac_common_ssh_sftp_transfer*) stream->data;
 
-    /* If successful, read data */
-    if (status == GUAC_PROTOCOL_STATUS_SUCCESS) {
+    /* An acknowledged blob is no longer in flight */
+    if (transfer->blobs_pending > 0)
+        transfer->blobs_pending--;
 
-        /* Attempt read into buffer */
-        char buffer[4096];
-        int bytes_read = libssh2_sftp_read(file, buffer, sizeof(buffer)); 
+    /* Once ended, simply wait for all blobs to be acknowledged */
+    if (transfer->complete) {
+        if (transfer->blobs_pending == 0) {
+            free(transfer);
+            guac_user_free_stream(user, stream);
+        }
+        return 0;
+    }
+
+    /* If the user has failed the stream, abort the transfer */
+    if (status != GUAC_PROTOCOL_STATUS_SUCCESS) {
+        libssh2_sftp_close(transfer->file);
+        free(transfer);
+        guac_user_free_stream(user, stream);
+        return 0;
+    }
 
-        /* If bytes read, send as blob */
-        if (bytes_read > 0) {
-            guac_protocol_send_blob(user->socket, stream,
-                    buffer, bytes_read);
+    /* Read and send data until the window is full */
+    while (transfer->blobs_pending < GUAC_COMMON_SSH_SFTP_WINDOW) {
 
-            guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes sent to user",
-                    bytes_read);
+        /* Read enough data to fill the window at once, allowing libssh2 to
+         * request several chunks of the file in parallel */
+        int available = (GUAC_COMMON_SSH_SFTP_WINDOW - transfer->blobs_pending)
+                      * GUAC_COMMON_SSH_SFTP_BLOB_SIZE;
 
+        ssize_t bytes_read = libssh2_sftp_read(transfer->file,
+                transfer->buffer, available);
+
+        /* If EOF, send end */
+        if (bytes_read == 0) {
+            guac_user_log(user, GUAC_LOG_DEBUG, "File sent");
+            guac_common_ssh_sftp_transfer_end(user, stream, transfer);
+            break;
         }
 
-        /* If bytes could not be read, handle EOF or error condition */
-        else {
+        /* Otherwise, fail stream */
+        if (bytes_read < 0) {
+            guac_user_log(user, GUAC_LOG_INFO, "Error reading file");
+            guac_common_ssh_sftp_transfer_end(user, stream, transfer);
+            break;
+        }
 
-            /* If EOF, send end */
-            if (bytes_read == 0) {
-                guac_user_log(user, GUAC_LOG_DEBUG, "File sent");
-                guac_protocol_send_end(user->socket, stream);
-                guac_user_free_stream(user, stream);
-            }
+        /* Send data read as blobs */
+        char* current = transfer->buffer;
+        while (bytes_read > 0) {
 
-            /* Otherwise, fail stream */
-            else {
-                guac_user_log(user, GUAC_LOG_INFO, "Error reading file");
-                guac_protocol_send_end(user->socket, stream);
-                guac_user_free_stream(user, stream);
-            }
+            int length = bytes_read;
+            if (length > GUAC_COMMON_SSH_SFTP_BLOB_SIZE)
+                length = GUAC_COMMON_SSH_SFTP_BLOB_SIZE;
+
+            guac_protocol_send_blob(user->socket, stream, current, length);
+            transfer->blobs_pending++;
 
-            /* Close file */
-            if (libssh2_sftp_close(file) == 0)
-                guac_user_log(user, GUAC_LOG_DEBUG, "File closed");
-            else
-                guac_user_log(user, GUAC_LOG_INFO, "Unable to close file");
+            current += length;
+            bytes_read -= length;
 
         }
 
-        guac_socket_flush(user->socket);
+        guac_user_log(user, GUAC_LOG_DEBUG, "%i bytes sent to user",
+                (int) (current - transfer->buffer));
 
     }
 
-    /* Otherwise, return stream to user */
-    else
+    guac_socket_flush(user->socket);
+
+    /* Free immediately if nothing remains to be acknowledged */
+    if (transfer->complete && transfer->blobs_pending == 0) {
+        free(transfer);
         guac_user_free_stream(user, stream);
+    }
 
     return 0;
 }
@@ -597,10 +760,18 @@ guac_stream* guac_common_ssh_sftp_download_file(
         return NULL;
     }
 
+    /* Init download state */
+    guac_common_ssh_sftp_transfer* transfer =
+        guac_common_ssh_sftp_transfer_alloc(file);
+    if (transfer == NULL) {
+        libssh2_sftp_close(file);
+        return NULL;
+    }
+
     /* Allocate stream */
     stream = guac_user_alloc_stream(user);
     stream->ack_handler = guac_common_ssh_sftp_ack_handler;
-    stream->data = file;
+    stream->data = transfer;
 
     /* Send stream start, strip name */
     filename = basename(filename);
@@ -633,9 +804,103 @@ void guac_common_ssh_sftp_set_upload_path(
 
 }
 
+/**
+ * Reads the next entry of the directory being listed from the SFTP server,
+ * appending that entry to the listing. Once all entries have been read, the
+ * directory is closed and the completed listing is added to the directory
+ * cache of the filesystem.
+ *
+ * Symbolic links are resolved with an explicit stat, as they may point to
+ * directories. The SFTP session can only have one such request outstanding
+ * at a time, but the result is cached along with the rest of the listing, so
+ * each link is resolved only once per listing rather than once per request.
+ *
+ * @param list_state
+ *     The state of the directory listing operation.
+ *
+ * @return
+ *     Non-zero if an entry may have been read, zero if the end of the
+ *     directory has been reached or the directory could not be read.
+ */
+static int guac_common_ssh_sftp_ls_read(
+        guac_common_ssh_sftp_ls_state* list_state) {
+
+    char filename[GUAC_COMMON_SSH_SFTP_MAX_PATH];
+    LIBSSH2_SFTP_ATTRIBUTES attributes;
+
+    guac_common_ssh_sftp_filesystem* filesystem = list_state->filesystem;
+    LIBSSH2_SFTP* sftp = filesystem->sftp_session;
+
+    /* Close directory at end of directory, caching its contents only if the
+     * entire directory was read successfully */
+    int result = libssh2_sftp_readdir(list_state->directory,
+            filename, sizeof(filename), &attributes);
+    if (result <= 0) {
+
+        libssh2_sftp_closedir(list_state->directory);
+        list_state->directory = NULL;
+
+        if (result == 0)
+            guac_common_dircache_put(filesystem->dircache,
+                    list_state->listing);
+
+        return 0;
+    }
+
+    /* Skip current and parent directory entries */
+    if (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0)
+        return 1;
+
+    /* Stat explicitly if symbolic link (might point to directory) */
+    if (LIBSSH2_SFTP_S_ISLNK(attributes.permissions)) {
+
+        char absolute_path[GUAC_COMMON_SSH_SFTP_MAX_PATH];
+
+        if (guac_ssh_append_filename(absolute_path,
+                    list_state->listing->path, filename))
+            libssh2_sftp_stat(sftp, absolute_path, &attributes);
+
+    }
+
+    guac_common_dircache_listing_add(list_state->listing, filename,
+            LIBSSH2_SFTP_S_ISDIR(attributes.permissions));
+
+    return 1;
+
+}
+
+/**
+ * Frees the given directory listing state, closing the directory being
+ * listed if still open, and frees the associated stream.
+ *
+ * @param user
+ *     The user that requested the directory listing.
+ *
+ * @param stream
+ *     The Guacamole protocol stream associated with the directory listing.
+ *
+ * @param list_state
+ *     The state of the directory listing operation.
+ */
+static void guac_common_ssh_sftp_ls_free(guac_user* user, guac_stream* stream,
+        guac_common_ssh_sftp_ls_state* list_state) {
+
+    if (list_state->directory != NULL)
+        libssh2_sftp_closedir(list_state->directory);
+
+    guac_common_dircache_release(list_state->filesystem->dircache,
+            list_state->listing);
+
+    free(list_state);
+    guac_user_free_stream(user, stream);
+
+}
+
 /**
  * Handler for ack messages received due to receipt of a "body" or "blob"
- * instruction associated with a SFTP directory list operation.
+ * instruction associated with a SFTP directory list operation. Rather than
+ * sending a single blob per ack, up to GUAC_COMMON_SSH_SFTP_WINDOW blobs of
+ * the listing may be awaiting acknowledgement at any one time.
  *
  * @param user
  *     The user receiving the ack message.
@@ -657,84 +922,94 @@ void guac_common_ssh_sftp_set_upload_path(
 static int guac_common_ssh_sftp_ls_ack_handler(guac_user* user,
         guac_stream* stream, char* message, guac_protocol_status status) {
 
-    int bytes_read;
-    int blob_written = 0;
-
-    char filename[GUAC_COMMON_SSH_SFTP_MAX_PATH];
-    LIBSSH2_SFTP_ATTRIBUTES attributes;
-
     guac_common_ssh_sftp_ls_state* list_state =
         (guac_common_ssh_sftp_ls_state*) stream->data;
 
-    guac_common_ssh_sftp_filesystem* filesystem = list_state->filesystem;
+    guac_common_dircache_listing* listing = list_state->listing;
 
-    LIBSSH2_SFTP* sftp = filesystem->sftp_session;
+    /* An acknowledged blob is no longer in flight */
+    if (list_state->blobs_pending > 0)
+        list_state->blobs_pending--;
+
+    /* Once ended, simply wait for all blobs to be acknowledged */
+    if (list_state->complete) {
+        if (list_state->blobs_pending == 0)
+            guac_common_ssh_sftp_ls_free(user, stream, list_state);
+        return 0;
+    }
 
     /* If unsuccessful, free stream and abort */
     if (status != GUAC_PROTOCOL_STATUS_SUCCESS) {
-        libssh2_sftp_closedir(list_state->directory);
-        guac_user_free_stream(user, stream);
-        free(list_state);
+        guac_common_ssh_sftp_ls_free(user, stream, list_state);
         return 0;
     }
 
-    /* While directory entries remain */
-    while ((bytes_read = libssh2_sftp_readdir(list_state->directory,
-                filename, sizeof(filename), &attributes)) > 0
-            && !blob_written) {
+    /* Send entries until the window is full */
+    while (list_state->blobs_pending < GUAC_COMMON_SSH_SFTP_WINDOW) {
 
         char absolute_path[GUAC_COMMON_SSH_SFTP_MAX_PATH];
 
-        /* Skip current and parent directory entries */
-        if (strcmp(filename, ".") == 0 || strcmp(filename, "..") == 0)
+        /* Read further entries only once all read entries are sent */
+        if (list_state->index == listing->length) {
+
+            /* Complete JSON and end stream at end of directory */
+            if (list_state->directory == NULL
+                    || !guac_common_ssh_sftp_ls_read(list_state)) {
+
+                if (guac_common_json_end_object(user, stream,
+                            &list_state->json_state))
+                    list_state->blobs_pending++;
+
+                if (list_state->json_state.size > 0) {
+                    guac_common_json_flush(user, stream,
+                            &list_state->json_state);
+                    list_state->blobs_pending++;
+                }
+
+                guac_protocol_send_end(user->socket, stream);
+                list_state->complete = 1;
+                break;
+
+            }
+
             continue;
 
+        }
+
+        guac_common_dircache_entry* entry =
+            &(listing->entries[list_state->index++]);
+
         /* Concatenate into absolute path - skip if invalid */
-        if (!guac_ssh_append_filename(absolute_path, 
-                    list_state->directory_name, filename)) {
+        if (!guac_ssh_append_filename(absolute_path,
+                    list_state->directory_name, entry->name)) {
 
             guac_user_log(user, GUAC_LOG_DEBUG,
                     "Skipping filename \"%s\" - filename is invalid or "
-                    "resulting path is too long", filename);
+                    "resulting path is too long", entry->name);
 
             continue;
         }
 
-        /* Stat explicitly if symbolic link (might point to directory) */
-        if (LIBSSH2_SFTP_S_ISLNK(attributes.permissions))
-            libssh2_sftp_stat(sftp, absolute_path, &attributes);
-
         /* Determine mimetype */
         const char* mimetype;
-        if (LIBSSH2_SFTP_S_ISDIR(attributes.permissions))
+        if (entry->directory)
             mimetype = GUAC_USER_STREAM_INDEX_MIMETYPE;
         else
             mimetype = "application/octet-stream";
 
         /* Write entry */
-        blob_written |= guac_common_json_write_property(user, stream,
-                &list_state->json_state, absolute_path, mimetype);
+        if (guac_common_json_write_property(user, stream,
+                    &list_state->json_state, absolute_path, mimetype))
+            list_state->blobs_pending++;
 
     }
 
-    /* Complete JSON and cleanup at end of directory */
-    if (bytes_read <= 0) {
-
-        /* Complete JSON object */
-        guac_common_json_end_object(user, stream, &list_state->json_state);
-        guac_common_json_flush(user, stream, &list_state->json_state);
-
-        /* Clean up resources */
-        libssh2_sftp_closedir(list_state->directory);
-        free(list_state);
-
-        /* Signal of stream */
-        guac_protocol_send_end(user->socket, stream);
-        guac_user_free_stream(user, stream);
+    guac_socket_flush(user->socket);
 
-    }
+    /* Free immediately if nothing remains to be acknowledged */
+    if (list_state->complete && list_state->blobs_pending == 0)
+        guac_common_ssh_sftp_ls_free(user, stream, list_state);
 
-    guac_socket_flush(user->socket);
     return 0;
 
 }
@@ -806,29 +1081,42 @@ static int guac_common_ssh_sftp_get_handler(guac_user* user,
         return 0;
     }
 
-    /* Attempt to read file information */
-    if (libssh2_sftp_stat(sftp, fullpath, &attributes)) {
+    /* Use cached listing if the directory was listed recently */
+    guac_common_dircache_listing* listing =
+        guac_common_dircache_get(filesystem->dircache, fullpath);
+
+    /* Otherwise, attempt to read file information */
+    if (listing == NULL && libssh2_sftp_stat(sftp, fullpath, &attributes)) {
         guac_user_log(user, GUAC_LOG_INFO, "Unable to read file \"%s\"",
                 fullpath);
         return 0;
     }
 
     /* If directory, send contents of directory */
-    if (LIBSSH2_SFTP_S_ISDIR(attributes.permissions)) {
+    if (listing != NULL || LIBSSH2_SFTP_S_ISDIR(attributes.permissions)) {
+
+        LIBSSH2_SFTP_HANDLE* dir = NULL;
+
+        /* Open as directory if not cached, listing entries as read */
+        if (listing == NULL) {
+
+            dir = libssh2_sftp_opendir(sftp, fullpath);
+            if (dir == NULL) {
+                guac_user_log(user, GUAC_LOG_INFO,
+                        "Unable to read directory \"%s\"", fullpath);
+                return 0;
+            }
+
+            listing = guac_common_dircache_listing_alloc(fullpath);
 
-        /* Open as directory */
-        LIBSSH2_SFTP_HANDLE* dir = libssh2_sftp_opendir(sftp, fullpath);
-        if (dir == NULL) {
-            guac_user_log(user, GUAC_LOG_INFO,
-                    "Unable to read directory \"%s\"", fullpath);
-            return 0;
         }
 
         /* Init directory listing state */
         guac_common_ssh_sftp_ls_state* list_state =
-            malloc(sizeof(guac_common_ssh_sftp_ls_state));
+            calloc(1, sizeof(guac_common_ssh_sftp_ls_state));
 
         list_state->directory = dir;
+        list_state->listing = listing;
         list_state->filesystem = filesystem;
         strncpy(list_state->directory_name, name,
                 sizeof(list_state->directory_name) - 1);
@@ -859,10 +1147,18 @@ static int guac_common_ssh_sftp_get_handler(guac_user* user,
             return 0;
         }
 
+        /* Init download state */
+        guac_common_ssh_sftp_transfer* transfer =
+            guac_common_ssh_sftp_transfer_alloc(file);
+        if (transfer == NULL) {
+            libssh2_sftp_close(file);
+            return 0;
+        }
+
         /* Allocate stream for body */
         guac_stream* stream = guac_user_alloc_stream(user);
         stream->ack_handler = guac_common_ssh_sftp_ack_handler;
-        stream->data = file;
+        stream->data = transfer;
 
         /* Associate new stream with get request */
         guac_protocol_send_body(user->socket, object, stream,
@@ -920,6 +1216,9 @@ static int guac_common_ssh_sftp_put_handler(guac_user* user,
             LIBSSH2_FXF_WRITE | LIBSSH2_FXF_CREAT | LIBSSH2_FXF_TRUNC,
             S_IRUSR | S_IWUSR);
 
+    /* Any cached listing of the destination directory is now stale */
+    guac_common_dircache_invalidate(filesystem->dircache, fullpath);
+
     /* Acknowledge stream if successful */
     if (file != NULL) {
         guac_user_log(user, GUAC_LOG_DEBUG, "File \"%s\" opened", fullpath);
@@ -939,8 +1238,9 @@ static int guac_common_ssh_sftp_put_handler(guac_user* user,
     stream->blob_handler = guac_common_ssh_sftp_blob_handler;
     stream->end_handler = guac_common_ssh_sftp_end_handler;
 
-    /* Store file within stream */
-    stream->data = file;
+    /* Store upload state within stream */
+    stream->data = (file != NULL)
+        ? guac_common_ssh_sftp_transfer_alloc(file) : NULL;
 
     guac_socket_flush(user->socket);
     return 0;
@@ -1012,6 +1312,9 @@ guac_common_ssh_sftp_filesystem* guac_common_ssh_create_sftp_filesystem(
     /* Initially upload files to current directory */
     strcpy(filesystem->upload_path, ".");
 
+    /* No directories have been listed yet */
+    filesystem->dircache = guac_common_dircache_alloc(GUAC_COMMON_DIRCACHE_TTL);
+
     /* Return allocated filesystem */
     return filesystem;
 
@@ -1024,6 +1327,7 @@ void guac_common_ssh_destroy_sftp_filesystem(
     libssh2_sftp_shutdown(filesystem->sftp_session);
 
     /* Free associated memory */
+    guac_common_dircache_free(filesystem->dircache);
     free(filesystem->name);
     free(filesystem);
 
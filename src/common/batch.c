@@ -0,0 +1,520 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "common/batch.h"
+
+#include <guacamole/timestamp.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+guac_common_batch* guac_common_batch_alloc(int jobs, size_t memory_limit,
+        size_t job_overhead, int resume) {
+
+    guac_common_batch* batch = malloc(sizeof(guac_common_batch));
+    if (batch == NULL)
+        return NULL;
+
+    batch->size = GUAC_COMMON_BATCH_INITIAL_FILES;
+    batch->length = 0;
+    batch->files = malloc(sizeof(guac_common_batch_file) * batch->size);
+    if (batch->files == NULL) {
+        free(batch);
+        return NULL;
+    }
+
+    batch->jobs = jobs > 0 ? jobs : 1;
+    batch->memory_limit = memory_limit;
+    batch->job_overhead = job_overhead;
+    batch->resume = resume;
+
+    batch->succeeded = 0;
+    batch->failed = 0;
+    batch->skipped = 0;
+
+    batch->_handler = NULL;
+    batch->_data = NULL;
+    batch->_queue = NULL;
+    batch->_next = 0;
+    batch->_running = 0;
+    batch->_memory_used = 0;
+
+    pthread_mutex_init(&batch->_lock, NULL);
+    pthread_cond_init(&batch->_finished, NULL);
+
+    return batch;
+
+}
+
+void guac_common_batch_free(guac_common_batch* batch) {
+
+    int i;
+
+    for (i = 0; i < batch->length; i++) {
+        free(batch->files[i].path);
+        free(batch->files[i].out_path);
+    }
+
+    pthread_cond_destroy(&batch->_finished);
+    pthread_mutex_destroy(&batch->_lock);
+
+    free(batch->files);
+    free(batch);
+
+}
+
+/**
+ * Returns whether the given output file exists and is at least as new as the
+ * given input file.
+ *
+ * @param input
+ *     The result of a successful stat() of the input file.
+ *
+ * @param out_path
+ *     The path of the output file.
+ *
+ * @return
+ *     Non-zero if the output file is up to date, zero otherwise.
+ */
+static int guac_common_batch_up_to_date(struct stat* input,
+        const char* out_path) {
+
+    struct stat output;
+    if (stat(out_path, &output))
+        return 0;
+
+    return S_ISREG(output.st_mode) && output.st_mtime >= input->st_mtime;
+
+}
+
+int guac_common_batch_add(guac_common_batch* batch, const char* path,
+        const char* out_path) {
+
+    /* Expand storage if necessary */
+    if (batch->length == batch->size) {
+
+        int size = batch->size * 2;
+        guac_common_batch_file* files = realloc(batch->files,
+                sizeof(guac_common_batch_file) * size);
+
+        if (files == NULL)
+            return 1;
+
+        batch->files = files;
+        batch->size = size;
+
+    }
+
+    char* path_copy = strdup(path);
+    char* out_path_copy = strdup(out_path);
+    if (path_copy == NULL || out_path_copy == NULL) {
+        free(path_copy);
+        free(out_path_copy);
+        return 1;
+    }
+
+    guac_common_batch_file* file = &batch->files[batch->length++];
+    file->path = path_copy;
+    file->out_path = out_path_copy;
+    file->size = 0;
+    file->status = GUAC_COMMON_BATCH_PENDING;
+    file->duration = 0;
+
+    /* Files which cannot be read are still processed, leaving the handler
+     * to report the failure */
+    struct stat input;
+    if (stat(path, &input))
+        return 0;
+
+    file->size = input.st_size;
+
+    if (batch->resume && guac_common_batch_up_to_date(&input, out_path)) {
+        file->status = GUAC_COMMON_BATCH_SKIPPED;
+        batch->skipped++;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Returns the estimated amount of memory required to process the given file,
+ * in bytes.
+ *
+ * @param batch
+ *     The batch containing the file.
+ *
+ * @param file
+ *     The file whose memory requirements should be estimated.
+ *
+ * @return
+ *     The estimated amount of memory required to process the file, in bytes.
+ */
+static size_t guac_common_batch_memory(guac_common_batch* batch,
+        guac_common_batch_file* file) {
+
+    if ((uintmax_t) file->size > SIZE_MAX - batch->job_overhead)
+        return SIZE_MAX;
+
+    return batch->job_overhead + file->size;
+
+}
+
+/**
+ * Comparator for qsort() which orders pointers to files by decreasing size,
+ * keeping files of equal size in the order they were added.
+ */
+static int guac_common_batch_compare(const void* a, const void* b) {
+
+    const guac_common_batch_file* file_a =
+        *((guac_common_batch_file* const*) a);
+    const guac_common_batch_file* file_b =
+        *((guac_common_batch_file* const*) b);
+
+    if (file_a->size != file_b->size)
+        return file_a->size < file_b->size ? 1 : -1;
+
+    return file_a < file_b ? -1 : (file_a > file_b);
+
+}
+
+/**
+ * Takes the largest pending file which fits within the remaining memory
+ * budget, marking that file as running, and waiting for other files to
+ * finish if no pending file fits. The lock of the batch must be held.
+ *
+ * @param batch
+ *     The batch to take a file from.
+ *
+ * @return
+ *     The file taken, or NULL if no pending files remain.
+ */
+static guac_common_batch_file* guac_common_batch_take(
+        guac_common_batch* batch) {
+
+    int i;
+
+    for (;;) {
+
+        /* Skip past files already taken */
+        while (batch->_next < batch->length
+                && batch->_queue[batch->_next]->status
+                    != GUAC_COMMON_BATCH_PENDING)
+            batch->_next++;
+
+        if (batch->_next == batch->length)
+            return NULL;
+
+        /* Take the largest pending file that fits, ignoring the limit
+         * entirely if nothing else is running */
+        for (i = batch->_next; i < batch->length; i++) {
+
+            guac_common_batch_file* file = batch->_queue[i];
+            if (file->status != GUAC_COMMON_BATCH_PENDING)
+                continue;
+
+            size_t memory = guac_common_batch_memory(batch, file);
+            if (batch->_running == 0 || batch->memory_limit == 0
+                    || (memory <= batch->memory_limit
+                        && batch->_memory_used
+                            <= batch->memory_limit - memory)) {
+                file->status = GUAC_COMMON_BATCH_RUNNING;
+                batch->_memory_used += memory;
+                batch->_running++;
+                return file;
+            }
+
+        }
+
+        /* Wait for memory to be released by a running file */
+        pthread_cond_wait(&batch->_finished, &batch->_lock);
+
+    }
+
+}
+
+/**
+ * Processes the given file with the handler of the given batch, recording
+ * the outcome and duration within the file. If the batch is being resumed,
+ * output is written to a temporary file which replaces the final output
+ * only if processing succeeds.
+ *
+ * @param batch
+ *     The batch containing the file.
+ *
+ * @param file
+ *     The file to process.
+ *
+ * @return
+ *     Zero on success, non-zero if processing failed.
+ */
+static int guac_common_batch_process(guac_common_batch* batch,
+        guac_common_batch_file* file) {
+
+    guac_timestamp start = guac_timestamp_current();
+    int failed;
+
+    if (batch->resume) {
+
+        size_t length = strlen(file->out_path);
+        char* partial_path = malloc(length
+                + sizeof(GUAC_COMMON_BATCH_PARTIAL_SUFFIX));
+        if (partial_path == NULL)
+            return 1;
+
+        memcpy(partial_path, file->out_path, length);
+        memcpy(partial_path + length, GUAC_COMMON_BATCH_PARTIAL_SUFFIX,
+                sizeof(GUAC_COMMON_BATCH_PARTIAL_SUFFIX));
+
+        /* Discard anything left behind by an interrupted batch */
+        unlink(partial_path);
+
+        failed = batch->_handler(file->path, partial_path, batch->_data);
+        if (!failed && rename(partial_path, file->out_path))
+            failed = 1;
+
+        if (failed)
+            unlink(partial_path);
+
+        free(partial_path);
+
+    }
+
+    else
+        failed = batch->_handler(file->path, file->out_path, batch->_data);
+
+    file->duration = guac_timestamp_current() - start;
+    return failed;
+
+}
+
+/**
+ * Worker thread which repeatedly takes and processes pending files from the
+ * given batch until no pending files remain.
+ *
+ * @param data
+ *     The guac_common_batch being processed.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_common_batch_worker(void* data) {
+
+    guac_common_batch* batch = (guac_common_batch*) data;
+    guac_common_batch_file* file;
+
+    pthread_mutex_lock(&batch->_lock);
+
+    while ((file = guac_common_batch_take(batch)) != NULL) {
+
+        pthread_mutex_unlock(&batch->_lock);
+        int failed = guac_common_batch_process(batch, file);
+        pthread_mutex_lock(&batch->_lock);
+
+        if (failed) {
+            file->status = GUAC_COMMON_BATCH_FAILED;
+            batch->failed++;
+        }
+        else {
+            file->status = GUAC_COMMON_BATCH_SUCCEEDED;
+            batch->succeeded++;
+        }
+
+        batch->_memory_used -= guac_common_batch_memory(batch, file);
+        batch->_running--;
+        pthread_cond_broadcast(&batch->_finished);
+
+    }
+
+    pthread_mutex_unlock(&batch->_lock);
+    return NULL;
+
+}
+
+int guac_common_batch_run(guac_common_batch* batch,
+        guac_common_batch_handler* handler, void* data) {
+
+    int i;
+
+    batch->_queue = malloc(sizeof(guac_common_batch_file*) * batch->length);
+    if (batch->_queue == NULL && batch->length > 0)
+        return batch->length;
+
+    /* Start with the largest files, as these bound the total duration */
+    int pending = 0;
+    for (i = 0; i < batch->length; i++) {
+        batch->_queue[i] = &batch->files[i];
+        if (batch->files[i].status == GUAC_COMMON_BATCH_PENDING)
+            pending++;
+    }
+
+    qsort(batch->_queue, batch->length, sizeof(guac_common_batch_file*),
+            guac_common_batch_compare);
+
+    batch->_handler = handler;
+    batch->_data = data;
+    batch->_next = 0;
+
+    /* The calling thread is itself one of the workers */
+    int jobs = batch->jobs < pending ? batch->jobs : pending;
+    pthread_t* threads = NULL;
+    int started = 0;
+
+    if (jobs > 1) {
+        threads = malloc(sizeof(pthread_t) * (jobs - 1));
+        if (threads != NULL) {
+            for (; started < jobs - 1; started++) {
+                if (pthread_create(&threads[started], NULL,
+                            guac_common_batch_worker, batch))
+                    break;
+            }
+        }
+    }
+
+    guac_common_batch_worker(batch);
+
+    for (i = 0; i < started; i++)
+        pthread_join(threads[i], NULL);
+
+    free(threads);
+    free(batch->_queue);
+
+    batch->_queue = NULL;
+    batch->_handler = NULL;
+    batch->_data = NULL;
+
+    return batch->failed;
+
+}
+
+/**
+ * Writes the given path to the given file, escaping any tabs, newlines and
+ * backslashes with backslashes.
+ *
+ * @param output
+ *     The file to write to.
+ *
+ * @param path
+ *     The path to write.
+ *
+ * @return
+ *     Zero on success, non-zero if the path could not be written.
+ */
+static int guac_common_batch_write_path(FILE* output, const char* path) {
+
+    for (; *path != '\0'; path++) {
+
+        int written;
+        switch (*path) {
+
+            case '\t':
+                written = fputs("\\t", output);
+                break;
+
+            case '\n':
+                written = fputs("\\n", output);
+                break;
+
+            case '\r':
+                written = fputs("\\r", output);
+                break;
+
+            case '\\':
+                written = fputs("\\\\", output);
+                break;
+
+            default:
+                written = fputc(*path, output);
+                break;
+
+        }
+
+        if (written == EOF)
+            return 1;
+
+    }
+
+    return 0;
+
+}
+
+int guac_common_batch_write_summary(guac_common_batch* batch, FILE* output) {
+
+    int i;
+
+    if (fputs("path\tstatus\tbytes\tmilliseconds\tbytes_per_second\n",
+                output) == EOF)
+        return 1;
+
+    for (i = 0; i < batch->length; i++) {
+
+        guac_common_batch_file* file = &batch->files[i];
+
+        const char* status;
+        switch (file->status) {
+
+            case GUAC_COMMON_BATCH_SUCCEEDED:
+                status = "succeeded";
+                break;
+
+            case GUAC_COMMON_BATCH_FAILED:
+                status = "failed";
+                break;
+
+            case GUAC_COMMON_BATCH_SKIPPED:
+                status = "skipped";
+                break;
+
+            default:
+                status = "pending";
+                break;
+
+        }
+
+        /* Throughput is only meaningful for files actually processed, and
+         * durations below the timer resolution are rounded up */
+        uint64_t throughput = 0;
+        if (file->status == GUAC_COMMON_BATCH_SUCCEEDED
+                || file->status == GUAC_COMMON_BATCH_FAILED) {
+            guac_timestamp duration = file->duration > 0 ? file->duration : 1;
+            throughput = (uint64_t) file->size * 1000 / duration;
+        }
+
+        if (guac_common_batch_write_path(output, file->path)
+                || fprintf(output, "\t%s\t%" PRIu64 "\t%" PRId64 "\t%" PRIu64
+                    "\n", status, (uint64_t) file->size,
+                    (int64_t) file->duration, throughput) < 0)
+            return 1;
+
+    }
+
+    return fflush(output) == EOF;
+
+}
+
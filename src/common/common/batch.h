@@ -0,0 +1,347 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_COMMON_BATCH_H
+#define GUAC_COMMON_BATCH_H
+
+#include "config.h"
+
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/**
+ * The number of files for which space is initially allocated within a
+ * guac_common_batch. Space for additional files is allocated as needed.
+ */
+#define GUAC_COMMON_BATCH_INITIAL_FILES 64
+
+/**
+ * The suffix appended to the path of each output file to produce the path of
+ * the temporary file written while a batch is being resumed. The temporary
+ * file is renamed to its final path only once processing has succeeded, such
+ * that an interrupted batch never leaves behind a partial output which would
+ * later be mistaken for a complete one.
+ */
+#define GUAC_COMMON_BATCH_PARTIAL_SUFFIX ".partial"
+
+/**
+ * The state of a single file within a batch.
+ */
+typedef enum guac_common_batch_status {
+
+    /**
+     * The file has not yet been processed.
+     */
+    GUAC_COMMON_BATCH_PENDING,
+
+    /**
+     * The file is currently being processed by a worker thread.
+     */
+    GUAC_COMMON_BATCH_RUNNING,
+
+    /**
+     * The file was processed successfully.
+     */
+    GUAC_COMMON_BATCH_SUCCEEDED,
+
+    /**
+     * Processing of the file failed.
+     */
+    GUAC_COMMON_BATCH_FAILED,
+
+    /**
+     * The file was not processed, as its output was already up to date.
+     */
+    GUAC_COMMON_BATCH_SKIPPED
+
+} guac_common_batch_status;
+
+/**
+ * Function which processes a single input file of a batch, writing the
+ * result to the given output path. Handlers are invoked concurrently from
+ * multiple threads, each for a different file.
+ *
+ * @param path
+ *     The path of the input file.
+ *
+ * @param out_path
+ *     The path of the output file which should be written.
+ *
+ * @param data
+ *     The arbitrary data given to guac_common_batch_run().
+ *
+ * @return
+ *     Zero on success, non-zero if processing of the file failed.
+ */
+typedef int guac_common_batch_handler(const char* path, const char* out_path,
+        void* data);
+
+/**
+ * A single input file within a batch, along with the result of processing
+ * that file.
+ */
+typedef struct guac_common_batch_file {
+
+    /**
+     * The path of the input file.
+     */
+    char* path;
+
+    /**
+     * The path of the output file.
+     */
+    char* out_path;
+
+    /**
+     * The size of the input file, in bytes, or zero if the input file could
+     * not be read.
+     */
+    off_t size;
+
+    /**
+     * The current state of the file. This value is guarded by the lock of
+     * the batch containing the file.
+     */
+    guac_common_batch_status status;
+
+    /**
+     * The amount of time taken to process the file, in milliseconds. This
+     * value is only meaningful once processing has completed.
+     */
+    guac_timestamp duration;
+
+} guac_common_batch_file;
+
+/**
+ * A set of input files which are processed concurrently by a pool of worker
+ * threads. Each idle worker takes the largest pending file whose estimated
+ * memory requirements fit within the remaining memory budget, such that
+ * large files are started early and do not dominate the end of the batch.
+ */
+typedef struct guac_common_batch {
+
+    /**
+     * All files within the batch, in the order they were added.
+     */
+    guac_common_batch_file* files;
+
+    /**
+     * The number of files within the batch.
+     */
+    int length;
+
+    /**
+     * The number of files for which space has been allocated.
+     */
+    int size;
+
+    /**
+     * The maximum number of files which may be processed at once.
+     */
+    int jobs;
+
+    /**
+     * The approximate amount of memory which may be used by all files being
+     * processed at once, in bytes, or zero if there is no limit. A single
+     * file whose estimate alone exceeds this limit is still processed, but
+     * only while no other file is being processed.
+     */
+    size_t memory_limit;
+
+    /**
+     * The approximate amount of memory required to process any file, in
+     * bytes, in addition to the size of the file itself.
+     */
+    size_t job_overhead;
+
+    /**
+     * Non-zero if files whose output is already up to date should be
+     * skipped, and outputs should be written via temporary files, zero
+     * otherwise.
+     */
+    int resume;
+
+    /**
+     * The number of files which were processed successfully.
+     */
+    int succeeded;
+
+    /**
+     * The number of files whose processing failed.
+     */
+    int failed;
+
+    /**
+     * The number of files which were skipped because their output was
+     * already up to date.
+     */
+    int skipped;
+
+    /**
+     * The handler being invoked for each file, valid only while
+     * guac_common_batch_run() is running.
+     */
+    guac_common_batch_handler* _handler;
+
+    /**
+     * The arbitrary data given to guac_common_batch_run().
+     */
+    void* _data;
+
+    /**
+     * All files within the batch in order of decreasing size, valid only
+     * while guac_common_batch_run() is running.
+     */
+    guac_common_batch_file** _queue;
+
+    /**
+     * The index within the queue of the first file which may still be
+     * pending. All preceding files have already been taken by a worker.
+     */
+    int _next;
+
+    /**
+     * The number of files currently being processed.
+     */
+    int _running;
+
+    /**
+     * The total estimated memory required by all files currently being
+     * processed, in bytes.
+     */
+    size_t _memory_used;
+
+    /**
+     * Lock which guards the state of all files and the overall progress of
+     * the batch.
+     */
+    pthread_mutex_t _lock;
+
+    /**
+     * Condition which is signalled whenever a file finishes processing,
+     * releasing its share of the memory budget.
+     */
+    pthread_cond_t _finished;
+
+} guac_common_batch;
+
+/**
+ * Allocates a new, empty batch.
+ *
+ * @param jobs
+ *     The maximum number of files which may be processed at once.
+ *
+ * @param memory_limit
+ *     The approximate amount of memory which may be used by all files being
+ *     processed at once, in bytes, or zero if there is no limit.
+ *
+ * @param job_overhead
+ *     The approximate amount of memory required to process any file, in
+ *     bytes, in addition to the size of the file itself.
+ *
+ * @param resume
+ *     Non-zero if files whose output is already up to date should be
+ *     skipped, zero if all files should be processed. If non-zero, outputs
+ *     are written to temporary files which replace any existing, out-of-date
+ *     output only once processing succeeds.
+ *
+ * @return
+ *     A newly-allocated, empty batch, or NULL if memory could not be
+ *     allocated.
+ */
+guac_common_batch* guac_common_batch_alloc(int jobs, size_t memory_limit,
+        size_t job_overhead, int resume);
+
+/**
+ * Frees the given batch and all files within it.
+ *
+ * @param batch
+ *     The batch to free.
+ */
+void guac_common_batch_free(guac_common_batch* batch);
+
+/**
+ * Adds the given input file to the given batch. If the batch is being
+ * resumed and the output file already exists and is no older than the input
+ * file, the file is marked as skipped and will not be processed. Files must
+ * not be added while the batch is running.
+ *
+ * @param batch
+ *     The batch to add the file to.
+ *
+ * @param path
+ *     The path of the input file.
+ *
+ * @param out_path
+ *     The path of the output file.
+ *
+ * @return
+ *     Zero on success, non-zero if space for the file could not be
+ *     allocated.
+ */
+int guac_common_batch_add(guac_common_batch* batch, const char* path,
+        const char* out_path);
+
+/**
+ * Processes all pending files within the given batch using the given
+ * handler, returning only once every file has been processed. The calling
+ * thread acts as one of the workers.
+ *
+ * @param batch
+ *     The batch to process.
+ *
+ * @param handler
+ *     The function to invoke for each pending file.
+ *
+ * @param data
+ *     Arbitrary data to pass to each invocation of the handler.
+ *
+ * @return
+ *     The number of files whose processing failed.
+ */
+int guac_common_batch_run(guac_common_batch* batch,
+        guac_common_batch_handler* handler, void* data);
+
+/**
+ * Writes a machine-readable summary of the given batch to the given file.
+ * The summary consists of a header line followed by one line per file, in
+ * the order the files were added, each containing the following
+ * tab-separated fields: the input path, the status ("succeeded", "failed",
+ * "skipped" or "pending"), the input size in bytes, the processing time in
+ * milliseconds, and the throughput in bytes per second. Any tabs, newlines
+ * or backslashes within paths are escaped with backslashes.
+ *
+ * @param batch
+ *     The batch to summarize.
+ *
+ * @param output
+ *     The file to write the summary to.
+ *
+ * @return
+ *     Zero on success, non-zero if the summary could not be written.
+ */
+int guac_common_batch_write_summary(guac_common_batch* batch, FILE* output);
+
+#endif
+
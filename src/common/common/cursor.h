@@ -26,13 +26,26 @@
 #include <cairo/cairo.h>
 #include <guacamole/client.h>
 #include <guacamole/socket.h>
+#include <guacamole/timer.h>
+#include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 
+#include <pthread.h>
+
 /**
  * The default size of the cursor image buffer.
  */
 #define GUAC_COMMON_CURSOR_DEFAULT_SIZE 64*64*4
 
+/**
+ * The default minimum amount of time between broadcasts of the mouse cursor
+ * position to users other than the user moving the mouse, in milliseconds.
+ * This is roughly the duration of one frame. If no frame is flushed within
+ * this interval of the mouse moving, the latest position is broadcast and
+ * flushed on its own.
+ */
+#define GUAC_COMMON_CURSOR_BROADCAST_INTERVAL 40
+
 /**
  * Cursor object which maintains and synchronizes the current mouse cursor
  * state across all users of a specific client.
@@ -123,6 +136,40 @@ typedef struct guac_common_cursor {
      */
     guac_timestamp timestamp;
 
+    /**
+     * Whether the mouse location or button state has changed since the
+     * last time it was broadcast to all users via guac_common_cursor_flush().
+     */
+    int pending;
+
+    /**
+     * The server timestamp representing the point in time when the mouse
+     * location was last broadcast to all users.
+     */
+    guac_timestamp last_broadcast;
+
+    /**
+     * The minimum amount of time between broadcasts of the mouse location,
+     * in milliseconds. This is also the maximum amount of time a change in
+     * mouse location may wait for the next frame before being broadcast on
+     * its own. This defaults to GUAC_COMMON_CURSOR_BROADCAST_INTERVAL.
+     */
+    int broadcast_interval;
+
+    /**
+     * One-shot timer which broadcasts and flushes any pending change in
+     * mouse location if no frame has done so within the broadcast interval,
+     * or NULL if the timer could not be allocated.
+     */
+    guac_timer* _broadcast_timer;
+
+    /**
+     * Lock which guards the mouse location, button state, and broadcast
+     * state of this cursor, as these are updated by user input threads
+     * while being broadcast by the thread rendering frames.
+     */
+    pthread_mutex_t _lock;
+
 } guac_common_cursor;
 
 /**
@@ -165,7 +212,9 @@ void guac_common_cursor_dup(guac_common_cursor* cursor, guac_user* user,
 /**
  * Updates the current position and button state of the mouse cursor, marking
  * the given user as the most recent user of the mouse. The remote mouse cursor
- * will be hidden for this user and shown for all others.
+ * will be hidden for this user and shown for all others. The new state is not
+ * sent to other users until the next call to guac_common_cursor_flush(), or
+ * until the broadcast interval elapses without such a call.
  *
  * @param cursor
  *     The cursor being updated.
@@ -195,6 +244,20 @@ void guac_common_cursor_dup(guac_common_cursor* cursor, guac_user* user,
 void guac_common_cursor_update(guac_common_cursor* cursor, guac_user* user,
         int x, int y, int button_mask);
 
+/**
+ * Sends the latest position and button state of the mouse cursor to all
+ * users except the user that moved the cursor last, if that state has changed
+ * since the last broadcast and the broadcast interval of the cursor has
+ * elapsed. This function does not flush any sockets, and is intended to be
+ * invoked once per frame, prior to guac_client_end_frame(). Changes which are
+ * not broadcast by a frame within the broadcast interval, such as when the
+ * display is otherwise unchanged, are broadcast and flushed automatically.
+ *
+ * @param cursor
+ *     The cursor whose state should be broadcast.
+ */
+void guac_common_cursor_flush(guac_common_cursor* cursor);
+
 /**
  * Sets the cursor image to the given raw image data. This raw image data must
  * be in 32-bit ARGB format, having 8 bits per color component, where the
@@ -0,0 +1,254 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_COMMON_DAMAGE_H
+#define GUAC_COMMON_DAMAGE_H
+
+#include "config.h"
+#include "common/rect.h"
+
+#include <stdint.h>
+
+/**
+ * The region of a single cell of a guac_common_damage map which has been
+ * modified, relative to the upper-left corner of that cell.
+ */
+typedef struct guac_common_damage_cell {
+
+    /**
+     * The X coordinate of the upper-left corner of the modified region,
+     * relative to the left edge of the cell.
+     */
+    uint16_t x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the modified region,
+     * relative to the top edge of the cell.
+     */
+    uint16_t y;
+
+    /**
+     * The width of the modified region, or 0 if the cell is unmodified.
+     */
+    uint16_t width;
+
+    /**
+     * The height of the modified region, or 0 if the cell is unmodified.
+     */
+    uint16_t height;
+
+} guac_common_damage_cell;
+
+/**
+ * A map of the modified regions of an image, divided into a grid of square
+ * cells. Each cell tracks the bounding rectangle of the modifications within
+ * that cell, while a bitmap of modified cells allows the modified regions to
+ * be quickly scanned and extracted as a small set of rectangles.
+ */
+typedef struct guac_common_damage {
+
+    /**
+     * The width and height of each cell, in pixels.
+     */
+    int cell_size;
+
+    /**
+     * The width of the image, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the image, in pixels.
+     */
+    int height;
+
+    /**
+     * The number of columns of cells.
+     */
+    int columns;
+
+    /**
+     * The number of rows of cells.
+     */
+    int rows;
+
+    /**
+     * The number of 64-bit words within each row of the bitmap.
+     */
+    int words;
+
+    /**
+     * Bitmap containing one bit per cell, set if that cell has been modified.
+     * The bit for the cell at column N of a row is bit (N % 64) of word
+     * (N / 64) of that row.
+     */
+    uint64_t* bitmap;
+
+    /**
+     * The modified region of each cell, stored row by row.
+     */
+    guac_common_damage_cell* cells;
+
+    /**
+     * The number of cells which have been modified.
+     */
+    int modified;
+
+    /**
+     * The index of the first row which may contain modified cells. All rows
+     * above this row are guaranteed to be unmodified.
+     */
+    int first_row;
+
+    /**
+     * A rectangle containing all modified regions. This rectangle is only
+     * meaningful if at least one cell has been modified, and may be larger
+     * than necessary if rectangles have since been extracted.
+     */
+    guac_common_rect bounds;
+
+} guac_common_damage;
+
+/**
+ * Allocates a new, unmodified damage map for an image of the given size.
+ *
+ * @param cell_size
+ *     The width and height of each cell of the map, in pixels. This value
+ *     must not exceed 65535.
+ *
+ * @param width
+ *     The width of the image, in pixels.
+ *
+ * @param height
+ *     The height of the image, in pixels.
+ *
+ * @return
+ *     A newly-allocated damage map, or NULL if allocation fails.
+ */
+guac_common_damage* guac_common_damage_alloc(int cell_size, int width,
+        int height);
+
+/**
+ * Frees the given damage map.
+ *
+ * @param damage
+ *     The damage map to free.
+ */
+void guac_common_damage_free(guac_common_damage* damage);
+
+/**
+ * Resizes the given damage map to fit an image of the given size. Any
+ * modified regions within the new bounds of the image are preserved.
+ *
+ * @param damage
+ *     The damage map to resize.
+ *
+ * @param width
+ *     The new width of the image, in pixels.
+ *
+ * @param height
+ *     The new height of the image, in pixels.
+ *
+ * @return
+ *     Zero if the map was resized successfully, non-zero if allocation fails,
+ *     in which case the map is left unchanged.
+ */
+int guac_common_damage_resize(guac_common_damage* damage, int width,
+        int height);
+
+/**
+ * Marks the given rectangle as modified. Any portion of the rectangle outside
+ * the bounds of the image is ignored.
+ *
+ * @param damage
+ *     The damage map to update.
+ *
+ * @param rect
+ *     The rectangle which has been modified.
+ */
+void guac_common_damage_add(guac_common_damage* damage,
+        const guac_common_rect* rect);
+
+/**
+ * Returns whether any modified region intersects the given rectangle.
+ *
+ * @param damage
+ *     The damage map to check.
+ *
+ * @param rect
+ *     The rectangle to check.
+ *
+ * @return
+ *     Non-zero if any modified region intersects the given rectangle, zero
+ *     otherwise.
+ */
+int guac_common_damage_intersects(const guac_common_damage* damage,
+        const guac_common_rect* rect);
+
+/**
+ * Returns the number of pixels by which the modified regions of the given
+ * damage map would grow if the given rectangle were marked as modified.
+ * As each cell tracks only the bounding rectangle of its modifications, this
+ * may be larger than the area of the rectangle itself.
+ *
+ * @param damage
+ *     The damage map to check.
+ *
+ * @param rect
+ *     The rectangle which may be marked as modified.
+ *
+ * @return
+ *     The number of pixels which would be newly considered modified.
+ */
+int guac_common_damage_cost(const guac_common_damage* damage,
+        const guac_common_rect* rect);
+
+/**
+ * Removes the next rectangle of modified regions from the given damage map,
+ * storing that rectangle within the given guac_common_rect. Rectangles are
+ * produced roughly top to bottom. Each rectangle covers a rectangular block
+ * of modified cells, trimmed to the modified regions within those cells, and
+ * no two rectangles cover the same cell. Repeatedly invoking this function
+ * until it returns zero thus produces a set of non-overlapping rectangles
+ * covering all modifications.
+ *
+ * @param damage
+ *     The damage map to extract a rectangle from.
+ *
+ * @param rect
+ *     The rectangle to populate with the next modified region.
+ *
+ * @return
+ *     Non-zero if a rectangle was extracted, zero if no modified regions
+ *     remain.
+ */
+int guac_common_damage_next(guac_common_damage* damage,
+        guac_common_rect* rect);
+
+/**
+ * Marks every cell of the given damage map as unmodified.
+ *
+ * @param damage
+ *     The damage map to clear.
+ */
+void guac_common_damage_clear(guac_common_damage* damage);
+
+#endif
+
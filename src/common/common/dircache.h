@@ -0,0 +1,256 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_COMMON_DIRCACHE_H
+#define GUAC_COMMON_DIRCACHE_H
+
+#include "config.h"
+
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+
+/**
+ * The maximum number of directory listings stored within a
+ * guac_common_dircache. If the cache is full, the oldest listing is evicted
+ * to make room for a new listing.
+ */
+#define GUAC_COMMON_DIRCACHE_SIZE 64
+
+/**
+ * The default amount of time that a cached directory listing remains valid,
+ * in milliseconds. Listings are invalidated sooner if the contents of the
+ * directory are changed through the filesystem owning the cache, but changes
+ * made by other means can only be noticed once this time has elapsed.
+ */
+#define GUAC_COMMON_DIRCACHE_TTL 5000
+
+/**
+ * The number of entries for which space is initially allocated within each
+ * directory listing. Space for additional entries is allocated as needed.
+ */
+#define GUAC_COMMON_DIRCACHE_INITIAL_ENTRIES 64
+
+/**
+ * A single entry within a cached directory listing.
+ */
+typedef struct guac_common_dircache_entry {
+
+    /**
+     * The name of the file, without any leading path.
+     */
+    char* name;
+
+    /**
+     * Non-zero if the file is a directory (or a link to a directory), zero
+     * otherwise.
+     */
+    int directory;
+
+} guac_common_dircache_entry;
+
+/**
+ * The complete contents of a single directory. Once stored within a
+ * guac_common_dircache, a listing is never modified, and may be read by any
+ * number of threads until released.
+ */
+typedef struct guac_common_dircache_listing {
+
+    /**
+     * The path of the directory, as given to
+     * guac_common_dircache_listing_alloc().
+     */
+    char* path;
+
+    /**
+     * All entries within the directory, in the order they were added.
+     */
+    guac_common_dircache_entry* entries;
+
+    /**
+     * The number of entries within the directory.
+     */
+    int length;
+
+    /**
+     * The number of entries for which space has been allocated.
+     */
+    int size;
+
+    /**
+     * The time at which reading of the directory began, which is the point
+     * from which the listing's time-to-live is measured.
+     */
+    guac_timestamp timestamp;
+
+    /**
+     * The number of references to this listing, including the reference held
+     * by the cache itself, if any. This value is guarded by the lock of the
+     * cache containing the listing.
+     */
+    int refcount;
+
+} guac_common_dircache_listing;
+
+/**
+ * A cache of directory listings, keyed by directory path. Paths are compared
+ * without regard to trailing slashes, and path components are assumed to be
+ * separated by "/".
+ */
+typedef struct guac_common_dircache {
+
+    /**
+     * All cached listings, where unused slots are NULL.
+     */
+    guac_common_dircache_listing* listings[GUAC_COMMON_DIRCACHE_SIZE];
+
+    /**
+     * The amount of time that each listing remains valid, in milliseconds.
+     */
+    int ttl;
+
+    /**
+     * Lock which guards the cached listings and their reference counts.
+     */
+    pthread_mutex_t _lock;
+
+} guac_common_dircache;
+
+/**
+ * Allocates a new, empty directory cache.
+ *
+ * @param ttl
+ *     The amount of time that each listing should remain valid, in
+ *     milliseconds.
+ *
+ * @return
+ *     A newly-allocated, empty directory cache.
+ */
+guac_common_dircache* guac_common_dircache_alloc(int ttl);
+
+/**
+ * Frees the given directory cache, releasing all cached listings. Listings
+ * still referenced elsewhere are not freed until released.
+ *
+ * @param cache
+ *     The directory cache to free.
+ */
+void guac_common_dircache_free(guac_common_dircache* cache);
+
+/**
+ * Allocates a new, empty directory listing which may be populated with
+ * guac_common_dircache_listing_add() and then stored within a cache with
+ * guac_common_dircache_put(). The returned listing holds a single reference,
+ * which must eventually be released with guac_common_dircache_release().
+ *
+ * @param path
+ *     The path of the directory being listed.
+ *
+ * @return
+ *     A newly-allocated, empty directory listing.
+ */
+guac_common_dircache_listing* guac_common_dircache_listing_alloc(
+        const char* path);
+
+/**
+ * Appends a new entry to the given directory listing. The listing must not
+ * yet have been stored within a cache.
+ *
+ * @param listing
+ *     The directory listing to append an entry to.
+ *
+ * @param name
+ *     The name of the file, without any leading path.
+ *
+ * @param directory
+ *     Non-zero if the file is a directory, zero otherwise.
+ *
+ * @return
+ *     Zero on success, non-zero if space for the entry could not be
+ *     allocated.
+ */
+int guac_common_dircache_listing_add(guac_common_dircache_listing* listing,
+        const char* name, int directory);
+
+/**
+ * Stores the given complete directory listing within the given cache,
+ * replacing any listing for the same directory. The cache acquires its own
+ * reference to the listing; the caller's reference remains valid and must
+ * still be released.
+ *
+ * @param cache
+ *     The directory cache to store the listing within.
+ *
+ * @param listing
+ *     The complete directory listing to store.
+ */
+void guac_common_dircache_put(guac_common_dircache* cache,
+        guac_common_dircache_listing* listing);
+
+/**
+ * Returns the cached listing of the directory having the given path, if such
+ * a listing exists and has not expired. The returned listing holds a new
+ * reference, which must be released with guac_common_dircache_release().
+ *
+ * @param cache
+ *     The directory cache to search.
+ *
+ * @param path
+ *     The path of the directory.
+ *
+ * @return
+ *     The cached listing of the given directory, or NULL if no valid listing
+ *     is cached.
+ */
+guac_common_dircache_listing* guac_common_dircache_get(
+        guac_common_dircache* cache, const char* path);
+
+/**
+ * Releases a reference to the given directory listing, freeing the listing
+ * if no references remain.
+ *
+ * @param cache
+ *     The directory cache which contains (or would have contained) the
+ *     listing.
+ *
+ * @param listing
+ *     The directory listing to release.
+ */
+void guac_common_dircache_release(guac_common_dircache* cache,
+        guac_common_dircache_listing* listing);
+
+/**
+ * Invalidates any cached listings which may be affected by a change to the
+ * file at the given path: the listing of its parent directory, the listing
+ * of the file itself if it is a directory, and the listings of any of its
+ * subdirectories. If the path is relative, the affected directory cannot be
+ * determined and all listings are invalidated.
+ *
+ * @param cache
+ *     The directory cache to invalidate listings within.
+ *
+ * @param path
+ *     The path of the file which was created, modified, renamed, or deleted.
+ */
+void guac_common_dircache_invalidate(guac_common_dircache* cache,
+        const char* path);
+
+#endif
+
@@ -40,7 +40,8 @@ typedef void guac_iconv_write(char** output, int remaining, int value);
  * Converts characters within a given string from one encoding to another,
  * as defined by the reader/writer functions specified. The input and output
  * string pointers will be updated based on the number of bytes read or
- * written.
+ * written. Runs of ASCII characters are converted in bulk where both the
+ * reader and writer are among those defined here.
  *
  * @param reader The reader function to use when reading the input string.
  * @param input Pointer to the beginning of the input string.
@@ -76,6 +77,26 @@ guac_iconv_read GUAC_READ_CP1252;
  */
 guac_iconv_read GUAC_READ_ISO8859_1;
 
+/**
+ * Read function for UTF8 which normalizes CRLF line endings to LF.
+ */
+guac_iconv_read GUAC_READ_UTF8_NORMALIZED;
+
+/**
+ * Read function for UTF16 which normalizes CRLF line endings to LF.
+ */
+guac_iconv_read GUAC_READ_UTF16_NORMALIZED;
+
+/**
+ * Read function for CP-1252 which normalizes CRLF line endings to LF.
+ */
+guac_iconv_read GUAC_READ_CP1252_NORMALIZED;
+
+/**
+ * Read function for ISO-8859-1 which normalizes CRLF line endings to LF.
+ */
+guac_iconv_read GUAC_READ_ISO8859_1_NORMALIZED;
+
 /**
  * Write function for UTF8.
  */
@@ -96,5 +117,25 @@ guac_iconv_write GUAC_WRITE_CP1252;
  */
 guac_iconv_write GUAC_WRITE_ISO8859_1;
 
+/**
+ * Write function for UTF8 which writes line feeds as CRLF line endings.
+ */
+guac_iconv_write GUAC_WRITE_UTF8_CRLF;
+
+/**
+ * Write function for UTF16 which writes line feeds as CRLF line endings.
+ */
+guac_iconv_write GUAC_WRITE_UTF16_CRLF;
+
+/**
+ * Write function for CP-1252 which writes line feeds as CRLF line endings.
+ */
+guac_iconv_write GUAC_WRITE_CP1252_CRLF;
+
+/**
+ * Write function for ISO-8859-1 which writes line feeds as CRLF line endings.
+ */
+guac_iconv_write GUAC_WRITE_ISO8859_1_CRLF;
+
 #endif
 
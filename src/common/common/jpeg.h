@@ -0,0 +1,48 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef __GUAC_COMMON_JPEG_H
+#define __GUAC_COMMON_JPEG_H
+
+#include "config.h"
+
+#include <cairo/cairo.h>
+
+/**
+ * Decodes the given JPEG image, returning a new Cairo surface containing the
+ * decoded image. Unlike libjpeg's default error handling, corrupt or
+ * truncated JPEG data results only in failure of this function, and does not
+ * terminate the process.
+ *
+ * @param data
+ *     The JPEG data to decode.
+ *
+ * @param length
+ *     The number of bytes of JPEG data.
+ *
+ * @return
+ *     A newly-allocated RGB24 Cairo surface containing the decoded image,
+ *     which must eventually be freed with cairo_surface_destroy(), or NULL if
+ *     the JPEG data could not be decoded.
+ */
+cairo_surface_t* guac_common_jpeg_decode(const unsigned char* data,
+        int length);
+
+#endif
+
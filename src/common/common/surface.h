@@ -21,7 +21,9 @@
 #define __GUAC_COMMON_SURFACE_H
 
 #include "config.h"
+#include "damage.h"
 #include "rect.h"
+#include "video.h"
 
 #include <cairo/cairo.h>
 #include <guacamole/client.h>
@@ -31,14 +33,10 @@
 
 #include <pthread.h>
 
-/**
- * The maximum number of updates to allow within the bitmap queue.
- */
-#define GUAC_COMMON_SURFACE_QUEUE_SIZE 256
-
 /**
  * Heat map cell size in pixels. Each side of each heat map cell will consist
- * of this many pixels.
+ * of this many pixels. The cells of the damage map of each surface are the
+ * same size and alignment as the cells of its heat map.
  */
 #define GUAC_COMMON_SURFACE_HEAT_CELL_SIZE 64
 
@@ -58,6 +56,51 @@
  */
 #define GUAC_COMMON_SURFACE_HEAT_CELL_HISTORY_SIZE 5
 
+/**
+ * The maximum number of bytes of cached snapshot PNG data to send within each
+ * blob when synchronizing a surface with a joining user.
+ */
+#define GUAC_COMMON_SURFACE_SNAPSHOT_BLOB_SIZE 6048
+
+/**
+ * The average framerate, in frames per second, above which a region of a
+ * visible layer is considered to contain video (or similar continuous motion)
+ * and may be streamed as video rather than as a series of images.
+ */
+#define GUAC_COMMON_SURFACE_VIDEO_FRAMERATE 10
+
+/**
+ * The minimum width and height of a region, in pixels, that may be streamed
+ * as video.
+ */
+#define GUAC_COMMON_SURFACE_VIDEO_MIN_DIMENSION 128
+
+/**
+ * The size of the grid, in pixels, to which the region covered by a video
+ * stream is aligned. This is the size of an H.264 macroblock.
+ */
+#define GUAC_COMMON_SURFACE_VIDEO_BLOCK_SIZE 16
+
+/**
+ * The number of milliseconds that the region covered by a video stream may go
+ * without changing before the video stream is ended. This is also the minimum
+ * amount of time between the end of one video stream and the beginning of
+ * the next.
+ */
+#define GUAC_COMMON_SURFACE_VIDEO_TIMEOUT 1000
+
+/**
+ * The maximum number of JPEG images which may be passed through to the client
+ * without yet having been decoded into the surface.
+ */
+#define GUAC_COMMON_SURFACE_JPEG_QUEUE_SIZE 64
+
+/**
+ * The maximum number of bytes of passed-through JPEG data to send within each
+ * blob.
+ */
+#define GUAC_COMMON_SURFACE_JPEG_BLOB_SIZE 6048
+
 /**
  * Representation of a cell in the refresh heat map. This cell is used to keep
  * track of how often an area on a surface is refreshed.
@@ -82,22 +125,27 @@ typedef struct guac_common_surface_heat_cell {
 } guac_common_surface_heat_cell;
 
 /**
- * Representation of a bitmap update, having a rectangle of image data (stored
- * elsewhere) and a flushed/not-flushed state.
+ * A JPEG image which has been sent to the client as-is, but which has not yet
+ * been decoded into the surface.
  */
-typedef struct guac_common_surface_bitmap_rect {
+typedef struct guac_common_surface_jpeg {
 
     /**
-     * Whether this rectangle has been flushed.
+     * The rectangle covered by the JPEG image.
      */
-    int flushed;
+    guac_common_rect rect;
 
     /**
-     * The rectangle containing the bitmap update.
+     * The JPEG data.
      */
-    guac_common_rect rect;
+    unsigned char* data;
 
-} guac_common_surface_bitmap_rect;
+    /**
+     * The number of bytes of JPEG data.
+     */
+    int length;
+
+} guac_common_surface_jpeg;
 
 /**
  * Surface which backs a Guacamole buffer or layer, automatically
@@ -187,14 +235,11 @@ typedef struct guac_common_surface {
     int opacity_dirty;
 
     /**
-     * Non-zero if this surface is dirty and needs to be flushed, 0 otherwise.
+     * The regions of this surface which have changed and have not yet been
+     * flushed. Each changed region is sent as image data when the surface is
+     * next flushed.
      */
-    int dirty;
-
-    /**
-     * The dirty rectangle.
-     */
-    guac_common_rect dirty_rect;
+    guac_common_damage* damage;
 
     /**
      * Whether the surface actually exists on the client.
@@ -213,20 +258,79 @@ typedef struct guac_common_surface {
     guac_common_rect clip_rect;
 
     /**
-     * The number of updates in the bitmap queue.
+     * A heat map keeping track of the refresh frequency of
+     * the areas of the screen, or NULL if this surface is an off-screen
+     * buffer, for which refresh frequency is not tracked.
      */
-    int bitmap_queue_length;
+    guac_common_surface_heat_cell* heat_map;
 
     /**
-     * All queued bitmap updates.
+     * PNG-encoded copy of the entire contents of this surface, as last sent to
+     * a joining user by guac_common_surface_dup(), or NULL if no such copy
+     * exists or the surface has since changed. Caching this snapshot allows
+     * any number of users joining in quick succession to be synchronized
+     * with a single encode.
      */
-    guac_common_surface_bitmap_rect bitmap_queue[GUAC_COMMON_SURFACE_QUEUE_SIZE];
+    unsigned char* snapshot;
 
     /**
-     * A heat map keeping track of the refresh frequency of
-     * the areas of the screen.
+     * The number of bytes of PNG data within the snapshot.
      */
-    guac_common_surface_heat_cell* heat_map;
+    int snapshot_length;
+
+    /**
+     * The number of bytes allocated for the snapshot.
+     */
+    int snapshot_size;
+
+    /**
+     * The number of JPEG images within the JPEG queue.
+     */
+    int jpeg_queue_length;
+
+    /**
+     * All JPEG images which have been drawn with
+     * guac_common_surface_draw_jpeg() and sent to the client, but have not
+     * yet been decoded into the surface, in the order they were drawn. Each
+     * image is decoded only once the region it covers is next read or
+     * modified, and is discarded without ever being decoded if completely
+     * covered by a later JPEG image.
+     */
+    guac_common_surface_jpeg jpeg_queue[GUAC_COMMON_SURFACE_JPEG_QUEUE_SIZE];
+
+    /**
+     * The video stream currently covering the region of this surface which
+     * has been changing at a video-like rate, or NULL if no such stream
+     * exists. While a video stream exists, updates entirely within its region
+     * are sent only as video, and the contents of the underlying layer
+     * within that region are out of date.
+     */
+    guac_common_video* video;
+
+    /**
+     * The region of this surface covered by the current video stream. This
+     * value is only meaningful if video is non-NULL.
+     */
+    guac_common_rect video_rect;
+
+    /**
+     * Whether the region covered by the current video stream has changed
+     * since the last video frame was sent.
+     */
+    int video_dirty;
+
+    /**
+     * Whether the current video stream must be ended at the next flush, as
+     * it has not been received by all users.
+     */
+    int video_stale;
+
+    /**
+     * The time at which the region covered by the current video stream last
+     * changed, or at which the most recent video stream ended if there is no
+     * current video stream.
+     */
+    guac_timestamp video_updated;
 
     /**
      * Mutex which is locked internally when access to the surface must be
@@ -299,6 +403,42 @@ void guac_common_surface_resize(guac_common_surface* surface, int w, int h);
 void guac_common_surface_draw(guac_common_surface* surface, int x, int y,
         cairo_surface_t* src);
 
+/**
+ * Draws the given JPEG image to the given guac_common_surface, sending the
+ * JPEG data to the client verbatim rather than re-encoding the decoded image.
+ * Decoding of the image into the surface is deferred until the region it
+ * covers is next needed. If the JPEG cannot be passed through as-is (for
+ * example, if it is partially clipped), it is decoded and drawn as if by
+ * guac_common_surface_draw().
+ *
+ * @param surface
+ *     The surface to draw to.
+ *
+ * @param x
+ *     The X coordinate of the draw location.
+ *
+ * @param y
+ *     The Y coordinate of the draw location.
+ *
+ * @param w
+ *     The width of the JPEG image, in pixels.
+ *
+ * @param h
+ *     The height of the JPEG image, in pixels.
+ *
+ * @param data
+ *     The JPEG data to draw.
+ *
+ * @param length
+ *     The number of bytes of JPEG data.
+ *
+ * @return
+ *     Zero if the JPEG was drawn successfully, non-zero if the JPEG data
+ *     could not be decoded.
+ */
+int guac_common_surface_draw_jpeg(guac_common_surface* surface, int x, int y,
+        int w, int h, const unsigned char* data, int length);
+
 /**
  * Paints to the given guac_common_surface using the given data as a stencil,
  * filling opaque regions with the specified color, and leaving transparent
@@ -385,6 +525,75 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
 void guac_common_surface_set(guac_common_surface* surface, int x, int y,
         int w, int h, int red, int green, int blue, int alpha);
 
+/**
+ * Notifies the given surface that a rectangle of its buffer has been modified
+ * directly, rather than through the drawing functions of the surface, such
+ * that the modified region will be sent to connected users as part of the next
+ * flush. This allows another drawing implementation (such as FreeRDP's GDI) to
+ * render into the surface buffer in place. Such an implementation must be
+ * informed whenever the surface is resized, as the buffer is reallocated.
+ * The current clipping rectangle is ignored.
+ *
+ * @param surface
+ *     The surface whose buffer has been modified.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the modified rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the modified rectangle.
+ *
+ * @param w
+ *     The width of the modified rectangle.
+ *
+ * @param h
+ *     The height of the modified rectangle.
+ */
+void guac_common_surface_invalidate(guac_common_surface* surface, int x,
+        int y, int w, int h);
+
+/**
+ * Callback invoked by guac_common_surface_modify() while the surface is
+ * locked, and thus may safely write to the surface buffer directly. The
+ * callback must not invoke any other guac_common_surface function on the same
+ * surface.
+ *
+ * @param surface
+ *     The surface whose buffer may be modified.
+ *
+ * @param data
+ *     The arbitrary data provided to guac_common_surface_modify().
+ *
+ * @return
+ *     Zero if the buffer was modified successfully, non-zero otherwise. This
+ *     value is returned by guac_common_surface_modify().
+ */
+typedef int guac_common_surface_modify_callback(guac_common_surface* surface,
+        void* data);
+
+/**
+ * Invokes the given callback with the surface locked, allowing its buffer to
+ * be modified in place by a decoder or other drawing implementation without
+ * racing concurrent flushes, resizes, or joining users. Any queued JPEG draws
+ * are realized beforehand so that they cannot later overwrite the modified
+ * contents. Modified regions are not sent until reported with
+ * guac_common_surface_invalidate() once this function has returned.
+ *
+ * @param surface
+ *     The surface whose buffer should be modified.
+ *
+ * @param callback
+ *     The callback to invoke while the surface is locked.
+ *
+ * @param data
+ *     Arbitrary data to pass to the callback.
+ *
+ * @return
+ *     The value returned by the callback.
+ */
+int guac_common_surface_modify(guac_common_surface* surface,
+        guac_common_surface_modify_callback* callback, void* data);
+
 /**
  * Given the coordinates and dimensions of a rectangle, clips all future
  * operations within that rectangle.
@@ -486,5 +695,25 @@ void guac_common_surface_flush(guac_common_surface* surface);
 void guac_common_surface_dup(guac_common_surface* surface, guac_user* user,
         guac_socket* socket);
 
+/**
+ * Encodes the entire contents of the given surface as PNG, returning a newly
+ * allocated copy of the encoded data. This allows the contents of a surface
+ * to be retained compactly while the surface itself is freed. The returned
+ * data must eventually be freed with free().
+ *
+ * @param surface
+ *     The surface to encode.
+ *
+ * @param length
+ *     Pointer to an int which will receive the number of bytes of PNG data
+ *     returned.
+ *
+ * @return
+ *     A newly allocated buffer containing the PNG-encoded contents of the
+ *     surface, or NULL if the surface is empty or could not be encoded.
+ */
+unsigned char* guac_common_surface_export(guac_common_surface* surface,
+        int* length);
+
 #endif
 
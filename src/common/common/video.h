@@ -0,0 +1,136 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef __GUAC_COMMON_VIDEO_H
+#define __GUAC_COMMON_VIDEO_H
+
+#include "config.h"
+#include "rect.h"
+
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+#include <guacamole/socket.h>
+#include <guacamole/timestamp.h>
+
+/**
+ * The mimetype of the video streams produced by guac_common_video: a raw
+ * H.264 elementary stream in Annex B format, with parameter sets repeated
+ * in-band at each keyframe.
+ */
+#define GUAC_COMMON_VIDEO_MIMETYPE "video/h264"
+
+/**
+ * The maximum number of bytes of encoded video to send within each blob.
+ */
+#define GUAC_COMMON_VIDEO_BLOB_SIZE 6048
+
+/**
+ * The maximum number of frames between keyframes.
+ */
+#define GUAC_COMMON_VIDEO_KEYFRAME_INTERVAL 50
+
+/**
+ * The target bitrate of each video stream, in bits per second for each pixel
+ * of the streamed region.
+ */
+#define GUAC_COMMON_VIDEO_BITRATE_PER_PIXEL 4
+
+/**
+ * A single H.264 video stream, played back by the client within a dedicated
+ * layer covering a rectangular region of some other layer. The details of
+ * the underlying encoder are private to the implementation.
+ */
+typedef struct guac_common_video guac_common_video;
+
+/**
+ * Returns whether video streams can be produced for the given client. Video
+ * can be produced only if an H.264 encoder is available and all users of the
+ * given client have declared support for GUAC_COMMON_VIDEO_MIMETYPE.
+ *
+ * @param client
+ *     The client to check for video support.
+ *
+ * @return
+ *     Non-zero if video streams can be sent to all users of the given client,
+ *     zero otherwise.
+ */
+int guac_common_video_supported(guac_client* client);
+
+/**
+ * Allocates a new video stream covering the given rectangle of the given
+ * layer, creating a new layer to contain the video and sending the "video"
+ * instruction which begins the stream. The dimensions of the rectangle must
+ * be even.
+ *
+ * @param client
+ *     The client to which the video will be streamed.
+ *
+ * @param socket
+ *     The socket over which all instructions and encoded video should be
+ *     sent.
+ *
+ * @param parent
+ *     The visible layer being covered by the video.
+ *
+ * @param rect
+ *     The region of the parent layer to be covered by the video.
+ *
+ * @return
+ *     A newly-allocated guac_common_video, or NULL if the video encoder could
+ *     not be initialized.
+ */
+guac_common_video* guac_common_video_alloc(guac_client* client,
+        guac_socket* socket, const guac_layer* parent,
+        const guac_common_rect* rect);
+
+/**
+ * Encodes the given image data as the next frame of the given video, sending
+ * any resulting video data as blobs. The image data must be 32-bit ARGB, as
+ * used by Cairo, with the same dimensions as the video.
+ *
+ * @param video
+ *     The video to encode a frame of.
+ *
+ * @param buffer
+ *     The first pixel of the image data to encode.
+ *
+ * @param stride
+ *     The number of bytes in each row of image data.
+ *
+ * @param timestamp
+ *     The time at which the frame should be presented.
+ *
+ * @return
+ *     Zero if the frame was encoded successfully, non-zero otherwise.
+ */
+int guac_common_video_encode(guac_common_video* video,
+        const unsigned char* buffer, int stride, guac_timestamp timestamp);
+
+/**
+ * Ends the given video stream, disposing of the layer containing the video
+ * and freeing all associated resources. Any frames still buffered within the
+ * encoder are discarded.
+ *
+ * @param video
+ *     The video to free.
+ */
+void guac_common_video_free(guac_common_video* video);
+
+#endif
+
@@ -28,6 +28,7 @@
 #include <guacamole/client.h>
 #include <guacamole/protocol.h>
 #include <guacamole/socket.h>
+#include <guacamole/timer.h>
 #include <guacamole/timestamp.h>
 #include <guacamole/user.h>
 
@@ -36,6 +37,8 @@
 #include <string.h>
 
 
+static guac_timer_callback guac_common_cursor_broadcast_deferred;
+
 /**
  * Allocates a cursor as well as an image buffer where the cursor is rendered.
  *
@@ -70,6 +73,14 @@ guac_common_cursor* guac_common_cursor_alloc(guac_client* client) {
     cursor->user = NULL;
     cursor->timestamp = guac_timestamp_current();
 
+    /* Nothing to broadcast yet */
+    cursor->pending = 0;
+    cursor->last_broadcast = cursor->timestamp;
+    cursor->broadcast_interval = GUAC_COMMON_CURSOR_BROADCAST_INTERVAL;
+    cursor->_broadcast_timer = guac_timer_alloc(
+            guac_common_cursor_broadcast_deferred, cursor);
+    pthread_mutex_init(&(cursor->_lock), NULL);
+
     /* Start cursor in upper-left */
     cursor->x = 0;
     cursor->y = 0;
@@ -84,6 +95,9 @@ void guac_common_cursor_free(guac_common_cursor* cursor) {
     guac_layer* buffer = cursor->buffer;
     cairo_surface_t* surface = cursor->surface;
 
+    /* Stop any deferred broadcast before the cursor is torn down */
+    guac_timer_free(cursor->_broadcast_timer);
+
     /* Free image buffer and surface */
     free(cursor->image_buffer);
     if (surface != NULL)
@@ -95,6 +109,7 @@ void guac_common_cursor_free(guac_common_cursor* cursor) {
     /* Return buffer to pool */
     guac_client_free_buffer(client, buffer);
 
+    pthread_mutex_destroy(&(cursor->_lock));
     free(cursor);
 
 }
@@ -103,8 +118,10 @@ void guac_common_cursor_dup(guac_common_cursor* cursor, guac_user* user,
         guac_socket* socket) {
 
     /* Synchronize location */
+    pthread_mutex_lock(&(cursor->_lock));
     guac_protocol_send_mouse(socket, cursor->x, cursor->y, cursor->button_mask,
             cursor->timestamp);
+    pthread_mutex_unlock(&(cursor->_lock));
 
     /* Synchronize cursor image */
     if (cursor->surface != NULL) {
@@ -126,7 +143,8 @@ void guac_common_cursor_dup(guac_common_cursor* cursor, guac_user* user,
 /**
  * Callback for guac_client_foreach_user() which sends the current cursor
  * position and button state to any given user except the user that moved the
- * cursor last.
+ * cursor last. The user's socket is not flushed; it will be flushed along with
+ * the rest of the frame.
  *
  * @param data
  *     A pointer to the guac_common_cursor whose state should be broadcast to
@@ -141,11 +159,9 @@ static void* guac_common_cursor_broadcast_state(guac_user* user,
     guac_common_cursor* cursor = (guac_common_cursor*) data;
 
     /* Send cursor state only if the user is not moving the cursor */
-    if (user != cursor->user) {
+    if (user != cursor->user)
         guac_protocol_send_mouse(user->socket, cursor->x, cursor->y,
                 cursor->button_mask, cursor->timestamp);
-        guac_socket_flush(user->socket);
-    }
 
     return NULL;
 
@@ -154,6 +170,8 @@ static void* guac_common_cursor_broadcast_state(guac_user* user,
 void guac_common_cursor_update(guac_common_cursor* cursor, guac_user* user,
         int x, int y, int button_mask) {
 
+    pthread_mutex_lock(&(cursor->_lock));
+
     /* Update current user of cursor */
     cursor->user = user;
 
@@ -165,10 +183,86 @@ void guac_common_cursor_update(guac_common_cursor* cursor, guac_user* user,
     /* Store time at which cursor was updated */
     cursor->timestamp = guac_timestamp_current();
 
+    /* Other users will be notified of the new state at the end of the
+     * frame, or once the broadcast interval elapses if no frame is sent */
+    if (!cursor->pending && cursor->_broadcast_timer != NULL)
+        guac_timer_schedule(cursor->_broadcast_timer,
+                cursor->broadcast_interval);
+
+    cursor->pending = 1;
+
+    pthread_mutex_unlock(&(cursor->_lock));
+
+}
+
+/**
+ * Broadcasts the latest cursor state to all users except the user that moved
+ * the cursor last, if that state has changed since the last broadcast and the
+ * broadcast interval has elapsed. The cursor lock must already be held.
+ *
+ * @param cursor
+ *     The cursor whose state should be broadcast.
+ *
+ * @return
+ *     The number of milliseconds remaining until the pending state may be
+ *     broadcast, zero if the state was broadcast, or -1 if nothing is
+ *     pending.
+ */
+static int guac_common_cursor_broadcast(guac_common_cursor* cursor) {
+
+    if (!cursor->pending)
+        return -1;
+
+    /* Broadcast only the latest state, and no more often than allowed */
+    guac_timestamp now = guac_timestamp_current();
+    guac_timestamp elapsed = now - cursor->last_broadcast;
+    if (elapsed < cursor->broadcast_interval)
+        return cursor->broadcast_interval - elapsed;
+
     /* Notify all other users of change in cursor state */
     guac_client_foreach_user(cursor->client,
             guac_common_cursor_broadcast_state, cursor);
 
+    cursor->pending = 0;
+    cursor->last_broadcast = now;
+    return 0;
+
+}
+
+/**
+ * Timer callback which broadcasts and flushes any change in cursor state that
+ * no frame has yet broadcast, rescheduling itself if the broadcast interval
+ * has not yet elapsed since the last broadcast.
+ *
+ * @param timer
+ *     The broadcast timer of the cursor.
+ *
+ * @param data
+ *     The guac_common_cursor whose state should be broadcast.
+ */
+static void guac_common_cursor_broadcast_deferred(guac_timer* timer,
+        void* data) {
+
+    guac_common_cursor* cursor = (guac_common_cursor*) data;
+
+    pthread_mutex_lock(&(cursor->_lock));
+    int remaining = guac_common_cursor_broadcast(cursor);
+    if (remaining > 0)
+        guac_timer_schedule(timer, remaining);
+    pthread_mutex_unlock(&(cursor->_lock));
+
+    /* No frame is pending which would otherwise flush the new state */
+    if (remaining == 0)
+        guac_socket_flush(cursor->client->socket);
+
+}
+
+void guac_common_cursor_flush(guac_common_cursor* cursor) {
+
+    pthread_mutex_lock(&(cursor->_lock));
+    guac_common_cursor_broadcast(cursor);
+    pthread_mutex_unlock(&(cursor->_lock));
+
 }
 
 /**
@@ -299,8 +393,10 @@ void guac_common_cursor_remove_user(guac_common_cursor* cursor,
         guac_user* user) {
 
     /* Disassociate from given user */
+    pthread_mutex_lock(&(cursor->_lock));
     if (cursor->user == user)
         cursor->user = NULL;
+    pthread_mutex_unlock(&(cursor->_lock));
 
 }
 
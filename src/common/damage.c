@@ -0,0 +1,492 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "common/damage.h"
+#include "common/rect.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Returns a pointer to the first word of the given row of the bitmap of the
+ * given damage map.
+ *
+ * @param damage
+ *     The damage map containing the bitmap.
+ *
+ * @param row
+ *     The index of the row.
+ *
+ * @return
+ *     A pointer to the first word of the requested row of the bitmap.
+ */
+static uint64_t* guac_common_damage_bitmap_row(
+        const guac_common_damage* damage, int row) {
+    return damage->bitmap + row * damage->words;
+}
+
+/**
+ * Returns the column of the first cell at or after the given column within
+ * the given row whose modified state matches the given state.
+ *
+ * @param damage
+ *     The damage map to search.
+ *
+ * @param row
+ *     The index of the row to search.
+ *
+ * @param column
+ *     The column at which to begin searching.
+ *
+ * @param modified
+ *     Non-zero to search for the first modified cell, zero to search for the
+ *     first unmodified cell.
+ *
+ * @return
+ *     The column of the first cell having the given state, or the number of
+ *     columns in the damage map if no such cell exists.
+ */
+static int guac_common_damage_find(const guac_common_damage* damage,
+        int row, int column, int modified) {
+
+    const uint64_t* bitmap = guac_common_damage_bitmap_row(damage, row);
+
+    while (column < damage->columns) {
+
+        /* Invert the current word if searching for unmodified cells, such
+         * that the search is always for set bits */
+        int index = column / 64;
+        uint64_t word = modified ? bitmap[index] : ~bitmap[index];
+
+        /* Ignore bits before the current column */
+        word &= ~UINT64_C(0) << (column % 64);
+
+        if (word != 0) {
+            column = index * 64 + __builtin_ctzll(word);
+            break;
+        }
+
+        column = (index + 1) * 64;
+
+    }
+
+    /* Bits past the last column are never set, but may have been inverted */
+    if (column > damage->columns)
+        column = damage->columns;
+
+    return column;
+
+}
+
+/**
+ * Marks the region of the given rectangle which lies within the given cell
+ * as modified. The rectangle must intersect the cell.
+ *
+ * @param damage
+ *     The damage map to update.
+ *
+ * @param row
+ *     The row of the cell.
+ *
+ * @param column
+ *     The column of the cell.
+ *
+ * @param rect
+ *     The modified rectangle, which must already be clipped to the bounds of
+ *     the image.
+ */
+static void guac_common_damage_add_cell(guac_common_damage* damage,
+        int row, int column, const guac_common_rect* rect) {
+
+    guac_common_damage_cell* cell =
+        &damage->cells[row * damage->columns + column];
+
+    /* Determine portion of rectangle within cell, relative to cell */
+    int cell_x = column * damage->cell_size;
+    int cell_y = row * damage->cell_size;
+
+    int left   = rect->x - cell_x;
+    int top    = rect->y - cell_y;
+    int right  = left + rect->width;
+    int bottom = top + rect->height;
+
+    if (left < 0) left = 0;
+    if (top  < 0) top  = 0;
+    if (right  > damage->cell_size) right  = damage->cell_size;
+    if (bottom > damage->cell_size) bottom = damage->cell_size;
+
+    /* Newly-modified cells need only be marked */
+    if (cell->width == 0) {
+        uint64_t* bitmap = guac_common_damage_bitmap_row(damage, row);
+        bitmap[column / 64] |= UINT64_C(1) << (column % 64);
+        damage->modified++;
+    }
+
+    /* Otherwise, expand existing region */
+    else {
+        if (left > cell->x) left = cell->x;
+        if (top  > cell->y) top  = cell->y;
+        if (right  < cell->x + cell->width)  right  = cell->x + cell->width;
+        if (bottom < cell->y + cell->height) bottom = cell->y + cell->height;
+    }
+
+    cell->x = left;
+    cell->y = top;
+    cell->width = right - left;
+    cell->height = bottom - top;
+
+}
+
+/**
+ * Clips the given rectangle to the bounds of the image tracked by the given
+ * damage map, and determines the range of cells covered by the clipped
+ * rectangle.
+ *
+ * @param damage
+ *     The damage map whose bounds should be used.
+ *
+ * @param rect
+ *     The rectangle to clip.
+ *
+ * @param clipped
+ *     The rectangle to populate with the clipped rectangle.
+ *
+ * @param min_column
+ *     Pointer to the int which should receive the first column covered.
+ *
+ * @param min_row
+ *     Pointer to the int which should receive the first row covered.
+ *
+ * @param max_column
+ *     Pointer to the int which should receive the last column covered.
+ *
+ * @param max_row
+ *     Pointer to the int which should receive the last row covered.
+ *
+ * @return
+ *     Non-zero if the clipped rectangle is non-empty, zero otherwise.
+ */
+static int guac_common_damage_clip(const guac_common_damage* damage,
+        const guac_common_rect* rect, guac_common_rect* clipped,
+        int* min_column, int* min_row, int* max_column, int* max_row) {
+
+    guac_common_rect bounds;
+    guac_common_rect_init(&bounds, 0, 0, damage->width, damage->height);
+
+    *clipped = *rect;
+    guac_common_rect_constrain(clipped, &bounds);
+    if (clipped->width <= 0 || clipped->height <= 0)
+        return 0;
+
+    *min_column = clipped->x / damage->cell_size;
+    *min_row    = clipped->y / damage->cell_size;
+    *max_column = (clipped->x + clipped->width  - 1) / damage->cell_size;
+    *max_row    = (clipped->y + clipped->height - 1) / damage->cell_size;
+
+    return 1;
+
+}
+
+guac_common_damage* guac_common_damage_alloc(int cell_size, int width,
+        int height) {
+
+    guac_common_damage* damage = calloc(1, sizeof(guac_common_damage));
+    if (damage == NULL)
+        return NULL;
+
+    damage->cell_size = cell_size;
+    damage->width = width;
+    damage->height = height;
+    damage->columns = (width + cell_size - 1) / cell_size;
+    damage->rows = (height + cell_size - 1) / cell_size;
+    damage->words = (damage->columns + 63) / 64;
+    damage->first_row = damage->rows;
+
+    /* Always allocate at least one element, such that allocation failure is
+     * distinguishable from an empty image */
+    damage->bitmap = calloc(damage->rows * damage->words + 1,
+            sizeof(uint64_t));
+    damage->cells = calloc(damage->rows * damage->columns + 1,
+            sizeof(guac_common_damage_cell));
+
+    if (damage->bitmap == NULL || damage->cells == NULL) {
+        guac_common_damage_free(damage);
+        return NULL;
+    }
+
+    return damage;
+
+}
+
+void guac_common_damage_free(guac_common_damage* damage) {
+    free(damage->bitmap);
+    free(damage->cells);
+    free(damage);
+}
+
+int guac_common_damage_resize(guac_common_damage* damage, int width,
+        int height) {
+
+    guac_common_damage* resized = guac_common_damage_alloc(damage->cell_size,
+            width, height);
+    if (resized == NULL)
+        return 1;
+
+    /* Copy each modified region, clipped to the new bounds */
+    for (int row = damage->first_row; row < damage->rows; row++) {
+
+        int column = guac_common_damage_find(damage, row, 0, 1);
+        while (column < damage->columns) {
+
+            guac_common_damage_cell* cell =
+                &damage->cells[row * damage->columns + column];
+
+            guac_common_rect rect;
+            guac_common_rect_init(&rect,
+                    column * damage->cell_size + cell->x,
+                    row * damage->cell_size + cell->y,
+                    cell->width, cell->height);
+
+            guac_common_damage_add(resized, &rect);
+
+            column = guac_common_damage_find(damage, row, column + 1, 1);
+
+        }
+
+    }
+
+    /* Replace contents of original map with those of the resized map */
+    free(damage->bitmap);
+    free(damage->cells);
+    *damage = *resized;
+    free(resized);
+
+    return 0;
+
+}
+
+void guac_common_damage_add(guac_common_damage* damage,
+        const guac_common_rect* rect) {
+
+    guac_common_rect clipped;
+    int min_column, min_row, max_column, max_row;
+
+    if (!guac_common_damage_clip(damage, rect, &clipped,
+                &min_column, &min_row, &max_column, &max_row))
+        return;
+
+    int was_empty = (damage->modified == 0);
+
+    /* Mark all cells covered by the rectangle */
+    for (int row = min_row; row <= max_row; row++) {
+        for (int column = min_column; column <= max_column; column++)
+            guac_common_damage_add_cell(damage, row, column, &clipped);
+    }
+
+    if (min_row < damage->first_row)
+        damage->first_row = min_row;
+
+    /* Update overall bounds */
+    if (was_empty)
+        damage->bounds = clipped;
+    else
+        guac_common_rect_extend(&damage->bounds, &clipped);
+
+}
+
+int guac_common_damage_intersects(const guac_common_damage* damage,
+        const guac_common_rect* rect) {
+
+    guac_common_rect clipped;
+    int min_column, min_row, max_column, max_row;
+
+    /* Quickly reject rectangles outside all modified regions */
+    if (damage->modified == 0
+            || !guac_common_rect_intersects(&damage->bounds, rect))
+        return 0;
+
+    if (!guac_common_damage_clip(damage, rect, &clipped,
+                &min_column, &min_row, &max_column, &max_row))
+        return 0;
+
+    /* Check modified region of each covered cell */
+    for (int row = min_row; row <= max_row; row++) {
+
+        int column = guac_common_damage_find(damage, row, min_column, 1);
+        while (column <= max_column) {
+
+            const guac_common_damage_cell* cell =
+                &damage->cells[row * damage->columns + column];
+
+            guac_common_rect modified;
+            guac_common_rect_init(&modified,
+                    column * damage->cell_size + cell->x,
+                    row * damage->cell_size + cell->y,
+                    cell->width, cell->height);
+
+            if (guac_common_rect_intersects(&modified, &clipped))
+                return 1;
+
+            column = guac_common_damage_find(damage, row, column + 1, 1);
+
+        }
+
+    }
+
+    return 0;
+
+}
+
+int guac_common_damage_cost(const guac_common_damage* damage,
+        const guac_common_rect* rect) {
+
+    guac_common_rect clipped;
+    int min_column, min_row, max_column, max_row;
+
+    if (!guac_common_damage_clip(damage, rect, &clipped,
+                &min_column, &min_row, &max_column, &max_row))
+        return 0;
+
+    int cost = 0;
+
+    for (int row = min_row; row <= max_row; row++) {
+        for (int column = min_column; column <= max_column; column++) {
+
+            const guac_common_damage_cell* cell =
+                &damage->cells[row * damage->columns + column];
+
+            /* Portion of rectangle within cell, relative to cell */
+            int cell_x = column * damage->cell_size;
+            int cell_y = row * damage->cell_size;
+
+            int left   = clipped.x - cell_x;
+            int top    = clipped.y - cell_y;
+            int right  = left + clipped.width;
+            int bottom = top + clipped.height;
+
+            if (left < 0) left = 0;
+            if (top  < 0) top  = 0;
+            if (right  > damage->cell_size) right  = damage->cell_size;
+            if (bottom > damage->cell_size) bottom = damage->cell_size;
+
+            /* Unmodified cells grow by the area of the rectangle alone */
+            if (cell->width == 0) {
+                cost += (right - left) * (bottom - top);
+                continue;
+            }
+
+            /* Modified cells grow to the bounds of both regions */
+            if (left > cell->x) left = cell->x;
+            if (top  > cell->y) top  = cell->y;
+            if (right  < cell->x + cell->width)  right  = cell->x + cell->width;
+            if (bottom < cell->y + cell->height) bottom = cell->y + cell->height;
+
+            cost += (right - left) * (bottom - top)
+                  - cell->width * cell->height;
+
+        }
+    }
+
+    return cost;
+
+}
+
+int guac_common_damage_next(guac_common_damage* damage,
+        guac_common_rect* rect) {
+
+    int row;
+    int column = damage->columns;
+
+    /* Find first modified cell */
+    for (row = damage->first_row; row < damage->rows; row++) {
+
+        column = guac_common_damage_find(damage, row, 0, 1);
+        if (column < damage->columns)
+            break;
+
+    }
+
+    /* All rows above the current row are now known to be unmodified */
+    damage->first_row = row;
+    if (row >= damage->rows)
+        return 0;
+
+    /* Extend to the right across all adjacent modified cells */
+    int end_column = guac_common_damage_find(damage, row, column, 0);
+
+    /* Extend downward while the same columns are modified in the next row */
+    int end_row = row + 1;
+    while (end_row < damage->rows
+            && guac_common_damage_find(damage, end_row, column, 1) == column
+            && guac_common_damage_find(damage, end_row, column, 0)
+                >= end_column)
+        end_row++;
+
+    /* Remove each covered cell, accumulating its modified region */
+    int first = 1;
+    for (int y = row; y < end_row; y++) {
+
+        uint64_t* bitmap = guac_common_damage_bitmap_row(damage, y);
+
+        for (int x = column; x < end_column; x++) {
+
+            guac_common_damage_cell* cell =
+                &damage->cells[y * damage->columns + x];
+
+            guac_common_rect modified;
+            guac_common_rect_init(&modified,
+                    x * damage->cell_size + cell->x,
+                    y * damage->cell_size + cell->y,
+                    cell->width, cell->height);
+
+            if (first) {
+                *rect = modified;
+                first = 0;
+            }
+            else
+                guac_common_rect_extend(rect, &modified);
+
+            memset(cell, 0, sizeof(guac_common_damage_cell));
+            bitmap[x / 64] &= ~(UINT64_C(1) << (x % 64));
+            damage->modified--;
+
+        }
+
+    }
+
+    return 1;
+
+}
+
+void guac_common_damage_clear(guac_common_damage* damage) {
+
+    memset(damage->bitmap, 0,
+            damage->rows * damage->words * sizeof(uint64_t));
+    memset(damage->cells, 0,
+            damage->rows * damage->columns * sizeof(guac_common_damage_cell));
+
+    damage->modified = 0;
+    damage->first_row = damage->rows;
+
+}
+
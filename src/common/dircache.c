@@ -0,0 +1,298 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "common/dircache.h"
+
+#include <guacamole/timestamp.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Returns the length of the given path, excluding any trailing slashes, such
+ * that "/a/b/" and "/a/b" are considered equivalent, and the root directory
+ * has length zero.
+ *
+ * @param path
+ *     The path whose length should be determined.
+ *
+ * @return
+ *     The length of the given path, excluding trailing slashes.
+ */
+static int guac_common_dircache_path_length(const char* path) {
+
+    int length = strlen(path);
+    while (length > 0 && path[length - 1] == '/')
+        length--;
+
+    return length;
+
+}
+
+/**
+ * Frees the given directory listing and all of its entries, regardless of
+ * its reference count.
+ *
+ * @param listing
+ *     The directory listing to free.
+ */
+static void guac_common_dircache_listing_free(
+        guac_common_dircache_listing* listing) {
+
+    int i;
+    for (i = 0; i < listing->length; i++)
+        free(listing->entries[i].name);
+
+    free(listing->entries);
+    free(listing->path);
+    free(listing);
+
+}
+
+/**
+ * Removes the listing at the given slot of the given cache, freeing that
+ * listing if no other references remain. The cache lock must be held.
+ *
+ * @param cache
+ *     The directory cache to remove the listing from.
+ *
+ * @param index
+ *     The index of the slot containing the listing.
+ */
+static void guac_common_dircache_remove(guac_common_dircache* cache,
+        int index) {
+
+    guac_common_dircache_listing* listing = cache->listings[index];
+    cache->listings[index] = NULL;
+
+    if (--listing->refcount == 0)
+        guac_common_dircache_listing_free(listing);
+
+}
+
+guac_common_dircache* guac_common_dircache_alloc(int ttl) {
+
+    guac_common_dircache* cache = calloc(1, sizeof(guac_common_dircache));
+    cache->ttl = ttl;
+    pthread_mutex_init(&(cache->_lock), NULL);
+
+    return cache;
+
+}
+
+void guac_common_dircache_free(guac_common_dircache* cache) {
+
+    int i;
+
+    /* Release all cached listings */
+    for (i = 0; i < GUAC_COMMON_DIRCACHE_SIZE; i++) {
+        if (cache->listings[i] != NULL)
+            guac_common_dircache_remove(cache, i);
+    }
+
+    pthread_mutex_destroy(&(cache->_lock));
+    free(cache);
+
+}
+
+guac_common_dircache_listing* guac_common_dircache_listing_alloc(
+        const char* path) {
+
+    guac_common_dircache_listing* listing =
+        malloc(sizeof(guac_common_dircache_listing));
+
+    listing->path = strdup(path);
+    listing->length = 0;
+    listing->size = GUAC_COMMON_DIRCACHE_INITIAL_ENTRIES;
+    listing->entries = malloc(sizeof(guac_common_dircache_entry)
+            * listing->size);
+    listing->timestamp = guac_timestamp_current();
+    listing->refcount = 1;
+
+    return listing;
+
+}
+
+int guac_common_dircache_listing_add(guac_common_dircache_listing* listing,
+        const char* name, int directory) {
+
+    /* Expand entries as necessary */
+    if (listing->length == listing->size) {
+
+        guac_common_dircache_entry* entries = realloc(listing->entries,
+                sizeof(guac_common_dircache_entry) * listing->size * 2);
+        if (entries == NULL)
+            return 1;
+
+        listing->entries = entries;
+        listing->size *= 2;
+
+    }
+
+    char* entry_name = strdup(name);
+    if (entry_name == NULL)
+        return 1;
+
+    guac_common_dircache_entry* entry = &(listing->entries[listing->length++]);
+    entry->name = entry_name;
+    entry->directory = directory;
+
+    return 0;
+
+}
+
+void guac_common_dircache_put(guac_common_dircache* cache,
+        guac_common_dircache_listing* listing) {
+
+    int i;
+    int slot = -1;
+    int length = guac_common_dircache_path_length(listing->path);
+
+    pthread_mutex_lock(&(cache->_lock));
+
+    for (i = 0; i < GUAC_COMMON_DIRCACHE_SIZE; i++) {
+
+        guac_common_dircache_listing* current = cache->listings[i];
+
+        /* Prefer empty slots */
+        if (current == NULL) {
+            if (slot == -1 || cache->listings[slot] != NULL)
+                slot = i;
+            continue;
+        }
+
+        /* Replace any existing listing for the same directory */
+        if (guac_common_dircache_path_length(current->path) == length
+                && strncmp(current->path, listing->path, length) == 0) {
+            slot = i;
+            break;
+        }
+
+        /* Otherwise, evict the oldest listing */
+        if (slot == -1 || (cache->listings[slot] != NULL
+                    && current->timestamp < cache->listings[slot]->timestamp))
+            slot = i;
+
+    }
+
+    if (cache->listings[slot] != NULL)
+        guac_common_dircache_remove(cache, slot);
+
+    listing->refcount++;
+    cache->listings[slot] = listing;
+
+    pthread_mutex_unlock(&(cache->_lock));
+
+}
+
+guac_common_dircache_listing* guac_common_dircache_get(
+        guac_common_dircache* cache, const char* path) {
+
+    int i;
+    int length = guac_common_dircache_path_length(path);
+    guac_timestamp now = guac_timestamp_current();
+
+    pthread_mutex_lock(&(cache->_lock));
+
+    for (i = 0; i < GUAC_COMMON_DIRCACHE_SIZE; i++) {
+
+        guac_common_dircache_listing* current = cache->listings[i];
+        if (current == NULL
+                || guac_common_dircache_path_length(current->path) != length
+                || strncmp(current->path, path, length) != 0)
+            continue;
+
+        /* Drop listing if expired */
+        if (now - current->timestamp >= cache->ttl) {
+            guac_common_dircache_remove(cache, i);
+            break;
+        }
+
+        current->refcount++;
+        pthread_mutex_unlock(&(cache->_lock));
+        return current;
+
+    }
+
+    pthread_mutex_unlock(&(cache->_lock));
+    return NULL;
+
+}
+
+void guac_common_dircache_release(guac_common_dircache* cache,
+        guac_common_dircache_listing* listing) {
+
+    pthread_mutex_lock(&(cache->_lock));
+
+    if (--listing->refcount == 0)
+        guac_common_dircache_listing_free(listing);
+
+    pthread_mutex_unlock(&(cache->_lock));
+
+}
+
+void guac_common_dircache_invalidate(guac_common_dircache* cache,
+        const char* path) {
+
+    int i;
+    int length = guac_common_dircache_path_length(path);
+
+    /* Determine length of parent directory path, excluding trailing slashes */
+    int parent_length = length;
+    while (parent_length > 0 && path[parent_length - 1] != '/')
+        parent_length--;
+    while (parent_length > 0 && path[parent_length - 1] == '/')
+        parent_length--;
+
+    pthread_mutex_lock(&(cache->_lock));
+
+    for (i = 0; i < GUAC_COMMON_DIRCACHE_SIZE; i++) {
+
+        guac_common_dircache_listing* current = cache->listings[i];
+        if (current == NULL)
+            continue;
+
+        int current_length = guac_common_dircache_path_length(current->path);
+
+        /* Invalidate everything if affected directory is unknown */
+        if (path[0] != '/')
+            guac_common_dircache_remove(cache, i);
+
+        /* Invalidate parent directory */
+        else if (current_length == parent_length
+                && strncmp(current->path, path, parent_length) == 0)
+            guac_common_dircache_remove(cache, i);
+
+        /* Invalidate the file itself and anything beneath it */
+        else if (current_length >= length
+                && strncmp(current->path, path, length) == 0
+                && (current_length == length
+                    || current->path[length] == '/'))
+            guac_common_dircache_remove(cache, i);
+
+    }
+
+    pthread_mutex_unlock(&(cache->_lock));
+
+}
+
@@ -196,6 +196,9 @@ void guac_common_display_flush(guac_common_display* display) {
 
     guac_common_surface_flush(display->default_surface);
 
+    /* Broadcast latest mouse cursor state along with the frame */
+    guac_common_cursor_flush(display->cursor);
+
     pthread_mutex_unlock(&display->_lock);
 
 }
@@ -22,6 +22,46 @@
 
 #include <guacamole/unicode.h>
 #include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Flag indicating that the bulk ASCII conversion performed by
+ * guac_iconv_ascii() must stop at carriage returns, as the reader in use
+ * normalizes CRLF line endings.
+ */
+#define GUAC_ICONV_STOP_CR 1
+
+/**
+ * Flag indicating that the bulk ASCII conversion performed by
+ * guac_iconv_ascii() must stop at line feeds, as the writer in use produces
+ * CRLF line endings.
+ */
+#define GUAC_ICONV_STOP_LF 2
+
+/**
+ * The number of bytes of input examined at once by guac_iconv_ascii().
+ */
+#ifdef __SSE2__
+#define GUAC_ICONV_BLOCK_SIZE 16
+#else
+#define GUAC_ICONV_BLOCK_SIZE 8
+#endif
+
+/**
+ * Each byte of a 64-bit word set to 0x01, for word-at-a-time tests of 8-bit
+ * characters.
+ */
+#define GUAC_ICONV_ONES_8 0x0101010101010101ULL
+
+/**
+ * Each 16-bit lane of a 64-bit word set to 0x0001, for word-at-a-time tests
+ * of 16-bit characters.
+ */
+#define GUAC_ICONV_ONES_16 0x0001000100010001ULL
 
 /**
  * Lookup table for Unicode code points, indexed by CP-1252 codepoint.
@@ -61,15 +101,369 @@ const static int __GUAC_RDP_CP1252_CODEPOINT[32] = {
     0x0178, /* 0x9F */
 };
 
+/**
+ * Returns the size in bytes of each character unit read by the given reader
+ * if that reader reads ASCII characters as a single unit having the
+ * character's own value, or zero if the reader is not known to do so. If the
+ * reader normalizes CRLF line endings, GUAC_ICONV_STOP_CR is added to the
+ * given stop flags.
+ *
+ * @param reader
+ *     The reader to test.
+ *
+ * @param stop
+ *     Pointer to the stop flags which should be updated.
+ *
+ * @return
+ *     The size of each character unit in bytes (1 or 2), or zero if the
+ *     reader does not support bulk ASCII conversion.
+ */
+static int guac_iconv_reader_unit(guac_iconv_read* reader, int* stop) {
+
+    if (reader == GUAC_READ_UTF8_NORMALIZED
+            || reader == GUAC_READ_UTF16_NORMALIZED
+            || reader == GUAC_READ_CP1252_NORMALIZED
+            || reader == GUAC_READ_ISO8859_1_NORMALIZED)
+        *stop |= GUAC_ICONV_STOP_CR;
+
+    if (reader == GUAC_READ_UTF8 || reader == GUAC_READ_UTF8_NORMALIZED
+            || reader == GUAC_READ_CP1252
+            || reader == GUAC_READ_CP1252_NORMALIZED
+            || reader == GUAC_READ_ISO8859_1
+            || reader == GUAC_READ_ISO8859_1_NORMALIZED)
+        return 1;
+
+    if (reader == GUAC_READ_UTF16 || reader == GUAC_READ_UTF16_NORMALIZED)
+        return 2;
+
+    return 0;
+
+}
+
+/**
+ * Returns the size in bytes of each character unit written by the given
+ * writer if that writer writes ASCII characters as a single unit having the
+ * character's own value, or zero if the writer is not known to do so. If the
+ * writer produces CRLF line endings, GUAC_ICONV_STOP_LF is added to the given
+ * stop flags.
+ *
+ * @param writer
+ *     The writer to test.
+ *
+ * @param stop
+ *     Pointer to the stop flags which should be updated.
+ *
+ * @return
+ *     The size of each character unit in bytes (1 or 2), or zero if the
+ *     writer does not support bulk ASCII conversion.
+ */
+static int guac_iconv_writer_unit(guac_iconv_write* writer, int* stop) {
+
+    if (writer == GUAC_WRITE_UTF8_CRLF
+            || writer == GUAC_WRITE_UTF16_CRLF
+            || writer == GUAC_WRITE_CP1252_CRLF
+            || writer == GUAC_WRITE_ISO8859_1_CRLF)
+        *stop |= GUAC_ICONV_STOP_LF;
+
+    if (writer == GUAC_WRITE_UTF8 || writer == GUAC_WRITE_UTF8_CRLF
+            || writer == GUAC_WRITE_CP1252
+            || writer == GUAC_WRITE_CP1252_CRLF
+            || writer == GUAC_WRITE_ISO8859_1
+            || writer == GUAC_WRITE_ISO8859_1_CRLF)
+        return 1;
+
+    if (writer == GUAC_WRITE_UTF16 || writer == GUAC_WRITE_UTF16_CRLF)
+        return 2;
+
+    return 0;
+
+}
+
+/**
+ * Returns whether the given character may be converted by guac_iconv_ascii().
+ * Such characters are non-NULL ASCII characters other than those requiring
+ * line ending translation.
+ *
+ * @param value
+ *     The character to test.
+ *
+ * @param stop
+ *     Any combination of GUAC_ICONV_STOP_CR and GUAC_ICONV_STOP_LF.
+ *
+ * @return
+ *     Non-zero if the character may be converted in bulk, zero otherwise.
+ */
+static int guac_iconv_is_plain(int value, int stop) {
+    return value > 0 && value < 0x80
+        && !((stop & GUAC_ICONV_STOP_CR) && value == '\r')
+        && !((stop & GUAC_ICONV_STOP_LF) && value == '\n');
+}
+
+/**
+ * Returns whether the block of GUAC_ICONV_BLOCK_SIZE bytes at the given
+ * location consists entirely of characters for which guac_iconv_is_plain()
+ * would return non-zero.
+ *
+ * @param block
+ *     The block of input to test.
+ *
+ * @param unit
+ *     The size of each character unit in bytes (1 or 2).
+ *
+ * @param stop
+ *     Any combination of GUAC_ICONV_STOP_CR and GUAC_ICONV_STOP_LF.
+ *
+ * @return
+ *     Non-zero if the entire block may be converted in bulk, zero otherwise.
+ */
+static int guac_iconv_block_is_plain(const unsigned char* block, int unit,
+        int stop) {
+
+#ifdef __SSE2__
+    __m128i data = _mm_loadu_si128((const __m128i*) block);
+    __m128i zero = _mm_setzero_si128();
+    int bad;
+
+    if (unit == 1) {
+        bad = _mm_movemask_epi8(data)
+            | _mm_movemask_epi8(_mm_cmpeq_epi8(data, zero));
+        if (stop & GUAC_ICONV_STOP_CR)
+            bad |= _mm_movemask_epi8(_mm_cmpeq_epi8(data, _mm_set1_epi8('\r')));
+        if (stop & GUAC_ICONV_STOP_LF)
+            bad |= _mm_movemask_epi8(_mm_cmpeq_epi8(data, _mm_set1_epi8('\n')));
+    }
+
+    else {
+        __m128i ascii = _mm_cmpeq_epi16(
+                _mm_and_si128(data, _mm_set1_epi16((short) 0xFF80)), zero);
+        bad = (_mm_movemask_epi8(ascii) ^ 0xFFFF)
+            | _mm_movemask_epi8(_mm_cmpeq_epi16(data, zero));
+        if (stop & GUAC_ICONV_STOP_CR)
+            bad |= _mm_movemask_epi8(_mm_cmpeq_epi16(data, _mm_set1_epi16('\r')));
+        if (stop & GUAC_ICONV_STOP_LF)
+            bad |= _mm_movemask_epi8(_mm_cmpeq_epi16(data, _mm_set1_epi16('\n')));
+    }
+
+    return !bad;
+#else
+    uint64_t data;
+    uint64_t ones;
+    uint64_t high;
+    uint64_t bad;
+
+    memcpy(&data, block, sizeof(data));
+
+    /* Non-ASCII and NULL characters (the standard "has zero" test applies to
+     * each lane, where the lane width depends on the unit size) */
+    if (unit == 1) {
+        ones = GUAC_ICONV_ONES_8;
+        high = ones * 0x80;
+        bad = data & high;
+    }
+    else {
+        ones = GUAC_ICONV_ONES_16;
+        high = ones * 0x8000;
+        bad = data & (ones * 0xFF80);
+    }
+
+    bad |= (data - ones) & ~data & high;
+
+    if (stop & GUAC_ICONV_STOP_CR) {
+        uint64_t cr = data ^ (ones * '\r');
+        bad |= (cr - ones) & ~cr & high;
+    }
+
+    if (stop & GUAC_ICONV_STOP_LF) {
+        uint64_t lf = data ^ (ones * '\n');
+        bad |= (lf - ones) & ~lf & high;
+    }
+
+    return !bad;
+#endif
+
+}
+
+/**
+ * Converts the block of GUAC_ICONV_BLOCK_SIZE bytes of input at the given
+ * location, which must consist entirely of ASCII characters, from one
+ * character unit size to another.
+ *
+ * @param block
+ *     The block of input to convert.
+ *
+ * @param in_unit
+ *     The size of each input character unit in bytes (1 or 2).
+ *
+ * @param output
+ *     The buffer which should receive the converted characters.
+ *
+ * @param out_unit
+ *     The size of each output character unit in bytes (1 or 2).
+ */
+static void guac_iconv_block_convert(const unsigned char* block, int in_unit,
+        unsigned char* output, int out_unit) {
+
+    /* Identical units require only a copy */
+    if (in_unit == out_unit) {
+        memcpy(output, block, GUAC_ICONV_BLOCK_SIZE);
+        return;
+    }
+
+#ifdef __SSE2__
+    __m128i data = _mm_loadu_si128((const __m128i*) block);
+    __m128i zero = _mm_setzero_si128();
+
+    /* Widen 8-bit characters to 16-bit */
+    if (in_unit == 1) {
+        _mm_storeu_si128((__m128i*) output, _mm_unpacklo_epi8(data, zero));
+        _mm_storeu_si128((__m128i*) (output + 16),
+                _mm_unpackhi_epi8(data, zero));
+    }
+
+    /* Narrow 16-bit characters to 8-bit */
+    else
+        _mm_storel_epi64((__m128i*) output, _mm_packus_epi16(data, data));
+#else
+    int i;
+
+    /* Widen 8-bit characters to 16-bit */
+    if (in_unit == 1) {
+        for (i = 0; i < GUAC_ICONV_BLOCK_SIZE; i++) {
+            uint16_t value = block[i];
+            memcpy(output + i * 2, &value, sizeof(value));
+        }
+    }
+
+    /* Narrow 16-bit characters to 8-bit */
+    else {
+        for (i = 0; i < GUAC_ICONV_BLOCK_SIZE / 2; i++) {
+            uint16_t value;
+            memcpy(&value, block + i * 2, sizeof(value));
+            output[i] = (unsigned char) value;
+        }
+    }
+#endif
+
+}
+
+/**
+ * Converts the longest possible run of ASCII characters at the beginning of
+ * the input, stopping at the first character which cannot be converted
+ * directly (non-ASCII characters, the NULL terminator, and any line ending
+ * characters requiring translation), or when either the input or output is
+ * exhausted. The input and output pointers are advanced past the characters
+ * converted. ASCII characters are represented identically by all supported
+ * encodings (aside from the size of each character unit), and thus bulk
+ * conversion of such characters is equivalent to converting each character
+ * individually.
+ *
+ * @param input
+ *     Pointer to the beginning of the input string.
+ *
+ * @param in_remaining
+ *     The number of bytes remaining after the pointer to the input string.
+ *
+ * @param in_unit
+ *     The size of each input character unit in bytes (1 or 2).
+ *
+ * @param output
+ *     Pointer to the beginning of the output string.
+ *
+ * @param out_remaining
+ *     The number of bytes remaining after the pointer to the output string.
+ *
+ * @param out_unit
+ *     The size of each output character unit in bytes (1 or 2).
+ *
+ * @param stop
+ *     Any combination of GUAC_ICONV_STOP_CR and GUAC_ICONV_STOP_LF.
+ *
+ * @return
+ *     The number of characters converted.
+ */
+static int guac_iconv_ascii(const char** input, int in_remaining, int in_unit,
+        char** output, int out_remaining, int out_unit, int stop) {
+
+    const unsigned char* in = (const unsigned char*) *input;
+    unsigned char* out = (unsigned char*) *output;
+
+    int block_length = GUAC_ICONV_BLOCK_SIZE / in_unit;
+    int length = in_remaining / in_unit;
+    int count = 0;
+
+    if (out_remaining / out_unit < length)
+        length = out_remaining / out_unit;
+
+    /* Convert entire blocks while possible */
+    while (count + block_length <= length
+            && guac_iconv_block_is_plain(in + count * in_unit, in_unit, stop)) {
+        guac_iconv_block_convert(in + count * in_unit, in_unit,
+                out + count * out_unit, out_unit);
+        count += block_length;
+    }
+
+    /* Convert any remaining characters individually */
+    while (count < length) {
+
+        int value;
+
+        if (in_unit == 1)
+            value = in[count];
+        else {
+            uint16_t unit;
+            memcpy(&unit, in + count * 2, sizeof(unit));
+            value = unit;
+        }
+
+        if (!guac_iconv_is_plain(value, stop))
+            break;
+
+        if (out_unit == 1)
+            out[count] = (unsigned char) value;
+        else {
+            uint16_t unit = value;
+            memcpy(out + count * 2, &unit, sizeof(unit));
+        }
+
+        count++;
+
+    }
+
+    *input += count * in_unit;
+    *output += count * out_unit;
+    return count;
+
+}
+
 int guac_iconv(guac_iconv_read* reader, const char** input, int in_remaining,
                guac_iconv_write* writer, char** output, int out_remaining) {
 
+    /* Determine whether ASCII runs may be converted in bulk */
+    int stop = 0;
+    int in_unit = guac_iconv_reader_unit(reader, &stop);
+    int out_unit = guac_iconv_writer_unit(writer, &stop);
+    int bulk = in_unit != 0 && out_unit != 0;
+
     while (in_remaining > 0 && out_remaining > 0) {
 
         int value;
         const char* read_start;
         char* write_start;
 
+        /* Convert any leading run of ASCII characters at once */
+        if (bulk) {
+
+            int count = guac_iconv_ascii(input, in_remaining, in_unit,
+                    output, out_remaining, out_unit, stop);
+
+            in_remaining -= count * in_unit;
+            out_remaining -= count * out_unit;
+
+            if (in_remaining <= 0 || out_remaining <= 0)
+                break;
+
+        }
+
         /* Read character */
         read_start = *input;
         value = reader(input, in_remaining);
@@ -91,6 +485,83 @@ int guac_iconv(guac_iconv_read* reader, const char** input, int in_remaining,
 
 }
 
+/**
+ * Reads a character using the given reader, translating CRLF line endings
+ * into a single line feed. Carriage returns which are not immediately
+ * followed by a line feed are read unchanged.
+ *
+ * @param reader
+ *     The reader to use to read each individual character.
+ *
+ * @param input
+ *     Pointer to the beginning of the input string.
+ *
+ * @param remaining
+ *     The number of bytes remaining after the pointer to the input string.
+ *
+ * @return
+ *     The Unicode codepoint read.
+ */
+static int guac_iconv_read_normalized(guac_iconv_read* reader,
+        const char** input, int remaining) {
+
+    const char* start = *input;
+
+    /* Read character, returning immediately unless it is a carriage return */
+    int value = reader(input, remaining);
+    if (value != '\r')
+        return value;
+
+    /* Do not read past the end of input if nothing follows the CR */
+    const char* after_cr = *input;
+    remaining -= after_cr - start;
+    if (remaining <= 0)
+        return value;
+
+    /* Consume following line feed if present */
+    if (reader(input, remaining) == '\n')
+        return '\n';
+
+    /* Otherwise, leave following character unread */
+    *input = after_cr;
+    return value;
+
+}
+
+/**
+ * Writes a character using the given writer, translating each line feed into
+ * a CRLF line ending.
+ *
+ * @param writer
+ *     The writer to use to write each individual character.
+ *
+ * @param output
+ *     Pointer to the beginning of the output string.
+ *
+ * @param remaining
+ *     The number of bytes remaining after the pointer to the output string.
+ *
+ * @param value
+ *     The Unicode codepoint to write.
+ */
+static void guac_iconv_write_crlf(guac_iconv_write* writer, char** output,
+        int remaining, int value) {
+
+    /* Only line feeds require translation */
+    if (value != '\n') {
+        writer(output, remaining, value);
+        return;
+    }
+
+    char* start = *output;
+    writer(output, remaining, '\r');
+
+    remaining -= *output - start;
+    if (remaining > 0)
+        writer(output, remaining, '\n');
+
+}
+
 int GUAC_READ_UTF8(const char** input, int remaining) {
 
     int value;
@@ -190,3 +661,35 @@ void GUAC_WRITE_ISO8859_1(char** output, int remaining, int value) {
     (*output)++;
 }
 
+int GUAC_READ_UTF8_NORMALIZED(const char** input, int remaining) {
+    return guac_iconv_read_normalized(GUAC_READ_UTF8, input, remaining);
+}
+
+int GUAC_READ_UTF16_NORMALIZED(const char** input, int remaining) {
+    return guac_iconv_read_normalized(GUAC_READ_UTF16, input, remaining);
+}
+
+int GUAC_READ_CP1252_NORMALIZED(const char** input, int remaining) {
+    return guac_iconv_read_normalized(GUAC_READ_CP1252, input, remaining);
+}
+
+int GUAC_READ_ISO8859_1_NORMALIZED(const char** input, int remaining) {
+    return guac_iconv_read_normalized(GUAC_READ_ISO8859_1, input, remaining);
+}
+
+void GUAC_WRITE_UTF8_CRLF(char** output, int remaining, int value) {
+    guac_iconv_write_crlf(GUAC_WRITE_UTF8, output, remaining, value);
+}
+
+void GUAC_WRITE_UTF16_CRLF(char** output, int remaining, int value) {
+    guac_iconv_write_crlf(GUAC_WRITE_UTF16, output, remaining, value);
+}
+
+void GUAC_WRITE_CP1252_CRLF(char** output, int remaining, int value) {
+    guac_iconv_write_crlf(GUAC_WRITE_CP1252, output, remaining, value);
+}
+
+void GUAC_WRITE_ISO8859_1_CRLF(char** output, int remaining, int value) {
+    guac_iconv_write_crlf(GUAC_WRITE_ISO8859_1, output, remaining, value);
+}
+
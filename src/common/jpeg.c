@@ -0,0 +1,174 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "common/jpeg.h"
+
+#include <stdio.h>
+
+#include <cairo/cairo.h>
+#include <jpeglib.h>
+
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * libjpeg error manager which returns control to guac_common_jpeg_decode()
+ * via longjmp() rather than terminating the process.
+ */
+typedef struct guac_common_jpeg_error_mgr {
+
+    /**
+     * The standard libjpeg error manager. This MUST be the first member.
+     */
+    struct jpeg_error_mgr base;
+
+    /**
+     * The point within guac_common_jpeg_decode() to return to if an error
+     * occurs.
+     */
+    jmp_buf abort;
+
+} guac_common_jpeg_error_mgr;
+
+/**
+ * Handler for fatal libjpeg errors, which aborts decoding by returning to
+ * the point saved within the error manager. The behavior of this function
+ * is dictated by the error_exit member of struct jpeg_error_mgr.
+ *
+ * @param cinfo
+ *     The decompressor which has encountered an error.
+ */
+static void guac_common_jpeg_error_exit(j_common_ptr cinfo) {
+    guac_common_jpeg_error_mgr* error = (guac_common_jpeg_error_mgr*) cinfo->err;
+    longjmp(error->abort, 1);
+}
+
+/**
+ * Handler for libjpeg warning and trace messages, which would otherwise be
+ * written to STDERR. Recoverable problems with the JPEG data being decoded
+ * are not worth reporting, so such messages are simply ignored. The behavior
+ * of this function is dictated by the output_message member of struct
+ * jpeg_error_mgr.
+ *
+ * @param cinfo
+ *     The decompressor producing the message.
+ */
+static void guac_common_jpeg_output_message(j_common_ptr cinfo) {
+    /* Ignore */
+}
+
+/**
+ * Copies a single scanline of RGB pixels decoded by libjpeg to a row of a
+ * Cairo RGB24 surface.
+ *
+ * @param dst
+ *     The first byte of the destination row.
+ *
+ * @param src
+ *     The first byte of the decoded scanline.
+ *
+ * @param width
+ *     The number of pixels in the scanline.
+ */
+static void guac_common_jpeg_copy_scanline(unsigned char* dst,
+        const unsigned char* src, int width) {
+
+    uint32_t* current = (uint32_t*) dst;
+
+    for (; width > 0; width--, src += 3)
+        *(current++) = 0xFF000000 | (src[0] << 16) | (src[1] << 8) | src[2];
+
+}
+
+cairo_surface_t* guac_common_jpeg_decode(const unsigned char* data,
+        int length) {
+
+    struct jpeg_decompress_struct cinfo;
+    guac_common_jpeg_error_mgr error;
+
+    /* Values which must survive longjmp() */
+    unsigned char* volatile scanline = NULL;
+    cairo_surface_t* volatile surface = NULL;
+
+    /* Handle errors by aborting decode */
+    cinfo.err = jpeg_std_error(&error.base);
+    error.base.error_exit = guac_common_jpeg_error_exit;
+    error.base.output_message = guac_common_jpeg_output_message;
+    if (setjmp(error.abort)) {
+        jpeg_destroy_decompress(&cinfo);
+        free(scanline);
+        if (surface != NULL)
+            cairo_surface_destroy(surface);
+        return NULL;
+    }
+
+    jpeg_create_decompress(&cinfo);
+
+    /* Read JPEG directly from memory buffer */
+    jpeg_mem_src(&cinfo, (unsigned char*) data, length);
+    if (jpeg_read_header(&cinfo, TRUE) != JPEG_HEADER_OK) {
+        jpeg_destroy_decompress(&cinfo);
+        return NULL;
+    }
+
+    /* Always decode as RGB */
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    int width = cinfo.output_width;
+    int height = cinfo.output_height;
+
+    scanline = malloc(width * 3);
+    surface = cairo_image_surface_create(CAIRO_FORMAT_RGB24, width, height);
+
+    if (scanline == NULL
+            || cairo_surface_status(surface) != CAIRO_STATUS_SUCCESS) {
+        jpeg_destroy_decompress(&cinfo);
+        free(scanline);
+        cairo_surface_destroy(surface);
+        return NULL;
+    }
+
+    int stride = cairo_image_surface_get_stride(surface);
+    unsigned char* row = cairo_image_surface_get_data(surface);
+
+    /* Read JPEG into surface, one scanline at a time */
+    while (cinfo.output_scanline < height) {
+
+        unsigned char* buffers[1] = { scanline };
+        jpeg_read_scanlines(&cinfo, buffers, 1);
+
+        guac_common_jpeg_copy_scanline(row, scanline, width);
+        row += stride;
+
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+
+    free(scanline);
+
+    /* Surface data was modified directly */
+    cairo_surface_mark_dirty(surface);
+    return surface;
+
+}
+
@@ -18,8 +18,11 @@
  */
 
 #include "config.h"
+#include "common/damage.h"
+#include "common/jpeg.h"
 #include "common/rect.h"
 #include "common/surface.h"
+#include "common/video.h"
 
 #include <cairo/cairo.h>
 #include <guacamole/client.h>
@@ -60,18 +63,6 @@
  */
 #define GUAC_SURFACE_BASE_COST 4096
 
-/**
- * An increase in cost is negligible if it is less than
- * 1/GUAC_SURFACE_NEGLIGIBLE_INCREASE of the old cost.
- */
-#define GUAC_SURFACE_NEGLIGIBLE_INCREASE 4
-
-/**
- * If combining an update because it appears to be follow a fill pattern,
- * the combined cost must not exceed
- * GUAC_SURFACE_FILL_PATTERN_FACTOR * (total uncombined cost).
- */
-#define GUAC_SURFACE_FILL_PATTERN_FACTOR 3
 
 /* Define cairo_format_stride_for_width() if missing */
 #ifndef HAVE_CAIRO_FORMAT_STRIDE_FOR_WIDTH
@@ -273,67 +264,60 @@ static int __guac_common_surface_is_opaque(guac_common_surface* surface,
 
 
 /**
- * Returns whether the given rectangle should be combined into the existing
- * dirty rectangle, to be eventually flushed as a "png" instruction.
+ * Returns whether the given update, which by its nature contains only
+ * metainformation about the update's rectangle (such as a copy or a solid
+ * fill), should instead be combined into the pending image data of the
+ * surface, to be eventually flushed as an image.
  *
  * @param surface The surface to be queried.
  * @param rect The update rectangle.
- * @param rect_only Non-zero if this update, by its nature, contains only
- *                  metainformation about the update's rectangle, zero if
- *                  the update also contains image data.
- * @return Non-zero if the update should be combined with any existing update,
- *         zero otherwise.
+ * @return Non-zero if the update should be combined with any pending image
+ *         data, zero otherwise.
  */
-static int __guac_common_should_combine(guac_common_surface* surface, const guac_common_rect* rect, int rect_only) {
-
-    if (surface->dirty) {
+static int __guac_common_should_combine(guac_common_surface* surface, const guac_common_rect* rect) {
 
-        int combined_cost, dirty_cost, update_cost;
+    guac_common_damage* damage = surface->damage;
 
-        /* Simulate combination */
-        guac_common_rect combined = surface->dirty_rect;
-        guac_common_rect_extend(&combined, rect);
-
-        /* Combine if result is still small */
-        if (combined.width <= GUAC_SURFACE_NEGLIGIBLE_WIDTH && combined.height <= GUAC_SURFACE_NEGLIGIBLE_HEIGHT)
-            return 1;
-
-        /* Estimate costs of the existing update, new update, and both combined */
-        combined_cost = GUAC_SURFACE_BASE_COST + combined.width * combined.height;
-        dirty_cost    = GUAC_SURFACE_BASE_COST + surface->dirty_rect.width * surface->dirty_rect.height;
-        update_cost   = GUAC_SURFACE_BASE_COST + rect->width * rect->height;
+    /* Nothing to combine with if no image data is pending */
+    if (damage->modified == 0)
+        return 0;
 
-        /* Reduce cost if no image data */
-        if (rect_only)
-            update_cost /= GUAC_SURFACE_DATA_FACTOR;
+    /* Estimate cost of additional image data vs. the update alone */
+    int combined_cost = guac_common_damage_cost(damage, rect);
+    int update_cost = (GUAC_SURFACE_BASE_COST + rect->width * rect->height)
+                    / GUAC_SURFACE_DATA_FACTOR;
 
-        /* Combine if cost estimate shows benefit */
-        if (combined_cost <= update_cost + dirty_cost)
-            return 1;
+    /* Combine if small, but only if doing so would add little to the
+     * pending image data */
+    if (rect->width <= GUAC_SURFACE_NEGLIGIBLE_WIDTH
+            && rect->height <= GUAC_SURFACE_NEGLIGIBLE_HEIGHT)
+        return combined_cost <= GUAC_SURFACE_BASE_COST;
 
-        /* Combine if increase in cost is negligible */
-        if (combined_cost - dirty_cost <= dirty_cost / GUAC_SURFACE_NEGLIGIBLE_INCREASE)
-            return 1;
+    /* Combine if cost estimate shows benefit */
+    return combined_cost <= update_cost;
 
-        if (combined_cost - update_cost <= update_cost / GUAC_SURFACE_NEGLIGIBLE_INCREASE)
-            return 1;
+}
 
-        /* Combine if we anticipate further updates, as this update follows a common fill pattern */
-        if (rect->x == surface->dirty_rect.x && rect->y == surface->dirty_rect.y + surface->dirty_rect.height) {
-            if (combined_cost <= (dirty_cost + update_cost) * GUAC_SURFACE_FILL_PATTERN_FACTOR)
-                return 1;
-        }
+/**
+ * Discards the cached snapshot of the given surface, if any. This function
+ * must be invoked whenever the contents of the surface change.
+ *
+ * @param surface
+ *     The surface whose contents have changed.
+ */
+static void __guac_common_surface_invalidate_snapshot(
+        guac_common_surface* surface) {
 
-    }
-    
-    /* Otherwise, do not combine */
-    return 0;
+    free(surface->snapshot);
+    surface->snapshot = NULL;
+    surface->snapshot_length = 0;
+    surface->snapshot_size = 0;
 
 }
 
 /**
- * Expands the dirty rect of the given surface to contain the rect described by the given
- * coordinates.
+ * Marks the given rectangle of the given surface as dirty, such that it will
+ * be sent as image data when the surface is next flushed.
  *
  * @param surface The surface to mark as dirty.
  * @param rect The rectangle of the update which is dirtying the surface.
@@ -344,15 +328,7 @@ static void __guac_common_mark_dirty(guac_common_surface* surface, const guac_co
     if (rect->width <= 0 || rect->height <= 0)
         return;
 
-    /* If already dirty, update existing rect */
-    if (surface->dirty)
-        guac_common_rect_extend(&surface->dirty_rect, rect);
-
-    /* Otherwise init dirty rect */
-    else {
-        surface->dirty_rect = *rect;
-        surface->dirty = 1;
-    }
+    guac_common_damage_add(surface->damage, rect);
 
 }
 
@@ -374,6 +350,10 @@ static unsigned int __guac_common_surface_calculate_framerate(
 
     int x, y;
 
+    /* Surfaces without heat maps are never considered to be updating */
+    if (surface->heat_map == NULL)
+        return 0;
+
     /* Calculate heat map dimensions */
     int heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->width);
 
@@ -589,6 +569,10 @@ static void __guac_common_surface_touch_rect(guac_common_surface* surface,
 
     int x, y;
 
+    /* Nothing to update if the surface has no heat map */
+    if (surface->heat_map == NULL)
+        return;
+
     /* Calculate heat map dimensions */
     int heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(surface->width);
 
@@ -635,61 +619,246 @@ static void __guac_common_surface_touch_rect(guac_common_surface* surface,
 }
 
 /**
- * Flushes the bitmap update currently described by the dirty rectangle within the
- * given surface to that surface's bitmap queue. There MUST be space within the
- * queue.
+ * Flushes the given surface, drawing any pending operations on the remote
+ * display. Surface properties are not flushed.
+ *
+ * @param surface
+ *     The surface to flush.
+ */
+static void __guac_common_surface_flush(guac_common_surface* surface);
+
+/**
+ * Decodes into the given surface any passed-through JPEG images which cover
+ * any part of the given rectangle, along with all JPEG images drawn before
+ * them, such that the contents of the surface within that rectangle are up
+ * to date.
+ *
+ * @param surface
+ *     The surface to update.
  *
- * @param surface The surface to flush.
+ * @param rect
+ *     The rectangle which must be up to date, or NULL if the entire surface
+ *     must be up to date.
  */
-static void __guac_common_surface_flush_to_queue(guac_common_surface* surface) {
+static void __guac_common_surface_realize_jpeg(guac_common_surface* surface,
+        const guac_common_rect* rect);
 
-    guac_common_surface_bitmap_rect* rect;
+/**
+ * Ends the video stream covering a region of the given surface, if any. As
+ * the contents of the underlying layer are out of date within that region,
+ * the region is queued to be redrawn with the next flush.
+ *
+ * @param surface
+ *     The surface whose video stream should be ended.
+ */
+static void __guac_common_surface_end_video(guac_common_surface* surface) {
 
-    /* Do not flush if not dirty */
-    if (!surface->dirty)
+#ifdef ENABLE_VIDEO_STREAMING
+    if (surface->video == NULL)
         return;
 
-    /* Add new rect to queue */
-    rect = &(surface->bitmap_queue[surface->bitmap_queue_length++]);
-    rect->rect = surface->dirty_rect;
-    rect->flushed = 0;
+    guac_common_video_free(surface->video);
+    surface->video = NULL;
+    surface->video_updated = guac_timestamp_current();
 
-    /* Surface now flushed */
-    surface->dirty = 0;
+    /* Redraw the region previously covered by video */
+    __guac_common_mark_dirty(surface, &surface->video_rect);
+#endif
 
 }
 
 /**
- * Flushes the given surface, drawing any pending operations on the remote
- * display. Surface properties are not flushed.
+ * Attempts to begin a video stream covering the given dirty rectangle of the
+ * given surface, if that rectangle is large enough, has been updated at a
+ * video-like rate, and all users support video. There must not already be a
+ * video stream covering any part of the surface.
+ *
+ * @param surface
+ *     The surface whose dirty rectangle should be considered for video.
+ *
+ * @param rect
+ *     The dirty rectangle to consider.
+ *
+ * @return
+ *     Non-zero if a video stream was started, zero otherwise.
+ */
+static int __guac_common_surface_begin_video(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+#ifdef ENABLE_VIDEO_STREAMING
+
+    /* Video is only streamed to visible layers */
+    if (surface->layer->index < 0)
+        return 0;
+
+    /* Small regions are better served by images */
+    if (rect->width < GUAC_COMMON_SURFACE_VIDEO_MIN_DIMENSION
+            || rect->height < GUAC_COMMON_SURFACE_VIDEO_MIN_DIMENSION)
+        return 0;
+
+    /* Do not restart video immediately after a previous video ended */
+    if (guac_timestamp_current() - surface->video_updated
+            < GUAC_COMMON_SURFACE_VIDEO_TIMEOUT)
+        return 0;
+
+    /* Video is preferred only for regions which are changing constantly and
+     * have no transparency */
+    if (__guac_common_surface_calculate_framerate(surface, rect)
+                < GUAC_COMMON_SURFACE_VIDEO_FRAMERATE
+            || !__guac_common_surface_is_opaque(surface, rect)
+            || !guac_common_video_supported(surface->client))
+        return 0;
+
+    guac_common_rect max;
+    guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
+
+    /* Align video with macroblocks, noting that H.264 (with 4:2:0 chroma
+     * subsampling) requires even dimensions */
+    guac_common_rect video_rect = *rect;
+    guac_common_rect_expand_to_grid(GUAC_COMMON_SURFACE_VIDEO_BLOCK_SIZE,
+            &video_rect, &max);
+    video_rect.width &= ~1;
+    video_rect.height &= ~1;
+
+    surface->video = guac_common_video_alloc(surface->client,
+            surface->socket, surface->layer, &video_rect);
+    if (surface->video == NULL)
+        return 0;
+
+    surface->video_rect = video_rect;
+    surface->video_dirty = 0;
+    surface->video_stale = 0;
+    return 1;
+#else
+    return 0;
+#endif
+
+}
+
+/**
+ * Notes that the given rectangle of the given surface has changed, such that
+ * the next frame of any video covering that rectangle must be sent.
+ *
+ * @param surface
+ *     The surface that has changed.
+ *
+ * @param rect
+ *     The rectangle that has changed.
+ */
+static void __guac_common_surface_touch_video(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    if (surface->video != NULL
+            && guac_common_rect_intersects(rect, &surface->video_rect)) {
+        surface->video_dirty = 1;
+        surface->video_updated = guac_timestamp_current();
+    }
+
+}
+
+/**
+ * Ends any video covering the given rectangle of the given surface. This must
+ * be invoked prior to any operation which reads from the remote copy of the
+ * surface, as that copy is out of date beneath any video.
+ *
+ * @param surface
+ *     The surface about to be read.
+ *
+ * @param rect
+ *     The rectangle about to be read.
+ */
+static void __guac_common_surface_read_video(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    if (surface->video != NULL
+            && guac_common_rect_intersects(rect, &surface->video_rect))
+        __guac_common_surface_end_video(surface);
+
+}
+
+/**
+ * Routes the update described by the given dirty rectangle within the given
+ * surface to a video stream, starting a new video stream if the update
+ * appears to be part of one. If the update is entirely within the region
+ * covered by video, the update will be sent as the next frame of video when
+ * the surface is flushed.
  *
  * @param surface
  *     The surface to flush.
+ *
+ * @param rect
+ *     The dirty rectangle being flushed.
+ *
+ * @return
+ *     Non-zero if the update was handled entirely by video, zero if the
+ *     update must still be sent as an image.
  */
-static void __guac_common_surface_flush(guac_common_surface* surface);
+static int __guac_common_surface_flush_to_video(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    if (surface->video == NULL
+            && !__guac_common_surface_begin_video(surface, rect))
+        return 0;
+
+    int intersection = guac_common_rect_intersects(rect,
+            &surface->video_rect);
+
+    if (intersection == 0)
+        return 0;
+
+    surface->video_dirty = 1;
+    surface->video_updated = guac_timestamp_current();
+
+    /* Any portion outside the video must still be drawn as an image */
+    return intersection == 2;
+
+}
 
 /**
- * Schedules a deferred flush of the given surface. This will not immediately
- * flush the surface to the client. Instead, the result of the flush is
- * added to a queue which is reinspected and combined (if possible) with other
- * deferred flushes during the call to guac_common_surface_flush().
+ * Sends the next frame of any video covering a region of the given surface,
+ * if that region has changed, ending the video if the region has stopped
+ * changing or the video has not been received by all users.
  *
- * @param surface The surface to flush.
+ * @param surface
+ *     The surface whose video should be flushed.
  */
-static void __guac_common_surface_flush_deferred(guac_common_surface* surface) {
+static void __guac_common_surface_flush_video(guac_common_surface* surface) {
+
+#ifdef ENABLE_VIDEO_STREAMING
+    if (surface->video == NULL)
+        return;
 
-    /* Do not flush if not dirty */
-    if (!surface->dirty)
+    guac_timestamp now = guac_timestamp_current();
+
+    /* Fall back to images once the region has cooled */
+    if (surface->video_stale
+            || now - surface->video_updated >= GUAC_COMMON_SURFACE_VIDEO_TIMEOUT) {
+        __guac_common_surface_end_video(surface);
+        __guac_common_surface_flush(surface);
+        return;
+    }
+
+    if (!surface->video_dirty)
         return;
 
-    /* Flush if queue size has reached maximum (space is reserved for the final
-     * dirty rect, as __guac_common_surface_flush() MAY add an additional rect
-     * to the queue */
-    if (surface->bitmap_queue_length == GUAC_COMMON_SURFACE_QUEUE_SIZE-1)
+    __guac_common_surface_realize_jpeg(surface, &surface->video_rect);
+
+    unsigned char* buffer = surface->buffer
+                          + surface->video_rect.y * surface->stride
+                          + surface->video_rect.x * 4;
+
+    /* Abandon video entirely if encoding fails */
+    if (guac_common_video_encode(surface->video, buffer, surface->stride,
+                now)) {
+        guac_client_log(surface->client, GUAC_LOG_DEBUG, "Unable to encode "
+                "video frame. Falling back to images.");
+        __guac_common_surface_end_video(surface);
         __guac_common_surface_flush(surface);
+        return;
+    }
 
-    /* Append dirty rect to queue */
-    __guac_common_surface_flush_to_queue(surface);
+    surface->video_dirty = 0;
+#endif
 
 }
 
@@ -819,6 +988,9 @@ static void __guac_common_surface_set(guac_common_surface* dst,
     int max_x = 0;
     int max_y = 0;
 
+    /* Any cached snapshot will no longer match the surface contents */
+    __guac_common_surface_invalidate_snapshot(dst);
+
     dst_stride = dst->stride;
     dst_buffer = dst->buffer + (dst_stride * rect->y) + (4 * rect->x);
 
@@ -971,6 +1143,9 @@ static void __guac_common_surface_put(unsigned char* src_buffer, int src_stride,
     int orig_x = rect->x;
     int orig_y = rect->y;
 
+    /* Any cached snapshot will no longer match the surface contents */
+    __guac_common_surface_invalidate_snapshot(dst);
+
     src_buffer += src_stride * (*sy) + 4 * (*sx);
     dst_buffer += (dst_stride * rect->y) + (4 * rect->x);
 
@@ -1063,6 +1238,9 @@ static void __guac_common_surface_fill_mask(unsigned char* src_buffer, int src_s
     uint32_t color = 0xFF000000 | (red << 16) | (green << 8) | blue;
     int x, y;
 
+    /* Any cached snapshot will no longer match the surface contents */
+    __guac_common_surface_invalidate_snapshot(dst);
+
     src_buffer += src_stride*sy + 4*sx;
     dst_buffer += (dst_stride * rect->y) + (4 * rect->x);
 
@@ -1122,6 +1300,9 @@ static void __guac_common_surface_transfer(guac_common_surface* src, int* sx, in
     int orig_x = rect->x;
     int orig_y = rect->y;
 
+    /* Any cached snapshot will no longer match the surface contents */
+    __guac_common_surface_invalidate_snapshot(dst);
+
     /* Copy forwards only if destination is in a different surface or is before source */
     if (src != dst || rect->y < *sy || (rect->y == *sy && rect->x < *sx)) {
         src_buffer += src->stride * (*sy) + 4 * (*sx);
@@ -1198,6 +1379,139 @@ static void __guac_common_surface_transfer(guac_common_surface* src, int* sx, in
 
 }
 
+static void __guac_common_surface_realize_jpeg(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    int i;
+    int count = 0;
+
+    /* Find the most recent JPEG covering any part of the rectangle */
+    for (i = surface->jpeg_queue_length - 1; i >= 0; i--) {
+        if (rect == NULL || guac_common_rect_intersects(
+                    &surface->jpeg_queue[i].rect, rect)) {
+            count = i + 1;
+            break;
+        }
+    }
+
+    /* Decode that JPEG and all JPEGs drawn before it, in order */
+    for (i = 0; i < count; i++) {
+
+        guac_common_surface_jpeg* jpeg = &surface->jpeg_queue[i];
+        cairo_surface_t* image = guac_common_jpeg_decode(jpeg->data,
+                jpeg->length);
+
+        /* Ignore the JPEG if it does not match its stated dimensions, as the
+         * client will have received the same invalid data */
+        if (image != NULL
+                && cairo_image_surface_get_width(image) == jpeg->rect.width
+                && cairo_image_surface_get_height(image) == jpeg->rect.height) {
+
+            int sx = 0;
+            int sy = 0;
+
+            guac_common_rect jpeg_rect = jpeg->rect;
+            __guac_common_bound_rect(surface, &jpeg_rect, &sx, &sy);
+            if (jpeg_rect.width > 0 && jpeg_rect.height > 0)
+                __guac_common_surface_put(cairo_image_surface_get_data(image),
+                        cairo_image_surface_get_stride(image), &sx, &sy,
+                        surface, &jpeg_rect, 1);
+
+        }
+
+        if (image != NULL)
+            cairo_surface_destroy(image);
+
+        free(jpeg->data);
+
+    }
+
+    /* Remove decoded JPEGs from queue */
+    surface->jpeg_queue_length -= count;
+    memmove(surface->jpeg_queue, surface->jpeg_queue + count,
+            surface->jpeg_queue_length * sizeof(guac_common_surface_jpeg));
+
+}
+
+/**
+ * Returns whether any update which has not yet been flushed may, once
+ * flushed, cover any part of the given rectangle. Lossy updates are expanded
+ * to the JPEG or WebP block grid when flushed, moving each edge outward by up
+ * to one block, thus the rectangle is first grown by the larger of those
+ * block sizes on each side.
+ *
+ * @param surface
+ *     The surface to check.
+ *
+ * @param rect
+ *     The rectangle to check.
+ *
+ * @return
+ *     Non-zero if any unflushed update may overlap the given rectangle once
+ *     flushed, zero otherwise.
+ */
+static int __guac_common_surface_is_pending(guac_common_surface* surface,
+        const guac_common_rect* rect) {
+
+    guac_common_rect max;
+    guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
+
+    guac_common_rect expanded;
+    guac_common_rect_init(&expanded,
+            rect->x - GUAC_SURFACE_JPEG_BLOCK_SIZE,
+            rect->y - GUAC_SURFACE_JPEG_BLOCK_SIZE,
+            rect->width  + GUAC_SURFACE_JPEG_BLOCK_SIZE * 2,
+            rect->height + GUAC_SURFACE_JPEG_BLOCK_SIZE * 2);
+    guac_common_rect_constrain(&expanded, &max);
+
+    return guac_common_damage_intersects(surface->damage, &expanded);
+
+}
+
+/**
+ * Sends the given JPEG data to the client as-is via an "img" instruction,
+ * drawing it at the location of the given rectangle within the layer
+ * associated with the given surface.
+ *
+ * @param surface
+ *     The surface being drawn to.
+ *
+ * @param rect
+ *     The rectangle covered by the JPEG image.
+ *
+ * @param data
+ *     The JPEG data to send.
+ *
+ * @param length
+ *     The number of bytes of JPEG data.
+ */
+static void __guac_common_surface_send_jpeg(guac_common_surface* surface,
+        const guac_common_rect* rect, const unsigned char* data, int length) {
+
+    guac_socket* socket = surface->socket;
+    guac_stream* stream = guac_client_alloc_stream(surface->client);
+
+    guac_protocol_send_img(socket, stream, GUAC_COMP_OVER, surface->layer,
+            "image/jpeg", rect->x, rect->y);
+
+    while (length > 0) {
+
+        int blob_length = length;
+        if (blob_length > GUAC_COMMON_SURFACE_JPEG_BLOB_SIZE)
+            blob_length = GUAC_COMMON_SURFACE_JPEG_BLOB_SIZE;
+
+        guac_protocol_send_blob(socket, stream, data, blob_length);
+
+        data += blob_length;
+        length -= blob_length;
+
+    }
+
+    guac_protocol_send_end(socket, stream);
+    guac_client_free_stream(surface->client, stream);
+
+}
+
 guac_common_surface* guac_common_surface_alloc(guac_client* client,
         guac_socket* socket, const guac_layer* layer, int w, int h) {
 
@@ -1221,9 +1535,15 @@ guac_common_surface* guac_common_surface_alloc(guac_client* client,
     surface->stride = cairo_format_stride_for_width(CAIRO_FORMAT_ARGB32, w);
     surface->buffer = calloc(h, surface->stride);
 
-    /* Create corresponding heat map */
-    surface->heat_map = calloc(heat_width * heat_height,
-            sizeof(guac_common_surface_heat_cell));
+    /* Create corresponding heat map for visible layers only (off-screen
+     * buffers are never streamed as video, and are often numerous) */
+    if (layer->index >= 0)
+        surface->heat_map = calloc(heat_width * heat_height,
+                sizeof(guac_common_surface_heat_cell));
+
+    /* Create damage map aligned with heat map */
+    surface->damage = guac_common_damage_alloc(
+            GUAC_COMMON_SURFACE_HEAT_CELL_SIZE, w, h);
 
     /* Reset clipping rect */
     guac_common_surface_reset_clip(surface);
@@ -1247,9 +1567,21 @@ void guac_common_surface_free(guac_common_surface* surface) {
     if (surface->realized)
         guac_protocol_send_dispose(surface->socket, surface->layer);
 
+    /* Discard any JPEG data which was never needed */
+    for (int i = 0; i < surface->jpeg_queue_length; i++)
+        free(surface->jpeg_queue[i].data);
+
+#ifdef ENABLE_VIDEO_STREAMING
+    /* Video layer is no longer needed */
+    if (surface->video != NULL)
+        guac_common_video_free(surface->video);
+#endif
+
     pthread_mutex_destroy(&surface->_lock);
 
+    free(surface->snapshot);
     free(surface->heat_map);
+    guac_common_damage_free(surface->damage);
     free(surface->buffer);
     free(surface);
 
@@ -1277,6 +1609,9 @@ void guac_common_surface_resize(guac_common_surface* surface, int w, int h) {
     int heat_width = GUAC_COMMON_SURFACE_HEAT_DIMENSION(w);
     int heat_height = GUAC_COMMON_SURFACE_HEAT_DIMENSION(h);
 
+    /* Old surface data must be complete before being copied */
+    __guac_common_surface_realize_jpeg(surface, NULL);
+
     /* Copy old surface data */
     old_buffer = surface->buffer;
     old_stride = surface->stride;
@@ -1297,17 +1632,21 @@ void guac_common_surface_resize(guac_common_surface* surface, int w, int h) {
     free(old_buffer);
 
     /* Allocate completely new heat map (can safely discard old stats) */
-    free(surface->heat_map);
-    surface->heat_map = calloc(heat_width * heat_height,
-            sizeof(guac_common_surface_heat_cell));
-
-    /* Resize dirty rect to fit new surface dimensions */
-    if (surface->dirty) {
-        __guac_common_bound_rect(surface, &surface->dirty_rect, NULL, NULL);
-        if (surface->dirty_rect.width <= 0 || surface->dirty_rect.height <= 0)
-            surface->dirty = 0;
+    if (surface->heat_map != NULL) {
+        free(surface->heat_map);
+        surface->heat_map = calloc(heat_width * heat_height,
+                sizeof(guac_common_surface_heat_cell));
     }
 
+    /* Resize damage map to fit new surface dimensions, discarding any
+     * damage if the map cannot be resized (the surface is about to be
+     * redrawn at its new size anyway) */
+    if (guac_common_damage_resize(surface->damage, w, h))
+        guac_common_damage_clear(surface->damage);
+
+    /* Any video may no longer fit */
+    __guac_common_surface_end_video(surface);
+
     /* Update Guacamole layer */
     if (surface->realized)
         guac_protocol_send_size(socket, layer, w, h);
@@ -1339,6 +1678,7 @@ void guac_common_surface_draw(guac_common_surface* surface, int x, int y, cairo_
         goto complete;
 
     /* Update backing surface */
+    __guac_common_surface_realize_jpeg(surface, &rect);
     __guac_common_surface_put(buffer, stride, &sx, &sy, surface, &rect, format != CAIRO_FORMAT_ARGB32);
     if (rect.width <= 0 || rect.height <= 0)
         goto complete;
@@ -1347,10 +1687,6 @@ void guac_common_surface_draw(guac_common_surface* surface, int x, int y, cairo_
     guac_timestamp time = guac_timestamp_current();
     __guac_common_surface_touch_rect(surface, &rect, time);
 
-    /* Flush if not combining */
-    if (!__guac_common_should_combine(surface, &rect, 0))
-        __guac_common_surface_flush_deferred(surface);
-
     /* Always defer draws */
     __guac_common_mark_dirty(surface, &rect);
 
@@ -1359,6 +1695,84 @@ complete:
 
 }
 
+int guac_common_surface_draw_jpeg(guac_common_surface* surface, int x, int y,
+        int w, int h, const unsigned char* data, int length) {
+
+    pthread_mutex_lock(&surface->_lock);
+
+    guac_common_rect rect;
+    guac_common_rect_init(&rect, x, y, w, h);
+
+    /* Pass through only if the JPEG will be drawn in its entirety, and will
+     * not be hidden beneath video */
+    guac_common_rect clipped = rect;
+    __guac_common_clip_rect(surface, &clipped, NULL, NULL);
+    if (clipped.x != rect.x || clipped.y != rect.y
+            || clipped.width != rect.width || clipped.height != rect.height
+            || (surface->video != NULL && guac_common_rect_intersects(&rect,
+                    &surface->video_rect)))
+        goto decode;
+
+    unsigned char* jpeg_data = malloc(length);
+    if (jpeg_data == NULL)
+        goto decode;
+
+    memcpy(jpeg_data, data, length);
+
+    /* Updates not yet flushed within the JPEG must be drawn before it */
+    if (__guac_common_surface_is_pending(surface, &rect))
+        __guac_common_surface_flush(surface);
+
+    /* Earlier JPEGs completely covered by this JPEG need never be decoded */
+    int i, kept = 0;
+    for (i = 0; i < surface->jpeg_queue_length; i++) {
+
+        guac_common_surface_jpeg* jpeg = &surface->jpeg_queue[i];
+        if (guac_common_rect_intersects(&jpeg->rect, &rect) == 2)
+            free(jpeg->data);
+        else
+            surface->jpeg_queue[kept++] = *jpeg;
+
+    }
+
+    surface->jpeg_queue_length = kept;
+
+    /* Make room for this JPEG if necessary */
+    if (surface->jpeg_queue_length == GUAC_COMMON_SURFACE_JPEG_QUEUE_SIZE)
+        __guac_common_surface_realize_jpeg(surface, NULL);
+
+    guac_common_surface_jpeg* jpeg =
+        &surface->jpeg_queue[surface->jpeg_queue_length++];
+    jpeg->rect = rect;
+    jpeg->data = jpeg_data;
+    jpeg->length = length;
+
+    /* Surface contents have changed, even if not yet decoded */
+    __guac_common_surface_invalidate_snapshot(surface);
+    __guac_common_surface_touch_rect(surface, &rect,
+            guac_timestamp_current());
+
+    /* Send JPEG without re-encoding */
+    __guac_common_surface_send_jpeg(surface, &rect, data, length);
+    surface->realized = 1;
+
+    pthread_mutex_unlock(&surface->_lock);
+    return 0;
+
+    /* Fall back to drawing the decoded image */
+decode:
+    pthread_mutex_unlock(&surface->_lock);
+
+    cairo_surface_t* image = guac_common_jpeg_decode(data, length);
+    if (image == NULL)
+        return 1;
+
+    guac_common_surface_draw(surface, x, y, image);
+    cairo_surface_destroy(image);
+    return 0;
+
+}
+
 void guac_common_surface_paint(guac_common_surface* surface, int x, int y,
         cairo_surface_t* src, int red, int green, int blue) {
 
@@ -1381,12 +1795,9 @@ void guac_common_surface_paint(guac_common_surface* surface, int x, int y,
         goto complete;
 
     /* Update backing surface */
+    __guac_common_surface_realize_jpeg(surface, &rect);
     __guac_common_surface_fill_mask(buffer, stride, sx, sy, surface, &rect, red, green, blue);
 
-    /* Flush if not combining */
-    if (!__guac_common_should_combine(surface, &rect, 0))
-        __guac_common_surface_flush_deferred(surface);
-
     /* Always defer draws */
     __guac_common_mark_dirty(surface, &rect);
 
@@ -1427,6 +1838,10 @@ void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
     /* NOTE: Being the last rectangle to be adjusted, only the width/height of
      * drect is now correct! */
 
+    /* Both source and destination must be up to date */
+    __guac_common_surface_realize_jpeg(src, &srect);
+    __guac_common_surface_realize_jpeg(dst, &drect);
+
     /* Update backing surface first only if drect cannot intersect srect */
     if (src != dst) {
         __guac_common_surface_transfer(src, &srect.x, &srect.y,
@@ -1436,17 +1851,26 @@ void guac_common_surface_copy(guac_common_surface* src, int sx, int sy,
     }
 
     /* Defer if combining */
-    if (__guac_common_should_combine(dst, &drect, 1))
+    if (__guac_common_should_combine(dst, &drect))
         __guac_common_mark_dirty(dst, &drect);
 
     /* Otherwise, flush and draw immediately */
     else {
+
+        /* Source must be up to date on the client */
+        guac_common_rect read_rect;
+        guac_common_rect_init(&read_rect, srect.x, srect.y,
+                drect.width, drect.height);
+        __guac_common_surface_read_video(src, &read_rect);
+
         __guac_common_surface_flush(dst);
         __guac_common_surface_flush(src);
         guac_protocol_send_copy(socket, src_layer, srect.x, srect.y,
                 drect.width, drect.height, GUAC_COMP_OVER, dst_layer,
                 drect.x, drect.y);
+        __guac_common_surface_touch_video(dst, &drect);
         dst->realized = 1;
+
     }
 
     /* Update backing surface last if drect can intersect srect */
@@ -1495,6 +1919,10 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
     /* NOTE: Being the last rectangle to be adjusted, only the width/height of
      * drect is now correct! */
 
+    /* Both source and destination must be up to date */
+    __guac_common_surface_realize_jpeg(src, &srect);
+    __guac_common_surface_realize_jpeg(dst, &drect);
+
     /* Update backing surface first only if drect cannot intersect srect */
     if (src != dst) {
         __guac_common_surface_transfer(src, &srect.x, &srect.y, op, dst, &drect);
@@ -1503,16 +1931,25 @@ void guac_common_surface_transfer(guac_common_surface* src, int sx, int sy, int
     }
 
     /* Defer if combining */
-    if (__guac_common_should_combine(dst, &drect, 1))
+    if (__guac_common_should_combine(dst, &drect))
         __guac_common_mark_dirty(dst, &drect);
 
     /* Otherwise, flush and draw immediately */
     else {
+
+        /* Source must be up to date on the client */
+        guac_common_rect read_rect;
+        guac_common_rect_init(&read_rect, srect.x, srect.y,
+                drect.width, drect.height);
+        __guac_common_surface_read_video(src, &read_rect);
+
         __guac_common_surface_flush(dst);
         __guac_common_surface_flush(src);
         guac_protocol_send_transfer(socket, src_layer, srect.x, srect.y,
                 drect.width, drect.height, op, dst_layer, drect.x, drect.y);
+        __guac_common_surface_touch_video(dst, &drect);
         dst->realized = 1;
+
     }
 
     /* Update backing surface last if drect can intersect srect */
@@ -1545,6 +1982,7 @@ void guac_common_surface_set(guac_common_surface* surface,
         goto complete;
 
     /* Update backing surface */
+    __guac_common_surface_realize_jpeg(surface, &rect);
     __guac_common_surface_set(surface, &rect, red, green, blue, alpha);
     if (rect.width <= 0 || rect.height <= 0)
         goto complete;
@@ -1552,17 +1990,13 @@ void guac_common_surface_set(guac_common_surface* surface,
     /* Handle as normal draw if non-opaque */
     if (alpha != 0xFF) {
 
-        /* Flush if not combining */
-        if (!__guac_common_should_combine(surface, &rect, 0))
-            __guac_common_surface_flush_deferred(surface);
-
         /* Always defer draws */
         __guac_common_mark_dirty(surface, &rect);
 
     }
 
     /* Defer if combining */
-    else if (__guac_common_should_combine(surface, &rect, 1))
+    else if (__guac_common_should_combine(surface, &rect))
         __guac_common_mark_dirty(surface, &rect);
 
     /* Otherwise, flush and draw immediately */
@@ -1570,6 +2004,7 @@ void guac_common_surface_set(guac_common_surface* surface,
         __guac_common_surface_flush(surface);
         guac_protocol_send_rect(socket, layer, rect.x, rect.y, rect.width, rect.height);
         guac_protocol_send_cfill(socket, GUAC_COMP_OVER, layer, red, green, blue, alpha);
+        __guac_common_surface_touch_video(surface, &rect);
         surface->realized = 1;
     }
 
@@ -1578,6 +2013,49 @@ complete:
 
 }
 
+void guac_common_surface_invalidate(guac_common_surface* surface, int x,
+        int y, int w, int h) {
+
+    pthread_mutex_lock(&surface->_lock);
+
+    guac_common_rect rect;
+    guac_common_rect_init(&rect, x, y, w, h);
+
+    /* Ignore any portion of the rectangle outside the surface */
+    __guac_common_bound_rect(surface, &rect, NULL, NULL);
+    if (rect.width <= 0 || rect.height <= 0)
+        goto complete;
+
+    /* Buffer contents have changed */
+    __guac_common_surface_invalidate_snapshot(surface);
+
+    /* Update the heat map for the update rectangle. */
+    guac_timestamp time = guac_timestamp_current();
+    __guac_common_surface_touch_rect(surface, &rect, time);
+
+    /* Always defer draws */
+    __guac_common_mark_dirty(surface, &rect);
+
+complete:
+    pthread_mutex_unlock(&surface->_lock);
+
+}
+
+int guac_common_surface_modify(guac_common_surface* surface,
+        guac_common_surface_modify_callback* callback, void* data) {
+
+    pthread_mutex_lock(&surface->_lock);
+
+    /* Queued JPEGs must not be drawn over the modified contents later */
+    __guac_common_surface_realize_jpeg(surface, NULL);
+
+    int result = callback(surface, data);
+
+    pthread_mutex_unlock(&surface->_lock);
+    return result;
+
+}
+
 void guac_common_surface_clip(guac_common_surface* surface, int x, int y, int w, int h) {
 
     pthread_mutex_lock(&surface->_lock);
@@ -1604,198 +2082,164 @@ void guac_common_surface_reset_clip(guac_common_surface* surface) {
 }
 
 /**
- * Flushes the bitmap update currently described by the dirty rectangle within
- * the given surface directly via an "img" instruction as PNG data. The
- * resulting instructions will be sent over the socket associated with the
- * given surface.
+ * Flushes the given dirty rectangle of the given surface directly via an
+ * "img" instruction as PNG data. The resulting instructions will be sent over
+ * the socket associated with the given surface.
  *
  * @param surface
  *     The surface to flush.
  *
+ * @param dirty
+ *     The dirty rectangle to flush.
+ *
  * @param opaque
  *     Whether the rectangle being flushed contains only fully-opaque pixels.
  */
 static void __guac_common_surface_flush_to_png(guac_common_surface* surface,
-        int opaque) {
-
-    if (surface->dirty) {
+        const guac_common_rect* dirty, int opaque) {
 
-        guac_socket* socket = surface->socket;
-        const guac_layer* layer = surface->layer;
-
-        /* Get Cairo surface for specified rect */
-        unsigned char* buffer = surface->buffer
-                              + surface->dirty_rect.y * surface->stride
-                              + surface->dirty_rect.x * 4;
-
-        cairo_surface_t* rect;
+    guac_socket* socket = surface->socket;
+    const guac_layer* layer = surface->layer;
 
-        /* Use RGB24 if the image is fully opaque */
-        if (opaque)
-            rect = cairo_image_surface_create_for_data(buffer,
-                    CAIRO_FORMAT_RGB24, surface->dirty_rect.width,
-                    surface->dirty_rect.height, surface->stride);
+    /* Get Cairo surface for specified rect */
+    unsigned char* buffer = surface->buffer
+                          + dirty->y * surface->stride
+                          + dirty->x * 4;
 
-        /* Otherwise ARGB32 is needed */
-        else {
+    cairo_surface_t* rect;
 
-            rect = cairo_image_surface_create_for_data(buffer,
-                    CAIRO_FORMAT_ARGB32, surface->dirty_rect.width,
-                    surface->dirty_rect.height, surface->stride);
+    /* Use RGB24 if the image is fully opaque */
+    if (opaque)
+        rect = cairo_image_surface_create_for_data(buffer,
+                CAIRO_FORMAT_RGB24, dirty->width,
+                dirty->height, surface->stride);
 
-            /* Clear destination rect first */
-            guac_protocol_send_rect(socket, layer,
-                    surface->dirty_rect.x, surface->dirty_rect.y,
-                    surface->dirty_rect.width, surface->dirty_rect.height);
-            guac_protocol_send_cfill(socket, GUAC_COMP_ROUT, layer,
-                    0x00, 0x00, 0x00, 0xFF);
+    /* Otherwise ARGB32 is needed */
+    else {
 
-        }
+        rect = cairo_image_surface_create_for_data(buffer,
+                CAIRO_FORMAT_ARGB32, dirty->width,
+                dirty->height, surface->stride);
 
-        /* Send PNG for rect */
-        guac_client_stream_png(surface->client, socket, GUAC_COMP_OVER,
-                layer, surface->dirty_rect.x, surface->dirty_rect.y, rect);
+        /* Clear destination rect first */
+        guac_protocol_send_rect(socket, layer,
+                dirty->x, dirty->y, dirty->width, dirty->height);
+        guac_protocol_send_cfill(socket, GUAC_COMP_ROUT, layer,
+                0x00, 0x00, 0x00, 0xFF);
 
-        cairo_surface_destroy(rect);
-        surface->realized = 1;
+    }
 
-        /* Surface is no longer dirty */
-        surface->dirty = 0;
+    /* Send PNG for rect */
+    guac_client_stream_png(surface->client, socket, GUAC_COMP_OVER,
+            layer, dirty->x, dirty->y, rect);
 
-    }
+    cairo_surface_destroy(rect);
+    surface->realized = 1;
 
 }
 
 /**
- * Flushes the bitmap update currently described by the dirty rectangle within
- * the given surface directly via an "img" instruction as JPEG data. The
- * resulting instructions will be sent over the socket associated with the
- * given surface.
+ * Flushes the given dirty rectangle of the given surface directly via an
+ * "img" instruction as JPEG data. The resulting instructions will be sent
+ * over the socket associated with the given surface.
  *
  * @param surface
  *     The surface to flush.
+ *
+ * @param dirty
+ *     The dirty rectangle to flush. This rectangle will be expanded to fit
+ *     the JPEG block grid.
  */
-static void __guac_common_surface_flush_to_jpeg(guac_common_surface* surface) {
-
-    if (surface->dirty) {
+static void __guac_common_surface_flush_to_jpeg(guac_common_surface* surface,
+        guac_common_rect* dirty) {
 
-        guac_socket* socket = surface->socket;
-        const guac_layer* layer = surface->layer;
-
-        guac_common_rect max;
-        guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
+    guac_socket* socket = surface->socket;
+    const guac_layer* layer = surface->layer;
 
-        /* Expand the dirty rect size to fit in a grid with cells equal to the
-         * minimum JPEG block size */
-        guac_common_rect_expand_to_grid(GUAC_SURFACE_JPEG_BLOCK_SIZE,
-                                        &surface->dirty_rect, &max);
+    guac_common_rect max;
+    guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
 
-        /* Get Cairo surface for specified rect */
-        unsigned char* buffer = surface->buffer
-                              + surface->dirty_rect.y * surface->stride
-                              + surface->dirty_rect.x * 4;
+    /* Expand the dirty rect size to fit in a grid with cells equal to the
+     * minimum JPEG block size */
+    guac_common_rect_expand_to_grid(GUAC_SURFACE_JPEG_BLOCK_SIZE, dirty, &max);
 
-        cairo_surface_t* rect = cairo_image_surface_create_for_data(buffer,
-                CAIRO_FORMAT_RGB24, surface->dirty_rect.width,
-                surface->dirty_rect.height, surface->stride);
+    /* The expanded rect may cover JPEGs not yet decoded */
+    __guac_common_surface_realize_jpeg(surface, dirty);
 
-        /* Send JPEG for rect */
-        guac_client_stream_jpeg(surface->client, socket, GUAC_COMP_OVER, layer,
-                surface->dirty_rect.x, surface->dirty_rect.y, rect,
-                GUAC_SURFACE_JPEG_IMAGE_QUALITY);
+    /* Get Cairo surface for specified rect */
+    unsigned char* buffer = surface->buffer
+                          + dirty->y * surface->stride
+                          + dirty->x * 4;
 
-        cairo_surface_destroy(rect);
-        surface->realized = 1;
+    cairo_surface_t* rect = cairo_image_surface_create_for_data(buffer,
+            CAIRO_FORMAT_RGB24, dirty->width,
+            dirty->height, surface->stride);
 
-        /* Surface is no longer dirty */
-        surface->dirty = 0;
+    /* Send JPEG for rect */
+    guac_client_stream_jpeg(surface->client, socket, GUAC_COMP_OVER, layer,
+            dirty->x, dirty->y, rect, GUAC_SURFACE_JPEG_IMAGE_QUALITY);
 
-    }
+    cairo_surface_destroy(rect);
+    surface->realized = 1;
 
 }
 
 /**
- * Flushes the bitmap update currently described by the dirty rectangle within
- * the given surface directly via an "img" instruction as WebP data. The
- * resulting instructions will be sent over the socket associated with the
- * given surface.
+ * Flushes the given dirty rectangle of the given surface directly via an
+ * "img" instruction as WebP data. The resulting instructions will be sent
+ * over the socket associated with the given surface.
  *
  * @param surface
  *     The surface to flush.
  *
+ * @param dirty
+ *     The dirty rectangle to flush. This rectangle will be expanded to fit
+ *     the WebP block grid.
+ *
  * @param opaque
  *     Whether the rectangle being flushed contains only fully-opaque pixels.
  */
 static void __guac_common_surface_flush_to_webp(guac_common_surface* surface,
-        int opaque) {
+        guac_common_rect* dirty, int opaque) {
 
-    if (surface->dirty) {
-
-        guac_socket* socket = surface->socket;
-        const guac_layer* layer = surface->layer;
-
-        guac_common_rect max;
-        guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
-
-        /* Expand the dirty rect size to fit in a grid with cells equal to the
-         * minimum WebP block size */
-        guac_common_rect_expand_to_grid(GUAC_SURFACE_WEBP_BLOCK_SIZE,
-                                        &surface->dirty_rect, &max);
-
-        /* Get Cairo surface for specified rect */
-        unsigned char* buffer = surface->buffer
-                              + surface->dirty_rect.y * surface->stride
-                              + surface->dirty_rect.x * 4;
-
-        cairo_surface_t* rect;
-
-        /* Use RGB24 if the image is fully opaque */
-        if (opaque)
-            rect = cairo_image_surface_create_for_data(buffer,
-                    CAIRO_FORMAT_RGB24, surface->dirty_rect.width,
-                    surface->dirty_rect.height, surface->stride);
-
-        /* Otherwise ARGB32 is needed */
-        else
-            rect = cairo_image_surface_create_for_data(buffer,
-                    CAIRO_FORMAT_ARGB32, surface->dirty_rect.width,
-                    surface->dirty_rect.height, surface->stride);
-
-        /* Send WebP for rect */
-        guac_client_stream_webp(surface->client, socket, GUAC_COMP_OVER, layer,
-                surface->dirty_rect.x, surface->dirty_rect.y, rect,
-                GUAC_SURFACE_WEBP_IMAGE_QUALITY, 0);
+    guac_socket* socket = surface->socket;
+    const guac_layer* layer = surface->layer;
 
-        cairo_surface_destroy(rect);
-        surface->realized = 1;
+    guac_common_rect max;
+    guac_common_rect_init(&max, 0, 0, surface->width, surface->height);
 
-        /* Surface is no longer dirty */
-        surface->dirty = 0;
+    /* Expand the dirty rect size to fit in a grid with cells equal to the
+     * minimum WebP block size */
+    guac_common_rect_expand_to_grid(GUAC_SURFACE_WEBP_BLOCK_SIZE, dirty, &max);
 
-    }
+    /* The expanded rect may cover JPEGs not yet decoded */
+    __guac_common_surface_realize_jpeg(surface, dirty);
 
-}
+    /* Get Cairo surface for specified rect */
+    unsigned char* buffer = surface->buffer
+                          + dirty->y * surface->stride
+                          + dirty->x * 4;
 
-/**
- * Comparator for instances of guac_common_surface_bitmap_rect, the elements
- * which make up a surface's bitmap buffer.
- *
- * @see qsort
- */
-static int __guac_common_surface_bitmap_rect_compare(const void* a, const void* b) {
+    cairo_surface_t* rect;
 
-    guac_common_surface_bitmap_rect* ra = (guac_common_surface_bitmap_rect*) a;
-    guac_common_surface_bitmap_rect* rb = (guac_common_surface_bitmap_rect*) b;
+    /* Use RGB24 if the image is fully opaque */
+    if (opaque)
+        rect = cairo_image_surface_create_for_data(buffer,
+                CAIRO_FORMAT_RGB24, dirty->width,
+                dirty->height, surface->stride);
 
-    /* Order roughly top to bottom, left to right */
-    if (ra->rect.y != rb->rect.y) return ra->rect.y - rb->rect.y;
-    if (ra->rect.x != rb->rect.x) return ra->rect.x - rb->rect.x;
+    /* Otherwise ARGB32 is needed */
+    else
+        rect = cairo_image_surface_create_for_data(buffer,
+                CAIRO_FORMAT_ARGB32, dirty->width,
+                dirty->height, surface->stride);
 
-    /* Wider updates should come first (more likely to intersect later) */
-    if (ra->rect.width != rb->rect.width) return rb->rect.width - ra->rect.width;
+    /* Send WebP for rect */
+    guac_client_stream_webp(surface->client, socket, GUAC_COMP_OVER, layer,
+            dirty->x, dirty->y, rect, GUAC_SURFACE_WEBP_IMAGE_QUALITY, 0);
 
-    /* Shorter updates should come first (less likely to increase cost) */
-    return ra->rect.height - rb->rect.height;
+    cairo_surface_destroy(rect);
+    surface->realized = 1;
 
 }
 
@@ -1833,103 +2277,171 @@ static void __guac_common_surface_flush_properties(
 
 static void __guac_common_surface_flush(guac_common_surface* surface) {
 
-    /* Flush final dirty rectangle to queue. */
-    __guac_common_surface_flush_to_queue(surface);
+    guac_common_rect dirty;
 
-    guac_common_surface_bitmap_rect* current = surface->bitmap_queue;
-    int i, j;
-    int original_queue_length;
-    int flushed = 0;
+    /* Flush each rectangle of changed cells, top to bottom */
+    while (guac_common_damage_next(surface->damage, &dirty)) {
 
-    original_queue_length = surface->bitmap_queue_length;
+        /* Skip anything covered entirely by video */
+        if (__guac_common_surface_flush_to_video(surface, &dirty))
+            continue;
 
-    /* Sort updates to make combination less costly */
-    qsort(surface->bitmap_queue, surface->bitmap_queue_length, sizeof(guac_common_surface_bitmap_rect),
-          __guac_common_surface_bitmap_rect_compare);
+        /* Image data must be up to date before being encoded */
+        __guac_common_surface_realize_jpeg(surface, &dirty);
 
-    /* Flush all rects in queue */
-    for (i=0; i < surface->bitmap_queue_length; i++) {
+        int opaque = __guac_common_surface_is_opaque(surface, &dirty);
 
-        /* Get next unflushed candidate */
-        guac_common_surface_bitmap_rect* candidate = current;
-        if (!candidate->flushed) {
+        /* Prefer WebP when reasonable */
+        if (__guac_common_surface_should_use_webp(surface, &dirty))
+            __guac_common_surface_flush_to_webp(surface, &dirty, opaque);
 
-            int combined = 0;
+        /* If not WebP, JPEG is the next best (lossy) choice */
+        else if (opaque && __guac_common_surface_should_use_jpeg(
+                    surface, &dirty))
+            __guac_common_surface_flush_to_jpeg(surface, &dirty);
 
-            /* Build up rect as much as possible */
-            for (j=i; j < surface->bitmap_queue_length; j++) {
-
-                if (!candidate->flushed) {
+        /* Use PNG if no lossy formats are appropriate */
+        else
+            __guac_common_surface_flush_to_png(surface, &dirty, opaque);
 
-                    /* Clip candidate within current bounds */
-                    __guac_common_bound_rect(surface, &candidate->rect, NULL, NULL);
-                    if (candidate->rect.width <= 0 || candidate->rect.height <= 0)
-                        candidate->flushed = 1;
+    }
 
-                    /* Combine if reasonable */
-                    else if (__guac_common_should_combine(surface, &candidate->rect, 0) || !surface->dirty) {
-                        __guac_common_mark_dirty(surface, &candidate->rect);
-                        candidate->flushed = 1;
-                        combined++;
-                    }
+}
 
-                }
+void guac_common_surface_flush(guac_common_surface* surface) {
 
-                candidate++;
+    pthread_mutex_lock(&surface->_lock);
 
-            }
+    /* Flush any applicable layer properties */
+    __guac_common_surface_flush_properties(surface);
 
-            /* Re-add to queue if there's room and this update was modified or we expect others might be */
-            if ((combined > 1 || i < original_queue_length)
-                    && surface->bitmap_queue_length < GUAC_COMMON_SURFACE_QUEUE_SIZE)
-                __guac_common_surface_flush_to_queue(surface);
+    /* Flush surface contents */
+    __guac_common_surface_flush(surface);
 
-            /* Flush as bitmap otherwise */
-            else if (surface->dirty) {
+    /* Send next frame of any video */
+    __guac_common_surface_flush_video(surface);
 
-                flushed++;
+    pthread_mutex_unlock(&surface->_lock);
 
-                int opaque = __guac_common_surface_is_opaque(surface,
-                            &surface->dirty_rect);
+}
 
-                /* Prefer WebP when reasonable */
-                if (__guac_common_surface_should_use_webp(surface,
-                            &surface->dirty_rect))
-                    __guac_common_surface_flush_to_webp(surface, opaque);
+/**
+ * Appends PNG data produced by Cairo to the snapshot of the surface being
+ * encoded, growing the snapshot as necessary. The behavior of this function
+ * is dictated by cairo_write_func_t.
+ *
+ * @param closure
+ *     The guac_common_surface whose snapshot is being written.
+ *
+ * @param data
+ *     The PNG data to append.
+ *
+ * @param length
+ *     The number of bytes of PNG data to append.
+ *
+ * @return
+ *     CAIRO_STATUS_SUCCESS if the data was appended, CAIRO_STATUS_NO_MEMORY
+ *     if the snapshot could not be grown.
+ */
+static cairo_status_t __guac_common_surface_snapshot_write(void* closure,
+        const unsigned char* data, unsigned int length) {
 
-                /* If not WebP, JPEG is the next best (lossy) choice */
-                else if (opaque && __guac_common_surface_should_use_jpeg(
-                            surface, &surface->dirty_rect))
-                    __guac_common_surface_flush_to_jpeg(surface);
+    guac_common_surface* surface = (guac_common_surface*) closure;
 
-                /* Use PNG if no lossy formats are appropriate */
-                else
-                    __guac_common_surface_flush_to_png(surface, opaque);
+    /* Grow snapshot as necessary */
+    int required = surface->snapshot_length + length;
+    if (required > surface->snapshot_size) {
 
-            }
+        int size = surface->snapshot_size * 2;
+        if (size < required)
+            size = required;
 
-        }
+        unsigned char* snapshot = realloc(surface->snapshot, size);
+        if (snapshot == NULL)
+            return CAIRO_STATUS_NO_MEMORY;
 
-        current++;
+        surface->snapshot = snapshot;
+        surface->snapshot_size = size;
 
     }
 
-    /* Flush complete */
-    surface->bitmap_queue_length = 0;
+    memcpy(surface->snapshot + surface->snapshot_length, data, length);
+    surface->snapshot_length += length;
+
+    return CAIRO_STATUS_SUCCESS;
 
 }
 
-void guac_common_surface_flush(guac_common_surface* surface) {
+/**
+ * Encodes the entire contents of the given surface as PNG, storing the result
+ * as the surface snapshot. If encoding fails, the surface is left without a
+ * snapshot. The surface lock must be held.
+ *
+ * @param surface
+ *     The surface to encode.
+ */
+static void __guac_common_surface_snapshot(guac_common_surface* surface) {
 
-    pthread_mutex_lock(&surface->_lock);
+    /* Get entire surface */
+    cairo_surface_t* rect = cairo_image_surface_create_for_data(
+            surface->buffer, CAIRO_FORMAT_ARGB32,
+            surface->width, surface->height, surface->stride);
 
-    /* Flush any applicable layer properties */
-    __guac_common_surface_flush_properties(surface);
+    /* Encode as PNG, discarding any partial result on failure */
+    if (cairo_surface_write_to_png_stream(rect,
+                __guac_common_surface_snapshot_write, surface)
+            != CAIRO_STATUS_SUCCESS)
+        __guac_common_surface_invalidate_snapshot(surface);
 
-    /* Flush surface contents */
-    __guac_common_surface_flush(surface);
+    cairo_surface_destroy(rect);
 
-    pthread_mutex_unlock(&surface->_lock);
+}
+
+/**
+ * Sends the cached snapshot of the given surface to the given user as an
+ * image stream drawn at the upper-left corner of the surface layer. The
+ * snapshot must already exist. The surface lock must be held.
+ *
+ * @param surface
+ *     The surface whose snapshot should be sent.
+ *
+ * @param user
+ *     The user to whom the snapshot should be sent.
+ *
+ * @param socket
+ *     The socket over which the snapshot should be sent.
+ */
+static void __guac_common_surface_send_snapshot(guac_common_surface* surface,
+        guac_user* user, guac_socket* socket) {
+
+    /* Allocate new stream for image */
+    guac_stream* stream = guac_user_alloc_stream(user);
+
+    /* Declare stream as containing image data */
+    guac_protocol_send_img(socket, stream, GUAC_COMP_OVER, surface->layer,
+            "image/png", 0, 0);
+
+    /* Send cached PNG data as blobs */
+    unsigned char* current = surface->snapshot;
+    int remaining = surface->snapshot_length;
+    while (remaining > 0) {
+
+        int length = remaining;
+        if (length > GUAC_COMMON_SURFACE_SNAPSHOT_BLOB_SIZE)
+            length = GUAC_COMMON_SURFACE_SNAPSHOT_BLOB_SIZE;
+
+        guac_protocol_send_blob(socket, stream, current, length);
+
+        current += length;
+        remaining -= length;
+
+    }
+
+    /* Terminate stream */
+    guac_protocol_send_end(socket, stream);
+
+    /* Free allocated stream */
+    guac_user_free_stream(user, stream);
 
 }
 
@@ -1942,6 +2454,11 @@ void guac_common_surface_dup(guac_common_surface* surface, guac_user* user,
     if (!surface->realized)
         goto complete;
 
+    /* The new user will not receive any video already in progress, and the
+     * layer beneath that video is out of date */
+    if (surface->video != NULL)
+        surface->video_stale = 1;
+
     /* Synchronize layer-specific properties if applicable */
     if (surface->layer->index > 0) {
 
@@ -1961,20 +2478,72 @@ void guac_common_surface_dup(guac_common_surface* surface, guac_user* user,
     /* Send contents of layer, if non-empty */
     if (surface->width > 0 && surface->height > 0) {
 
-        /* Get entire surface */
-        cairo_surface_t* rect = cairo_image_surface_create_for_data(
-                surface->buffer, CAIRO_FORMAT_ARGB32,
-                surface->width, surface->height, surface->stride);
+        /* Entire surface must be up to date */
+        __guac_common_surface_realize_jpeg(surface, NULL);
+
+        /* Encode entire surface only if not already encoded for a previous
+         * user since last changed */
+        if (surface->snapshot == NULL)
+            __guac_common_surface_snapshot(surface);
 
-        /* Send PNG for rect */
-        guac_user_stream_png(user, socket, GUAC_COMP_OVER, surface->layer,
-                0, 0, rect);
-        cairo_surface_destroy(rect);
+        /* Replay cached snapshot */
+        if (surface->snapshot != NULL)
+            __guac_common_surface_send_snapshot(surface, user, socket);
+
+        /* Fall back to encoding directly for this user if the snapshot
+         * could not be created */
+        else {
+
+            /* Get entire surface */
+            cairo_surface_t* rect = cairo_image_surface_create_for_data(
+                    surface->buffer, CAIRO_FORMAT_ARGB32,
+                    surface->width, surface->height, surface->stride);
+
+            /* Send PNG for rect */
+            guac_user_stream_png(user, socket, GUAC_COMP_OVER, surface->layer,
+                    0, 0, rect);
+            cairo_surface_destroy(rect);
+
+        }
+
+    }
+
+complete:
+    pthread_mutex_unlock(&surface->_lock);
+
+}
+
+unsigned char* guac_common_surface_export(guac_common_surface* surface,
+        int* length) {
+
+    unsigned char* data = NULL;
+
+    pthread_mutex_lock(&surface->_lock);
+
+    /* Empty surfaces cannot be encoded */
+    if (surface->width <= 0 || surface->height <= 0)
+        goto complete;
+
+    /* Entire surface must be up to date */
+    __guac_common_surface_realize_jpeg(surface, NULL);
+
+    /* Reuse any snapshot already encoded for a joining user */
+    if (surface->snapshot == NULL)
+        __guac_common_surface_snapshot(surface);
+
+    if (surface->snapshot == NULL)
+        goto complete;
 
+    /* Hand the caller its own copy */
+    data = malloc(surface->snapshot_length);
+    if (data != NULL) {
+        memcpy(data, surface->snapshot, surface->snapshot_length);
+        *length = surface->snapshot_length;
     }
 
 complete:
     pthread_mutex_unlock(&surface->_lock);
+    return data;
 
 }
 
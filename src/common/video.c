@@ -0,0 +1,397 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "common/rect.h"
+#include "common/video.h"
+
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+#include <guacamole/timestamp.h>
+#include <guacamole/user.h>
+#include <libavcodec/avcodec.h>
+#include <libavutil/dict.h>
+#include <libavutil/imgutils.h>
+#include <libswscale/swscale.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct guac_common_video {
+
+    /**
+     * The client to which the video is being streamed.
+     */
+    guac_client* client;
+
+    /**
+     * The socket over which instructions and encoded video are sent.
+     */
+    guac_socket* socket;
+
+    /**
+     * The layer dedicated to playback of the video.
+     */
+    guac_layer* layer;
+
+    /**
+     * The stream over which encoded video is sent.
+     */
+    guac_stream* stream;
+
+    /**
+     * The width of the video, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the video, in pixels.
+     */
+    int height;
+
+    /**
+     * The H.264 encoder.
+     */
+    AVCodecContext* context;
+
+    /**
+     * The frame receiving YUV image data converted from the surface prior to
+     * encoding.
+     */
+    AVFrame* frame;
+
+    /**
+     * The libswscale context converting from ARGB to YUV.
+     */
+    struct SwsContext* sws;
+
+    /**
+     * The time at which the first frame was encoded, or zero if no frames
+     * have yet been encoded. Presentation timestamps are relative to this
+     * time, in milliseconds.
+     */
+    guac_timestamp start;
+
+    /**
+     * The presentation timestamp of the most recently encoded frame.
+     */
+    int64_t last_pts;
+
+};
+
+/**
+ * Guard ensuring libavcodec is initialized only once.
+ */
+static pthread_once_t guac_common_video_init_once = PTHREAD_ONCE_INIT;
+
+/**
+ * Initializes libavcodec, if required by the version of libavcodec in use.
+ * This function must be invoked via pthread_once().
+ */
+static void guac_common_video_init(void) {
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58,10,100)
+    avcodec_register_all();
+#endif
+}
+
+/**
+ * Returns whether the given user has declared support for
+ * GUAC_COMMON_VIDEO_MIMETYPE.
+ *
+ * @param user
+ *     The user to check.
+ *
+ * @return
+ *     Non-zero if the user supports the video produced by guac_common_video,
+ *     zero otherwise.
+ */
+static int guac_common_video_user_supported(guac_user* user) {
+
+    const char** mimetype = user->info.video_mimetypes;
+    if (mimetype == NULL)
+        return 0;
+
+    /* Search for H.264 within list of supported video mimetypes */
+    while (*mimetype != NULL) {
+
+        if (strcmp(*mimetype, GUAC_COMMON_VIDEO_MIMETYPE) == 0)
+            return 1;
+
+        mimetype++;
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Callback which is invoked by guac_common_video_supported() for each user
+ * associated with the given client, updating an overall support flag
+ * describing video support for the client as a whole.
+ *
+ * @param user
+ *     The user to check for video support.
+ *
+ * @param data
+ *     Pointer to an int containing the current video support status for the
+ *     client associated with the given user. This flag will be 0 if any user
+ *     already checked has lacked video support, or 1 otherwise.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_common_video_support_callback(guac_user* user, void* data) {
+
+    int* video_supported = (int*) data;
+
+    /* Check whether current user supports video */
+    if (*video_supported)
+        *video_supported = guac_common_video_user_supported(user);
+
+    return NULL;
+
+}
+
+int guac_common_video_supported(guac_client* client) {
+
+    pthread_once(&guac_common_video_init_once, guac_common_video_init);
+
+    /* Video cannot be produced at all without an H.264 encoder */
+    if (avcodec_find_encoder(AV_CODEC_ID_H264) == NULL)
+        return 0;
+
+    /* Video is supported for entire client only if each user supports it */
+    int video_supported = 1;
+    guac_client_foreach_user(client, guac_common_video_support_callback,
+            &video_supported);
+
+    return video_supported;
+
+}
+
+/**
+ * Sends the given packet of encoded video over the stream of the given video,
+ * split across as many blobs as necessary.
+ *
+ * @param video
+ *     The video whose stream should receive the packet.
+ *
+ * @param data
+ *     The encoded video data to send.
+ *
+ * @param size
+ *     The number of bytes of encoded video data.
+ */
+static void guac_common_video_send_packet(guac_common_video* video,
+        const unsigned char* data, int size) {
+
+    while (size > 0) {
+
+        int length = size;
+        if (length > GUAC_COMMON_VIDEO_BLOB_SIZE)
+            length = GUAC_COMMON_VIDEO_BLOB_SIZE;
+
+        guac_protocol_send_blob(video->socket, video->stream, data, length);
+
+        data += length;
+        size -= length;
+
+    }
+
+}
+
+guac_common_video* guac_common_video_alloc(guac_client* client,
+        guac_socket* socket, const guac_layer* parent,
+        const guac_common_rect* rect) {
+
+    pthread_once(&guac_common_video_init_once, guac_common_video_init);
+
+    const AVCodec* codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (codec == NULL)
+        goto fail_codec;
+
+    AVCodecContext* context = avcodec_alloc_context3(codec);
+    if (context == NULL)
+        goto fail_context;
+
+    /* Encode with minimal latency: no B-frames, and timestamps in
+     * milliseconds as frames arrive at an irregular rate */
+    context->bit_rate = (int64_t) rect->width * rect->height
+                      * GUAC_COMMON_VIDEO_BITRATE_PER_PIXEL;
+    context->width = rect->width;
+    context->height = rect->height;
+    context->time_base = (AVRational) { 1, 1000 };
+    context->gop_size = GUAC_COMMON_VIDEO_KEYFRAME_INTERVAL;
+    context->max_b_frames = 0;
+    context->pix_fmt = AV_PIX_FMT_YUV420P;
+
+    /* Options recognized by libx264 (ignored by other encoders) */
+    AVDictionary* options = NULL;
+    av_dict_set(&options, "preset", "ultrafast", 0);
+    av_dict_set(&options, "tune", "zerolatency", 0);
+
+    int result = avcodec_open2(context, codec, &options);
+    av_dict_free(&options);
+
+    if (result < 0)
+        goto fail_codec_open;
+
+    AVFrame* frame = av_frame_alloc();
+    if (frame == NULL)
+        goto fail_frame;
+
+    frame->format = context->pix_fmt;
+    frame->width = context->width;
+    frame->height = context->height;
+
+    if (av_image_alloc(frame->data, frame->linesize, frame->width,
+                frame->height, frame->format, 32) < 0)
+        goto fail_frame_data;
+
+    struct SwsContext* sws = sws_getContext(
+            rect->width, rect->height, AV_PIX_FMT_RGB32,
+            rect->width, rect->height, AV_PIX_FMT_YUV420P,
+            SWS_POINT, NULL, NULL, NULL);
+
+    if (sws == NULL)
+        goto fail_sws;
+
+    guac_common_video* video = malloc(sizeof(guac_common_video));
+    if (video == NULL)
+        goto fail_video;
+
+    video->client = client;
+    video->socket = socket;
+    video->width = rect->width;
+    video->height = rect->height;
+    video->context = context;
+    video->frame = frame;
+    video->sws = sws;
+    video->start = 0;
+    video->last_pts = -1;
+
+    /* Cover the requested region with a dedicated layer */
+    video->layer = guac_client_alloc_layer(client);
+    guac_protocol_send_size(socket, video->layer, rect->width, rect->height);
+    guac_protocol_send_move(socket, video->layer, parent,
+            rect->x, rect->y, 0);
+
+    /* Begin video stream */
+    video->stream = guac_client_alloc_stream(client);
+    guac_protocol_send_video(socket, video->stream, video->layer,
+            GUAC_COMMON_VIDEO_MIMETYPE);
+
+    return video;
+
+    /* Free all allocated data in case of failure */
+fail_video:
+    sws_freeContext(sws);
+
+fail_sws:
+    av_freep(&frame->data[0]);
+
+fail_frame_data:
+    av_frame_free(&frame);
+
+fail_frame:
+fail_codec_open:
+    avcodec_free_context(&context);
+
+fail_context:
+fail_codec:
+    return NULL;
+
+}
+
+int guac_common_video_encode(guac_common_video* video,
+        const unsigned char* buffer, int stride, guac_timestamp timestamp) {
+
+    AVFrame* frame = video->frame;
+
+    /* Convert image data to YUV */
+    const uint8_t* src_data[] = { buffer };
+    const int src_stride[] = { stride };
+    sws_scale(video->sws, src_data, src_stride, 0, video->height,
+            frame->data, frame->linesize);
+
+    /* Presentation timestamps must strictly increase */
+    if (video->start == 0)
+        video->start = timestamp;
+
+    int64_t pts = timestamp - video->start;
+    if (pts <= video->last_pts)
+        pts = video->last_pts + 1;
+
+    frame->pts = video->last_pts = pts;
+
+    /* Init video packet, requesting that encoder allocate its data */
+    AVPacket packet;
+    av_init_packet(&packet);
+    packet.data = NULL;
+    packet.size = 0;
+
+/* For libavcodec < 57.37.100: input/output was not decoupled */
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(57,37,100)
+    int got_data;
+    if (avcodec_encode_video2(video->context, &packet, frame, &got_data) < 0)
+        return 1;
+
+    if (got_data) {
+        guac_common_video_send_packet(video, packet.data, packet.size);
+        av_packet_unref(&packet);
+    }
+#else
+    if (avcodec_send_frame(video->context, frame) < 0)
+        return 1;
+
+    /* Send all available packets */
+    while (avcodec_receive_packet(video->context, &packet) == 0) {
+        guac_common_video_send_packet(video, packet.data, packet.size);
+        av_packet_unref(&packet);
+    }
+#endif
+
+    return 0;
+
+}
+
+void guac_common_video_free(guac_common_video* video) {
+
+    /* End stream and remove video from display */
+    guac_protocol_send_end(video->socket, video->stream);
+    guac_protocol_send_dispose(video->socket, video->layer);
+
+    guac_client_free_stream(video->client, video->stream);
+    guac_client_free_layer(video->client, video->layer);
+
+    /* Free encoder */
+    sws_freeContext(video->sws);
+    av_freep(&video->frame->data[0]);
+    av_frame_free(&video->frame);
+    avcodec_free_context(&video->context);
+
+    free(video);
+
+}
+
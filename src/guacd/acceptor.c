@@ -0,0 +1,277 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "acceptor.h"
+#include "connection.h"
+#include "log.h"
+#include "proc.h"
+#include "proc-map.h"
+
+#include <guacamole/error.h>
+#include <guacamole/socket.h>
+
+#ifdef ENABLE_SSL
+#include <openssl/ssl.h>
+#include <guacamole/socket-ssl.h>
+#endif
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/**
+ * Starts a new, detached connection thread for the given newly-accepted
+ * connection. If the connection thread cannot be started, the connection is
+ * closed.
+ *
+ * @param map
+ *     The shared map of all connected clients.
+ *
+ * @param fd
+ *     The file descriptor of the newly-accepted connection.
+ *
+ * @param socket
+ *     The guac_socket already opened for the connection, or NULL if the
+ *     connection thread should open its own guac_socket for the given file
+ *     descriptor.
+ */
+static void guacd_start_connection(guacd_proc_map* map, int fd,
+        guac_socket* socket) {
+
+    pthread_t child_thread;
+
+    /* Create parameters for connection thread */
+    guacd_connection_thread_params* params = malloc(sizeof(guacd_connection_thread_params));
+    if (params == NULL) {
+        guacd_log(GUAC_LOG_ERROR, "Could not create connection thread: %s", strerror(errno));
+        goto fail;
+    }
+
+    params->map = map;
+    params->connected_socket_fd = fd;
+    params->socket = socket;
+
+#ifdef ENABLE_SSL
+    /* Any required SSL/TLS handshake has already been performed */
+    params->ssl_context = NULL;
+#endif
+
+    /* Spawn thread to handle connection */
+    if (pthread_create(&child_thread, NULL, guacd_connection_thread, params)) {
+        guacd_log(GUAC_LOG_ERROR, "Could not create connection thread.");
+        free(params);
+        goto fail;
+    }
+
+    pthread_detach(child_thread);
+    return;
+
+fail:
+
+    /* Freeing the guac_socket also closes its file descriptor */
+    if (socket != NULL)
+        guac_socket_free(socket);
+    else
+        close(fd);
+
+}
+
+#ifdef ENABLE_SSL
+/**
+ * Sets the send and receive timeouts of the given socket, such that blocking
+ * reads and writes fail after the given number of milliseconds.
+ *
+ * @param fd
+ *     The file descriptor of the socket to modify.
+ *
+ * @param timeout
+ *     The timeout to set, in milliseconds, or zero to block indefinitely.
+ */
+static void guacd_set_socket_timeout(int fd, int timeout) {
+
+    struct timeval tv = {
+        .tv_sec  = timeout / 1000,
+        .tv_usec = (timeout % 1000) * 1000
+    };
+
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv))
+            || setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)))
+        guacd_log(GUAC_LOG_DEBUG, "Unable to set socket timeout: %s",
+                strerror(errno));
+
+}
+
+/**
+ * Performs SSL/TLS handshakes for connections queued within a handshake pool,
+ * starting a connection thread for each connection whose handshake succeeds.
+ *
+ * @param data
+ *     The guacd_handshake_pool to take connections from.
+ *
+ * @return
+ *     Always NULL. This function does not return.
+ */
+static void* guacd_handshake_thread(void* data) {
+
+    guacd_handshake_pool* pool = (guacd_handshake_pool*) data;
+
+    for (;;) {
+
+        /* Wait for next connection */
+        pthread_mutex_lock(&pool->lock);
+        while (pool->length == 0)
+            pthread_cond_wait(&pool->not_empty, &pool->lock);
+
+        int fd = pool->queue[pool->head];
+        pool->head = (pool->head + 1) % GUACD_HANDSHAKE_QUEUE_SIZE;
+        pool->length--;
+
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->lock);
+
+        /* Do not allow a stalled client to occupy this thread indefinitely */
+        guacd_set_socket_timeout(fd, GUACD_TIMEOUT);
+
+        guac_socket* socket = guac_socket_open_secure(pool->ssl_context, fd);
+        if (socket == NULL) {
+            guacd_log_guac_error(GUAC_LOG_ERROR, "Unable to set up SSL/TLS");
+            close(fd);
+            continue;
+        }
+
+        /* The connection itself may legitimately be idle */
+        guacd_set_socket_timeout(fd, 0);
+
+        guac_socket_ssl_data* ssl_data = (guac_socket_ssl_data*) socket->data;
+        guacd_log(GUAC_LOG_DEBUG, "SSL/TLS handshake complete (kernel TLS "
+                "offload: send %s, receive %s).",
+                ssl_data->ktls_send ? "active" : "inactive",
+                ssl_data->ktls_recv ? "active" : "inactive");
+
+        guacd_start_connection(pool->map, fd, socket);
+
+    }
+
+    return NULL;
+
+}
+
+guacd_handshake_pool* guacd_handshake_pool_alloc(guacd_proc_map* map,
+        SSL_CTX* ssl_context, int threads) {
+
+    guacd_handshake_pool* pool = calloc(1, sizeof(guacd_handshake_pool));
+    if (pool == NULL)
+        return NULL;
+
+    pool->map = map;
+    pool->ssl_context = ssl_context;
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_empty, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+
+    /* Start all handshake threads */
+    for (int i = 0; i < threads; i++) {
+
+        pthread_t handshake_thread;
+        if (pthread_create(&handshake_thread, NULL,
+                    guacd_handshake_thread, pool)) {
+
+            guacd_log(GUAC_LOG_ERROR, "Could not create SSL/TLS handshake "
+                    "thread.");
+
+            /* The pool cannot be freed once any thread is using it */
+            if (i > 0)
+                return pool;
+
+            free(pool);
+            return NULL;
+
+        }
+
+        pthread_detach(handshake_thread);
+
+    }
+
+    return pool;
+
+}
+
+void guacd_handshake_pool_submit(guacd_handshake_pool* pool, int fd) {
+
+    pthread_mutex_lock(&pool->lock);
+
+    /* Apply backpressure to acceptors while handshake threads catch up */
+    while (pool->length == GUACD_HANDSHAKE_QUEUE_SIZE)
+        pthread_cond_wait(&pool->not_full, &pool->lock);
+
+    int tail = (pool->head + pool->length) % GUACD_HANDSHAKE_QUEUE_SIZE;
+    pool->queue[tail] = fd;
+    pool->length++;
+
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+
+}
+#endif
+
+void* guacd_acceptor_thread(void* data) {
+
+    guacd_acceptor_params* params = (guacd_acceptor_params*) data;
+
+    struct sockaddr_in client_addr;
+    socklen_t client_addr_len;
+
+    for (;;) {
+
+        /* Accept connection */
+        client_addr_len = sizeof(client_addr);
+        int connected_socket_fd = accept(params->socket_fd,
+                (struct sockaddr*) &client_addr, &client_addr_len);
+
+        if (connected_socket_fd < 0) {
+            guacd_log(GUAC_LOG_ERROR, "Could not accept client connection: %s", strerror(errno));
+            continue;
+        }
+
+#ifdef ENABLE_SSL
+        /* Defer to handshake pool if SSL/TLS is required */
+        if (params->handshake_pool != NULL) {
+            guacd_handshake_pool_submit(params->handshake_pool,
+                    connected_socket_fd);
+            continue;
+        }
+#endif
+
+        guacd_start_connection(params->map, connected_socket_fd, NULL);
+
+    }
+
+    return NULL;
+
+}
+
@@ -0,0 +1,173 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUACD_ACCEPTOR_H
+#define GUACD_ACCEPTOR_H
+
+#include "config.h"
+
+#include "proc-map.h"
+
+#ifdef ENABLE_SSL
+#include <openssl/ssl.h>
+#endif
+
+#include <pthread.h>
+
+#ifdef ENABLE_SSL
+/**
+ * The maximum number of accepted connections which may be waiting for an
+ * SSL/TLS handshake thread. Once this many connections are waiting, acceptor
+ * threads block until a handshake thread becomes available, leaving any
+ * further connections queued within the listen backlog of the kernel.
+ */
+#define GUACD_HANDSHAKE_QUEUE_SIZE 256
+
+/**
+ * A fixed-size pool of threads which perform the SSL/TLS handshakes of newly
+ * accepted connections. Limiting the number of concurrent handshakes prevents
+ * a burst of reconnecting clients from spawning an unbounded number of
+ * threads which all compete for CPU time at once.
+ */
+typedef struct guacd_handshake_pool {
+
+    /**
+     * The SSL context to use for all handshakes.
+     */
+    SSL_CTX* ssl_context;
+
+    /**
+     * The shared map of all connected clients, to which connections are
+     * routed once their handshakes complete.
+     */
+    guacd_proc_map* map;
+
+    /**
+     * Circular queue of the file descriptors of all accepted connections
+     * which are waiting for a handshake thread.
+     */
+    int queue[GUACD_HANDSHAKE_QUEUE_SIZE];
+
+    /**
+     * The index of the oldest file descriptor within the queue.
+     */
+    int head;
+
+    /**
+     * The number of file descriptors currently within the queue.
+     */
+    int length;
+
+    /**
+     * Lock which guards access to the queue.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled whenever a connection is added to the
+     * queue.
+     */
+    pthread_cond_t not_empty;
+
+    /**
+     * Condition which is signalled whenever a connection is removed from the
+     * queue.
+     */
+    pthread_cond_t not_full;
+
+} guacd_handshake_pool;
+
+/**
+ * Allocates a new handshake pool, starting the given number of handshake
+ * threads. The pool and its threads persist for the lifetime of guacd.
+ *
+ * @param map
+ *     The shared map of all connected clients.
+ *
+ * @param ssl_context
+ *     The SSL context to use for all handshakes.
+ *
+ * @param threads
+ *     The number of handshake threads to start.
+ *
+ * @return
+ *     A newly-allocated handshake pool, or NULL if the pool or any of its
+ *     threads could not be created.
+ */
+guacd_handshake_pool* guacd_handshake_pool_alloc(guacd_proc_map* map,
+        SSL_CTX* ssl_context, int threads);
+
+/**
+ * Queues the given newly-accepted connection for an SSL/TLS handshake,
+ * blocking if the queue is full. Once the handshake succeeds, the connection
+ * is handled by its own connection thread, as with unencrypted connections.
+ *
+ * @param pool
+ *     The handshake pool which should perform the handshake.
+ *
+ * @param fd
+ *     The file descriptor of the newly-accepted connection.
+ */
+void guacd_handshake_pool_submit(guacd_handshake_pool* pool, int fd);
+#endif
+
+/**
+ * Parameters required by each acceptor thread.
+ */
+typedef struct guacd_acceptor_params {
+
+    /**
+     * The listening socket on which connections should be accepted.
+     */
+    int socket_fd;
+
+    /**
+     * The shared map of all connected clients.
+     */
+    guacd_proc_map* map;
+
+#ifdef ENABLE_SSL
+    /**
+     * The pool which should perform the SSL/TLS handshakes of accepted
+     * connections. If SSL is not active, this will be NULL.
+     */
+    guacd_handshake_pool* handshake_pool;
+#endif
+
+} guacd_acceptor_params;
+
+/**
+ * Accepts connections on a listening socket forever, starting a connection
+ * thread for each accepted connection (or first passing the connection to
+ * the handshake pool if SSL/TLS is in use). Multiple acceptor threads may run
+ * at once, each with its own listening socket bound to the same address with
+ * SO_REUSEPORT.
+ *
+ * @param data
+ *     A pointer to a guacd_acceptor_params structure describing the
+ *     listening socket and where accepted connections should be handed off.
+ *
+ * @return
+ *     Always NULL. This function does not return under normal operation.
+ */
+void* guacd_acceptor_thread(void* data);
+
+#endif
+
@@ -60,6 +60,34 @@ static int guacd_conf_callback(const char* section, const char* param, const cha
             return 0;
         }
 
+        /* Listen backlog */
+        else if (strcmp(param, "listen_backlog") == 0) {
+
+            int backlog = guacd_parse_count(value);
+            if (backlog <= 0) {
+                guacd_conf_parse_error = "The listen backlog must be a positive integer";
+                return 1;
+            }
+
+            config->listen_backlog = backlog;
+            return 0;
+
+        }
+
+        /* Number of acceptor threads */
+        else if (strcmp(param, "acceptor_threads") == 0) {
+
+            int threads = guacd_parse_count(value);
+            if (threads <= 0) {
+                guacd_conf_parse_error = "The number of acceptor threads must be a positive integer";
+                return 1;
+            }
+
+            config->acceptor_threads = threads;
+            return 0;
+
+        }
+
     }
 
     /* Options related to daemon startup */
@@ -107,6 +135,34 @@ static int guacd_conf_callback(const char* section, const char* param, const cha
             config->key_file = strdup(value);
             return 0;
         }
+
+        /* Number of handshake threads */
+        else if (strcmp(param, "handshake_threads") == 0) {
+
+            int threads = guacd_parse_count(value);
+            if (threads <= 0) {
+                guacd_conf_parse_error = "The number of handshake threads must be a positive integer";
+                return 1;
+            }
+
+            config->handshake_threads = threads;
+            return 0;
+
+        }
+
+        /* Session cache size */
+        else if (strcmp(param, "session_cache_size") == 0) {
+
+            int size = guacd_parse_count(value);
+            if (size < 0) {
+                guacd_conf_parse_error = "The session cache size must be a non-negative integer";
+                return 1;
+            }
+
+            config->session_cache_size = size;
+            return 0;
+
+        }
 #else
         guacd_conf_parse_error = "SSL support not compiled in";
         return 1;
@@ -178,6 +234,8 @@ guacd_config* guacd_conf_load() {
     /* Load defaults */
     conf->bind_host = NULL;
     conf->bind_port = strdup("4822");
+    conf->listen_backlog = GUACD_DEFAULT_LISTEN_BACKLOG;
+    conf->acceptor_threads = GUACD_DEFAULT_ACCEPTOR_THREADS;
     conf->pidfile = NULL;
     conf->foreground = 0;
     conf->print_version = 0;
@@ -186,6 +244,8 @@ guacd_config* guacd_conf_load() {
 #ifdef ENABLE_SSL
     conf->cert_file = NULL;
     conf->key_file = NULL;
+    conf->handshake_threads = GUACD_DEFAULT_HANDSHAKE_THREADS;
+    conf->session_cache_size = GUACD_DEFAULT_SSL_SESSION_CACHE_SIZE;
 #endif
 
     /* Read configuration from file */
@@ -25,6 +25,7 @@
 #include <guacamole/client.h>
 
 #include <ctype.h>
+#include <limits.h>
 #include <string.h>
 
 /*
@@ -535,3 +536,28 @@ int guacd_parse_log_level(const char* name) {
 
 }
 
+int guacd_parse_count(const char* value) {
+
+    /* Require at least one digit */
+    if (*value == '\0')
+        return -1;
+
+    int count = 0;
+    for (; *value != '\0'; value++) {
+
+        /* Only decimal digits are allowed */
+        if (*value < '0' || *value > '9')
+            return -1;
+
+        /* Refuse values which would overflow */
+        if (count > (INT_MAX - (*value - '0')) / 10)
+            return -1;
+
+        count = count * 10 + (*value - '0');
+
+    }
+
+    return count;
+
+}
+
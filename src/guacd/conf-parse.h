@@ -53,6 +53,12 @@ int guacd_parse_conf(guacd_param_callback* callback, char* buffer, int length, v
  */
 int guacd_parse_log_level(const char* name);
 
+/**
+ * Parses the given string as a non-negative decimal integer, returning that
+ * integer, or -1 if the string is not a valid non-negative integer.
+ */
+int guacd_parse_count(const char* value);
+
 /**
  * Human-readable description of the current error, if any.
  */
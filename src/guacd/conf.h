@@ -24,6 +24,31 @@
 
 #include <guacamole/client.h>
 
+/**
+ * The default maximum number of pending connections which may be queued by
+ * the kernel for each listening socket. The effective value may be further
+ * limited by the operating system (net.core.somaxconn on Linux).
+ */
+#define GUACD_DEFAULT_LISTEN_BACKLOG 1024
+
+/**
+ * The default number of threads accepting connections.
+ */
+#define GUACD_DEFAULT_ACCEPTOR_THREADS 1
+
+#ifdef ENABLE_SSL
+/**
+ * The default number of threads performing SSL/TLS handshakes for newly
+ * accepted connections.
+ */
+#define GUACD_DEFAULT_HANDSHAKE_THREADS 4
+
+/**
+ * The default maximum number of SSL/TLS sessions cached for resumption.
+ */
+#define GUACD_DEFAULT_SSL_SESSION_CACHE_SIZE 1024
+#endif
+
 /**
  * The contents of a guacd configuration file.
  */
@@ -39,6 +64,19 @@ typedef struct guacd_config {
      */
     char* bind_port;
 
+    /**
+     * The maximum number of pending connections which may be queued by the
+     * kernel for each listening socket.
+     */
+    int listen_backlog;
+
+    /**
+     * The number of threads accepting connections. If greater than one, each
+     * thread accepts connections on its own listening socket bound with
+     * SO_REUSEPORT, allowing the kernel to distribute connections among them.
+     */
+    int acceptor_threads;
+
     /**
      * The file to write the PID in, if any.
      */
@@ -64,6 +102,19 @@ typedef struct guacd_config {
      * SSL private key file.
      */
     char* key_file;
+
+    /**
+     * The number of threads performing SSL/TLS handshakes for newly accepted
+     * connections. Handshakes beyond this number wait for a thread to become
+     * available.
+     */
+    int handshake_threads;
+
+    /**
+     * The maximum number of SSL/TLS sessions cached for resumption by
+     * reconnecting clients. If zero, session resumption is disabled.
+     */
+    int session_cache_size;
 #endif
 
     /**
@@ -365,14 +365,15 @@ void* guacd_connection_thread(void* data) {
     guacd_proc_map* map = params->map;
     int connected_socket_fd = params->connected_socket_fd;
 
-    guac_socket* socket;
+    /* Use socket if already opened on behalf of this thread */
+    guac_socket* socket = params->socket;
 
 #ifdef ENABLE_SSL
 
     SSL_CTX* ssl_context = params->ssl_context;
 
-    /* If SSL chosen, use it */
-    if (ssl_context != NULL) {
+    /* If SSL chosen (and not already set up by a handshake thread), use it */
+    if (socket == NULL && ssl_context != NULL) {
         socket = guac_socket_open_secure(ssl_context, connected_socket_fd);
         if (socket == NULL) {
             guacd_log_guac_error(GUAC_LOG_ERROR, "Unable to set up SSL/TLS");
@@ -381,12 +382,13 @@ void* guacd_connection_thread(void* data) {
             return NULL;
         }
     }
-    else
+    else if (socket == NULL)
         socket = guac_socket_open(connected_socket_fd);
 
 #else
     /* Open guac_socket */
-    socket = guac_socket_open(connected_socket_fd);
+    if (socket == NULL)
+        socket = guac_socket_open(connected_socket_fd);
 #endif
 
     /* Route connection according to Guacamole, creating a new process if needed */
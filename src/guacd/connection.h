@@ -24,6 +24,8 @@
 
 #include "proc-map.h"
 
+#include <guacamole/socket.h>
+
 #ifdef ENABLE_SSL
 #include <openssl/ssl.h>
 #endif
@@ -51,6 +53,14 @@ typedef struct guacd_connection_thread_params {
      */
     int connected_socket_fd;
 
+    /**
+     * The guac_socket already opened for the newly-accepted connection, such
+     * as when the SSL/TLS handshake was performed by a handshake thread, or
+     * NULL if the socket should be opened by the connection thread from
+     * connected_socket_fd.
+     */
+    guac_socket* socket;
+
 } guacd_connection_thread_params;
 
 /**
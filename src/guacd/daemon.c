@@ -19,6 +19,7 @@
 
 #include "config.h"
 
+#include "acceptor.h"
 #include "conf.h"
 #include "conf-args.h"
 #include "conf-file.h"
@@ -35,6 +36,7 @@
 #include <libgen.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -245,15 +247,80 @@ static void guacd_openssl_free_locks(int count) {
 #endif
 #endif
 
+/**
+ * The session ID context to associate with all SSL/TLS sessions established
+ * by guacd, as required for sessions to be resumed.
+ */
+#define GUACD_SSL_SESSION_ID_CONTEXT "guacd"
+
+/**
+ * Creates a new TCP socket bound to the given address. If requested, the
+ * socket is created with SO_REUSEPORT, such that additional sockets may be
+ * bound to the same address, with incoming connections distributed among
+ * them by the kernel.
+ *
+ * @param address
+ *     The address to bind to.
+ *
+ * @param reuse_port
+ *     Non-zero if the socket should be created with SO_REUSEPORT, zero
+ *     otherwise.
+ *
+ * @return
+ *     The file descriptor of the bound socket, or -1 if the socket could not
+ *     be created or bound, in which case errno is set appropriately.
+ */
+static int guacd_bind_socket(struct addrinfo* address, int reuse_port) {
+
+    int opt_on = 1;
+
+    /* Get socket */
+    int socket_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (socket_fd < 0) {
+        guacd_log(GUAC_LOG_ERROR, "Error opening socket: %s", strerror(errno));
+        return -1;
+    }
+
+    /* Allow socket reuse */
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR,
+                (void*) &opt_on, sizeof(opt_on))) {
+        guacd_log(GUAC_LOG_WARNING, "Unable to set socket options for reuse: %s",
+                strerror(errno));
+    }
+
+#ifdef SO_REUSEPORT
+    /* Allow multiple listening sockets on the same port, if requested */
+    if (reuse_port && setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT,
+                (void*) &opt_on, sizeof(opt_on))) {
+        int error = errno;
+        close(socket_fd);
+        errno = error;
+        return -1;
+    }
+#endif
+
+    /* Attempt to bind socket to address */
+    if (bind(socket_fd, address->ai_addr, address->ai_addrlen)) {
+        int error = errno;
+        close(socket_fd);
+        errno = error;
+        return -1;
+    }
+
+    return socket_fd;
+
+}
+
 int main(int argc, char* argv[]) {
 
     /* Server */
-    int socket_fd;
+    int socket_fd = -1;
+    int* socket_fds;
+    int listener_count;
     struct addrinfo* addresses;
     struct addrinfo* current_address;
     char bound_address[1024];
     char bound_port[64];
-    int opt_on = 1;
 
     struct addrinfo hints = {
         .ai_family   = AF_UNSPEC,
@@ -261,13 +328,12 @@ int main(int argc, char* argv[]) {
         .ai_protocol = IPPROTO_TCP
     };
 
-    /* Client */
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len;
-    int connected_socket_fd;
+    /* Acceptors */
+    guacd_acceptor_params* acceptors;
 
 #ifdef ENABLE_SSL
     SSL_CTX* ssl_context = NULL;
+    guacd_handshake_pool* handshake_pool = NULL;
 #endif
 
     guacd_proc_map* map = guacd_proc_map_alloc();
@@ -304,19 +370,14 @@ int main(int argc, char* argv[]) {
 
     }
 
-    /* Get socket */
-    socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (socket_fd < 0) {
-        guacd_log(GUAC_LOG_ERROR, "Error opening socket: %s", strerror(errno));
-        exit(EXIT_FAILURE);
-    }
-
-    /* Allow socket reuse */
-    if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR,
-                (void*) &opt_on, sizeof(opt_on))) {
-        guacd_log(GUAC_LOG_WARNING, "Unable to set socket options for reuse: %s",
-                strerror(errno));
+#ifndef SO_REUSEPORT
+    /* Multiple acceptors require multiple sockets bound to the same port */
+    if (config->acceptor_threads > 1) {
+        guacd_log(GUAC_LOG_WARNING, "SO_REUSEPORT is not supported on this "
+                "platform. Only one acceptor thread will be used.");
+        config->acceptor_threads = 1;
     }
+#endif
 
     /* Attempt binding of each address until success */
     current_address = addresses;
@@ -334,9 +395,10 @@ int main(int argc, char* argv[]) {
                     gai_strerror(retval));
 
         /* Attempt to bind socket to address */
-        if (bind(socket_fd,
-                    current_address->ai_addr,
-                    current_address->ai_addrlen) == 0) {
+        socket_fd = guacd_bind_socket(current_address,
+                config->acceptor_threads > 1);
+
+        if (socket_fd >= 0) {
 
             guacd_log(GUAC_LOG_DEBUG, "Successfully bound socket to "
                     "host %s, port %s", bound_address, bound_port);
@@ -362,6 +424,28 @@ int main(int argc, char* argv[]) {
         exit(EXIT_FAILURE);
     }
 
+    /* Bind one listening socket per acceptor thread */
+    socket_fds = malloc(sizeof(int) * config->acceptor_threads);
+    if (socket_fds == NULL) {
+        guacd_log(GUAC_LOG_ERROR, "Unable to allocate listening sockets.");
+        exit(EXIT_FAILURE);
+    }
+
+    socket_fds[0] = socket_fd;
+    for (listener_count = 1; listener_count < config->acceptor_threads;
+            listener_count++) {
+
+        int additional_fd = guacd_bind_socket(current_address, 1);
+        if (additional_fd < 0) {
+            guacd_log(GUAC_LOG_WARNING, "Unable to bind additional listening "
+                    "socket: %s", strerror(errno));
+            break;
+        }
+
+        socket_fds[listener_count] = additional_fd;
+
+    }
+
 #ifdef ENABLE_SSL
     /* Init SSL if enabled */
     if (config->key_file != NULL || config->cert_file != NULL) {
@@ -402,6 +486,24 @@ int main(int argc, char* argv[]) {
         else
             guacd_log(GUAC_LOG_WARNING, "No certificate file given - SSL/TLS may not work.");
 
+        /* Allow reconnecting clients to resume previous sessions, skipping
+         * the full handshake. Stateless session tickets are also issued by
+         * default, encrypted with keys private to this guacd process. */
+        if (config->session_cache_size > 0) {
+            SSL_CTX_set_session_cache_mode(ssl_context, SSL_SESS_CACHE_SERVER);
+            SSL_CTX_set_session_id_context(ssl_context,
+                    (const unsigned char*) GUACD_SSL_SESSION_ID_CONTEXT,
+                    strlen(GUACD_SSL_SESSION_ID_CONTEXT));
+            SSL_CTX_sess_set_cache_size(ssl_context,
+                    config->session_cache_size);
+        }
+
+        /* Otherwise, require a full handshake for every connection */
+        else {
+            SSL_CTX_set_session_cache_mode(ssl_context, SSL_SESS_CACHE_OFF);
+            SSL_CTX_set_options(ssl_context, SSL_OP_NO_TICKET);
+        }
+
     }
 #endif
 
@@ -453,51 +555,69 @@ int main(int argc, char* argv[]) {
     freeaddrinfo(addresses);
 
     /* Listen for connections */
-    if (listen(socket_fd, 5) < 0) {
-        guacd_log(GUAC_LOG_ERROR, "Could not listen on socket: %s", strerror(errno));
-        return 3;
+    for (int i = 0; i < listener_count; i++) {
+        if (listen(socket_fds[i], config->listen_backlog) < 0) {
+            guacd_log(GUAC_LOG_ERROR, "Could not listen on socket: %s", strerror(errno));
+            return 3;
+        }
+    }
+
+#ifdef ENABLE_SSL
+    /* Perform SSL/TLS handshakes on a bounded set of threads */
+    if (ssl_context != NULL) {
+        handshake_pool = guacd_handshake_pool_alloc(map, ssl_context,
+                config->handshake_threads);
+        if (handshake_pool == NULL) {
+            guacd_log(GUAC_LOG_ERROR, "Could not start SSL/TLS handshake threads.");
+            return 3;
+        }
     }
+#endif
 
-    /* Daemon loop */
-    for (;;) {
+    acceptors = malloc(sizeof(guacd_acceptor_params) * listener_count);
+    if (acceptors == NULL) {
+        guacd_log(GUAC_LOG_ERROR, "Could not allocate acceptor threads.");
+        return 3;
+    }
 
-        pthread_t child_thread;
+    for (int i = 0; i < listener_count; i++) {
+        acceptors[i].socket_fd = socket_fds[i];
+        acceptors[i].map = map;
+#ifdef ENABLE_SSL
+        acceptors[i].handshake_pool = handshake_pool;
+#endif
+    }
 
-        /* Accept connection */
-        client_addr_len = sizeof(client_addr);
-        connected_socket_fd = accept(socket_fd,
-                (struct sockaddr*) &client_addr, &client_addr_len);
+    /* Start additional acceptor threads, each on its own socket */
+    for (int i = 1; i < listener_count; i++) {
 
-        if (connected_socket_fd < 0) {
-            guacd_log(GUAC_LOG_ERROR, "Could not accept client connection: %s", strerror(errno));
+        pthread_t acceptor_thread;
+        if (pthread_create(&acceptor_thread, NULL, guacd_acceptor_thread,
+                    &acceptors[i])) {
+            guacd_log(GUAC_LOG_WARNING, "Could not create acceptor thread.");
             continue;
         }
 
-        /* Create parameters for connection thread */
-        guacd_connection_thread_params* params = malloc(sizeof(guacd_connection_thread_params));
-        if (params == NULL) {
-            guacd_log(GUAC_LOG_ERROR, "Could not create connection thread: %s", strerror(errno));
-            continue;
-        }
+        pthread_detach(acceptor_thread);
 
-        params->map = map;
-        params->connected_socket_fd = connected_socket_fd;
+    }
 
-#ifdef ENABLE_SSL
-        params->ssl_context = ssl_context;
-#endif
+    guacd_log(GUAC_LOG_DEBUG, "Accepting connections with %i thread(s) "
+            "(backlog of %i).", listener_count, config->listen_backlog);
 
-        /* Spawn thread to handle connection */
-        pthread_create(&child_thread, NULL, guacd_connection_thread, params);
-        pthread_detach(child_thread);
+    /* Daemon loop (accepting on the first socket within this thread) */
+    guacd_acceptor_thread(&acceptors[0]);
 
+    /* Close sockets */
+    for (int i = 0; i < listener_count; i++) {
+        if (close(socket_fds[i]) < 0) {
+            guacd_log(GUAC_LOG_ERROR, "Could not close socket: %s", strerror(errno));
+            return 3;
+        }
     }
 
-    /* Close socket */
-    if (close(socket_fd) < 0) {
-        guacd_log(GUAC_LOG_ERROR, "Could not close socket: %s", strerror(errno));
-        return 3;
-    }
+    free(acceptors);
+    free(socket_fds);
 
 #ifdef ENABLE_SSL
     if (ssl_context != NULL) {
@@ -75,6 +75,11 @@ int guacenc_buffer_resize(guacenc_buffer* buffer, int width, int height) {
     if (buffer->width == width && buffer->height == height)
         return 0;
 
+    /* Both the old and new extents of the buffer are affected */
+    guacenc_buffer_damage(buffer, CAIRO_OPERATOR_SOURCE, 0, 0,
+            width > buffer->width ? width : buffer->width,
+            height > buffer->height ? height : buffer->height);
+
     /* Simply deallocate if new image has absolutely no pixels */
     if (width == 0 || height == 0) {
         guacenc_buffer_free_image(buffer);
@@ -169,3 +174,58 @@ int guacenc_buffer_copy(guacenc_buffer* dst, guacenc_buffer* src) {
 
 }
 
+void guacenc_buffer_damage(guacenc_buffer* buffer, cairo_operator_t op,
+        int x, int y, int width, int height) {
+
+    /* Unbounded operators affect the entire buffer */
+    switch (op) {
+        case CAIRO_OPERATOR_IN:
+        case CAIRO_OPERATOR_OUT:
+        case CAIRO_OPERATOR_DEST_IN:
+        case CAIRO_OPERATOR_DEST_ATOP:
+            x = 0;
+            y = 0;
+            width = buffer->width;
+            height = buffer->height;
+            break;
+        default:
+            break;
+    }
+
+    /* Ignore empty rectangles */
+    if (width <= 0 || height <= 0)
+        return;
+
+    /* Simply assign damage if no damage yet exists */
+    if (buffer->damage_width <= 0 || buffer->damage_height <= 0) {
+        buffer->damage_x = x;
+        buffer->damage_y = y;
+        buffer->damage_width = width;
+        buffer->damage_height = height;
+        return;
+    }
+
+    /* Otherwise, expand existing damage to include new rectangle */
+    int left   = buffer->damage_x < x ? buffer->damage_x : x;
+    int top    = buffer->damage_y < y ? buffer->damage_y : y;
+    int right  = buffer->damage_x + buffer->damage_width;
+    int bottom = buffer->damage_y + buffer->damage_height;
+
+    if (right < x + width)
+        right = x + width;
+
+    if (bottom < y + height)
+        bottom = y + height;
+
+    buffer->damage_x = left;
+    buffer->damage_y = top;
+    buffer->damage_width = right - left;
+    buffer->damage_height = bottom - top;
+
+}
+
+void guacenc_buffer_clear_damage(guacenc_buffer* buffer) {
+    buffer->damage_width = 0;
+    buffer->damage_height = 0;
+}
+
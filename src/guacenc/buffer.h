@@ -71,6 +71,32 @@ typedef struct guacenc_buffer {
      */
     cairo_t* cairo;
 
+    /**
+     * The X coordinate of the upper-left corner of the bounding rectangle of
+     * all regions modified since damage was last cleared. The bounding
+     * rectangle may extend beyond the current bounds of the buffer if the
+     * buffer has been shrunk.
+     */
+    int damage_x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the bounding rectangle of
+     * all regions modified since damage was last cleared.
+     */
+    int damage_y;
+
+    /**
+     * The width of the bounding rectangle of all regions modified since
+     * damage was last cleared, or 0 if nothing has been modified.
+     */
+    int damage_width;
+
+    /**
+     * The height of the bounding rectangle of all regions modified since
+     * damage was last cleared, or 0 if nothing has been modified.
+     */
+    int damage_height;
+
 } guacenc_buffer;
 
 /**
@@ -150,5 +176,40 @@ int guacenc_buffer_fit(guacenc_buffer* buffer, int x, int y);
  */
 int guacenc_buffer_copy(guacenc_buffer* dst, guacenc_buffer* src);
 
-#endif
+/**
+ * Marks the given rectangle of the given buffer as modified, expanding the
+ * buffer's damage rectangle as necessary. If the given Cairo operator is
+ * unbounded (affects pixels outside the drawn area, such as
+ * CAIRO_OPERATOR_IN), the entire buffer is marked as modified.
+ *
+ * @param buffer
+ *     The buffer that has been modified.
+ *
+ * @param op
+ *     The Cairo operator used to modify the buffer.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the modified rectangle.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the modified rectangle.
+ *
+ * @param width
+ *     The width of the modified rectangle, in pixels.
+ *
+ * @param height
+ *     The height of the modified rectangle, in pixels.
+ */
+void guacenc_buffer_damage(guacenc_buffer* buffer, cairo_operator_t op,
+        int x, int y, int width, int height);
+
+/**
+ * Clears the damage rectangle of the given buffer, such that the buffer is
+ * considered unmodified.
+ *
+ * @param buffer
+ *     The buffer whose damage should be cleared.
+ */
+void guacenc_buffer_clear_damage(guacenc_buffer* buffer);
 
+#endif
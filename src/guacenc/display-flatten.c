@@ -26,6 +26,8 @@
 #include <guacamole/client.h>
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -37,6 +39,12 @@
  */
 guacenc_display* __qsort_display;
 
+/**
+ * Lock which must be held while __qsort_display is in use, as displays may be
+ * flattened concurrently when several recordings are encoded at once.
+ */
+static pthread_mutex_t __qsort_display_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /**
  * Comparator which orders layer pointers such that (1) NULL pointers are last,
  * (2) layers with the same parent_index are adjacent, and (3) layers with the
@@ -78,18 +86,285 @@ static int guacenc_display_layer_comparator(const void* a, const void* b) {
 
 }
 
+/**
+ * An arbitrary rectangle, used to track the regions of the display which must
+ * be re-rendered during a flatten operation.
+ */
+typedef struct guacenc_display_rect {
+
+    /**
+     * The X coordinate of the upper-left corner of the rectangle.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the rectangle.
+     */
+    int y;
+
+    /**
+     * The width of the rectangle, or 0 if the rectangle is empty.
+     */
+    int width;
+
+    /**
+     * The height of the rectangle, or 0 if the rectangle is empty.
+     */
+    int height;
+
+} guacenc_display_rect;
+
+/**
+ * Expands the given rectangle such that it contains the given region. Empty
+ * regions are ignored.
+ *
+ * @param rect
+ *     The rectangle to expand.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the region to add.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the region to add.
+ *
+ * @param width
+ *     The width of the region to add.
+ *
+ * @param height
+ *     The height of the region to add.
+ */
+static void guacenc_display_rect_extend(guacenc_display_rect* rect,
+        int x, int y, int width, int height) {
+
+    /* Ignore empty regions */
+    if (width <= 0 || height <= 0)
+        return;
+
+    /* Simply assign region if rectangle is currently empty */
+    if (rect->width <= 0 || rect->height <= 0) {
+        rect->x = x;
+        rect->y = y;
+        rect->width = width;
+        rect->height = height;
+        return;
+    }
+
+    int left   = rect->x < x ? rect->x : x;
+    int top    = rect->y < y ? rect->y : y;
+    int right  = rect->x + rect->width;
+    int bottom = rect->y + rect->height;
+
+    if (right < x + width)
+        right = x + width;
+
+    if (bottom < y + height)
+        bottom = y + height;
+
+    rect->x = left;
+    rect->y = top;
+    rect->width = right - left;
+    rect->height = bottom - top;
+
+}
+
+/**
+ * Reduces the given rectangle such that it contains only the portion which
+ * also lies within the given region. If the two do not intersect, the
+ * resulting rectangle is empty.
+ *
+ * @param rect
+ *     The rectangle to reduce.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the region to clip to.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the region to clip to.
+ *
+ * @param width
+ *     The width of the region to clip to.
+ *
+ * @param height
+ *     The height of the region to clip to.
+ */
+static void guacenc_display_rect_clip(guacenc_display_rect* rect,
+        int x, int y, int width, int height) {
+
+    int left   = rect->x > x ? rect->x : x;
+    int top    = rect->y > y ? rect->y : y;
+    int right  = rect->x + rect->width;
+    int bottom = rect->y + rect->height;
+
+    if (right > x + width)
+        right = x + width;
+
+    if (bottom > y + height)
+        bottom = y + height;
+
+    /* Rectangles which do not intersect result in an empty rectangle */
+    if (right <= left || bottom <= top) {
+        rect->width = 0;
+        rect->height = 0;
+        return;
+    }
+
+    rect->x = left;
+    rect->y = top;
+    rect->width = right - left;
+    rect->height = bottom - top;
+
+}
+
+/**
+ * Determines the position of the given layer relative to the default layer,
+ * taking into account the positions of all ancestors of the layer.
+ *
+ * @param display
+ *     The display containing the layer.
+ *
+ * @param layer
+ *     The layer whose position should be determined.
+ *
+ * @param x
+ *     Pointer to the int which should receive the X coordinate of the layer
+ *     relative to the default layer.
+ *
+ * @param y
+ *     Pointer to the int which should receive the Y coordinate of the layer
+ *     relative to the default layer.
+ *
+ * @return
+ *     Zero if the layer is a descendant of (or is) the default layer, and is
+ *     thus potentially visible, non-zero otherwise.
+ */
+static int guacenc_display_get_offset(guacenc_display* display,
+        guacenc_layer* layer, int* x, int* y) {
+
+    int depth = 0;
+
+    *x = 0;
+    *y = 0;
+
+    /* Walk up the layer tree until the default layer is reached */
+    while (layer != display->layers[0]) {
+
+        /* Layers not attached to the default layer are never visible (the
+         * depth limit also guards against cycles) */
+        int parent_index = layer->parent_index;
+        if (parent_index < 0 || parent_index >= GUACENC_DISPLAY_MAX_LAYERS
+                || ++depth > GUACENC_DISPLAY_MAX_LAYERS)
+            return 1;
+
+        guacenc_layer* parent = display->layers[parent_index];
+        if (parent == NULL)
+            return 1;
+
+        *x += layer->x;
+        *y += layer->y;
+        layer = parent;
+
+    }
+
+    return 0;
+
+}
+
+/**
+ * Determines the region of the default layer which must be re-rendered, based
+ * on the damage of each layer and the position of the mouse cursor, clearing
+ * the damage of each layer. The position of the mouse cursor is recorded
+ * within the display for comparison during the next flatten operation.
+ *
+ * @param display
+ *     The display whose damage should be determined.
+ *
+ * @param damage
+ *     The rectangle which should receive the region of the default layer
+ *     which must be re-rendered.
+ */
+static void guacenc_display_collect_damage(guacenc_display* display,
+        guacenc_display_rect* damage) {
+
+    int i;
+
+    damage->x = 0;
+    damage->y = 0;
+    damage->width = 0;
+    damage->height = 0;
+
+    /* Add damage of all layers, translated to the default layer */
+    for (i = 0; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
+
+        guacenc_layer* layer = display->layers[i];
+        if (layer == NULL)
+            continue;
+
+        guacenc_buffer* buffer = layer->buffer;
+
+        int x, y;
+        if (guacenc_display_get_offset(display, layer, &x, &y) == 0)
+            guacenc_display_rect_extend(damage,
+                    x + buffer->damage_x, y + buffer->damage_y,
+                    buffer->damage_width, buffer->damage_height);
+
+        guacenc_buffer_clear_damage(buffer);
+
+    }
+
+    /* Determine the current bounds of the mouse cursor, if visible */
+    guacenc_cursor* cursor = display->cursor;
+    guacenc_buffer* cursor_buffer = cursor->buffer;
+    guacenc_display_rect cursor_rect = { 0, 0, 0, 0 };
+    if (cursor->x >= 0 && cursor->y >= 0) {
+        cursor_rect.x = cursor->x - cursor->hotspot_x;
+        cursor_rect.y = cursor->y - cursor->hotspot_y;
+        cursor_rect.width = cursor_buffer->width;
+        cursor_rect.height = cursor_buffer->height;
+    }
+
+    /* Both the previous and current cursor bounds are damaged if the cursor
+     * has moved or changed */
+    if (cursor_rect.x != display->cursor_x
+            || cursor_rect.y != display->cursor_y
+            || cursor_rect.width != display->cursor_width
+            || cursor_rect.height != display->cursor_height
+            || cursor_buffer->damage_width > 0) {
+
+        guacenc_display_rect_extend(damage,
+                display->cursor_x, display->cursor_y,
+                display->cursor_width, display->cursor_height);
+
+        guacenc_display_rect_extend(damage,
+                cursor_rect.x, cursor_rect.y,
+                cursor_rect.width, cursor_rect.height);
+
+    }
+
+    guacenc_buffer_clear_damage(cursor_buffer);
+
+    display->cursor_x = cursor_rect.x;
+    display->cursor_y = cursor_rect.y;
+    display->cursor_width = cursor_rect.width;
+    display->cursor_height = cursor_rect.height;
+
+}
+
 /**
  * Renders the mouse cursor on top of the frame buffer of the default layer of
- * the given display.
+ * the given display, within the given region only.
  *
  * @param display
  *     The display whose mouse cursor should be rendered to the frame buffer
  *     of its default layer.
  *
+ * @param damage
+ *     The region of the frame buffer of the default layer being re-rendered.
+ *
  * @return
  *     Zero if rendering succeeds, non-zero otherwise.
  */
-static int guacenc_display_render_cursor(guacenc_display* display) {
+static int guacenc_display_render_cursor(guacenc_display* display,
+        const guacenc_display_rect* damage) {
 
     guacenc_cursor* cursor = display->cursor;
 
@@ -106,7 +381,11 @@ static int guacenc_display_render_cursor(guacenc_display* display) {
     guacenc_buffer* dst = def_layer->frame;
 
     /* Render cursor to layer */
-    if (src->width > 0 && src->height > 0) {
+    if (src->width > 0 && src->height > 0 && dst->cairo != NULL) {
+        cairo_reset_clip(dst->cairo);
+        cairo_rectangle(dst->cairo, damage->x, damage->y,
+                damage->width, damage->height);
+        cairo_clip(dst->cairo);
         cairo_set_source_surface(dst->cairo, src->surface,
                 cursor->x - cursor->hotspot_x,
                 cursor->y - cursor->hotspot_y);
@@ -115,6 +394,7 @@ static int guacenc_display_render_cursor(guacenc_display* display) {
                 cursor->y - cursor->hotspot_y,
                 src->width, src->height);
         cairo_fill(dst->cairo);
+        cairo_reset_clip(dst->cairo);
     }
 
     /* Always succeeds */
@@ -122,18 +402,96 @@ static int guacenc_display_render_cursor(guacenc_display* display) {
 
 }
 
+/**
+ * Resets the given region of the frame buffer of the given layer to the
+ * contents of the layer's buffer. If the frame buffer is not the same size
+ * as the layer's buffer, the frame buffer is resized and reset in its
+ * entirety.
+ *
+ * @param layer
+ *     The layer whose frame buffer should be reset.
+ *
+ * @param region
+ *     The region to reset, in the coordinate space of the layer.
+ */
+static void guacenc_display_reset_frame(guacenc_layer* layer,
+        const guacenc_display_rect* region) {
+
+    guacenc_buffer* buffer = layer->buffer;
+    guacenc_buffer* frame = layer->frame;
+
+    /* Reset entire frame if size has changed */
+    if (frame->width != buffer->width || frame->height != buffer->height) {
+        guacenc_buffer_copy(frame, buffer);
+        return;
+    }
+
+    /* Nothing to reset if layer has no pixels */
+    if (buffer->surface == NULL || frame->cairo == NULL)
+        return;
+
+    /* Overwrite region of frame with contents of buffer */
+    cairo_t* cairo = frame->cairo;
+    cairo_reset_clip(cairo);
+    cairo_rectangle(cairo, region->x, region->y,
+            region->width, region->height);
+    cairo_clip(cairo);
+
+    cairo_set_operator(cairo, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_surface(cairo, buffer->surface, 0, 0);
+    cairo_paint(cairo);
+    cairo_set_operator(cairo, CAIRO_OPERATOR_OVER);
+
+}
+
 int guacenc_display_flatten(guacenc_display* display) {
 
     int i;
     guacenc_layer* render_order[GUACENC_DISPLAY_MAX_LAYERS];
 
+    /* Retrieve default layer (guaranteed to not be NULL) */
+    guacenc_layer* def_layer = guacenc_display_get_layer(display, 0);
+    assert(def_layer != NULL);
+
+    /* Determine the region of the display which must be re-rendered */
+    guacenc_display_rect damage;
+    guacenc_display_collect_damage(display, &damage);
+
+    /* Re-render everything if damage alone is insufficient */
+    bool full = display->damage_all
+        || def_layer->frame->width  != def_layer->buffer->width
+        || def_layer->frame->height != def_layer->buffer->height;
+
+    if (full) {
+        damage.x = 0;
+        damage.y = 0;
+        damage.width = def_layer->buffer->width;
+        damage.height = def_layer->buffer->height;
+    }
+
+    /* Changes outside the default layer are not visible */
+    guacenc_display_rect_clip(&damage, 0, 0,
+            def_layer->buffer->width, def_layer->buffer->height);
+
+    display->damage_x = damage.x;
+    display->damage_y = damage.y;
+    display->damage_width = damage.width;
+    display->damage_height = damage.height;
+    display->damage_all = false;
+
+    /* Nothing to render if nothing has changed */
+    if (damage.width <= 0 || damage.height <= 0)
+        return 0;
+
     /* Copy list of layers within display */
     memcpy(render_order, display->layers, sizeof(render_order));
 
     /* Sort layers by depth, parent, and Z */
+    pthread_mutex_lock(&__qsort_display_lock);
     __qsort_display = display;
     qsort(render_order, GUACENC_DISPLAY_MAX_LAYERS, sizeof(guacenc_layer*),
             guacenc_display_layer_comparator);
+    pthread_mutex_unlock(&__qsort_display_lock);
 
     /* Reset layer frame buffers */
     for (i = 0; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
@@ -143,12 +501,23 @@ int guacenc_display_flatten(guacenc_display* display) {
         if (layer == NULL)
             continue;
 
-        /* Get source buffer and destination frame buffer */
-        guacenc_buffer* buffer = layer->buffer;
-        guacenc_buffer* frame = layer->frame;
-
         /* Reset frame contents */
-        guacenc_buffer_copy(frame, buffer);
+        if (full)
+            guacenc_buffer_copy(layer->frame, layer->buffer);
+
+        /* Reset only the damaged region of visible layers */
+        else {
+
+            int x, y;
+            if (guacenc_display_get_offset(display, layer, &x, &y))
+                continue;
+
+            guacenc_display_rect region = damage;
+            region.x -= x;
+            region.y -= y;
+            guacenc_display_reset_frame(layer, &region);
+
+        }
 
     }
 
@@ -188,9 +557,30 @@ int guacenc_display_flatten(guacenc_display* display) {
         if (cairo == NULL)
             continue;
 
+        /* Determine region of parent affected by layer */
+        guacenc_display_rect region = {
+            layer->x, layer->y, src->width, src->height
+        };
+
+        /* Limit rendering of visible layers to the damaged region */
+        if (!full) {
+
+            int x, y;
+            if (guacenc_display_get_offset(display, parent, &x, &y))
+                continue;
+
+            guacenc_display_rect_clip(&region, damage.x - x, damage.y - y,
+                    damage.width, damage.height);
+
+            if (region.width <= 0 || region.height <= 0)
+                continue;
+
+        }
+
         /* Render buffer to layer */
         cairo_reset_clip(cairo);
-        cairo_rectangle(cairo, layer->x, layer->y, src->width, src->height);
+        cairo_rectangle(cairo, region.x, region.y,
+                region.width, region.height);
         cairo_clip(cairo);
 
         cairo_set_source_surface(cairo, surface, layer->x, layer->y);
@@ -199,7 +589,7 @@ int guacenc_display_flatten(guacenc_display* display) {
     }
 
     /* Render cursor on top of everything else */
-    return guacenc_display_render_cursor(display);
+    return guacenc_display_render_cursor(display, &damage);
 
 }
 
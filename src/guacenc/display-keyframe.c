@@ -0,0 +1,357 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "buffer.h"
+#include "cursor.h"
+#include "display.h"
+#include "layer.h"
+#include "log.h"
+
+#include <cairo/cairo.h>
+#include <guacamole/client.h>
+#include <guacamole/timestamp.h>
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * Tag which precedes each serialized layer within a keyframe.
+ */
+#define GUACENC_KEYFRAME_TAG_LAYER 'L'
+
+/**
+ * Tag which precedes each serialized buffer within a keyframe.
+ */
+#define GUACENC_KEYFRAME_TAG_BUFFER 'B'
+
+/**
+ * Tag which marks the end of a serialized keyframe.
+ */
+#define GUACENC_KEYFRAME_TAG_END 'E'
+
+/**
+ * Writes the given 32-bit integer to the given file, in native byte order.
+ *
+ * @param file
+ *     The file to write to.
+ *
+ * @param value
+ *     The value to write.
+ *
+ * @return
+ *     Zero on success, non-zero if the write fails.
+ */
+static int guacenc_keyframe_write_int(FILE* file, int32_t value) {
+    return fwrite(&value, sizeof(value), 1, file) != 1;
+}
+
+/**
+ * Reads a 32-bit integer previously written with
+ * guacenc_keyframe_write_int().
+ *
+ * @param file
+ *     The file to read from.
+ *
+ * @param value
+ *     Pointer to the int which should receive the value read.
+ *
+ * @return
+ *     Zero on success, non-zero if the read fails.
+ */
+static int guacenc_keyframe_read_int(FILE* file, int* value) {
+
+    int32_t read_value;
+    if (fread(&read_value, sizeof(read_value), 1, file) != 1)
+        return 1;
+
+    *value = read_value;
+    return 0;
+
+}
+
+/**
+ * Writes the given timestamp to the given file, in native byte order.
+ *
+ * @param file
+ *     The file to write to.
+ *
+ * @param value
+ *     The timestamp to write.
+ *
+ * @return
+ *     Zero on success, non-zero if the write fails.
+ */
+static int guacenc_keyframe_write_timestamp(FILE* file, guac_timestamp value) {
+    int64_t written_value = value;
+    return fwrite(&written_value, sizeof(written_value), 1, file) != 1;
+}
+
+/**
+ * Reads a timestamp previously written with
+ * guacenc_keyframe_write_timestamp().
+ *
+ * @param file
+ *     The file to read from.
+ *
+ * @param value
+ *     Pointer to the guac_timestamp which should receive the value read.
+ *
+ * @return
+ *     Zero on success, non-zero if the read fails.
+ */
+static int guacenc_keyframe_read_timestamp(FILE* file,
+        guac_timestamp* value) {
+
+    int64_t read_value;
+    if (fread(&read_value, sizeof(read_value), 1, file) != 1)
+        return 1;
+
+    *value = read_value;
+    return 0;
+
+}
+
+/**
+ * Writes the size, autosize flag, and image contents of the given buffer to
+ * the given file. Image contents are stored as raw rows of premultiplied
+ * ARGB32 pixels, exactly as held by the buffer, prefixed with the length of
+ * the image data in bytes. Encoding the image in any format which does not
+ * store premultiplied pixels (such as PNG) would lose precision for
+ * semi-transparent pixels, such that a display restored from the keyframe
+ * would not match the display from which the keyframe was taken.
+ *
+ * @param buffer
+ *     The buffer to write.
+ *
+ * @param file
+ *     The file to write to.
+ *
+ * @return
+ *     Zero on success, non-zero if the buffer could not be written.
+ */
+static int guacenc_keyframe_write_buffer(guacenc_buffer* buffer, FILE* file) {
+
+    int y;
+
+    if (guacenc_keyframe_write_int(file, buffer->autosize)
+            || guacenc_keyframe_write_int(file, buffer->width)
+            || guacenc_keyframe_write_int(file, buffer->height))
+        return 1;
+
+    /* Buffers without any pixels have no image data */
+    if (buffer->surface == NULL)
+        return guacenc_keyframe_write_int(file, 0);
+
+    size_t row_length = (size_t) buffer->width * 4;
+    if (guacenc_keyframe_write_int(file, row_length * buffer->height))
+        return 1;
+
+    /* Write image data row by row, omitting any stride padding */
+    cairo_surface_flush(buffer->surface);
+    for (y = 0; y < buffer->height; y++) {
+        if (fwrite(buffer->image + y * buffer->stride, 1, row_length, file)
+                != row_length)
+            return 1;
+    }
+
+    return 0;
+
+}
+
+/**
+ * Reads a buffer previously written with guacenc_keyframe_write_buffer(),
+ * replacing the size and contents of the given buffer.
+ *
+ * @param buffer
+ *     The buffer to restore.
+ *
+ * @param file
+ *     The file to read from.
+ *
+ * @return
+ *     Zero on success, non-zero if the buffer could not be read.
+ */
+static int guacenc_keyframe_read_buffer(guacenc_buffer* buffer, FILE* file) {
+
+    int autosize;
+    int width;
+    int height;
+    int length;
+    int y;
+
+    if (guacenc_keyframe_read_int(file, &autosize)
+            || guacenc_keyframe_read_int(file, &width)
+            || guacenc_keyframe_read_int(file, &height)
+            || guacenc_keyframe_read_int(file, &length))
+        return 1;
+
+    /* Restore size (any existing contents are overwritten below) */
+    buffer->autosize = autosize;
+    if (guacenc_buffer_resize(buffer, width, height))
+        return 1;
+
+    /* Nothing further to read if the buffer has no pixels */
+    if (length == 0)
+        return 0;
+
+    /* Fail if the image data does not match the stored size */
+    size_t row_length = (size_t) width * 4;
+    if (buffer->surface == NULL || length != row_length * height)
+        return 1;
+
+    /* Overwrite buffer contents with stored image data */
+    cairo_surface_flush(buffer->surface);
+    for (y = 0; y < height; y++) {
+        if (fread(buffer->image + y * buffer->stride, 1, row_length, file)
+                != row_length)
+            return 1;
+    }
+
+    cairo_surface_mark_dirty(buffer->surface);
+    return 0;
+
+}
+
+int guacenc_display_write_keyframe(guacenc_display* display, FILE* file) {
+
+    int i;
+
+    /* Timeline */
+    if (guacenc_keyframe_write_timestamp(file, display->first_sync)
+            || guacenc_keyframe_write_timestamp(file, display->last_sync))
+        return 1;
+
+    /* Cursor */
+    guacenc_cursor* cursor = display->cursor;
+    if (guacenc_keyframe_write_int(file, cursor->x)
+            || guacenc_keyframe_write_int(file, cursor->y)
+            || guacenc_keyframe_write_int(file, cursor->hotspot_x)
+            || guacenc_keyframe_write_int(file, cursor->hotspot_y)
+            || guacenc_keyframe_write_buffer(cursor->buffer, file))
+        return 1;
+
+    /* All allocated layers */
+    for (i = 0; i < GUACENC_DISPLAY_MAX_LAYERS; i++) {
+
+        guacenc_layer* layer = display->layers[i];
+        if (layer == NULL)
+            continue;
+
+        if (guacenc_keyframe_write_int(file, GUACENC_KEYFRAME_TAG_LAYER)
+                || guacenc_keyframe_write_int(file, i)
+                || guacenc_keyframe_write_int(file, layer->parent_index)
+                || guacenc_keyframe_write_int(file, layer->x)
+                || guacenc_keyframe_write_int(file, layer->y)
+                || guacenc_keyframe_write_int(file, layer->z)
+                || guacenc_keyframe_write_int(file, layer->opacity)
+                || guacenc_keyframe_write_buffer(layer->buffer, file))
+            return 1;
+
+    }
+
+    /* All allocated buffers */
+    for (i = 0; i < GUACENC_DISPLAY_MAX_BUFFERS; i++) {
+
+        guacenc_buffer* buffer = display->buffers[i];
+        if (buffer == NULL)
+            continue;
+
+        if (guacenc_keyframe_write_int(file, GUACENC_KEYFRAME_TAG_BUFFER)
+                || guacenc_keyframe_write_int(file, -i - 1)
+                || guacenc_keyframe_write_buffer(buffer, file))
+            return 1;
+
+    }
+
+    return guacenc_keyframe_write_int(file, GUACENC_KEYFRAME_TAG_END);
+
+}
+
+int guacenc_display_read_keyframe(guacenc_display* display, FILE* file) {
+
+    /* Timeline */
+    if (guacenc_keyframe_read_timestamp(file, &display->first_sync)
+            || guacenc_keyframe_read_timestamp(file, &display->last_sync))
+        return 1;
+
+    /* Cursor */
+    guacenc_cursor* cursor = display->cursor;
+    if (guacenc_keyframe_read_int(file, &cursor->x)
+            || guacenc_keyframe_read_int(file, &cursor->y)
+            || guacenc_keyframe_read_int(file, &cursor->hotspot_x)
+            || guacenc_keyframe_read_int(file, &cursor->hotspot_y)
+            || guacenc_keyframe_read_buffer(cursor->buffer, file))
+        return 1;
+
+    /* Restore layers and buffers until end of keyframe */
+    for (;;) {
+
+        int tag;
+        int index;
+
+        if (guacenc_keyframe_read_int(file, &tag))
+            return 1;
+
+        if (tag == GUACENC_KEYFRAME_TAG_END)
+            break;
+
+        if (guacenc_keyframe_read_int(file, &index))
+            return 1;
+
+        /* Layer and its properties */
+        if (tag == GUACENC_KEYFRAME_TAG_LAYER) {
+
+            guacenc_layer* layer = guacenc_display_get_layer(display, index);
+            if (layer == NULL
+                    || guacenc_keyframe_read_int(file, &layer->parent_index)
+                    || guacenc_keyframe_read_int(file, &layer->x)
+                    || guacenc_keyframe_read_int(file, &layer->y)
+                    || guacenc_keyframe_read_int(file, &layer->z)
+                    || guacenc_keyframe_read_int(file, &layer->opacity)
+                    || guacenc_keyframe_read_buffer(layer->buffer, file))
+                return 1;
+
+        }
+
+        /* Off-screen buffer */
+        else if (tag == GUACENC_KEYFRAME_TAG_BUFFER) {
+
+            guacenc_buffer* buffer = guacenc_display_get_buffer(display, index);
+            if (buffer == NULL
+                    || guacenc_keyframe_read_buffer(buffer, file))
+                return 1;
+
+        }
+
+        /* Anything else means the keyframe is corrupt */
+        else {
+            guacenc_log(GUAC_LOG_WARNING, "Invalid keyframe data");
+            return 1;
+        }
+
+    }
+
+    /* Restored state must be rendered in its entirety */
+    display->damage_all = true;
+    return 0;
+
+}
+
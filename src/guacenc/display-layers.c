@@ -93,6 +93,9 @@ int guacenc_display_free_layer(guacenc_display* display,
     /* Mark layer as freed */
     display->layers[index] = NULL;
 
+    /* Removal of a layer affects the entire display */
+    display->damage_all = true;
+
     return 0;
 
 }
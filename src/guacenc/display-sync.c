@@ -29,6 +29,16 @@
 #include <assert.h>
 #include <stdlib.h>
 
+int guacenc_display_past_range(guacenc_display* display) {
+
+    /* No end if rendering through the end of the recording */
+    if (display->range_end < 0)
+        return 0;
+
+    return display->last_sync - display->first_sync > display->range_end;
+
+}
+
 int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp) {
 
     /* Verify timestamp is not decreasing */
@@ -40,6 +50,15 @@ int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp) {
     /* Update timestamp of display */
     display->last_sync = timestamp;
 
+    /* All positions within the recording are relative to the first sync */
+    if (display->first_sync == 0)
+        display->first_sync = timestamp;
+
+    /* Do not render frames outside the requested range */
+    guac_timestamp position = timestamp - display->first_sync;
+    if (position < display->range_start || guacenc_display_past_range(display))
+        return 0;
+
     /* Flatten display to default layer */
     if (guacenc_display_flatten(display))
         return 1;
@@ -53,8 +72,12 @@ int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp) {
     if (guacenc_video_advance_timeline(display->output, timestamp))
         return 1;
 
-    /* Prepare frame for write upon next flush */
-    guacenc_video_prepare_frame(display->output, def_layer->frame);
+    /* Prepare frame for write upon next flush, reusing the previously
+     * prepared frame as-is if nothing has changed */
+    if (display->damage_width > 0 && display->damage_height > 0)
+        guacenc_video_prepare_frame(display->output, def_layer->frame,
+                display->damage_x, display->damage_y,
+                display->damage_width, display->damage_height);
 #endif
 
     return 0;
@@ -97,6 +97,12 @@ guacenc_display* guacenc_display_alloc(const char* path, const char* codec,
     guacenc_display* display =
         (guacenc_display*) calloc(1, sizeof(guacenc_display));
 
+    /* Render entire recording by default */
+    display->range_end = -1;
+
+    /* Nothing has yet been rendered */
+    display->damage_all = true;
+
 #ifdef LIBAVCODEC_VERSION_INT
     /* Associate display with video output */
     display->output = video;
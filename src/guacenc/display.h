@@ -31,6 +31,9 @@
 #include <guacamole/protocol.h>
 #include <guacamole/timestamp.h>
 
+#include <stdbool.h>
+#include <stdio.h>
+
 /**
  * The maximum number of buffers that the Guacamole video encoder will handle
  * within a single Guacamole protocol dump.
@@ -89,6 +92,82 @@ typedef struct guacenc_display {
      */
     guac_timestamp last_sync;
 
+    /**
+     * The timestamp of the first sync instruction handled, or 0 if no sync has
+     * yet been read. All positions within the recording (such as the range to
+     * be rendered) are relative to this timestamp.
+     */
+    guac_timestamp first_sync;
+
+    /**
+     * The position within the recording, in milliseconds relative to
+     * first_sync, before which frames should not be rendered.
+     */
+    guac_timestamp range_start;
+
+    /**
+     * The position within the recording, in milliseconds relative to
+     * first_sync, after which frames should not be rendered, or -1 if frames
+     * should be rendered through the end of the recording.
+     */
+    guac_timestamp range_end;
+
+    /**
+     * Whether the entire display must be re-rendered when next flattened,
+     * regardless of the damage tracked by each layer. This is set when
+     * changes are made which are not reflected in layer damage, such as
+     * moving, shading, or disposing of a layer.
+     */
+    bool damage_all;
+
+    /**
+     * The X coordinate of the upper-left corner of the rectangle of the
+     * default layer which changed during the most recent flatten operation.
+     */
+    int damage_x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the rectangle of the
+     * default layer which changed during the most recent flatten operation.
+     */
+    int damage_y;
+
+    /**
+     * The width of the rectangle of the default layer which changed during
+     * the most recent flatten operation, or 0 if nothing changed.
+     */
+    int damage_width;
+
+    /**
+     * The height of the rectangle of the default layer which changed during
+     * the most recent flatten operation, or 0 if nothing changed.
+     */
+    int damage_height;
+
+    /**
+     * The X coordinate of the upper-left corner of the mouse cursor as of the
+     * most recent flatten operation.
+     */
+    int cursor_x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the mouse cursor as of the
+     * most recent flatten operation.
+     */
+    int cursor_y;
+
+    /**
+     * The width of the mouse cursor as of the most recent flatten operation,
+     * or 0 if the cursor was not rendered.
+     */
+    int cursor_width;
+
+    /**
+     * The height of the mouse cursor as of the most recent flatten operation,
+     * or 0 if the cursor was not rendered.
+     */
+    int cursor_height;
+
 #ifdef LIBAVCODEC_VERSION_INT
     /**
      * The video that this display is recording to.
@@ -114,12 +193,66 @@ typedef struct guacenc_display {
  */
 int guacenc_display_sync(guacenc_display* display, guac_timestamp timestamp);
 
+/**
+ * Returns whether the current position of the given display, as dictated by
+ * the last sync instruction handled, lies beyond the end of the range of the
+ * recording being rendered.
+ *
+ * @param display
+ *     The display to check.
+ *
+ * @return
+ *     Non-zero if the display has passed the end of the range being rendered,
+ *     zero otherwise.
+ */
+int guacenc_display_past_range(guacenc_display* display);
+
+/**
+ * Writes the full state of the given display (all layers, buffers, the
+ * cursor, and the current timeline position) to the given file as a
+ * keyframe. Image data is stored as PNG. Image streams are not included, and
+ * thus keyframes should only be written when no image streams are open.
+ *
+ * @param display
+ *     The display whose state should be written.
+ *
+ * @param file
+ *     The file to write the keyframe to.
+ *
+ * @return
+ *     Zero if the keyframe was written successfully, non-zero otherwise.
+ */
+int guacenc_display_write_keyframe(guacenc_display* display, FILE* file);
+
+/**
+ * Restores the state of the given display from a keyframe previously written
+ * with guacenc_display_write_keyframe(). The display should be newly
+ * allocated, as layers and buffers not present within the keyframe are left
+ * untouched.
+ *
+ * @param display
+ *     The display whose state should be restored.
+ *
+ * @param file
+ *     The file to read the keyframe from, positioned at the start of the
+ *     keyframe.
+ *
+ * @return
+ *     Zero if the keyframe was read successfully, non-zero otherwise.
+ */
+int guacenc_display_read_keyframe(guacenc_display* display, FILE* file);
+
 /**
  * Flattens the given display, rendering all child layers to the frame buffers
  * of their parent layers. The frame buffer of the default layer of the display
  * will thus contain the flattened, composited rendering of the entire display
- * state after this function succeeds. The contents of the frame buffers of
- * each layer are replaced by this function.
+ * state after this function succeeds.
+ *
+ * Only the regions of each frame buffer affected by damage to the layers of
+ * the display (or by movement of the mouse cursor) are re-rendered, and the
+ * damage of each layer is cleared. The bounding rectangle of all changes to
+ * the default layer is stored within the damage_x, damage_y, damage_width,
+ * and damage_height members of the display.
  *
  * @param display
  *     The display to flatten.
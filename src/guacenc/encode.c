@@ -19,42 +19,62 @@
 
 #include "config.h"
 #include "display.h"
+#include "index.h"
 #include "instructions.h"
 #include "log.h"
 
 #include <guacamole/client.h>
 #include <guacamole/error.h>
 #include <guacamole/parser.h>
-#include <guacamole/socket.h>
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
 
 /**
- * Reads and handles all Guacamole instructions from the given guac_socket
- * until end-of-stream is reached.
+ * Reads and handles all Guacamole instructions within the given
+ * memory-mapped recording until the end of the recording is reached, or
+ * until the end of the range being rendered is reached if no keyframe index
+ * is being built. The recording itself is never modified. If a
+ * keyframe index is being built and a keyframe cannot be stored, that index
+ * is freed and the remainder of the recording is read without indexing.
  *
  * @param display
  *     The current internal display of the Guacamole video encoder.
  *
  * @param path
- *     The name of the file being parsed (for logging purposes). This file
- *     must already be open and available through the given socket.
+ *     The name of the file being parsed (for logging purposes).
  *
- * @param socket
- *     The guac_socket through which instructions should be read.
+ * @param data
+ *     The contents of the recording, mapped read-only. This data is never
+ *     modified.
+ *
+ * @param length
+ *     The length of the recording, in bytes.
+ *
+ * @param offset
+ *     The byte offset within the recording of the first instruction to read.
+ *
+ * @param index
+ *     Pointer to the keyframe index being built while instructions are read,
+ *     which may point to NULL if no index is being built. If indexing fails,
+ *     the index is freed and the pointed-to value is set to NULL.
  *
  * @return
- *     Zero on success, non-zero if parsing of Guacamole protocol data through
- *     the given socket fails.
+ *     Zero on success, non-zero if parsing of the Guacamole protocol data
+ *     within the recording fails.
  */
 static int guacenc_read_instructions(guacenc_display* display,
-        const char* path, guac_socket* socket) {
+        const char* path, const char* data, off_t length, off_t offset,
+        guacenc_index** index) {
 
     /* Obtain Guacamole protocol parser */
     guac_parser* parser = guac_parser_alloc();
@@ -62,20 +82,53 @@ static int guacenc_read_instructions(guacenc_display* display,
         return 1;
 
     /* Continuously read and handle all instructions */
-    while (!guac_parser_read(parser, socket, -1)) {
+    while (offset < length) {
+
+        /* Instructions are far shorter than INT_MAX bytes, so there is no
+         * need to provide the parser with more than that at once */
+        off_t available = length - offset;
+        if (available > INT_MAX)
+            available = INT_MAX;
+
+        int parsed = guac_parser_parse(parser, data + offset, available);
+
+        /* Fail on parse error */
+        if (parsed < 0) {
+            guacenc_log(GUAC_LOG_ERROR, "%s: %s",
+                    path, guac_status_string(guac_error));
+            guac_parser_free(parser);
+            return 1;
+        }
+
+        /* Ignore any incomplete instruction at the end of the recording */
+        if (parsed == 0)
+            break;
+
+        offset += parsed;
+
+        guac_timestamp last_sync = display->last_sync;
+
         if (guacenc_handle_instruction(display, parser->opcode,
                 parser->argc, parser->argv)) {
             guacenc_log(GUAC_LOG_DEBUG, "Handling of \"%s\" instruction "
                     "failed.", parser->opcode);
         }
-    }
 
-    /* Fail on read/parse error */
-    if (guac_error != GUAC_STATUS_CLOSED) {
-        guacenc_log(GUAC_LOG_ERROR, "%s: %s",
-                path, guac_status_string(guac_error));
-        guac_parser_free(parser);
-        return 1;
+        /* Consider storing a keyframe at each sync boundary, resuming at
+         * the instruction following the sync */
+        if (*index != NULL && display->last_sync != last_sync
+                && guacenc_index_update(*index, display, offset)) {
+            guacenc_log(GUAC_LOG_WARNING, "%s: Unable to store keyframe. "
+                    "Recording will not be indexed.", path);
+            guacenc_index_free(*index);
+            *index = NULL;
+        }
+
+        /* Stop once the requested range has been rendered, unless the rest
+         * of the recording must still be read to complete the index */
+        if (*index == NULL && guacenc_display_past_range(display))
+            break;
+
     }
 
     /* Parse complete */
@@ -84,8 +137,56 @@ static int guacenc_read_instructions(guacenc_display* display,
 
 }
 
+/**
+ * Restores the given display from the last keyframe preceding the start of
+ * the range being rendered, providing the offset of the instruction
+ * immediately following that keyframe. If no such keyframe exists, the
+ * display and offset are left untouched.
+ *
+ * @param display
+ *     The newly-allocated display to restore.
+ *
+ * @param path
+ *     The name of the file being encoded (for logging purposes).
+ *
+ * @param offset
+ *     Pointer to the byte offset within the recording at which reading
+ *     should begin, updated if a keyframe is restored.
+ *
+ * @param index
+ *     The keyframe index of the file being encoded.
+ *
+ * @return
+ *     Zero if the display was restored or no keyframe applies, non-zero if
+ *     an error prevents the display from being restored. If non-zero is
+ *     returned, the state of the display is undefined.
+ */
+static int guacenc_seek(guacenc_display* display, const char* path,
+        off_t* offset, guacenc_index* index) {
+
+    /* Nothing to do if no keyframe precedes the start of the range */
+    guacenc_keyframe* keyframe = guacenc_index_find(index,
+            display->range_start);
+    if (keyframe == NULL)
+        return 0;
+
+    if (guacenc_index_restore(index, keyframe, display)) {
+        guacenc_log(GUAC_LOG_ERROR, "%s: Unable to restore keyframe.", path);
+        return 1;
+    }
+
+    *offset = keyframe->offset;
+
+    guacenc_log(GUAC_LOG_DEBUG, "%s: Resuming from keyframe at %" PRId64
+            " ms.", path, (int64_t) keyframe->position);
+
+    return 0;
+
+}
+
 int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force) {
+        int width, int height, int bitrate, guac_timestamp start,
+        guac_timestamp end, bool force, bool build_index) {
 
     /* Open input file */
     int fd = open(path, O_RDONLY);
@@ -129,27 +230,82 @@ int guacenc_encode(const char* path, const char* out_path, const char* codec,
         return 1;
     }
 
-    /* Obtain guac_socket wrapping file descriptor */
-    guac_socket* socket = guac_socket_open(fd);
-    if (socket == NULL) {
-        guacenc_log(GUAC_LOG_ERROR, "%s: %s", path,
-                guac_status_string(guac_error));
+    /* Render only the requested range */
+    display->range_start = start;
+    display->range_end = end;
+
+    /* Determine size of recording */
+    struct stat file_stat;
+    if (fstat(fd, &file_stat)) {
+        guacenc_log(GUAC_LOG_ERROR, "%s: %s", path, strerror(errno));
         close(fd);
         guacenc_display_free(display);
         return 1;
     }
 
+    off_t length = file_stat.st_size;
+    off_t offset = 0;
+
+    /* Resume from nearest keyframe if an up-to-date index exists, otherwise
+     * build the index while reading (if requested) */
+    guacenc_index* index = guacenc_index_load(path, fd);
+    if (index != NULL) {
+
+        int seek_failed = guacenc_seek(display, path, &offset, index);
+        guacenc_index_free(index);
+        index = NULL;
+
+        if (seek_failed || offset > length) {
+            close(fd);
+            guacenc_display_free(display);
+            return 1;
+        }
+
+    }
+    else if (build_index)
+        index = guacenc_index_create(path, fd);
+
+    /* Map recording into memory read-only. Each instruction is copied into
+     * the parser only once complete, thus mapped pages remain shared with the
+     * page cache rather than being privately copied. */
+    char* data = NULL;
+    if (length > 0) {
+
+        data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            guacenc_log(GUAC_LOG_ERROR, "%s: %s", path, strerror(errno));
+            close(fd);
+            guacenc_index_free(index);
+            guacenc_display_free(display);
+            return 1;
+        }
+
+        posix_madvise(data, length, POSIX_MADV_SEQUENTIAL);
+
+    }
+
     guacenc_log(GUAC_LOG_INFO, "Encoding \"%s\" to \"%s\" ...", path, out_path);
 
     /* Attempt to read all instructions in the file */
-    if (guacenc_read_instructions(display, path, socket)) {
-        guac_socket_free(socket);
+    if (guacenc_read_instructions(display, path, data, length, offset,
+                &index)) {
+        if (data != NULL)
+            munmap(data, length);
+        close(fd);
+        guacenc_index_free(index);
         guacenc_display_free(display);
         return 1;
     }
 
+    /* Store index for future seeks (the entire recording has been read) */
+    if (index != NULL)
+        guacenc_index_commit(index);
+
     /* Close input and finish encoding process */
-    guac_socket_free(socket);
+    if (data != NULL)
+        munmap(data, length);
+    close(fd);
+    guacenc_index_free(index);
     return guacenc_display_free(display);
 
 }
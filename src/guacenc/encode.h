@@ -22,10 +22,14 @@
 
 #include "config.h"
 
+#include <guacamole/timestamp.h>
+
 #include <stdbool.h>
 
 /**
- * Encodes the given Guacamole protocol dump as video. A read lock will be
+ * Encodes the given Guacamole protocol dump as video. If requested and no
+ * up-to-date keyframe index exists for the recording, one is built while the
+ * recording is read and stored alongside the recording. A read lock will be
  * acquired on the input file to ensure that in-progress recordings are not
  * encoded. This behavior can be overridden by specifying true for the force
  * parameter.
@@ -50,16 +54,34 @@
  *     The desired overall bitrate of the resulting encoded video, in bits per
  *     second.
  *
+ * @param start
+ *     The position within the recording at which encoding should begin, in
+ *     milliseconds relative to the first frame of the recording. If a
+ *     keyframe index is available for the recording, rendering resumes from
+ *     the nearest preceding keyframe rather than the beginning of the
+ *     recording.
+ *
+ * @param end
+ *     The position within the recording at which encoding should end, in
+ *     milliseconds relative to the first frame of the recording, or -1 to
+ *     encode through the end of the recording.
+ *
  * @param force
  *     Perform the encoding, even if the input file appears to be an
  *     in-progress recording (has an associated lock).
  *
+ * @param build_index
+ *     Whether a keyframe index should be built and stored alongside the
+ *     recording if no up-to-date index exists. Any existing, up-to-date
+ *     index is used regardless of this value.
+ *
  * @return
  *     Zero on success, non-zero if an error prevented successful encoding of
  *     the video.
  */
 int guacenc_encode(const char* path, const char* out_path, const char* codec,
-        int width, int height, int bitrate, bool force);
+        int width, int height, int bitrate, guac_timestamp start,
+        guac_timestamp end, bool force, bool build_index);
 
 #endif
 
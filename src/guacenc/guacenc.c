@@ -19,34 +19,131 @@
 
 #include "config.h"
 
+#include "common/batch.h"
 #include "encode.h"
 #include "guacenc.h"
 #include "log.h"
 #include "parse.h"
 
+#include <guacamole/timestamp.h>
 #include <libavcodec/avcodec.h>
 
+#include <errno.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+
+/**
+ * The encoding options given on the command line, which apply to every
+ * recording being encoded.
+ */
+typedef struct guacenc_options {
+
+    /**
+     * The width of the output video, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of the output video, in pixels.
+     */
+    int height;
+
+    /**
+     * The bitrate of the output video, in bits per second.
+     */
+    int bitrate;
+
+    /**
+     * The position within each recording at which encoding should begin, in
+     * milliseconds.
+     */
+    guac_timestamp start;
+
+    /**
+     * The position within each recording at which encoding should end, in
+     * milliseconds, or -1 to encode through the end of each recording.
+     */
+    guac_timestamp end;
+
+    /**
+     * Whether recordings should be encoded even if they appear to be
+     * in-progress.
+     */
+    bool force;
+
+    /**
+     * Whether a keyframe index should be built for each recording lacking
+     * an up-to-date index.
+     */
+    bool build_index;
+
+} guacenc_options;
+
+/**
+ * Encodes a single recording as part of a batch, logging granular
+ * success/failure at debug level. The behavior of this function is dictated
+ * by guac_common_batch_handler.
+ *
+ * @param path
+ *     The path of the recording to encode.
+ *
+ * @param out_path
+ *     The path of the video file to write.
+ *
+ * @param data
+ *     The guacenc_options to encode with.
+ *
+ * @return
+ *     Zero on success, non-zero if encoding failed.
+ */
+static int guacenc_encode_file(const char* path, const char* out_path,
+        void* data) {
+
+    guacenc_options* options = (guacenc_options*) data;
+
+    if (guacenc_encode(path, out_path, "mpeg4", options->width,
+                options->height, options->bitrate, options->start,
+                options->end, options->force, options->build_index)) {
+        guacenc_log(GUAC_LOG_DEBUG, "%s was NOT successfully encoded.", path);
+        return 1;
+    }
+
+    guacenc_log(GUAC_LOG_DEBUG, "%s was successfully encoded.", path);
+    return 0;
+
+}
 
 int main(int argc, char* argv[]) {
 
     int i;
 
     /* Load defaults */
-    bool force = false;
-    int width = GUACENC_DEFAULT_WIDTH;
-    int height = GUACENC_DEFAULT_HEIGHT;
-    int bitrate = GUACENC_DEFAULT_BITRATE;
+    guacenc_options options = {
+        .width       = GUACENC_DEFAULT_WIDTH,
+        .height      = GUACENC_DEFAULT_HEIGHT,
+        .bitrate     = GUACENC_DEFAULT_BITRATE,
+        .start       = 0,
+        .end         = -1,
+        .force       = false,
+        .build_index = false
+    };
+
+    int jobs = 1;
+    size_t memory_limit = 0;
+    bool resume = false;
+    const char* summary_path = NULL;
 
     /* Parse arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "s:r:f")) != -1) {
+    while ((opt = getopt(argc, argv, "s:r:b:e:fij:m:uS:")) != -1) {
 
         /* -s: Dimensions (WIDTHxHEIGHT) */
         if (opt == 's') {
-            if (guacenc_parse_dimensions(optarg, &width, &height)) {
+            if (guacenc_parse_dimensions(optarg,
+                        &options.width, &options.height)) {
                 guacenc_log(GUAC_LOG_ERROR, "Invalid dimensions.");
                 goto invalid_options;
             }
@@ -54,15 +151,71 @@ int main(int argc, char* argv[]) {
 
         /* -r: Bitrate (bits per second) */
         else if (opt == 'r') {
-            if (guacenc_parse_int(optarg, &bitrate)) {
+            if (guacenc_parse_int(optarg, &options.bitrate)) {
                 guacenc_log(GUAC_LOG_ERROR, "Invalid bitrate.");
                 goto invalid_options;
             }
         }
 
+        /* -b: Beginning of range to encode (seconds) */
+        else if (opt == 'b') {
+            int seconds;
+            if (guacenc_parse_int(optarg, &seconds)) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid start time.");
+                goto invalid_options;
+            }
+            options.start = (guac_timestamp) seconds * 1000;
+        }
+
+        /* -e: End of range to encode (seconds) */
+        else if (opt == 'e') {
+            int seconds;
+            if (guacenc_parse_int(optarg, &seconds)) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid end time.");
+                goto invalid_options;
+            }
+            options.end = (guac_timestamp) seconds * 1000;
+        }
+
         /* -f: Force */
         else if (opt == 'f')
-            force = true;
+            options.force = true;
+
+        /* -i: Always build keyframe index */
+        else if (opt == 'i')
+            options.build_index = true;
+
+        /* -j: Maximum number of recordings to encode at once */
+        else if (opt == 'j') {
+            if (guacenc_parse_int(optarg, &jobs)) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid number of jobs.");
+                goto invalid_options;
+            }
+        }
+
+        /* -m: Approximate memory limit across all jobs (megabytes) */
+        else if (opt == 'm') {
+
+            /* Reject non-positive limits, and limits not representable in
+             * bytes */
+            int megabytes;
+            if (guacenc_parse_int(optarg, &megabytes)
+                    || (size_t) megabytes > SIZE_MAX / (1024 * 1024)) {
+                guacenc_log(GUAC_LOG_ERROR, "Invalid memory limit.");
+                goto invalid_options;
+            }
+
+            memory_limit = (size_t) megabytes * 1024 * 1024;
+
+        }
+
+        /* -u: Skip recordings whose video is already up to date */
+        else if (opt == 'u')
+            resume = true;
+
+        /* -S: Summary of per-file throughput */
+        else if (opt == 'S')
+            summary_path = optarg;
 
         /* Invalid option */
         else {
@@ -71,6 +224,17 @@ int main(int argc, char* argv[]) {
 
     }
 
+    /* Abort if range is empty */
+    if (options.end != -1 && options.end <= options.start) {
+        guacenc_log(GUAC_LOG_ERROR, "End time must be after start time.");
+        goto invalid_options;
+    }
+
+    /* Keyframes are only useful for encoding part of a recording, thus the
+     * index is built by default only if a range is requested */
+    if (options.start != 0 || options.end != -1)
+        options.build_index = true;
+
     /* Log start */
     guacenc_log(GUAC_LOG_INFO, "Guacamole video encoder (guacenc) "
             "version " VERSION);
@@ -78,9 +242,8 @@ int main(int argc, char* argv[]) {
     /* Prepare libavcodec */
     avcodec_register_all();
 
-    /* Track number of overall failures */
+    /* Track number of overall files */
     int total_files = argc - optind;
-    int failures = 0;
 
     /* Abort if no files given */
     if (total_files <= 0) {
@@ -91,9 +254,16 @@ int main(int argc, char* argv[]) {
     guacenc_log(GUAC_LOG_INFO, "%i input file(s) provided.", total_files);
 
     guacenc_log(GUAC_LOG_INFO, "Video will be encoded at %ix%i "
-            "and %i bps.", width, height, bitrate);
+            "and %i bps.", options.width, options.height, options.bitrate);
 
-    /* Encode all input files */
+    guac_common_batch* batch = guac_common_batch_alloc(jobs, memory_limit,
+            GUACENC_JOB_MEMORY_OVERHEAD, resume);
+    if (batch == NULL) {
+        guacenc_log(GUAC_LOG_ERROR, "Unable to allocate batch: Out of memory.");
+        return 1;
+    }
+
+    /* Queue all input files */
     for (i = optind; i < argc; i++) {
 
         /* Get current filename */
@@ -110,18 +280,44 @@ int main(int argc, char* argv[]) {
             continue;
         }
 
-        /* Attempt encoding, log granular success/failure at debug level */
-        if (guacenc_encode(path, out_path, "mpeg4",
-                    width, height, bitrate, force)) {
-            failures++;
-            guacenc_log(GUAC_LOG_DEBUG,
-                    "%s was NOT successfully encoded.", path);
+        if (guac_common_batch_add(batch, path, out_path)) {
+            guacenc_log(GUAC_LOG_ERROR, "Cannot encode \"%s\": Out of "
+                    "memory", path);
+            continue;
         }
-        else
-            guacenc_log(GUAC_LOG_DEBUG, "%s was successfully encoded.", path);
 
     }
 
+    if (batch->skipped != 0)
+        guacenc_log(GUAC_LOG_INFO, "Skipping %i file(s) whose video is "
+                "already up to date.", batch->skipped);
+
+    if (jobs > 1)
+        guacenc_log(GUAC_LOG_INFO, "Encoding up to %i file(s) at once.",
+                jobs);
+
+    /* Encode all queued files */
+    int failures = guac_common_batch_run(batch, guacenc_encode_file,
+            &options);
+
+    /* Write machine-readable summary, if requested */
+    if (summary_path != NULL) {
+
+        FILE* summary = strcmp(summary_path, "-") == 0
+            ? stdout : fopen(summary_path, "w");
+
+        if (summary == NULL
+                || guac_common_batch_write_summary(batch, summary))
+            guacenc_log(GUAC_LOG_ERROR, "Cannot write summary to \"%s\": "
+                    "%s", summary_path, strerror(errno));
+
+        if (summary != NULL && summary != stdout)
+            fclose(summary);
+
+    }
+
+    guac_common_batch_free(batch);
+
     /* Warn if at least one file failed */
     if (failures != 0)
         guacenc_log(GUAC_LOG_WARNING, "Encoding failed for %i of %i file(s).",
@@ -140,7 +336,14 @@ invalid_options:
     fprintf(stderr, "USAGE: %s"
             " [-s WIDTHxHEIGHT]"
             " [-r BITRATE]"
+            " [-b START]"
+            " [-e END]"
             " [-f]"
+            " [-i]"
+            " [-j JOBS]"
+            " [-m MEMORY]"
+            " [-u]"
+            " [-S SUMMARY]"
             " [FILE]...\n", argv[0]);
 
     return 1;
@@ -44,6 +44,15 @@
  */
 #define GUACENC_DEFAULT_BITRATE 2000000
 
+/**
+ * The approximate amount of memory required to encode a single recording,
+ * in bytes, beyond the size of the recording itself, covering the layers
+ * and buffers of the display and the state of the video encoder. This is
+ * used only to decide how many recordings may be encoded at once when a
+ * memory limit is given on the command line.
+ */
+#define GUACENC_JOB_MEMORY_OVERHEAD (64 * 1024 * 1024)
+
 /**
  * The default log level below which no messages should be logged.
  */
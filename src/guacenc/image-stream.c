@@ -140,7 +140,9 @@ int guacenc_image_stream_end(guacenc_image_stream* stream,
 
     /* Draw surface to buffer */
     if (buffer->cairo != NULL) {
-        cairo_set_operator(buffer->cairo, guacenc_display_cairo_operator(stream->mask));
+        cairo_operator_t op = guacenc_display_cairo_operator(stream->mask);
+        guacenc_buffer_damage(buffer, op, stream->x, stream->y, width, height);
+        cairo_set_operator(buffer->cairo, op);
         cairo_set_source_surface(buffer->cairo, surface, stream->x, stream->y);
         cairo_rectangle(buffer->cairo, stream->x, stream->y, width, height);
         cairo_fill(buffer->cairo);
@@ -0,0 +1,492 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+#include "display.h"
+#include "index.h"
+#include "log.h"
+
+#include <guacamole/client.h>
+#include <guacamole/timestamp.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * The header present at the beginning of every keyframe index, identifying
+ * the exact version of the recording that was indexed.
+ */
+typedef struct guacenc_index_header {
+
+    /**
+     * Always GUACENC_INDEX_MAGIC (without null terminator).
+     */
+    char magic[8];
+
+    /**
+     * The size of the indexed recording, in bytes.
+     */
+    int64_t size;
+
+    /**
+     * The modification time of the indexed recording, in seconds since the
+     * epoch.
+     */
+    int64_t mtime;
+
+} guacenc_index_header;
+
+/**
+ * The header present at the beginning of each keyframe within a keyframe
+ * index. The serialized display state immediately follows.
+ */
+typedef struct guacenc_index_record {
+
+    /**
+     * The position of the keyframe, in milliseconds relative to the first
+     * sync instruction of the recording.
+     */
+    int64_t position;
+
+    /**
+     * The byte offset within the recording of the first instruction following
+     * the keyframe.
+     */
+    int64_t offset;
+
+    /**
+     * The length of the serialized display state following this record, in
+     * bytes.
+     */
+    int64_t length;
+
+} guacenc_index_record;
+
+/**
+ * Populates the given index header with the identifying characteristics of
+ * the recording associated with the given file descriptor.
+ *
+ * @param header
+ *     The header to populate.
+ *
+ * @param fd
+ *     The open file descriptor of the recording.
+ *
+ * @return
+ *     Zero on success, non-zero if the recording could not be examined.
+ */
+static int guacenc_index_init_header(guacenc_index_header* header, int fd) {
+
+    struct stat recording_stat;
+    if (fstat(fd, &recording_stat))
+        return 1;
+
+    memset(header, 0, sizeof(guacenc_index_header));
+    memcpy(header->magic, GUACENC_INDEX_MAGIC, sizeof(header->magic));
+    header->size = recording_stat.st_size;
+    header->mtime = recording_stat.st_mtime;
+
+    return 0;
+
+}
+
+/**
+ * Returns a newly-allocated string containing the given path with the given
+ * suffix appended.
+ *
+ * @param path
+ *     The path to append the suffix to.
+ *
+ * @param suffix
+ *     The suffix to append.
+ *
+ * @return
+ *     A newly-allocated string which must be freed with free(), or NULL if
+ *     insufficient memory is available.
+ */
+static char* guacenc_index_path(const char* path, const char* suffix) {
+
+    size_t path_length = strlen(path);
+    size_t suffix_length = strlen(suffix);
+
+    char* result = malloc(path_length + suffix_length + 1);
+    if (result == NULL)
+        return NULL;
+
+    memcpy(result, path, path_length);
+    memcpy(result + path_length, suffix, suffix_length + 1);
+
+    return result;
+
+}
+
+/**
+ * Appends the given keyframe to the in-memory list of keyframes of the given
+ * index, expanding that list as necessary.
+ *
+ * @param index
+ *     The index to add the keyframe to.
+ *
+ * @param keyframe
+ *     The keyframe to add.
+ *
+ * @return
+ *     Zero on success, non-zero if insufficient memory is available.
+ */
+static int guacenc_index_append(guacenc_index* index,
+        guacenc_keyframe* keyframe) {
+
+    /* Expand keyframe storage if necessary */
+    if (index->num_keyframes == index->max_keyframes) {
+
+        int max_keyframes = index->max_keyframes * 2;
+        guacenc_keyframe* keyframes = realloc(index->keyframes,
+                sizeof(guacenc_keyframe) * max_keyframes);
+
+        if (keyframes == NULL)
+            return 1;
+
+        index->keyframes = keyframes;
+        index->max_keyframes = max_keyframes;
+
+    }
+
+    index->keyframes[index->num_keyframes++] = *keyframe;
+    return 0;
+
+}
+
+/**
+ * Allocates a new, empty guacenc_index around the given open file.
+ *
+ * @param file
+ *     The open index file.
+ *
+ * @param path
+ *     The path of the open index file. This string will be owned by the new
+ *     index.
+ *
+ * @return
+ *     The newly-allocated index, or NULL if insufficient memory is
+ *     available.
+ */
+static guacenc_index* guacenc_index_alloc(FILE* file, char* path) {
+
+    guacenc_index* index = calloc(1, sizeof(guacenc_index));
+    if (index == NULL)
+        return NULL;
+
+    index->max_keyframes = GUACENC_INDEX_INITIAL_KEYFRAMES;
+    index->keyframes = malloc(sizeof(guacenc_keyframe)
+            * index->max_keyframes);
+
+    if (index->keyframes == NULL) {
+        free(index);
+        return NULL;
+    }
+
+    index->file = file;
+    index->path = path;
+    return index;
+
+}
+
+guacenc_index* guacenc_index_load(const char* path, int fd) {
+
+    guacenc_index_header expected;
+    guacenc_index_header header;
+
+    if (guacenc_index_init_header(&expected, fd))
+        return NULL;
+
+    char* index_path = guacenc_index_path(path, GUACENC_INDEX_SUFFIX);
+    if (index_path == NULL)
+        return NULL;
+
+    /* Silently ignore missing indexes */
+    FILE* file = fopen(index_path, "rb");
+    if (file == NULL) {
+        free(index_path);
+        return NULL;
+    }
+
+    /* Ignore indexes for any other version of the recording */
+    if (fread(&header, sizeof(header), 1, file) != 1
+            || memcmp(&header, &expected, sizeof(header)) != 0) {
+        guacenc_log(GUAC_LOG_DEBUG, "Ignoring out-of-date index \"%s\".",
+                index_path);
+        fclose(file);
+        free(index_path);
+        return NULL;
+    }
+
+    guacenc_index* index = guacenc_index_alloc(file, index_path);
+    if (index == NULL) {
+        fclose(file);
+        free(index_path);
+        return NULL;
+    }
+
+    /* Read all keyframe records, skipping the serialized state of each */
+    guacenc_index_record record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+
+        guacenc_keyframe keyframe = {
+            .position     = record.position,
+            .offset       = record.offset,
+            .state_offset = ftello(file)
+        };
+
+        if (keyframe.state_offset < 0
+                || fseeko(file, record.length, SEEK_CUR)
+                || guacenc_index_append(index, &keyframe)) {
+            guacenc_log(GUAC_LOG_WARNING, "Unable to read index \"%s\".",
+                    index_path);
+            guacenc_index_free(index);
+            return NULL;
+        }
+
+    }
+
+    guacenc_log(GUAC_LOG_DEBUG, "Loaded %i keyframe(s) from \"%s\".",
+            index->num_keyframes, index_path);
+
+    return index;
+
+}
+
+guacenc_index* guacenc_index_create(const char* path, int fd) {
+
+    guacenc_index_header header;
+    if (guacenc_index_init_header(&header, fd))
+        return NULL;
+
+    char* final_path = guacenc_index_path(path, GUACENC_INDEX_SUFFIX);
+    if (final_path == NULL)
+        return NULL;
+
+    char* temp_path = guacenc_index_path(final_path, GUACENC_INDEX_TEMP_SUFFIX);
+    if (temp_path == NULL) {
+        free(final_path);
+        return NULL;
+    }
+
+    /* Write to a uniquely-named temporary file until complete */
+    int index_fd = mkstemp(temp_path);
+    if (index_fd == -1) {
+        guacenc_log(GUAC_LOG_DEBUG, "Not indexing \"%s\": %s", path,
+                strerror(errno));
+        free(temp_path);
+        free(final_path);
+        return NULL;
+    }
+
+    FILE* file = fdopen(index_fd, "w+b");
+    if (file == NULL) {
+        close(index_fd);
+        unlink(temp_path);
+        free(temp_path);
+        free(final_path);
+        return NULL;
+    }
+
+    guacenc_index* index = guacenc_index_alloc(file, temp_path);
+    if (index == NULL) {
+        fclose(file);
+        unlink(temp_path);
+        free(temp_path);
+        free(final_path);
+        return NULL;
+    }
+
+    index->writing = true;
+    index->final_path = final_path;
+
+    /* Identify the recording being indexed */
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        guacenc_index_free(index);
+        return NULL;
+    }
+
+    return index;
+
+}
+
+/**
+ * Returns whether the given display has any image streams open. Keyframes
+ * cannot be taken while image streams are open, as the partially-received
+ * contents of those streams are not part of the stored display state.
+ *
+ * @param display
+ *     The display to check.
+ *
+ * @return
+ *     true if any image streams are open, false otherwise.
+ */
+static bool guacenc_index_streams_open(guacenc_display* display) {
+
+    int i;
+    for (i = 0; i < GUACENC_DISPLAY_MAX_STREAMS; i++) {
+        if (display->image_streams[i] != NULL)
+            return true;
+    }
+
+    return false;
+
+}
+
+int guacenc_index_update(guacenc_index* index, guacenc_display* display,
+        off_t offset) {
+
+    /* Determine position of previous keyframe (start of recording if none) */
+    guac_timestamp last_position = 0;
+    if (index->num_keyframes > 0)
+        last_position = index->keyframes[index->num_keyframes - 1].position;
+
+    /* Do not store keyframes more often than necessary */
+    guac_timestamp position = display->last_sync - display->first_sync;
+    if (position - last_position < GUACENC_INDEX_KEYFRAME_INTERVAL)
+        return 0;
+
+    /* Wait until state is fully described by layers and buffers alone */
+    if (guacenc_index_streams_open(display))
+        return 0;
+
+    guacenc_index_record record = {
+        .position = position,
+        .offset   = offset
+    };
+
+    /* Write record with placeholder length */
+    off_t record_offset = ftello(index->file);
+    if (record_offset < 0
+            || fwrite(&record, sizeof(record), 1, index->file) != 1)
+        return 1;
+
+    guacenc_keyframe keyframe = {
+        .position     = position,
+        .offset       = offset,
+        .state_offset = record_offset + sizeof(record)
+    };
+
+    /* Write display state */
+    if (guacenc_display_write_keyframe(display, index->file))
+        return 1;
+
+    /* Update record with actual length of display state */
+    off_t end_offset = ftello(index->file);
+    record.length = end_offset - keyframe.state_offset;
+
+    if (end_offset < 0
+            || fseeko(index->file, record_offset, SEEK_SET)
+            || fwrite(&record, sizeof(record), 1, index->file) != 1
+            || fseeko(index->file, end_offset, SEEK_SET))
+        return 1;
+
+    guacenc_log(GUAC_LOG_DEBUG, "Keyframe stored at %" PRId64 " ms.",
+            (int64_t) position);
+
+    return guacenc_index_append(index, &keyframe);
+
+}
+
+int guacenc_index_commit(guacenc_index* index) {
+
+    /* Ensure all data is written before the index becomes visible */
+    if (fflush(index->file) || fsync(fileno(index->file)))
+        return 1;
+
+    if (rename(index->path, index->final_path)) {
+        guacenc_log(GUAC_LOG_WARNING, "Unable to store index \"%s\": %s",
+                index->final_path, strerror(errno));
+        return 1;
+    }
+
+    /* The index is now complete and must not be deleted when freed */
+    index->writing = false;
+
+    guacenc_log(GUAC_LOG_INFO, "Stored %i keyframe(s) in \"%s\".",
+            index->num_keyframes, index->final_path);
+
+    return 0;
+
+}
+
+guacenc_keyframe* guacenc_index_find(guacenc_index* index,
+        guac_timestamp position) {
+
+    /* Binary search for last keyframe at or before the given position */
+    int low = 0;
+    int high = index->num_keyframes - 1;
+    guacenc_keyframe* found = NULL;
+
+    while (low <= high) {
+
+        int mid = low + (high - low) / 2;
+        guacenc_keyframe* keyframe = &(index->keyframes[mid]);
+
+        if (keyframe->position <= position) {
+            found = keyframe;
+            low = mid + 1;
+        }
+        else
+            high = mid - 1;
+
+    }
+
+    return found;
+
+}
+
+int guacenc_index_restore(guacenc_index* index, guacenc_keyframe* keyframe,
+        guacenc_display* display) {
+
+    if (fseeko(index->file, keyframe->state_offset, SEEK_SET))
+        return 1;
+
+    return guacenc_display_read_keyframe(display, index->file);
+
+}
+
+void guacenc_index_free(guacenc_index* index) {
+
+    /* Ignore NULL index */
+    if (index == NULL)
+        return;
+
+    fclose(index->file);
+
+    /* Remove incomplete index */
+    if (index->writing)
+        unlink(index->path);
+
+    free(index->keyframes);
+    free(index->final_path);
+    free(index->path);
+    free(index);
+
+}
+
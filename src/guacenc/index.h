@@ -0,0 +1,262 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUACENC_INDEX_H
+#define GUACENC_INDEX_H
+
+#include "config.h"
+#include "display.h"
+
+#include <guacamole/timestamp.h>
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/**
+ * The suffix appended to the path of a recording to produce the path of its
+ * keyframe index.
+ */
+#define GUACENC_INDEX_SUFFIX ".idx"
+
+/**
+ * The suffix appended to the path of a keyframe index to produce the
+ * mkstemp() template of the temporary file used while that index is still
+ * being written. The index is renamed to its final path only once the entire
+ * recording has been read.
+ */
+#define GUACENC_INDEX_TEMP_SUFFIX ".XXXXXX"
+
+/**
+ * The value which must be present at the beginning of every keyframe index.
+ * This value changes whenever the format of the index changes, such that
+ * indexes written by older versions of guacenc are rebuilt rather than
+ * misread.
+ */
+#define GUACENC_INDEX_MAGIC "GUACIDX2"
+
+/**
+ * The minimum amount of recording time between keyframes, in milliseconds.
+ */
+#define GUACENC_INDEX_KEYFRAME_INTERVAL 300000
+
+/**
+ * The initial number of keyframes for which space is allocated within a
+ * guacenc_index. Space for additional keyframes is allocated as needed.
+ */
+#define GUACENC_INDEX_INITIAL_KEYFRAMES 64
+
+/**
+ * A single keyframe within a keyframe index: the full display state as of a
+ * particular sync instruction, along with the location within the recording
+ * of the instruction immediately following that sync.
+ */
+typedef struct guacenc_keyframe {
+
+    /**
+     * The timestamp of the sync instruction at which the keyframe was taken,
+     * relative to the first sync instruction of the recording.
+     */
+    guac_timestamp position;
+
+    /**
+     * The byte offset within the recording of the first instruction following
+     * the keyframe.
+     */
+    off_t offset;
+
+    /**
+     * The byte offset within the index file of the serialized display state.
+     */
+    off_t state_offset;
+
+} guacenc_keyframe;
+
+/**
+ * An index of keyframes for a single recording, stored alongside that
+ * recording. Each keyframe is a complete snapshot of guacenc_display state
+ * taken at a sync boundary, allowing rendering of an arbitrary portion of the
+ * recording to begin from the nearest preceding keyframe rather than from the
+ * beginning of the recording.
+ *
+ * The index is a local cache and is written in native byte order. An index is
+ * considered valid only if the size and modification time of the recording
+ * match those stored within the index.
+ */
+typedef struct guacenc_index {
+
+    /**
+     * The open index file.
+     */
+    FILE* file;
+
+    /**
+     * Whether this index is being written (true) or has been loaded from an
+     * existing, complete index file (false).
+     */
+    bool writing;
+
+    /**
+     * The path of the index file. If the index is being written, this is the
+     * path of the temporary file.
+     */
+    char* path;
+
+    /**
+     * The path that the index file will be renamed to once complete. This is
+     * only used if the index is being written.
+     */
+    char* final_path;
+
+    /**
+     * All keyframes within the index, in order of increasing position.
+     */
+    guacenc_keyframe* keyframes;
+
+    /**
+     * The number of keyframes within the index.
+     */
+    int num_keyframes;
+
+    /**
+     * The number of keyframes for which space has been allocated.
+     */
+    int max_keyframes;
+
+} guacenc_index;
+
+/**
+ * Loads the keyframe index associated with the recording having the given
+ * path. If no index exists, or the index is out of date with respect to the
+ * recording, NULL is returned.
+ *
+ * @param path
+ *     The path of the recording whose index should be loaded.
+ *
+ * @param fd
+ *     The open file descriptor of the recording.
+ *
+ * @return
+ *     The loaded keyframe index, or NULL if no valid index exists.
+ */
+guacenc_index* guacenc_index_load(const char* path, int fd);
+
+/**
+ * Begins writing a new keyframe index for the recording having the given
+ * path. Keyframes are added with guacenc_index_update() while the recording
+ * is read, and the index only replaces any existing index once
+ * guacenc_index_commit() is called.
+ *
+ * @param path
+ *     The path of the recording being indexed.
+ *
+ * @param fd
+ *     The open file descriptor of the recording.
+ *
+ * @return
+ *     The new keyframe index, or NULL if the index cannot be created (for
+ *     example, if the directory containing the recording is not writable).
+ */
+guacenc_index* guacenc_index_create(const char* path, int fd);
+
+/**
+ * Adds a keyframe for the current state of the given display if sufficient
+ * recording time has elapsed since the last keyframe. This function should
+ * be invoked after each sync instruction is handled. Keyframes are not taken
+ * while image streams are open.
+ *
+ * @param index
+ *     The keyframe index being written.
+ *
+ * @param display
+ *     The display whose state should be stored.
+ *
+ * @param offset
+ *     The byte offset within the recording of the instruction following the
+ *     sync instruction just handled.
+ *
+ * @return
+ *     Zero on success (including if no keyframe was needed), non-zero if
+ *     the keyframe could not be written.
+ */
+int guacenc_index_update(guacenc_index* index, guacenc_display* display,
+        off_t offset);
+
+/**
+ * Completes the given keyframe index, atomically replacing any existing
+ * index for the same recording. The index should not be updated further
+ * after this function is invoked.
+ *
+ * @param index
+ *     The keyframe index being written.
+ *
+ * @return
+ *     Zero on success, non-zero if the index could not be completed.
+ */
+int guacenc_index_commit(guacenc_index* index);
+
+/**
+ * Returns the last keyframe within the given index at or before the given
+ * position.
+ *
+ * @param index
+ *     The keyframe index to search.
+ *
+ * @param position
+ *     The position within the recording, in milliseconds relative to the
+ *     first sync instruction.
+ *
+ * @return
+ *     The closest preceding keyframe, or NULL if no such keyframe exists.
+ */
+guacenc_keyframe* guacenc_index_find(guacenc_index* index,
+        guac_timestamp position);
+
+/**
+ * Restores the display state stored within the given keyframe. The given
+ * display should be newly allocated.
+ *
+ * @param index
+ *     The keyframe index containing the keyframe.
+ *
+ * @param keyframe
+ *     The keyframe to restore.
+ *
+ * @param display
+ *     The display to restore the keyframe into.
+ *
+ * @return
+ *     Zero on success, non-zero if the keyframe could not be read.
+ */
+int guacenc_index_restore(guacenc_index* index, guacenc_keyframe* keyframe,
+        guacenc_display* display);
+
+/**
+ * Frees all memory associated with the given keyframe index, closing its
+ * underlying file. If the index was being written and has not been
+ * committed, the partially-written index is deleted. If the given index is
+ * NULL, this function has no effect.
+ *
+ * @param index
+ *     The keyframe index to free, which may be NULL.
+ */
+void guacenc_index_free(guacenc_index* index);
+
+#endif
+
@@ -26,6 +26,7 @@ extern "C" {
 }
 #include "Guacamole.capnp.h"
 
+#include <math.h>
 #include <stdlib.h>
 
 int guacenc_handle_cfill(guacenc_display* display, Guacamole::GuacServerInstruction::Reader instr) {
@@ -46,9 +47,19 @@ int guacenc_handle_cfill(guacenc_display* display, Guacamole::GuacServerInstruct
 
     /* Fill with RGBA color */
     if (buffer->cairo != NULL) {
-        cairo_set_operator(buffer->cairo, guacenc_display_cairo_operator(mask));
+
+        /* Record area affected by fill */
+        double x1, y1, x2, y2;
+        cairo_operator_t op = guacenc_display_cairo_operator(mask);
+        cairo_fill_extents(buffer->cairo, &x1, &y1, &x2, &y2);
+        guacenc_buffer_damage(buffer, op, (int) floor(x1), (int) floor(y1),
+                (int) ceil(x2) - (int) floor(x1),
+                (int) ceil(y2) - (int) floor(y1));
+
+        cairo_set_operator(buffer->cairo, op);
         cairo_set_source_rgba(buffer->cairo, r, g, b, a);
         cairo_fill(buffer->cairo);
+
     }
 
     return 0;
@@ -61,6 +61,8 @@ int guacenc_handle_cursor(guacenc_display* display, Guacamole::GuacServerInstruc
         cairo_set_operator(dst->cairo, CAIRO_OPERATOR_SOURCE);
         cairo_set_source_surface(dst->cairo, src->surface, sx, sy);
         cairo_paint(dst->cairo);
+        guacenc_buffer_damage(dst, CAIRO_OPERATOR_SOURCE, 0, 0,
+                dst->width, dst->height);
     }
 
     return 0;
@@ -53,6 +53,9 @@ int guacenc_handle_move(guacenc_display* display, Guacamole::GuacServerInstructi
     layer->y = y;
     layer->z = z;
 
+    /* Layer position affects the entire display */
+    display->damage_all = true;
+
     return 0;
 
 }
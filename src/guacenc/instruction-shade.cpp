@@ -43,6 +43,9 @@ int guacenc_handle_shade(guacenc_display* display, Guacamole::GuacServerInstruct
     /* Update layer properties */
     layer->opacity = opacity;
 
+    /* Layer opacity affects the entire display */
+    display->damage_all = true;
+
     return 0;
 
 }
@@ -124,6 +124,10 @@ guacenc_video* guacenc_video_alloc(const char* path, const char* codec_name,
     /* No frames have been written or prepared yet */
     video->last_timestamp = 0;
     video->next_pts = 0;
+    video->source = NULL;
+    video->source_lsize = 0;
+    video->source_psize = 0;
+    video->sws = NULL;
 
     return video;
 
@@ -358,7 +362,93 @@ static AVFrame* guacenc_video_frame_convert(guacenc_buffer* buffer, int lsize,
 
 }
 
-void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer) {
+/**
+ * Copies the given rectangle of the given Guacamole video encoder buffer into
+ * an AVFrame previously allocated with guacenc_video_frame_convert() for a
+ * buffer of the same size and with the same margins. Only the given rectangle
+ * is copied; all other image data within the frame, including the margins,
+ * is left untouched.
+ *
+ * @param frame
+ *     The frame to update.
+ *
+ * @param buffer
+ *     The guacenc_buffer whose image data should be copied.
+ *
+ * @param lsize
+ *     The size of the letterboxes within the frame, in pixels.
+ *
+ * @param psize
+ *     The size of the pillarboxes within the frame, in pixels.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle to copy.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle to copy.
+ *
+ * @param width
+ *     The width of the rectangle to copy, in pixels.
+ *
+ * @param height
+ *     The height of the rectangle to copy, in pixels.
+ */
+static void guacenc_video_frame_update(AVFrame* frame, guacenc_buffer* buffer,
+        int lsize, int psize, int x, int y, int width, int height) {
+
+    /* Clip rectangle to bounds of buffer */
+    if (x < 0) { width  += x; x = 0; }
+    if (y < 0) { height += y; y = 0; }
+
+    if (x + width > buffer->width)
+        width = buffer->width - x;
+
+    if (y + height > buffer->height)
+        height = buffer->height - y;
+
+    /* Nothing to copy if rectangle lies entirely outside buffer */
+    if (width <= 0 || height <= 0)
+        return;
+
+    /* Flush any pending operations */
+    cairo_surface_flush(buffer->surface);
+
+    /* Get pointers to first row of source and destination image data */
+    int src_stride = buffer->stride;
+    unsigned char* src_data = buffer->image + y * src_stride + x * 4;
+
+    int dst_stride = frame->linesize[0];
+    unsigned char* dst_data = frame->data[0]
+        + (y + lsize) * dst_stride + (x + psize) * 4;
+
+    /* Copy modified rows */
+    while (height > 0) {
+        memcpy(dst_data, src_data, width * 4);
+        dst_data += dst_stride;
+        src_data += src_stride;
+        height--;
+    }
+
+}
+
+/**
+ * Frees the cached source frame of the given video, if any.
+ *
+ * @param video
+ *     The video whose cached source frame should be freed.
+ */
+static void guacenc_video_free_source(guacenc_video* video) {
+
+    if (video->source == NULL)
+        return;
+
+    av_freep(&video->source->data[0]);
+    av_frame_free(&video->source);
+
+}
+
+void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer,
+        int x, int y, int width, int height) {
 
     int lsize;
     int psize;
@@ -391,39 +481,54 @@ void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer) {
                * buffer->width / dst->width / 2;
     }
 
-    /* Prepare source frame for buffer */
-    AVFrame* src = guacenc_video_frame_convert(buffer, lsize, psize);
-    if (src == NULL) {
-        guacenc_log(GUAC_LOG_WARNING, "Failed to allocate source frame. "
-                "Frame dropped.");
-        return;
+    /* Reuse previous source frame, copying only the modified region, if
+     * the size of the buffer and its margins are unchanged */
+    AVFrame* src = video->source;
+    if (src != NULL
+            && src->width  == buffer->width  + psize * 2
+            && src->height == buffer->height + lsize * 2
+            && video->source_lsize == lsize
+            && video->source_psize == psize)
+        guacenc_video_frame_update(src, buffer, lsize, psize,
+                x, y, width, height);
+
+    /* Otherwise, prepare an entirely new source frame for buffer */
+    else {
+
+        guacenc_video_free_source(video);
+
+        src = guacenc_video_frame_convert(buffer, lsize, psize);
+        if (src == NULL) {
+            guacenc_log(GUAC_LOG_WARNING, "Failed to allocate source frame. "
+                    "Frame dropped.");
+            return;
+        }
+
+        video->source = src;
+        video->source_lsize = lsize;
+        video->source_psize = psize;
+
     }
 
-    /* Prepare scaling context */
-    struct SwsContext* sws = sws_getContext(src->width, src->height,
+    /* Prepare scaling context, reusing the previous context if possible */
+    video->sws = sws_getCachedContext(video->sws, src->width, src->height,
             AV_PIX_FMT_RGB32, dst->width, dst->height, AV_PIX_FMT_YUV420P,
             SWS_BICUBIC, NULL, NULL, NULL);
 
     /* Abort if scaling context could not be created */
-    if (sws == NULL) {
+    if (video->sws == NULL) {
         guacenc_log(GUAC_LOG_WARNING, "Failed to allocate software scaling "
                 "context. Frame dropped.");
-        av_freep(&src->data[0]);
-        av_frame_free(&src);
         return;
     }
 
-    /* Apply scaling, copying the source frame to the destination */
-    sws_scale(sws, (const uint8_t* const*) src->data, src->linesize,
+    /* Apply scaling, copying the source frame to the destination. The
+     * entire frame is scaled, as the bicubic filter (and chroma subsampling)
+     * causes each destination row to depend on several neighboring source
+     * rows. */
+    sws_scale(video->sws, (const uint8_t* const*) src->data, src->linesize,
             0, src->height, dst->data, dst->linesize);
 
-    /* Free scaling context */
-    sws_freeContext(sws);
-
-    /* Free source frame */
-    av_freep(&src->data[0]);
-    av_frame_free(&src);
-
 }
 
 int guacenc_video_free(guacenc_video* video) {
@@ -452,6 +557,10 @@ int guacenc_video_free(guacenc_video* video) {
     av_freep(&video->next_frame->data[0]);
     av_frame_free(&video->next_frame);
 
+    /* Free cached source frame and scaling context */
+    guacenc_video_free_source(video);
+    sws_freeContext(video->sws);
+
     /* Clean up encoding context */
     avcodec_close(video->context);
     avcodec_free_context(&(video->context));
@@ -26,6 +26,7 @@
 
 #include <guacamole/timestamp.h>
 #include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
 
 #include <stdint.h>
 #include <stdio.h>
@@ -87,6 +88,34 @@ typedef struct guacenc_video {
      */
     guac_timestamp last_timestamp;
 
+    /**
+     * The RGB32 copy of the most recently prepared buffer, including any
+     * letterboxes or pillarboxes, or NULL if no frame has yet been prepared.
+     * This frame is retained between calls to guacenc_video_prepare_frame()
+     * such that only the modified portion of each buffer need be copied.
+     */
+    AVFrame* source;
+
+    /**
+     * The size of the letterboxes included within the source frame, in
+     * pixels.
+     */
+    int source_lsize;
+
+    /**
+     * The size of the pillarboxes included within the source frame, in
+     * pixels.
+     */
+    int source_psize;
+
+    /**
+     * The libswscale context used to convert the source frame to the
+     * dimensions and pixel format of the video, or NULL if no frame has yet
+     * been prepared. This context is reused for as long as the dimensions of
+     * the source frame remain unchanged.
+     */
+    struct SwsContext* sws;
+
 } guacenc_video;
 
 /**
@@ -161,8 +190,29 @@ int guacenc_video_advance_timeline(guacenc_video* video,
  * @param buffer
  *     The guacenc_buffer representing the image data of the frame that should
  *     be queued.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle within the
+ *     given buffer which has changed since the previous call to this
+ *     function.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle within the
+ *     given buffer which has changed since the previous call to this
+ *     function.
+ *
+ * @param width
+ *     The width of the rectangle within the given buffer which has changed
+ *     since the previous call to this function. If the buffer has changed
+ *     size, the entire buffer is considered changed regardless of this
+ *     rectangle.
+ *
+ * @param height
+ *     The height of the rectangle within the given buffer which has changed
+ *     since the previous call to this function.
  */
-void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer);
+void guacenc_video_prepare_frame(guacenc_video* video, guacenc_buffer* buffer,
+        int x, int y, int width, int height);
 
 /**
  * Frees all resources associated with the given video, finalizing the encoding
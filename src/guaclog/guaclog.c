@@ -19,13 +19,83 @@
 
 #include "config.h"
 
+#include "common/batch.h"
 #include "guaclog.h"
 #include "interpret.h"
 #include "log.h"
 
+#include <errno.h>
 #include <getopt.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Parses a string into a single positive integer value.
+ *
+ * @param arg
+ *     The string to parse.
+ *
+ * @param i
+ *     A pointer to the integer which should receive the parsed value.
+ *
+ * @return
+ *     Zero if parsing was successful, non-zero if the provided string was
+ *     not a positive integer.
+ */
+static int guaclog_parse_int(const char* arg, int* i) {
+
+    char* end;
+
+    /* Parse string as an integer */
+    errno = 0;
+    long int value = strtol(arg, &end, 10);
+
+    /* Ignore number if invalid / non-positive */
+    if (errno != 0 || value <= 0 || value > INT_MAX || *end != '\0')
+        return 1;
+
+    *i = value;
+    return 0;
+
+}
+
+/**
+ * Interprets a single recording as part of a batch, logging granular
+ * success/failure at debug level. The behavior of this function is dictated
+ * by guac_common_batch_handler.
+ *
+ * @param path
+ *     The path of the recording to interpret.
+ *
+ * @param out_path
+ *     The path of the text file to write.
+ *
+ * @param data
+ *     Pointer to a bool which is true if recordings should be interpreted
+ *     even if they appear to be in-progress.
+ *
+ * @return
+ *     Zero on success, non-zero if interpreting failed.
+ */
+static int guaclog_interpret_file(const char* path, const char* out_path,
+        void* data) {
+
+    bool force = *((bool*) data);
+
+    if (guaclog_interpret(path, out_path, force)) {
+        guaclog_log(GUAC_LOG_DEBUG,
+                "%s was NOT successfully interpreted.", path);
+        return 1;
+    }
+
+    guaclog_log(GUAC_LOG_DEBUG, "%s was successfully interpreted.", path);
+    return 0;
+
+}
 
 int main(int argc, char* argv[]) {
 
@@ -33,15 +103,51 @@ int main(int argc, char* argv[]) {
 
     /* Load defaults */
     bool force = false;
+    int jobs = 1;
+    size_t memory_limit = 0;
+    bool resume = false;
+    const char* summary_path = NULL;
 
     /* Parse arguments */
     int opt;
-    while ((opt = getopt(argc, argv, "s:r:f")) != -1) {
+    while ((opt = getopt(argc, argv, "s:r:fj:m:uS:")) != -1) {
 
         /* -f: Force */
         if (opt == 'f')
             force = true;
 
+        /* -j: Maximum number of recordings to interpret at once */
+        else if (opt == 'j') {
+            if (guaclog_parse_int(optarg, &jobs)) {
+                guaclog_log(GUAC_LOG_ERROR, "Invalid number of jobs.");
+                goto invalid_options;
+            }
+        }
+
+        /* -m: Approximate memory limit across all jobs (megabytes) */
+        else if (opt == 'm') {
+
+            /* Reject non-positive limits, and limits not representable in
+             * bytes */
+            int megabytes;
+            if (guaclog_parse_int(optarg, &megabytes)
+                    || (size_t) megabytes > SIZE_MAX / (1024 * 1024)) {
+                guaclog_log(GUAC_LOG_ERROR, "Invalid memory limit.");
+                goto invalid_options;
+            }
+
+            memory_limit = (size_t) megabytes * 1024 * 1024;
+
+        }
+
+        /* -u: Skip recordings whose log is already up to date */
+        else if (opt == 'u')
+            resume = true;
+
+        /* -S: Summary of per-file throughput */
+        else if (opt == 'S')
+            summary_path = optarg;
+
         /* Invalid option */
         else {
             goto invalid_options;
@@ -53,9 +159,8 @@ int main(int argc, char* argv[]) {
     guaclog_log(GUAC_LOG_INFO, "Guacamole input log interpreter (guaclog) "
             "version " VERSION);
 
-    /* Track number of overall failures */
+    /* Track number of overall files */
     int total_files = argc - optind;
-    int failures = 0;
 
     /* Abort if no files given */
     if (total_files <= 0) {
@@ -65,7 +170,14 @@ int main(int argc, char* argv[]) {
 
     guaclog_log(GUAC_LOG_INFO, "%i input file(s) provided.", total_files);
 
-    /* Interpret all input files */
+    guac_common_batch* batch = guac_common_batch_alloc(jobs, memory_limit,
+            GUACLOG_JOB_MEMORY_OVERHEAD, resume);
+    if (batch == NULL) {
+        guaclog_log(GUAC_LOG_ERROR, "Unable to allocate batch: Out of memory.");
+        return 1;
+    }
+
+    /* Queue all input files */
     for (i = optind; i < argc; i++) {
 
         /* Get current filename */
@@ -82,18 +194,44 @@ int main(int argc, char* argv[]) {
             continue;
         }
 
-        /* Attempt interpreting, log granular success/failure at debug level */
-        if (guaclog_interpret(path, out_path, force)) {
-            failures++;
-            guaclog_log(GUAC_LOG_DEBUG,
-                    "%s was NOT successfully interpreted.", path);
+        if (guac_common_batch_add(batch, path, out_path)) {
+            guaclog_log(GUAC_LOG_ERROR, "Cannot interpret \"%s\": Out of "
+                    "memory", path);
+            continue;
         }
-        else
-            guaclog_log(GUAC_LOG_DEBUG, "%s was successfully "
-                    "interpreted.", path);
 
     }
 
+    if (batch->skipped != 0)
+        guaclog_log(GUAC_LOG_INFO, "Skipping %i file(s) whose log is "
+                "already up to date.", batch->skipped);
+
+    if (jobs > 1)
+        guaclog_log(GUAC_LOG_INFO, "Interpreting up to %i file(s) at once.",
+                jobs);
+
+    /* Interpret all queued files */
+    int failures = guac_common_batch_run(batch, guaclog_interpret_file,
+            &force);
+
+    /* Write machine-readable summary, if requested */
+    if (summary_path != NULL) {
+
+        FILE* summary = strcmp(summary_path, "-") == 0
+            ? stdout : fopen(summary_path, "w");
+
+        if (summary == NULL
+                || guac_common_batch_write_summary(batch, summary))
+            guaclog_log(GUAC_LOG_ERROR, "Cannot write summary to \"%s\": "
+                    "%s", summary_path, strerror(errno));
+
+        if (summary != NULL && summary != stdout)
+            fclose(summary);
+
+    }
+
+    guac_common_batch_free(batch);
+
     /* Warn if at least one file failed */
     if (failures != 0)
         guaclog_log(GUAC_LOG_WARNING, "Interpreting failed for %i of %i "
@@ -111,6 +249,10 @@ invalid_options:
 
     fprintf(stderr, "USAGE: %s"
             " [-f]"
+            " [-j JOBS]"
+            " [-m MEMORY]"
+            " [-u]"
+            " [-S SUMMARY]"
             " [FILE]...\n", argv[0]);
 
     return 1;
@@ -22,6 +22,14 @@
 
 #include "config.h"
 
+/**
+ * The approximate amount of memory required to interpret a single
+ * recording, in bytes, beyond the size of the recording itself. This is used
+ * only to decide how many recordings may be interpreted at once when a
+ * memory limit is given on the command line.
+ */
+#define GUACLOG_JOB_MEMORY_OVERHEAD (1024 * 1024)
+
 /**
  * The default log level below which no messages should be logged.
  */
@@ -25,36 +25,41 @@
 #include <guacamole/client.h>
 #include <guacamole/error.h>
 #include <guacamole/parser.h>
-#include <guacamole/socket.h>
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
 
 /**
- * Reads and handles all Guacamole instructions from the given guac_socket
- * until end-of-stream is reached.
+ * Reads and handles all Guacamole instructions within the given
+ * memory-mapped recording until the end of the recording is reached.
+ * The recording itself is never modified.
  *
  * @param state
  *     The current state of the Guacamole input log interpreter.
  *
  * @param path
- *     The name of the file being parsed (for logging purposes). This file
- *     must already be open and available through the given socket.
+ *     The name of the file being parsed (for logging purposes).
  *
- * @param socket
- *     The guac_socket through which instructions should be read.
+ * @param data
+ *     The contents of the recording, mapped read-only. This data is never
+ *     modified.
+ *
+ * @param length
+ *     The length of the recording, in bytes.
  *
  * @return
- *     Zero on success, non-zero if parsing of Guacamole protocol data through
- *     the given socket fails.
+ *     Zero on success, non-zero if parsing of the Guacamole protocol data
+ *     within the recording fails.
  */
 static int guaclog_read_instructions(guaclog_state* state,
-        const char* path, guac_socket* socket) {
+        const char* path, const char* data, off_t length) {
 
     /* Obtain Guacamole protocol parser */
     guac_parser* parser = guac_parser_alloc();
@@ -62,17 +67,34 @@ static int guaclog_read_instructions(guaclog_state* state,
         return 1;
 
     /* Continuously read and handle all instructions */
-    while (!guac_parser_read(parser, socket, -1)) {
+    off_t offset = 0;
+    while (offset < length) {
+
+        /* Instructions are far shorter than INT_MAX bytes, so there is no
+         * need to provide the parser with more than that at once */
+        off_t available = length - offset;
+        if (available > INT_MAX)
+            available = INT_MAX;
+
+        int parsed = guac_parser_parse(parser, data + offset, available);
+
+        /* Fail on parse error */
+        if (parsed < 0) {
+            guaclog_log(GUAC_LOG_ERROR, "%s: %s",
+                    path, guac_status_string(guac_error));
+            guac_parser_free(parser);
+            return 1;
+        }
+
+        /* Ignore any incomplete instruction at the end of the recording */
+        if (parsed == 0)
+            break;
+
+        offset += parsed;
+
         guaclog_handle_instruction(state, parser->opcode,
                 parser->argc, parser->argv);
-    }
 
-    /* Fail on read/parse error */
-    if (guac_error != GUAC_STATUS_CLOSED) {
-        guaclog_log(GUAC_LOG_ERROR, "%s: %s",
-                path, guac_status_string(guac_error));
-        guac_parser_free(parser);
-        return 1;
     }
 
     /* Parse complete */
@@ -124,28 +146,52 @@ int guaclog_interpret(const char* path, const char* out_path, bool force) {
         return 1;
     }
 
-    /* Obtain guac_socket wrapping file descriptor */
-    guac_socket* socket = guac_socket_open(fd);
-    if (socket == NULL) {
-        guaclog_log(GUAC_LOG_ERROR, "%s: %s", path,
-                guac_status_string(guac_error));
+    /* Determine size of recording */
+    struct stat file_stat;
+    if (fstat(fd, &file_stat)) {
+        guaclog_log(GUAC_LOG_ERROR, "%s: %s", path, strerror(errno));
         close(fd);
         guaclog_state_free(state);
         return 1;
     }
 
+    off_t length = file_stat.st_size;
+
+    /* Map recording into memory read-only. Each instruction is copied into
+     * the parser only once complete, thus mapped pages remain shared with the
+     * page cache rather than being privately copied. */
+    char* data = NULL;
+    if (length > 0) {
+
+        data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            guaclog_log(GUAC_LOG_ERROR, "%s: %s", path, strerror(errno));
+            close(fd);
+            guaclog_state_free(state);
+            return 1;
+        }
+
+        posix_madvise(data, length, POSIX_MADV_SEQUENTIAL);
+
+    }
+
     guaclog_log(GUAC_LOG_INFO, "Writing input events from \"%s\" "
             "to \"%s\" ...", path, out_path);
 
     /* Attempt to read all instructions in the file */
-    if (guaclog_read_instructions(state, path, socket)) {
-        guac_socket_free(socket);
+    int failed = guaclog_read_instructions(state, path, data, length);
+
+    /* Close input */
+    if (data != NULL)
+        munmap(data, length);
+    close(fd);
+
+    if (failed) {
         guaclog_state_free(state);
         return 1;
     }
 
-    /* Close input and finish interpreting process */
-    guac_socket_free(socket);
+    /* Finish interpreting process */
     return guaclog_state_free(state);
 
 }
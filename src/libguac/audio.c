@@ -21,6 +21,10 @@
 
 #include "raw_encoder.h"
 
+#ifdef ENABLE_OPUS
+#include "opus_encoder.h"
+#endif
+
 #include <guacamole/audio.h>
 #include <guacamole/client.h>
 #include <guacamole/protocol.h>
@@ -33,7 +37,9 @@
 /**
  * Sets the encoder associated with the given guac_audio_stream, automatically
  * invoking its begin_handler. The guac_audio_stream MUST NOT already be
- * associated with an encoder.
+ * associated with an encoder. If the Opus encoder is requested but cannot be
+ * initialized, raw 16-bit PCM is used instead, such that the stream is never
+ * left silent.
  *
  * @param audio
  *     The guac_audio_stream whose encoder is being set.
@@ -48,11 +54,50 @@ static void guac_audio_stream_set_encoder(guac_audio_stream* audio,
     if (encoder != NULL && encoder->begin_handler)
         encoder->begin_handler(audio);
 
+#ifdef ENABLE_OPUS
+    /* The Opus encoder leaves its state unassigned if it cannot be
+     * initialized (Opus is only ever chosen for 16-bit audio) */
+    if (encoder == opus_encoder && audio->data == NULL) {
+        guac_client_log(audio->client, GUAC_LOG_WARNING, "Opus encoder "
+                "could not be initialized. Falling back to raw PCM audio.");
+        encoder = raw16_encoder;
+        encoder->begin_handler(audio);
+    }
+#endif
+
     /* Assign encoder, which may be NULL */
     audio->encoder = encoder;
 
 }
 
+#ifdef ENABLE_OPUS
+/**
+ * Returns whether the given user has declared support for the given audio
+ * mimetype.
+ *
+ * @param user
+ *     The user to check.
+ *
+ * @param mimetype
+ *     The audio mimetype to look for.
+ *
+ * @return
+ *     Non-zero if the user supports the given mimetype, zero otherwise.
+ */
+static int guac_audio_user_supports(guac_user* user, const char* mimetype) {
+
+    int i;
+
+    for (i=0; user->info.audio_mimetypes[i] != NULL; i++) {
+        if (strcmp(user->info.audio_mimetypes[i], mimetype) == 0)
+            return 1;
+    }
+
+    return 0;
+
+}
+#endif
+
 /**
  * Assigns a new audio encoder to the given guac_audio_stream based on the
  * audio mimetypes declared as supported by the given user. If no audio encoder
@@ -84,6 +129,14 @@ static void* guac_audio_assign_encoder(guac_user* user, void* data) {
     if (user == NULL || audio->encoder != NULL)
         return audio->encoder;
 
+#ifdef ENABLE_OPUS
+    /* Prefer compressed audio over raw regardless of mimetype order */
+    if (bps == 16 && guac_audio_user_supports(user, opus_encoder->mimetype)) {
+        guac_audio_stream_set_encoder(audio, opus_encoder);
+        return audio->encoder;
+    }
+#endif
+
     /* For each supported mimetype, check for an associated encoder */
     for (i=0; user->info.audio_mimetypes[i] != NULL; i++) {
 
@@ -30,6 +30,7 @@
 #include "protocol.h"
 #include "socket.h"
 #include "stream.h"
+#include "table.h"
 #include "timestamp.h"
 #include "user.h"
 
@@ -53,9 +54,14 @@ const guac_layer* GUAC_DEFAULT_LAYER = &__GUAC_DEFAULT_LAYER;
 
 guac_layer* guac_client_alloc_layer(guac_client* client) {
 
+    /* Allocate index, failing if all indices are in use */
+    int index = guac_pool_next_int(client->__layer_pool);
+    if (index < 0)
+        return NULL;
+
     /* Init new layer */
     guac_layer* allocd_layer = malloc(sizeof(guac_layer));
-    allocd_layer->index = guac_pool_next_int(client->__layer_pool)+1;
+    allocd_layer->index = index + 1;
 
     return allocd_layer;
 
@@ -63,9 +69,14 @@ guac_layer* guac_client_alloc_layer(guac_client* client) {
 
 guac_layer* guac_client_alloc_buffer(guac_client* client) {
 
+    /* Allocate index, failing if all indices are in use */
+    int index = guac_pool_next_int(client->__buffer_pool);
+    if (index < 0)
+        return NULL;
+
     /* Init new layer */
     guac_layer* allocd_layer = malloc(sizeof(guac_layer));
-    allocd_layer->index = -guac_pool_next_int(client->__buffer_pool) - 1;
+    allocd_layer->index = -index - 1;
 
     return allocd_layer;
 
@@ -97,14 +108,23 @@ guac_stream* guac_client_alloc_stream(guac_client* client) {
     int stream_index;
 
     /* Refuse to allocate beyond maximum */
-    if (client->__stream_pool->active == GUAC_CLIENT_MAX_STREAMS)
+    if (__atomic_load_n(&(client->__stream_pool->active), __ATOMIC_RELAXED)
+            >= GUAC_CLIENT_MAX_STREAMS)
         return NULL;
 
     /* Allocate stream */
     stream_index = guac_pool_next_int(client->__stream_pool);
+    if (stream_index < 0)
+        return NULL;
+
+    /* Allocate storage for stream if not yet allocated */
+    allocd_stream = guac_table_acquire(client->__output_streams, stream_index);
+    if (allocd_stream == NULL) {
+        guac_pool_free_int(client->__stream_pool, stream_index);
+        return NULL;
+    }
 
     /* Initialize stream with odd index (even indices are user-level) */
-    allocd_stream = &(client->__output_streams[stream_index]);
     allocd_stream->index = (stream_index * 2) + 1;
     allocd_stream->data = NULL;
     allocd_stream->ack_handler = NULL;
@@ -125,9 +145,19 @@ void guac_client_free_stream(guac_client* client, guac_stream* stream) {
 
 }
 
+/**
+ * Initializes the given newly-allocated client-level stream as closed. The
+ * signature of this function is dictated by guac_table_init_handler.
+ *
+ * @param element
+ *     The guac_stream to initialize.
+ */
+static void guac_client_init_stream(void* element) {
+    ((guac_stream*) element)->index = GUAC_CLIENT_CLOSED_STREAM_INDEX;
+}
+
 guac_client* guac_client_alloc() {
 
-    int i;
     pthread_rwlockattr_t lock_attributes;
 
     /* Allocate new client */
@@ -152,12 +182,10 @@ guac_client* guac_client_alloc() {
     /* Allocate stream pool */
     client->__stream_pool = guac_pool_alloc(0);
 
-    /* Initialize streams */
-    client->__output_streams = malloc(sizeof(guac_stream) * GUAC_CLIENT_MAX_STREAMS);
-
-    for (i=0; i<GUAC_CLIENT_MAX_STREAMS; i++) {
-        client->__output_streams[i].index = GUAC_CLIENT_CLOSED_STREAM_INDEX;
-    }
+    /* Initialize streams (storage is allocated as streams are used) */
+    client->__output_streams = guac_table_alloc(sizeof(guac_stream),
+            GUAC_CLIENT_STREAM_CHUNK_SIZE, GUAC_CLIENT_MAX_STREAMS,
+            guac_client_init_stream);
 
 
     /* Init locks */
@@ -190,7 +218,7 @@ void guac_client_free(guac_client* client) {
     guac_pool_free(client->__layer_pool);
 
     /* Free streams */
-    free(client->__output_streams);
+    guac_table_free(client->__output_streams);
 
     /* Free stream pool */
     guac_pool_free(client->__stream_pool);
@@ -30,7 +30,14 @@
  * The maximum number of inbound or outbound streams supported by any one
  * guac_client.
  */
-#define GUAC_CLIENT_MAX_STREAMS 64
+#define GUAC_CLIENT_MAX_STREAMS 4096
+
+/**
+ * The number of streams for which storage is allocated at a time within any
+ * one guac_client. Storage for additional streams is allocated as needed, up
+ * to GUAC_CLIENT_MAX_STREAMS.
+ */
+#define GUAC_CLIENT_STREAM_CHUNK_SIZE 64
 
 /**
  * The index of a closed stream.
@@ -34,6 +34,7 @@
 #include "pool-types.h"
 #include "socket-types.h"
 #include "stream-types.h"
+#include "table-types.h"
 #include "timestamp-types.h"
 #include "user-fntypes.h"
 #include "user-types.h"
@@ -145,9 +146,9 @@ struct guac_client {
 
     /**
      * All available client-level output streams (data going to all connected
-     * users).
+     * users), allocated as needed.
      */
-    guac_stream* __output_streams;
+    guac_table* __output_streams;
 
     /**
      * The unique identifier allocated for the connection, which may
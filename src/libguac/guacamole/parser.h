@@ -112,6 +112,31 @@ guac_parser* guac_parser_alloc();
  */
 int guac_parser_append(guac_parser* parser, void* buffer, int length);
 
+/**
+ * Parses a single complete instruction from the beginning of the given
+ * buffer. Unlike guac_parser_append(), the buffer is never modified and need
+ * not remain valid after this function returns. Once the instruction has been
+ * found to be complete and valid, only that instruction is copied into the
+ * parser's instruction buffer, where its elements are null-terminated, such
+ * that the opcode and arguments of the parser remain valid until the next
+ * instruction is parsed. This is intended for parsing protocol data which is
+ * already entirely in memory, such as a read-only memory-mapped recording,
+ * and must not be mixed with guac_parser_read() on the same parser.
+ *
+ * If an error occurs parsing the instruction, including if the instruction
+ * is too long to fit within the parser's instruction buffer, -1 is returned,
+ * and guac_error is set appropriately.
+ *
+ * @param parser The parser to parse the instruction with.
+ * @param buffer A buffer containing protocol data, beginning with the
+ *               instruction to be parsed.
+ * @param length The number of bytes available within the buffer.
+ * @return The number of bytes occupied by the parsed instruction, zero if
+ *         the buffer does not contain a complete instruction, or -1 if the
+ *         data within the buffer is not a valid instruction.
+ */
+int guac_parser_parse(guac_parser* parser, const void* buffer, int length);
+
 /**
  * Returns the number of unparsed bytes stored in the given parser's internal
  * buffers.
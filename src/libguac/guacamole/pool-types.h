@@ -26,11 +26,6 @@
  * @file pool-types.h
  */
 
-/**
- * Represents a single integer within a larger pool of integers.
- */
-typedef struct guac_pool_int guac_pool_int;
-
 /**
  * A pool of integers. Integers can be removed from and later free'd back
  * into the pool. New integers are returned when the pool is exhausted,
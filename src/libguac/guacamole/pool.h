@@ -29,7 +29,25 @@
 
 #include "pool-types.h"
 
-#include <pthread.h>
+#include <stdint.h>
+
+/**
+ * The number of integers tracked by each chunk of a guac_pool's bitmap of
+ * freed integers. Chunks are allocated only as the pool grows.
+ */
+#define GUAC_POOL_CHUNK_SIZE 4096
+
+/**
+ * The maximum number of bitmap chunks within a guac_pool. A pool can thus
+ * provide at most GUAC_POOL_CHUNK_SIZE * GUAC_POOL_MAX_CHUNKS distinct
+ * integers.
+ */
+#define GUAC_POOL_MAX_CHUNKS 1024
+
+/**
+ * The number of bits within each word of a guac_pool bitmap chunk.
+ */
+#define GUAC_POOL_WORD_BITS 64
 
 struct guac_pool {
 
@@ -41,45 +59,44 @@ struct guac_pool {
     int min_size;
 
     /**
-     * The number of integers currently in use.
+     * The number of integers currently in use. This value is updated
+     * atomically.
      */
     int active;
 
     /**
      * The next integer to be released (after no more integers remain in the
-     * pool.
+     * pool). All integers below this value have been returned by
+     * guac_pool_next_int at least once. This value is updated atomically.
      */
     int __next_value;
 
     /**
-     * The first integer in the pool, if any.
+     * The number of freed integers which have not yet been claimed by
+     * guac_pool_next_int. Any caller which successfully decrements this value
+     * is guaranteed to find a set bit within the bitmap. This value is
+     * updated atomically.
      */
-    guac_pool_int* __head;
-
-    /**
-     * The last integer in the pool, if any.
-     */
-    guac_pool_int* __tail;
-
-    /**
-     * Lock which is acquired when the pool is being modified or accessed.
-     */
-    pthread_mutex_t __lock;
-
-};
-
-struct guac_pool_int {
+    int __free_count;
 
     /**
-     * The integer value of this pool entry.
+     * The integer at which the next search of the bitmap of freed integers
+     * begins. This advances past each integer claimed, such that freed
+     * integers are reused in rotating order rather than the most recently
+     * freed integer being reused immediately. This value is updated
+     * atomically.
      */
-    int value;
+    int __claim_position;
 
     /**
-     * The next available (unused) guac_pool_int in the list of
-     * allocated but free'd ints.
+     * Bitmap of freed integers, split into chunks of GUAC_POOL_CHUNK_SIZE
+     * bits, where a set bit indicates that the corresponding integer has been
+     * freed and may be returned again. Each chunk is allocated (and
+     * atomically published) the first time an integer within its range is
+     * returned, and is never moved or freed until the pool itself is freed,
+     * so that freeing an integer never requires allocation.
      */
-    guac_pool_int* __next;
+    uint64_t* __chunks[GUAC_POOL_MAX_CHUNKS];
 
 };
 
@@ -103,7 +120,10 @@ void guac_pool_free(guac_pool* pool);
 /**
  * Returns the next available integer from the given guac_pool. All integers
  * returned are non-negative, and are returned in sequences, starting from 0.
- * This operation is threadsafe.
+ * Freed integers are reused in rotating order, continuing from the integer
+ * most recently reused, such that an integer which was just freed is not
+ * returned again while other freed integers remain. This operation is
+ * threadsafe and lock-free.
  *
  * @param pool
  *     The guac_pool to retrieve an integer from.
@@ -111,14 +131,16 @@ void guac_pool_free(guac_pool* pool);
  * @return
  *     The next available integer, which may be either an integer not yet
  *     returned by a call to guac_pool_next_int, or an integer which was
- *     previously returned, but has since been freed.
+ *     previously returned, but has since been freed. If the pool is
+ *     exhausted (all GUAC_POOL_CHUNK_SIZE * GUAC_POOL_MAX_CHUNKS integers are
+ *     in use) or memory cannot be allocated, -1 is returned.
  */
 int guac_pool_next_int(guac_pool* pool);
 
 /**
  * Frees the given integer back into the given guac_pool. The integer given
- * will be available for future calls to guac_pool_next_int.  This operation is
- * threadsafe.
+ * will be available for future calls to guac_pool_next_int. This operation is
+ * threadsafe, lock-free, and never allocates memory.
  *
  * @param pool
  *     The guac_pool to free the given integer into.
@@ -55,6 +55,20 @@ typedef ssize_t guac_socket_read_handler(guac_socket* socket,
 typedef ssize_t guac_socket_write_handler(guac_socket* socket,
        void* data);
 
+/**
+ * Generic write handler for writing raw bytes, rather than instructions, to a
+ * socket, modeled after the standard POSIX write() function. When set within
+ * a guac_socket, a handler of this type will be called whenever
+ * guac_socket_write() is invoked on that socket.
+ *
+ * @param socket The guac_socket being written to.
+ * @param buf The buffer containing the data to be written.
+ * @param count The number of bytes to write from the buffer.
+ * @return The number of bytes written, or -1 if an error occurs.
+ */
+typedef ssize_t guac_socket_raw_write_handler(guac_socket* socket,
+        const void* buf, size_t count);
+
 /**
  * Generic handler for socket select operations, similar to the POSIX select()
  * function. When guac_socket_select() is called on a guac_socket, its
@@ -54,11 +54,29 @@ typedef struct guac_socket_ssl_data {
      */
     SSL* ssl;
 
+    /**
+     * Non-zero if encryption of outbound data has been offloaded to the
+     * kernel (kTLS), zero otherwise. Outbound data is still written through
+     * OpenSSL, which handles any non-application records.
+     */
+    int ktls_send;
+
+    /**
+     * Non-zero if decryption of inbound data has been offloaded to the
+     * kernel (kTLS), zero otherwise. Inbound data is still read through
+     * OpenSSL, which handles any non-application records.
+     */
+    int ktls_recv;
+
 } guac_socket_ssl_data;
 
 /**
  * Creates a new guac_socket which will use SSL for all communication. Freeing
  * this guac_socket will automatically close the associated file descriptor.
+ * If supported by both OpenSSL and the kernel, encryption and decryption are
+ * offloaded to the kernel (kTLS) once the handshake completes. Whether this
+ * offload is active is recorded within the ktls_send and ktls_recv members
+ * of the socket's guac_socket_ssl_data.
  *
  * @param context
  *     The SSL_CTX structure describing the desired SSL configuration.
@@ -0,0 +1,149 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef __GUAC_SOCKET_ZSTD_H
+#define __GUAC_SOCKET_ZSTD_H
+
+/**
+ * Provides a guac_socket implementation which compresses all outgoing
+ * instructions with zstd. This header will only be available if libguac was
+ * built with zstd support.
+ *
+ * Once compression has been negotiated during the handshake, the server
+ * writes the 8-byte preamble GUAC_SOCKET_ZSTD_PREAMBLE immediately after the
+ * "ready" instruction. All further outgoing data consists of chunks, each
+ * prefixed with a 32-bit little-endian header containing the length of the
+ * chunk in bytes. If the GUAC_SOCKET_ZSTD_RAW bit of the header is set, the
+ * chunk is a single uncompressed instruction. Otherwise, the chunk is the
+ * next portion of a single zstd stream which spans all such chunks. Every
+ * instruction, whether compressed or not, uses the packed Cap'n Proto
+ * encoding.
+ *
+ * @file socket-zstd.h
+ */
+
+#include "socket-types.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * The name of the zstd transport, as listed by the client within the
+ * "compress" instruction of the handshake.
+ */
+#define GUAC_SOCKET_ZSTD_FORMAT "zstd"
+
+/**
+ * The preamble written to the underlying socket before any compressed data.
+ * The preamble is exactly one Cap'n Proto word in length, and can never be
+ * mistaken for the segment table of an uncompressed message.
+ */
+#define GUAC_SOCKET_ZSTD_PREAMBLE "GUACZSTD"
+
+/**
+ * The bit within the header of each chunk which is set if that chunk is an
+ * uncompressed instruction, rather than part of the zstd stream.
+ */
+#define GUAC_SOCKET_ZSTD_RAW 0x80000000
+
+/**
+ * The zstd compression level to use. Low levels are preferred, as the cost
+ * of compression is paid for every frame of every connection.
+ */
+#define GUAC_SOCKET_ZSTD_LEVEL 3
+
+/**
+ * Statistics describing the effectiveness and cost of compression on a
+ * socket created with guac_socket_zstd().
+ */
+typedef struct guac_socket_zstd_stats {
+
+    /**
+     * The total number of bytes of instruction data written to the socket,
+     * in the packed encoding, prior to compression.
+     */
+    uint64_t bytes_in;
+
+    /**
+     * The total number of bytes written to the underlying socket, including
+     * the preamble and chunk headers.
+     */
+    uint64_t bytes_out;
+
+    /**
+     * The number of bytes of instruction data which were passed through
+     * without compression, as those instructions contained data which was
+     * already compressed.
+     */
+    uint64_t bytes_raw;
+
+    /**
+     * The total CPU time spent within the compressor, in microseconds.
+     */
+    uint64_t compress_usec;
+
+} guac_socket_zstd_stats;
+
+/**
+ * Creates a new guac_socket which compresses all instructions written to it
+ * with zstd before writing them to the given socket, writing the preamble
+ * immediately. Blobs of image, video, and compressed audio streams are
+ * written without compression. The compressor is flushed at each "sync"
+ * instruction and whenever the socket is flushed. Reads are passed through
+ * to the given socket unchanged.
+ *
+ * Freeing the returned guac_socket ends the zstd stream but does not free the
+ * given socket.
+ *
+ * @param socket
+ *     The guac_socket to which compressed data should be written.
+ *
+ * @param level
+ *     The zstd compression level to use.
+ *
+ * @return
+ *     A newly-allocated guac_socket which compresses all outgoing data, or
+ *     NULL if the socket cannot be created, in which case guac_error is set
+ *     appropriately.
+ */
+guac_socket* guac_socket_zstd(guac_socket* socket, int level);
+
+/**
+ * Retrieves the compression statistics of the given socket, which must have
+ * been created with guac_socket_zstd().
+ *
+ * @param socket
+ *     The socket to retrieve statistics from.
+ *
+ * @param stats
+ *     The structure to populate with the current statistics.
+ */
+void guac_socket_zstd_get_stats(guac_socket* socket,
+        guac_socket_zstd_stats* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
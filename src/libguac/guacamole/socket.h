@@ -30,6 +30,7 @@
 #include "socket-constants.h"
 #include "socket-fntypes.h"
 #include "socket-types.h"
+#include "timer-types.h"
 #include "timestamp-types.h"
 
 #include <pthread.h>
@@ -57,6 +58,12 @@ struct guac_socket {
      */
     guac_socket_write_handler* write_handler;
 
+    /**
+     * Handler which will be called whenever raw bytes are written to this
+     * socket with guac_socket_write().
+     */
+    guac_socket_raw_write_handler* raw_write_handler;
+
     /**
      * Handler which will be called whenever this socket needs to be flushed.
      */
@@ -108,14 +115,10 @@ struct guac_socket {
     int __ready_buf[3];
 
     /**
-     * Whether automatic keep-alive is enabled.
-     */
-    int __keep_alive_enabled;
-
-    /**
-     * The keep-alive thread.
+     * The timer which periodically sends keep-alive pings, or NULL if
+     * automatic keep-alive is not enabled.
      */
-    pthread_t __keep_alive_thread;
+    guac_timer* __keep_alive;
 
 };
 
@@ -138,7 +141,10 @@ void guac_socket_free(guac_socket* socket);
 /**
  * Declares that the given socket must automatically send a keep-alive ping
  * to ensure neither side of the socket times out while the socket is open.
- * This ping will take the form of a "nop" instruction.
+ * This ping will take the form of a "nop" instruction, and is sent only if
+ * nothing else has been written to the socket recently. Keep-alive pings are
+ * sent by the process-wide timer service; no thread is dedicated to any one
+ * socket.
  *
  * @param socket
  *     The guac_socket to declare as requiring an automatic keep-alive ping.
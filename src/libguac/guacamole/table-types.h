@@ -0,0 +1,46 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _GUAC_TABLE_TYPES_H
+#define _GUAC_TABLE_TYPES_H
+
+/**
+ * Type definitions related to the guac_table table of indexed elements.
+ *
+ * @file table-types.h
+ */
+
+/**
+ * A table of fixed-size elements addressed by non-negative integer index.
+ * Storage for the table is allocated in chunks as indices are first used,
+ * such that the table grows as needed without ever moving existing elements.
+ */
+typedef struct guac_table guac_table;
+
+/**
+ * Handler which is invoked for each element of a newly-allocated chunk of a
+ * guac_table, initializing that element to its default state.
+ *
+ * @param element
+ *     The element to initialize.
+ */
+typedef void guac_table_init_handler(void* element);
+
+#endif
+
@@ -0,0 +1,141 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _GUAC_TABLE_H
+#define _GUAC_TABLE_H
+
+/**
+ * Provides functions and structures for maintaining tables of fixed-size
+ * elements which grow as needed while never moving existing elements.
+ *
+ * @file table.h
+ */
+
+#include "table-types.h"
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct guac_table {
+
+    /**
+     * The size of each element, in bytes.
+     */
+    size_t element_size;
+
+    /**
+     * The number of elements within each chunk.
+     */
+    int chunk_size;
+
+    /**
+     * The maximum number of elements within the table. Indices at or above
+     * this value are invalid.
+     */
+    int max_size;
+
+    /**
+     * The handler to invoke for each element of each newly-allocated chunk,
+     * or NULL if elements should simply be zeroed.
+     */
+    guac_table_init_handler* init_handler;
+
+    /**
+     * Array of pointers to each chunk of elements, where chunks which have not
+     * yet been allocated are NULL. Each chunk is atomically published when
+     * allocated and is not moved or freed until the table itself is freed.
+     */
+    void** __chunks;
+
+};
+
+/**
+ * Allocates a new, empty guac_table. No storage for elements is allocated
+ * until elements are first retrieved with guac_table_acquire().
+ *
+ * @param element_size
+ *     The size of each element, in bytes.
+ *
+ * @param chunk_size
+ *     The number of elements to allocate at a time.
+ *
+ * @param max_size
+ *     The maximum number of elements within the table.
+ *
+ * @param init_handler
+ *     The handler to invoke for each element of each newly-allocated chunk,
+ *     or NULL if elements should simply be zeroed.
+ *
+ * @return
+ *     A new, empty guac_table, or NULL if the table could not be allocated.
+ */
+guac_table* guac_table_alloc(size_t element_size, int chunk_size,
+        int max_size, guac_table_init_handler* init_handler);
+
+/**
+ * Frees the given guac_table, including all elements.
+ *
+ * @param table
+ *     The guac_table to free.
+ */
+void guac_table_free(guac_table* table);
+
+/**
+ * Returns the element having the given index only if storage for that
+ * element has already been allocated. This operation is threadsafe and never
+ * allocates memory.
+ *
+ * @param table
+ *     The guac_table to retrieve the element from.
+ *
+ * @param index
+ *     The index of the element to retrieve.
+ *
+ * @return
+ *     The element having the given index, or NULL if the index is invalid or
+ *     storage for that element has not yet been allocated.
+ */
+void* guac_table_get(guac_table* table, int index);
+
+/**
+ * Returns the element having the given index, allocating storage for that
+ * element if necessary. Pointers returned by this function remain valid
+ * until the table is freed. This operation is threadsafe.
+ *
+ * @param table
+ *     The guac_table to retrieve the element from.
+ *
+ * @param index
+ *     The index of the element to retrieve.
+ *
+ * @return
+ *     The element having the given index, or NULL if the index is invalid or
+ *     storage for that element could not be allocated.
+ */
+void* guac_table_acquire(guac_table* table, int index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,58 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _GUAC_TIMER_CONSTANTS_H
+#define _GUAC_TIMER_CONSTANTS_H
+
+/**
+ * Constants related to the process-wide timer service.
+ *
+ * @file timer-constants.h
+ */
+
+/**
+ * The duration of a single tick of the timer wheel, in milliseconds. Timers
+ * fire no earlier than requested, and no later than one tick after the
+ * requested time (barring delays caused by other timer callbacks).
+ */
+#define GUAC_TIMER_RESOLUTION 10
+
+/**
+ * The base-2 logarithm of the number of slots within each level of the timer
+ * wheel.
+ */
+#define GUAC_TIMER_WHEEL_BITS 6
+
+/**
+ * The number of slots within each level of the timer wheel.
+ */
+#define GUAC_TIMER_WHEEL_SIZE (1 << GUAC_TIMER_WHEEL_BITS)
+
+/**
+ * The number of levels within the timer wheel. Each level covers
+ * GUAC_TIMER_WHEEL_SIZE times the duration of the level below, with the
+ * lowest level covering GUAC_TIMER_WHEEL_SIZE ticks. Timers further in the
+ * future than the highest level covers are parked in the highest level and
+ * reinserted as the wheel turns.
+ */
+#define GUAC_TIMER_WHEEL_LEVELS 4
+
+#endif
+
@@ -0,0 +1,51 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _GUAC_TIMER_TYPES_H
+#define _GUAC_TIMER_TYPES_H
+
+/**
+ * Type definitions related to the process-wide timer service.
+ *
+ * @file timer-types.h
+ */
+
+/**
+ * A timer which invokes a callback once a requested amount of time has
+ * elapsed. All timers within a process are serviced by a single thread.
+ */
+typedef struct guac_timer guac_timer;
+
+/**
+ * Callback which is invoked by the timer service thread when a timer fires.
+ * Callbacks should not block for long periods, as no other timer can fire
+ * while a callback is running. A callback may reschedule its own timer with
+ * guac_timer_schedule().
+ *
+ * @param timer
+ *     The timer which fired.
+ *
+ * @param data
+ *     The arbitrary data associated with the timer when it was allocated.
+ */
+typedef void guac_timer_callback(guac_timer* timer, void* data);
+
+#endif
+
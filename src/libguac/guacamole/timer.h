@@ -0,0 +1,141 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef _GUAC_TIMER_H
+#define _GUAC_TIMER_H
+
+/**
+ * Provides a process-wide timer service, allowing arbitrary callbacks to be
+ * invoked after a given delay without requiring a dedicated thread for each.
+ * Timers are kept within a hierarchical timer wheel serviced by a single
+ * thread, which is started the first time any timer is scheduled and which
+ * sleeps indefinitely while no timers are pending.
+ *
+ * @file timer.h
+ */
+
+#include "timer-constants.h"
+#include "timer-types.h"
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct guac_timer {
+
+    /**
+     * The callback to invoke when this timer fires.
+     */
+    guac_timer_callback* callback;
+
+    /**
+     * Arbitrary data to pass to the callback when this timer fires.
+     */
+    void* data;
+
+    /**
+     * The tick at which this timer should fire, relative to the start of the
+     * timer service.
+     */
+    uint64_t __expires;
+
+    /**
+     * The next timer within the same slot of the timer wheel, or NULL if this
+     * is the last such timer.
+     */
+    guac_timer* __next;
+
+    /**
+     * Pointer to the pointer referencing this timer within the timer wheel
+     * (the head of a slot, or the __next member of the previous timer), or
+     * NULL if this timer is not currently pending.
+     */
+    guac_timer** __pprev;
+
+    /**
+     * Non-zero if the callback of this timer is currently being invoked by
+     * the timer service thread.
+     */
+    int __running;
+
+};
+
+/**
+ * Allocates a new timer which will invoke the given callback each time the
+ * timer fires. The timer is not initially scheduled.
+ *
+ * @param callback
+ *     The callback to invoke when the timer fires.
+ *
+ * @param data
+ *     Arbitrary data to pass to the callback.
+ *
+ * @return
+ *     A newly-allocated timer, or NULL if allocation fails.
+ */
+guac_timer* guac_timer_alloc(guac_timer_callback* callback, void* data);
+
+/**
+ * Schedules the given timer to fire once the given number of milliseconds
+ * have elapsed. If the timer is already pending, it is rescheduled. This
+ * function may be invoked from within the timer's own callback.
+ *
+ * @param timer
+ *     The timer to schedule.
+ *
+ * @param delay
+ *     The number of milliseconds to wait before firing the timer.
+ *
+ * @return
+ *     Zero if the timer was scheduled successfully, non-zero if the timer
+ *     service thread could not be started.
+ */
+int guac_timer_schedule(guac_timer* timer, int delay);
+
+/**
+ * Cancels the given timer if pending. If the timer's callback is currently
+ * running on the timer service thread, this function blocks until the
+ * callback returns, unless invoked from within that callback. Once this
+ * function returns, the callback will not be invoked again unless the timer
+ * is rescheduled.
+ *
+ * @param timer
+ *     The timer to cancel.
+ */
+void guac_timer_cancel(guac_timer* timer);
+
+/**
+ * Cancels the given timer as with guac_timer_cancel(), and frees all
+ * resources associated with it. If the given timer is NULL, this function
+ * has no effect.
+ *
+ * @param timer
+ *     The timer to free.
+ */
+void guac_timer_free(guac_timer* timer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
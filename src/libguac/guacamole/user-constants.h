@@ -35,7 +35,14 @@
  * The maximum number of inbound or outbound streams supported by any one
  * guac_user.
  */
-#define GUAC_USER_MAX_STREAMS 64
+#define GUAC_USER_MAX_STREAMS 4096
+
+/**
+ * The number of streams for which storage is allocated at a time within any
+ * one guac_user. Storage for additional streams is allocated as needed, up to
+ * GUAC_USER_MAX_STREAMS.
+ */
+#define GUAC_USER_STREAM_CHUNK_SIZE 64
 
 /**
  * The index of a closed stream.
@@ -45,7 +52,14 @@
 /**
  * The maximum number of objects supported by any one guac_client.
  */
-#define GUAC_USER_MAX_OBJECTS 64
+#define GUAC_USER_MAX_OBJECTS 4096
+
+/**
+ * The number of objects for which storage is allocated at a time within any
+ * one guac_user. Storage for additional objects is allocated as needed, up to
+ * GUAC_USER_MAX_OBJECTS.
+ */
+#define GUAC_USER_OBJECT_CHUNK_SIZE 64
 
 /**
  * The index of an object which has not been defined.
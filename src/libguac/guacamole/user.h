@@ -33,6 +33,7 @@
 #include "pool-types.h"
 #include "socket-types.h"
 #include "stream-types.h"
+#include "table-types.h"
 #include "timestamp-types.h"
 #include "user-constants.h"
 #include "user-fntypes.h"
@@ -178,14 +179,16 @@ struct guac_user {
     guac_pool* __stream_pool;
 
     /**
-     * All available output streams (data going to connected user).
+     * All available output streams (data going to connected user), allocated
+     * as needed.
      */
-    guac_stream* __output_streams;
+    guac_table* __output_streams;
 
     /**
-     * All available input streams (data coming from connected user).
+     * All available input streams (data coming from connected user),
+     * allocated as needed.
      */
-    guac_stream* __input_streams;
+    guac_table* __input_streams;
 
     /**
      * Pool of object indices.
@@ -193,9 +196,10 @@ struct guac_user {
     guac_pool* __object_pool;
 
     /**
-     * All available objects (arbitrary sets of named streams).
+     * All available objects (arbitrary sets of named streams), allocated as
+     * needed.
      */
-    guac_object* __objects;
+    guac_table* __objects;
 
     /**
      * Arbitrary user-specific data.
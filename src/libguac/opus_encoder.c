@@ -0,0 +1,541 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "audio.h"
+#include "opus_encoder.h"
+
+#include <guacamole/audio.h>
+#include <guacamole/client.h>
+#include <guacamole/protocol.h>
+#include <guacamole/socket.h>
+#include <guacamole/stream.h>
+#include <guacamole/user.h>
+
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Sends the given data along the given audio stream as one or more blobs.
+ *
+ * @param socket
+ *     The guac_socket to send the blobs over.
+ *
+ * @param stream
+ *     The stream to send the blobs along.
+ *
+ * @param data
+ *     The data to send.
+ *
+ * @param length
+ *     The number of bytes of data to send.
+ */
+static void guac_opus_encoder_send_data(guac_socket* socket,
+        guac_stream* stream, const unsigned char* data, int length) {
+
+    while (length > 0) {
+
+        /* Determine size of blob to be written */
+        int chunk_size = length;
+        if (chunk_size > GUAC_OPUS_ENCODER_BLOB_SIZE)
+            chunk_size = GUAC_OPUS_ENCODER_BLOB_SIZE;
+
+        /* Send audio data */
+        guac_protocol_send_blob(socket, stream, data, chunk_size);
+
+        /* Advance to next blob */
+        data += chunk_size;
+        length -= chunk_size;
+
+    }
+
+}
+
+/**
+ * Sends the given Ogg page to all connected users.
+ *
+ * @param audio
+ *     The audio stream that the page belongs to.
+ *
+ * @param page
+ *     The Ogg page to send.
+ */
+static void guac_opus_encoder_send_page(guac_audio_stream* audio,
+        ogg_page* page) {
+
+    guac_socket* socket = audio->client->socket;
+
+    guac_opus_encoder_send_data(socket, audio->stream,
+            page->header, page->header_len);
+
+    guac_opus_encoder_send_data(socket, audio->stream,
+            page->body, page->body_len);
+
+}
+
+/**
+ * Appends the given Ogg page to the buffer of header pages which are sent to
+ * each user upon joining.
+ *
+ * @param state
+ *     The encoder state whose header buffer should be updated.
+ *
+ * @param page
+ *     The Ogg page to append.
+ */
+static void guac_opus_encoder_store_header_page(
+        guac_opus_encoder_state* state, ogg_page* page) {
+
+    int length = page->header_len + page->body_len;
+
+    unsigned char* headers = realloc(state->headers,
+            state->headers_length + length);
+    if (headers == NULL)
+        return;
+
+    memcpy(headers + state->headers_length, page->header, page->header_len);
+    memcpy(headers + state->headers_length + page->header_len,
+            page->body, page->body_len);
+
+    state->headers = headers;
+    state->headers_length += length;
+
+}
+
+/**
+ * Submits a header packet to the Ogg stream, forcing it onto its own page as
+ * required by the Ogg Opus specification (RFC 7845), and storing that page
+ * for replay to joining users.
+ *
+ * @param state
+ *     The encoder state of the audio stream.
+ *
+ * @param data
+ *     The contents of the header packet.
+ *
+ * @param length
+ *     The number of bytes within the header packet.
+ */
+static void guac_opus_encoder_write_header(guac_opus_encoder_state* state,
+        unsigned char* data, int length) {
+
+    ogg_packet packet = {
+        .packet     = data,
+        .bytes      = length,
+        .b_o_s      = (state->packetno == 0),
+        .e_o_s      = 0,
+        .granulepos = 0,
+        .packetno   = state->packetno++
+    };
+
+    ogg_stream_packetin(&state->ogg_state, &packet);
+
+    ogg_page page;
+    while (ogg_stream_flush(&state->ogg_state, &page) != 0)
+        guac_opus_encoder_store_header_page(state, &page);
+
+}
+
+/**
+ * Writes the Opus identification and comment headers (RFC 7845, sections
+ * 5.1 and 5.2) to the Ogg stream.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param state
+ *     The encoder state of the audio stream.
+ *
+ * @param pre_skip
+ *     The number of 48 kHz samples which must be discarded by the decoder at
+ *     the beginning of the stream.
+ */
+static void guac_opus_encoder_write_headers(guac_audio_stream* audio,
+        guac_opus_encoder_state* state, int pre_skip) {
+
+    static const char vendor[] = "libguac";
+
+    /* Identification header (all values little-endian) */
+    unsigned char head[19] = { 'O', 'p', 'u', 's', 'H', 'e', 'a', 'd' };
+    head[8]  = 1; /* Version */
+    head[9]  = audio->channels;
+    head[10] = pre_skip & 0xFF;
+    head[11] = (pre_skip >> 8) & 0xFF;
+    head[12] = audio->rate & 0xFF;
+    head[13] = (audio->rate >> 8) & 0xFF;
+    head[14] = (audio->rate >> 16) & 0xFF;
+    head[15] = (audio->rate >> 24) & 0xFF;
+    head[16] = 0; /* Output gain (low byte) */
+    head[17] = 0; /* Output gain (high byte) */
+    head[18] = 0; /* Channel mapping family (mono/stereo) */
+
+    guac_opus_encoder_write_header(state, head, sizeof(head));
+
+    /* Comment header containing only the vendor string */
+    unsigned char tags[8 + 4 + sizeof(vendor) - 1 + 4] = {
+        'O', 'p', 'u', 's', 'T', 'a', 'g', 's',
+        sizeof(vendor) - 1, 0, 0, 0
+    };
+    memcpy(tags + 12, vendor, sizeof(vendor) - 1);
+
+    guac_opus_encoder_write_header(state, tags, sizeof(tags));
+
+}
+
+/**
+ * Sends the "audio" instruction associating the given audio stream with the
+ * Opus mimetype, followed by the Ogg Opus header pages.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param socket
+ *     The guac_socket to send the instruction and headers over.
+ */
+static void guac_opus_encoder_send_audio(guac_audio_stream* audio,
+        guac_socket* socket) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+
+    /* Associate stream */
+    guac_protocol_send_audio(socket, audio->stream, opus_encoder->mimetype);
+
+    /* Decoders require headers before any audio data */
+    guac_opus_encoder_send_data(socket, audio->stream,
+            state->headers, state->headers_length);
+
+}
+
+/**
+ * Encodes the contents of the frame buffer as a single Opus packet, sending
+ * any Ogg pages completed as a result. If the frame buffer is not full, the
+ * remainder of the frame is filled with silence.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param end_of_stream
+ *     Non-zero if this is the final packet of the stream, zero otherwise.
+ */
+static void guac_opus_encoder_encode_frame(guac_audio_stream* audio,
+        int end_of_stream) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+    unsigned char data[GUAC_OPUS_ENCODER_MAX_PACKET];
+
+    /* Pad incomplete frames with silence */
+    int channels = audio->channels;
+    memset(state->frame + state->frame_length * channels, 0,
+            (state->frame_size - state->frame_length) * channels
+            * sizeof(opus_int16));
+
+    int length = opus_encode(state->encoder, state->frame, state->frame_size,
+            data, sizeof(data));
+
+    state->frame_length = 0;
+
+    /* Drop the frame if encoding fails */
+    if (length < 0)
+        return;
+
+    /* Granule positions are always in terms of 48 kHz samples */
+    state->granulepos += (ogg_int64_t) state->frame_size
+                       * GUAC_OPUS_ENCODER_RATE / state->rate;
+
+    ogg_packet packet = {
+        .packet     = data,
+        .bytes      = length,
+        .b_o_s      = 0,
+        .e_o_s      = end_of_stream,
+        .granulepos = state->granulepos,
+        .packetno   = state->packetno++
+    };
+
+    ogg_stream_packetin(&state->ogg_state, &packet);
+
+    /* Send any pages which are now complete */
+    ogg_page page;
+    while (ogg_stream_pageout(&state->ogg_state, &page) != 0)
+        guac_opus_encoder_send_page(audio, &page);
+
+}
+
+/**
+ * Appends a single sample (one value per channel) to the frame buffer,
+ * encoding the frame if it is full.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param sample
+ *     The sample to append, containing one value per channel.
+ */
+static void guac_opus_encoder_append(guac_audio_stream* audio,
+        const opus_int16* sample) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+
+    int channels = audio->channels;
+    memcpy(state->frame + state->frame_length * channels, sample,
+            channels * sizeof(opus_int16));
+
+    if (++state->frame_length == state->frame_size)
+        guac_opus_encoder_encode_frame(audio, 0);
+
+}
+
+/**
+ * Resamples the given input sample to the sample rate given to libopus using
+ * linear interpolation, appending any resulting samples to the frame buffer.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param sample
+ *     The input sample, containing one value per channel.
+ */
+static void guac_opus_encoder_resample(guac_audio_stream* audio,
+        const opus_int16* sample) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+    int channels = audio->channels;
+    int i;
+
+    /* Emit all output samples between the previous and current inputs */
+    while (state->position < 1.0) {
+
+        opus_int16 output[2];
+        for (i = 0; i < channels; i++)
+            output[i] = state->last[i]
+                      + (sample[i] - state->last[i]) * state->position;
+
+        guac_opus_encoder_append(audio, output);
+        state->position += state->step;
+
+    }
+
+    /* Current input becomes the previous input for the next sample */
+    state->position -= 1.0;
+    for (i = 0; i < channels; i++)
+        state->last[i] = sample[i];
+
+}
+
+/**
+ * Reads a single 16-bit little-endian sample (one value per channel) from
+ * the given PCM data, passing it on for resampling or buffering as
+ * appropriate.
+ *
+ * @param audio
+ *     The audio stream being encoded.
+ *
+ * @param pcm_data
+ *     The PCM data containing the sample.
+ */
+static void guac_opus_encoder_write_sample(guac_audio_stream* audio,
+        const unsigned char* pcm_data) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+    opus_int16 sample[2];
+    int i;
+
+    for (i = 0; i < audio->channels; i++) {
+        sample[i] = (opus_int16) (pcm_data[0] | (pcm_data[1] << 8));
+        pcm_data += 2;
+    }
+
+    if (state->step == 1.0)
+        guac_opus_encoder_append(audio, sample);
+    else
+        guac_opus_encoder_resample(audio, sample);
+
+}
+
+/**
+ * Returns whether the given sample rate is supported natively by libopus.
+ *
+ * @param rate
+ *     The sample rate to test, in samples per second.
+ *
+ * @return
+ *     Non-zero if the sample rate is supported, zero otherwise.
+ */
+static int guac_opus_encoder_native_rate(int rate) {
+    return rate == 8000 || rate == 12000 || rate == 16000
+        || rate == 24000 || rate == 48000;
+}
+
+static void guac_opus_encoder_begin_handler(guac_audio_stream* audio) {
+
+    guac_opus_encoder_state* state;
+    int error;
+
+    /* The stream falls back to raw PCM if encoder state is not assigned */
+    audio->data = NULL;
+
+    /* Allocate and init encoder state */
+    state = calloc(1, sizeof(guac_opus_encoder_state));
+    if (state == NULL)
+        return;
+
+    /* Resample only if Opus cannot accept the PCM rate as-is */
+    if (guac_opus_encoder_native_rate(audio->rate))
+        state->rate = audio->rate;
+    else
+        state->rate = GUAC_OPUS_ENCODER_RATE;
+
+    state->step = (double) audio->rate / state->rate;
+
+    state->encoder = opus_encoder_create(state->rate, audio->channels,
+            OPUS_APPLICATION_AUDIO, &error);
+
+    if (error != OPUS_OK || state->encoder == NULL) {
+        free(state);
+        return;
+    }
+
+    opus_encoder_ctl(state->encoder,
+            OPUS_SET_BITRATE(GUAC_OPUS_ENCODER_BITRATE));
+
+    /* Allocate buffer for exactly one frame */
+    state->frame_size = state->rate * GUAC_OPUS_ENCODER_FRAME_DURATION / 1000;
+    state->frame = malloc(state->frame_size * audio->channels
+            * sizeof(opus_int16));
+
+    if (state->frame == NULL) {
+        opus_encoder_destroy(state->encoder);
+        free(state);
+        return;
+    }
+
+    /* The encoder lookahead must be skipped by the decoder */
+    opus_int32 lookahead = 0;
+    opus_encoder_ctl(state->encoder, OPUS_GET_LOOKAHEAD(&lookahead));
+    int pre_skip = lookahead * GUAC_OPUS_ENCODER_RATE / state->rate;
+
+    audio->data = state;
+
+    ogg_stream_init(&state->ogg_state, audio->stream->index);
+    guac_opus_encoder_write_headers(audio, state, pre_skip);
+
+    /* Broadcast existence of stream */
+    guac_opus_encoder_send_audio(audio, audio->client->socket);
+
+}
+
+static void guac_opus_encoder_join_handler(guac_audio_stream* audio,
+        guac_user* user) {
+
+    /* Notify user of existence of stream */
+    guac_opus_encoder_send_audio(audio, user->socket);
+
+}
+
+static void guac_opus_encoder_end_handler(guac_audio_stream* audio) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+
+    /* Encode any remaining samples as the final packet */
+    guac_opus_encoder_encode_frame(audio, 1);
+
+    /* Send all remaining pages */
+    ogg_page page;
+    while (ogg_stream_flush(&state->ogg_state, &page) != 0)
+        guac_opus_encoder_send_page(audio, &page);
+
+    /* Send end of stream */
+    guac_protocol_send_end(audio->client->socket, audio->stream);
+
+    ogg_stream_clear(&state->ogg_state);
+    opus_encoder_destroy(state->encoder);
+
+    /* Free state information */
+    free(state->headers);
+    free(state->frame);
+    free(state);
+
+}
+
+static void guac_opus_encoder_write_handler(guac_audio_stream* audio,
+        const unsigned char* pcm_data, int length) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+    int sample_length = audio->channels * 2;
+
+    /* Complete any partial sample left over from the previous write */
+    if (state->partial_length > 0) {
+
+        int remaining = sample_length - state->partial_length;
+        if (remaining > length)
+            remaining = length;
+
+        memcpy(state->partial + state->partial_length, pcm_data, remaining);
+        state->partial_length += remaining;
+        pcm_data += remaining;
+        length -= remaining;
+
+        if (state->partial_length < sample_length)
+            return;
+
+        guac_opus_encoder_write_sample(audio, state->partial);
+        state->partial_length = 0;
+
+    }
+
+    /* Handle all complete samples */
+    while (length >= sample_length) {
+        guac_opus_encoder_write_sample(audio, pcm_data);
+        pcm_data += sample_length;
+        length -= sample_length;
+    }
+
+    /* Save any partial sample for the next write */
+    memcpy(state->partial, pcm_data, length);
+    state->partial_length = length;
+
+}
+
+static void guac_opus_encoder_flush_handler(guac_audio_stream* audio) {
+
+    guac_opus_encoder_state* state = (guac_opus_encoder_state*) audio->data;
+
+    /* Send all complete packets, leaving any partial frame buffered */
+    ogg_page page;
+    while (ogg_stream_flush(&state->ogg_state, &page) != 0)
+        guac_opus_encoder_send_page(audio, &page);
+
+}
+
+/* Opus encoder handlers */
+guac_audio_encoder _opus_encoder = {
+    .mimetype      = "audio/ogg;codecs=opus",
+    .begin_handler = guac_opus_encoder_begin_handler,
+    .write_handler = guac_opus_encoder_write_handler,
+    .flush_handler = guac_opus_encoder_flush_handler,
+    .join_handler  = guac_opus_encoder_join_handler,
+    .end_handler   = guac_opus_encoder_end_handler
+};
+
+/* Actual encoder definition */
+guac_audio_encoder* opus_encoder = &_opus_encoder;
+
@@ -0,0 +1,161 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef GUAC_OPUS_ENCODER_H
+#define GUAC_OPUS_ENCODER_H
+
+#include "config.h"
+
+#include "audio.h"
+
+#include <ogg/ogg.h>
+#include <opus/opus.h>
+
+/**
+ * The number of bytes to send in each audio blob.
+ */
+#define GUAC_OPUS_ENCODER_BLOB_SIZE 6048
+
+/**
+ * The duration of each Opus frame, in milliseconds. Opus supports frames of
+ * 2.5, 5, 10, 20, 40 or 60 ms. Longer frames reduce per-packet overhead at the
+ * cost of latency.
+ */
+#define GUAC_OPUS_ENCODER_FRAME_DURATION 20
+
+/**
+ * The target bitrate of the encoded audio, in bits per second.
+ */
+#define GUAC_OPUS_ENCODER_BITRATE 64000
+
+/**
+ * The sample rate used internally by the encoder when the PCM sample rate of
+ * the audio stream is not natively supported by Opus. All Opus streams are
+ * ultimately decoded at 48 kHz.
+ */
+#define GUAC_OPUS_ENCODER_RATE 48000
+
+/**
+ * The maximum size of a single encoded Opus packet, in bytes, as recommended
+ * by the libopus documentation.
+ */
+#define GUAC_OPUS_ENCODER_MAX_PACKET 4000
+
+/**
+ * The current state of the Opus encoder. PCM data is resampled if necessary,
+ * buffered until a full Opus frame is available, encoded, and encapsulated
+ * within Ogg pages which are sent as blobs.
+ */
+typedef struct guac_opus_encoder_state {
+
+    /**
+     * The underlying libopus encoder.
+     */
+    OpusEncoder* encoder;
+
+    /**
+     * The Ogg stream encapsulating the encoded Opus packets.
+     */
+    ogg_stream_state ogg_state;
+
+    /**
+     * The sample rate given to libopus. This will be the sample rate of the
+     * audio stream if supported natively by Opus, or GUAC_OPUS_ENCODER_RATE
+     * otherwise.
+     */
+    int rate;
+
+    /**
+     * The number of samples (per channel) within each Opus frame, at the
+     * sample rate given to libopus.
+     */
+    int frame_size;
+
+    /**
+     * Buffer of not-yet-encoded 16-bit samples, interleaved by channel, with
+     * room for exactly one Opus frame.
+     */
+    opus_int16* frame;
+
+    /**
+     * The number of samples (per channel) currently stored in the frame
+     * buffer.
+     */
+    int frame_length;
+
+    /**
+     * The ratio of the audio stream sample rate to the sample rate given to
+     * libopus, or 1.0 if no resampling is required.
+     */
+    double step;
+
+    /**
+     * The position of the next resampled output sample, relative to the
+     * previous input sample (0.0) and the current input sample (1.0).
+     */
+    double position;
+
+    /**
+     * The previous input sample for each channel, used for interpolation when
+     * resampling.
+     */
+    opus_int16 last[2];
+
+    /**
+     * Bytes of a partial sample frame left over from the previous write.
+     */
+    unsigned char partial[4];
+
+    /**
+     * The number of bytes stored within the partial buffer.
+     */
+    int partial_length;
+
+    /**
+     * The granule position of the next Ogg packet: the total number of
+     * 48 kHz samples encoded so far, including the encoder lookahead.
+     */
+    ogg_int64_t granulepos;
+
+    /**
+     * The sequence number of the next Ogg packet.
+     */
+    ogg_int64_t packetno;
+
+    /**
+     * The Ogg pages containing the Opus identification and comment headers,
+     * which must be sent to any user joining after the stream has begun.
+     */
+    unsigned char* headers;
+
+    /**
+     * The number of bytes within the headers buffer.
+     */
+    int headers_length;
+
+} guac_opus_encoder_state;
+
+/**
+ * Audio encoder which encodes 16-bit PCM as Opus, encapsulated within an Ogg
+ * container.
+ */
+extern guac_audio_encoder* opus_encoder;
+
+#endif
+
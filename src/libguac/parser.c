@@ -24,10 +24,61 @@
 #include "socket.h"
 #include "unicode.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Returns the number of bytes at the beginning of the given buffer which are
+ * ASCII characters. As each ASCII character is exactly one byte, runs of
+ * such characters can be skipped by length alone, without examining each
+ * character individually.
+ *
+ * @param buffer
+ *     The buffer to examine.
+ *
+ * @param length
+ *     The maximum number of bytes to examine.
+ *
+ * @return
+ *     The number of leading bytes within the buffer which are ASCII.
+ */
+static int guac_parser_ascii_span(const char* buffer, int length) {
+
+    int span = 0;
+
+#ifdef __SSE2__
+    /* Test 16 bytes at a time for any set high bit */
+    while (length - span >= 16) {
+        __m128i data = _mm_loadu_si128((const __m128i*) (buffer + span));
+        if (_mm_movemask_epi8(data))
+            break;
+        span += 16;
+    }
+#else
+    /* Test 8 bytes at a time for any set high bit */
+    while (length - span >= 8) {
+        uint64_t data;
+        memcpy(&data, buffer + span, sizeof(data));
+        if (data & 0x8080808080808080ULL)
+            break;
+        span += 8;
+    }
+#endif
+
+    /* Finish remaining bytes individually */
+    while (span < length && !(buffer[span] & 0x80))
+        span++;
+
+    return span;
+
+}
+
 static void guac_parser_reset(guac_parser* parser) {
     parser->opcode = NULL;
     parser->argc = 0;
@@ -112,6 +163,19 @@ int guac_parser_append(guac_parser* parser, void* buffer, int length) {
 
         while (bytes_parsed < length && parser->__element_length >= 0) {
 
+            /* Skip any run of ASCII characters within the element at once */
+            int ascii_length = length - bytes_parsed;
+            if (ascii_length > parser->__element_length)
+                ascii_length = parser->__element_length;
+
+            ascii_length = guac_parser_ascii_span(char_buffer, ascii_length);
+            parser->__element_length -= ascii_length;
+            bytes_parsed += ascii_length;
+            char_buffer += ascii_length;
+
+            if (bytes_parsed == length)
+                break;
+
             /* Get length of current character */
             char c = *char_buffer;
             int char_length = guac_utf8_charsize((unsigned char) c);
@@ -163,6 +227,135 @@ int guac_parser_append(guac_parser* parser, void* buffer, int length) {
 
 }
 
+int guac_parser_parse(guac_parser* parser, const void* buffer, int length) {
+
+    const char* start = (const char*) buffer;
+    const char* current = start;
+    const char* end = current + length;
+
+    /* Offset of the terminator of each element */
+    int terminators[GUAC_INSTRUCTION_MAX_ELEMENTS];
+
+    guac_parser_reset(parser);
+
+    for (;;) {
+
+        /* Do not exceed maximum number of elements */
+        if (parser->__elementc == GUAC_INSTRUCTION_MAX_ELEMENTS)
+            goto parse_error;
+
+        /* Parse element length */
+        int element_length = 0;
+        for (;;) {
+
+            if (current == end)
+                return 0;
+
+            char c = *(current++);
+
+            /* If digit, add to length */
+            if (c >= '0' && c <= '9') {
+                element_length = element_length*10 + c - '0';
+                if (element_length > GUAC_INSTRUCTION_MAX_LENGTH)
+                    goto parse_error;
+            }
+
+            /* If period, switch to parsing content */
+            else if (c == '.')
+                break;
+
+            /* If not digit, parse error */
+            else
+                goto parse_error;
+
+        }
+
+        const char* element = current;
+
+        /* Skip element content, skipping runs of ASCII by length alone */
+        while (element_length > 0) {
+
+            int ascii_length = end - current;
+            if (ascii_length > element_length)
+                ascii_length = element_length;
+
+            ascii_length = guac_parser_ascii_span(current, ascii_length);
+            element_length -= ascii_length;
+            current += ascii_length;
+
+            if (element_length == 0)
+                break;
+
+            if (current == end)
+                return 0;
+
+            /* Skip multibyte character, if entirely present */
+            int char_length = guac_utf8_charsize((unsigned char) *current);
+            if (end - current < char_length)
+                return 0;
+
+            element_length--;
+            current += char_length;
+
+        }
+
+        /* Terminator must follow content */
+        if (current == end)
+            return 0;
+
+        terminators[parser->__elementc] = current - start;
+        parser->__elementv[parser->__elementc++] = (char*) element;
+
+        /* If semicolon, instruction is complete */
+        char c = *(current++);
+        if (c == ';')
+            break;
+
+        /* Otherwise, terminator must be a comma */
+        if (c != ',')
+            goto parse_error;
+
+    }
+
+    /* Copy complete instruction into the instruction buffer, leaving the
+     * provided buffer untouched */
+    int instruction_length = current - start;
+    if (instruction_length > sizeof(parser->__instructionbuf)) {
+        parser->state = GUAC_PARSE_ERROR;
+        guac_error = GUAC_STATUS_NO_MEMORY;
+        guac_error_message = "Instruction too long";
+        return -1;
+    }
+
+    char* copy = parser->__instructionbuf;
+    memcpy(copy, start, instruction_length);
+
+    /* The instruction buffer no longer contains any unparsed data */
+    parser->__instructionbuf_unparsed_start = copy;
+    parser->__instructionbuf_unparsed_end = copy;
+
+    /* Point each element at its copy, terminating each */
+    int i;
+    for (i = 0; i < parser->__elementc; i++) {
+        parser->__elementv[i] = copy + (parser->__elementv[i] - start);
+        copy[terminators[i]] = '\0';
+    }
+
+    parser->state = GUAC_PARSE_COMPLETE;
+    parser->opcode = parser->__elementv[0];
+    parser->argv = &(parser->__elementv[1]);
+    parser->argc = parser->__elementc - 1;
+
+    return instruction_length;
+
+parse_error:
+    parser->state = GUAC_PARSE_ERROR;
+    guac_error = GUAC_STATUS_PROTOCOL_ERROR;
+    guac_error_message = "Instruction parse error";
+    return -1;
+
+}
+
 int guac_parser_read(guac_parser* parser, guac_socket* socket, int usec_timeout) {
 
     char* unparsed_end   = parser->__instructionbuf_unparsed_end;
@@ -21,12 +21,18 @@
 
 #include "pool.h"
 
+#include <stdint.h>
 #include <stdlib.h>
 
+/**
+ * The number of bitmap words within each chunk of a guac_pool.
+ */
+#define GUAC_POOL_CHUNK_WORDS (GUAC_POOL_CHUNK_SIZE / GUAC_POOL_WORD_BITS)
+
 guac_pool* guac_pool_alloc(int size) {
 
-    pthread_mutexattr_t lock_attributes;
-    guac_pool* pool = malloc(sizeof(guac_pool));
+    /* Allocate pool with no bitmap chunks */
+    guac_pool* pool = calloc(1, sizeof(guac_pool));
 
     /* If unable to allocate, just return NULL. */
     if (pool == NULL)
@@ -36,12 +42,8 @@ guac_pool* guac_pool_alloc(int size) {
     pool->min_size = size;
     pool->active = 0;
     pool->__next_value = 0;
-    pool->__head = NULL;
-    pool->__tail = NULL;
-
-    /* Init lock */
-    pthread_mutexattr_init(&lock_attributes);
-    pthread_mutex_init(&(pool->__lock), &lock_attributes);
+    pool->__free_count = 0;
+    pool->__claim_position = 0;
 
     return pool;
 
@@ -49,86 +51,194 @@ guac_pool* guac_pool_alloc(int size) {
 
 void guac_pool_free(guac_pool* pool) {
 
-    /* Free all ints in pool */
-    guac_pool_int* current = pool->__head;
-    while (current != NULL) {
-
-        guac_pool_int* old = current;
-        current = current->__next;
+    int i;
 
-        free(old);
-    }
-
-    /* Destroy lock */
-    pthread_mutex_destroy(&(pool->__lock));
+    /* Free all bitmap chunks */
+    for (i = 0; i < GUAC_POOL_MAX_CHUNKS; i++)
+        free(pool->__chunks[i]);
 
     /* Free pool */
     free(pool);
 
 }
 
-int guac_pool_next_int(guac_pool* pool) {
+/**
+ * Returns the bitmap chunk containing the bit for the given integer,
+ * allocating and atomically publishing that chunk if it does not yet exist.
+ *
+ * @param pool
+ *     The guac_pool containing the chunk.
+ *
+ * @param value
+ *     The integer whose chunk should be returned.
+ *
+ * @return
+ *     The bitmap chunk containing the bit for the given integer, or NULL if
+ *     the chunk could not be allocated.
+ */
+static uint64_t* __guac_pool_get_chunk(guac_pool* pool, int value) {
 
-    int value;
+    uint64_t** slot = &(pool->__chunks[value / GUAC_POOL_CHUNK_SIZE]);
 
-    /* Acquire exclusive access */
-    pthread_mutex_lock(&(pool->__lock));
+    /* Use existing chunk if already allocated */
+    uint64_t* chunk = __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+    if (chunk != NULL)
+        return chunk;
 
-    pool->active++;
+    uint64_t* new_chunk = calloc(GUAC_POOL_CHUNK_WORDS, sizeof(uint64_t));
+    if (new_chunk == NULL)
+        return NULL;
+
+    /* Publish new chunk, deferring to any chunk published concurrently */
+    if (__atomic_compare_exchange_n(slot, &chunk, new_chunk, 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        return new_chunk;
+
+    free(new_chunk);
+    return chunk;
+
+}
+
+/**
+ * Claims a freed integer within the given pool, clearing its bit within the
+ * bitmap of freed integers. The search begins at the claim position of the
+ * pool and wraps around, such that freed integers are reused in rotating
+ * order, delaying reuse of any particular integer for as long as possible.
+ *
+ * @param pool
+ *     The guac_pool to claim a freed integer from.
+ *
+ * @return
+ *     The claimed integer, or -1 if no freed integers are available.
+ */
+static int __guac_pool_claim_free_int(guac_pool* pool) {
+
+    /* Reserve one freed integer, if any exist */
+    int free_count = __atomic_load_n(&(pool->__free_count), __ATOMIC_ACQUIRE);
+    do {
+        if (free_count <= 0)
+            return -1;
+    } while (!__atomic_compare_exchange_n(&(pool->__free_count), &free_count,
+                free_count - 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    /* The reservation guarantees a set bit exists, though other threads may
+     * claim the bits we encounter first, hence the outer loop */
+    for (;;) {
+
+        /* Only integers which have been returned can be freed, and the next
+         * value may have been advanced beyond the pool's capacity */
+        int limit = __atomic_load_n(&(pool->__next_value), __ATOMIC_ACQUIRE);
+        if (limit > GUAC_POOL_CHUNK_SIZE * GUAC_POOL_MAX_CHUNKS)
+            limit = GUAC_POOL_CHUNK_SIZE * GUAC_POOL_MAX_CHUNKS;
+
+        int words = (limit + GUAC_POOL_WORD_BITS - 1) / GUAC_POOL_WORD_BITS;
+        if (words == 0)
+            continue;
+
+        int start = __atomic_load_n(&(pool->__claim_position),
+                __ATOMIC_RELAXED);
+        if (start < 0 || start >= words * GUAC_POOL_WORD_BITS)
+            start = 0;
+
+        int start_word = start / GUAC_POOL_WORD_BITS;
+        int start_bit = start % GUAC_POOL_WORD_BITS;
+        int i;
+
+        /* Visit each word once, beginning with the bits at and after the
+         * claim position, and revisit the first word last for the bits
+         * before the claim position */
+        for (i = 0; i <= words; i++) {
+
+            int base = ((start_word + i) % words) * GUAC_POOL_WORD_BITS;
+
+            uint64_t mask = ~((uint64_t) 0);
+            if (i == 0)
+                mask <<= start_bit;
+            else if (i == words)
+                mask = ((uint64_t) 1 << start_bit) - 1;
+
+            /* Integers are only freed after their chunk exists */
+            uint64_t* chunk = __atomic_load_n(
+                    &(pool->__chunks[base / GUAC_POOL_CHUNK_SIZE]),
+                    __ATOMIC_ACQUIRE);
+            if (chunk == NULL)
+                continue;
+
+            uint64_t* word = &(chunk[(base % GUAC_POOL_CHUNK_SIZE)
+                    / GUAC_POOL_WORD_BITS]);
+
+            /* Attempt to clear the first set bit until successful or none
+             * remain (a failed exchange reloads the word) */
+            uint64_t bits = __atomic_load_n(word, __ATOMIC_ACQUIRE);
+            while ((bits & mask) != 0) {
+                int bit = __builtin_ctzll(bits & mask);
+                if (__atomic_compare_exchange_n(word, &bits,
+                            bits & ~((uint64_t) 1 << bit), 0,
+                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                    __atomic_store_n(&(pool->__claim_position),
+                            base + bit + 1, __ATOMIC_RELAXED);
+                    return base + bit;
+                }
+            }
+
+        }
 
-    /* If more integers are needed, return a new one. */
-    if (pool->__head == NULL || pool->__next_value < pool->min_size) {
-        value = pool->__next_value++;
-        pthread_mutex_unlock(&(pool->__lock));
-        return value;
     }
 
-    /* Otherwise, remove first integer. */
-    value = pool->__head->value;
+}
+
+int guac_pool_next_int(guac_pool* pool) {
 
-    /* If only one element exists, reset pool to empty. */
-    if (pool->__tail == pool->__head) {
-        free(pool->__head);
-        pool->__head = NULL;
-        pool->__tail = NULL;
+    int value;
+
+    __atomic_add_fetch(&(pool->active), 1, __ATOMIC_RELAXED);
+
+    /* Reuse a freed integer only once the minimum size has been reached */
+    if (__atomic_load_n(&(pool->__next_value), __ATOMIC_ACQUIRE)
+            >= pool->min_size) {
+        value = __guac_pool_claim_free_int(pool);
+        if (value >= 0)
+            return value;
     }
 
-    /* Otherwise, advance head. */
-    else {
-        guac_pool_int* old_head = pool->__head;
-        pool->__head = old_head->__next;
-        free(old_head);
+    /* Otherwise, return a new integer */
+    value = __atomic_fetch_add(&(pool->__next_value), 1, __ATOMIC_ACQ_REL);
+
+    /* Ensure the new integer can later be freed without allocation */
+    if (value >= GUAC_POOL_CHUNK_SIZE * GUAC_POOL_MAX_CHUNKS
+            || __guac_pool_get_chunk(pool, value) == NULL) {
+        __atomic_sub_fetch(&(pool->active), 1, __ATOMIC_RELAXED);
+        return -1;
     }
 
-    /* Return retrieved value. */
-    pthread_mutex_unlock(&(pool->__lock));
     return value;
+
 }
 
 void guac_pool_free_int(guac_pool* pool, int value) {
 
-    /* Allocate and initialize new returned value */
-    guac_pool_int* pool_int = malloc(sizeof(guac_pool_int));
-    pool_int->value = value;
-    pool_int->__next = NULL;
-
-    /* Acquire exclusive access */
-    pthread_mutex_lock(&(pool->__lock));
+    /* Ignore integers never returned by this pool */
+    if (value < 0
+            || value >= __atomic_load_n(&(pool->__next_value), __ATOMIC_ACQUIRE)
+            || value >= GUAC_POOL_CHUNK_SIZE * GUAC_POOL_MAX_CHUNKS)
+        return;
 
-    pool->active--;
+    uint64_t* chunk = __atomic_load_n(
+            &(pool->__chunks[value / GUAC_POOL_CHUNK_SIZE]), __ATOMIC_ACQUIRE);
+    if (chunk == NULL)
+        return;
 
-    /* If pool empty, store as sole entry. */
-    if (pool->__tail == NULL)
-        pool->__head = pool->__tail = pool_int;
+    /* Mark integer as freed, ignoring integers which are already free */
+    uint64_t bit = (uint64_t) 1 << (value % GUAC_POOL_WORD_BITS);
+    uint64_t old_bits = __atomic_fetch_or(&(chunk[(value % GUAC_POOL_CHUNK_SIZE)
+                / GUAC_POOL_WORD_BITS]), bit, __ATOMIC_RELEASE);
+    if (old_bits & bit)
+        return;
 
-    /* Otherwise, append to end of pool. */
-    else {
-        pool->__tail->__next = pool_int;
-        pool->__tail = pool_int;
-    }
+    /* Only once marked, make the integer available for claiming */
+    __atomic_add_fetch(&(pool->__free_count), 1, __ATOMIC_RELEASE);
 
-    /* Value has been freed */
-    pthread_mutex_unlock(&(pool->__lock));
+    __atomic_sub_fetch(&(pool->active), 1, __ATOMIC_RELAXED);
 
 }
 
@@ -364,6 +364,7 @@ guac_socket* guac_socket_broadcast(guac_client* client) {
     /* Set read/write handlers */
     socket->read_handler   = __guac_socket_broadcast_read_handler;
     socket->write_handler  = __guac_socket_broadcast_write_handler;
+    socket->raw_write_handler = __guac_socket_broadcast_write_handler;
     socket->select_handler = __guac_socket_broadcast_select_handler;
     socket->flush_handler  = __guac_socket_broadcast_flush_handler;
     socket->lock_handler   = __guac_socket_broadcast_lock_handler;
@@ -438,6 +438,7 @@ guac_socket* guac_socket_open(int fd) {
     /* Set read/write handlers */
     socket->read_handler   = guac_socket_fd_read_handler;
     socket->write_handler  = guac_socket_fd_write_handler;
+    socket->raw_write_handler = guac_socket_fd_write_handler;
     socket->select_handler = guac_socket_fd_select_handler;
     socket->lock_handler   = guac_socket_fd_lock_handler;
     socket->unlock_handler = guac_socket_fd_unlock_handler;
@@ -135,6 +135,7 @@ guac_socket* guac_socket_nest(guac_socket* parent, int index) {
 
     /* Set write and free handlers */
     socket->write_handler  = __guac_socket_nest_write_handler;
+    socket->raw_write_handler = __guac_socket_nest_write_handler;
     socket->free_handler   = __guac_socket_nest_free_handler;
 
     return socket;
@@ -25,9 +25,19 @@
 #include "wait-fd.h"
 
 #include <stdlib.h>
+#include <unistd.h>
 
+#include <openssl/bio.h>
 #include <openssl/ssl.h>
 
+/*
+ * Kernel TLS offload is available only if OpenSSL was built with kTLS support
+ * and provides a means of enabling it.
+ */
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define GUAC_SOCKET_SSL_KTLS
+#endif
+
 static ssize_t __guac_socket_ssl_read_handler(guac_socket* socket,
         void* buf, size_t count) {
 
@@ -54,6 +64,9 @@ static ssize_t __guac_socket_ssl_write_handler(guac_socket* socket,
     guac_socket_ssl_data* data = (guac_socket_ssl_data*) socket->data;
     int retval;
 
+    /* Always write through OpenSSL, even with kTLS active, such that any
+     * pending post-handshake messages (KeyUpdate, etc.) are handled. OpenSSL
+     * passes application data to the kernel for encryption in that case. */
     retval = SSL_write(data->ssl, buf, count);
 
     /* Record errors in guac_error */
@@ -114,8 +127,16 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
     /* Init SSL */
     data->context = context;
     data->ssl = ssl;
+    data->ktls_send = 0;
+    data->ktls_recv = 0;
     SSL_set_fd(data->ssl, fd);
 
+#ifdef GUAC_SOCKET_SSL_KTLS
+    /* Offload record encryption to the kernel after the handshake if
+     * possible (OpenSSL silently falls back to userspace otherwise) */
+    SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif
+
     /* Accept SSL connection, handle errors */
     if (SSL_accept(ssl) <= 0) {
 
@@ -132,9 +153,16 @@ guac_socket* guac_socket_open_secure(SSL_CTX* context, int fd) {
     data->fd = fd;
     socket->data = data;
 
+#ifdef GUAC_SOCKET_SSL_KTLS
+    /* Record whether the kernel accepted the negotiated cipher */
+    data->ktls_send = BIO_get_ktls_send(SSL_get_wbio(ssl));
+    data->ktls_recv = BIO_get_ktls_recv(SSL_get_rbio(ssl));
+#endif
+
     /* Set read/write handlers */
     socket->read_handler   = __guac_socket_ssl_read_handler;
     socket->write_handler  = __guac_socket_ssl_write_handler;
+    socket->raw_write_handler = __guac_socket_ssl_write_handler;
     socket->select_handler = __guac_socket_ssl_select_handler;
     socket->free_handler   = __guac_socket_ssl_free_handler;
 
@@ -221,6 +221,7 @@ guac_socket* guac_socket_tee(guac_socket* primary, guac_socket* secondary) {
     /* Assign handlers */
     socket->read_handler   = __guac_socket_tee_read_handler;
     socket->write_handler  = __guac_socket_tee_write_handler;
+    socket->raw_write_handler = __guac_socket_tee_write_handler;
     socket->select_handler = __guac_socket_tee_select_handler;
     socket->flush_handler  = __guac_socket_tee_flush_handler;
     socket->lock_handler   = __guac_socket_tee_lock_handler;
@@ -435,6 +435,7 @@ guac_socket* guac_socket_open_wsa(SOCKET sock) {
     /* Set read/write handlers */
     socket->read_handler   = guac_socket_wsa_read_handler;
     socket->write_handler  = guac_socket_wsa_write_handler;
+    socket->raw_write_handler = guac_socket_wsa_write_handler;
     socket->select_handler = guac_socket_wsa_select_handler;
     socket->lock_handler   = guac_socket_wsa_lock_handler;
     socket->unlock_handler = guac_socket_wsa_unlock_handler;
@@ -0,0 +1,545 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "Guacamole.capnp.h"
+#include "config.h"
+
+extern "C" {
+#include "error.h"
+}
+#include "client-constants.h"
+#include "socket.h"
+#include "socket-zstd.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zstd.h>
+#include <capnp/message.h>
+#include <capnp/serialize-packed.h>
+#include <kj/io.h>
+
+/**
+ * The number of distinct stream indices which may appear within outgoing
+ * instructions. Streams allocated from the client's pool are sent with odd
+ * indices (2n + 1) while those allocated from each user's pool are sent with
+ * even indices (2n), thus the range of indices is twice the size of either
+ * pool.
+ */
+#define GUAC_SOCKET_ZSTD_MAX_STREAM_INDEX (GUAC_CLIENT_MAX_STREAMS * 2)
+
+/**
+ * Data associated with a socket which compresses all outgoing instructions
+ * with zstd.
+ */
+typedef struct guac_socket_zstd_data {
+
+    /**
+     * The socket to which compressed data is written.
+     */
+    guac_socket* socket;
+
+    /**
+     * The zstd compression context, holding the state of the single zstd
+     * stream spanning all compressed chunks.
+     */
+    ZSTD_CCtx* context;
+
+    /**
+     * Buffer receiving the packed encoding of each instruction prior to
+     * compression.
+     */
+    kj::VectorOutputStream packed;
+
+    /**
+     * Buffer receiving compressed data, preceded by space for the header of
+     * the chunk containing that data.
+     */
+    unsigned char out_buf[4 + GUAC_SOCKET_OUTPUT_BUFFER_SIZE];
+
+    /**
+     * Bitmap of all streams whose blobs are already compressed, indexed by
+     * stream index.
+     */
+    unsigned char precompressed[GUAC_SOCKET_ZSTD_MAX_STREAM_INDEX / 8];
+
+    /**
+     * The current compression statistics.
+     */
+    guac_socket_zstd_stats stats;
+
+    /**
+     * Lock which protects the compressor and statistics, guaranteeing
+     * atomicity of writes and flushes.
+     */
+    pthread_mutex_t buffer_lock;
+
+} guac_socket_zstd_data;
+
+/**
+ * Returns the CPU time consumed by the current thread, in microseconds.
+ *
+ * @return
+ *     The CPU time consumed by the current thread, in microseconds.
+ */
+static uint64_t guac_socket_zstd_cpu_usec() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+}
+
+/**
+ * Writes a single chunk to the underlying socket, including its header.
+ *
+ * @param data
+ *     The data associated with the compressing socket.
+ *
+ * @param header
+ *     The 4-byte buffer receiving the chunk header. When writing a compressed
+ *     chunk, this is the start of out_buf, such that the header and data can
+ *     be written together.
+ *
+ * @param buffer
+ *     The contents of the chunk.
+ *
+ * @param length
+ *     The number of bytes within the chunk.
+ *
+ * @param flags
+ *     GUAC_SOCKET_ZSTD_RAW if the chunk is an uncompressed instruction, zero
+ *     otherwise.
+ *
+ * @return
+ *     Zero on success, non-zero if an error occurs.
+ */
+static int guac_socket_zstd_write_chunk(guac_socket_zstd_data* data,
+        unsigned char* header, const void* buffer, size_t length,
+        uint32_t flags) {
+
+    uint32_t value = length | flags;
+
+    header[0] = value;
+    header[1] = value >> 8;
+    header[2] = value >> 16;
+    header[3] = value >> 24;
+
+    data->stats.bytes_out += 4 + length;
+
+    /* Compressed data directly follows its header within out_buf */
+    if (header + 4 == buffer)
+        return guac_socket_write(data->socket, header, 4 + length) != 0;
+
+    return guac_socket_write(data->socket, header, 4)
+        || guac_socket_write(data->socket, buffer, length);
+
+}
+
+/**
+ * Compresses the given data, writing any compressed output as chunks. The
+ * buffer lock must already be held.
+ *
+ * @param data
+ *     The data associated with the compressing socket.
+ *
+ * @param buffer
+ *     The data to compress, which may be NULL if length is zero.
+ *
+ * @param length
+ *     The number of bytes of data to compress.
+ *
+ * @param mode
+ *     ZSTD_e_continue if compressed data may remain buffered within the
+ *     compressor, ZSTD_e_flush if all data provided so far must be written,
+ *     or ZSTD_e_end if the zstd stream should be ended.
+ *
+ * @return
+ *     Zero on success, non-zero if an error occurs.
+ */
+static int guac_socket_zstd_compress(guac_socket_zstd_data* data,
+        const void* buffer, size_t length, ZSTD_EndDirective mode) {
+
+    ZSTD_inBuffer in = { buffer, length, 0 };
+    size_t remaining;
+
+    uint64_t start = guac_socket_zstd_cpu_usec();
+
+    do {
+
+        ZSTD_outBuffer out = { data->out_buf + 4, sizeof(data->out_buf) - 4, 0 };
+
+        remaining = ZSTD_compressStream2(data->context, &out, &in, mode);
+        if (ZSTD_isError(remaining)) {
+            guac_error = GUAC_STATUS_INTERNAL_ERROR;
+            guac_error_message = "Compression of outgoing data failed";
+            return 1;
+        }
+
+        /* Write any compressed data as a chunk */
+        if (out.pos > 0 && guac_socket_zstd_write_chunk(data, data->out_buf,
+                    data->out_buf + 4, out.pos, 0))
+            return 1;
+
+    } while (in.pos < in.size || (mode != ZSTD_e_continue && remaining > 0));
+
+    data->stats.compress_usec += guac_socket_zstd_cpu_usec() - start;
+    return 0;
+
+}
+
+/**
+ * Updates the set of streams whose blobs are already compressed based on
+ * the given instruction, returning whether the instruction should be
+ * written without compression.
+ *
+ * @param data
+ *     The data associated with the compressing socket.
+ *
+ * @param instruction
+ *     The instruction being written.
+ *
+ * @return
+ *     Non-zero if the instruction is a blob of an already-compressed stream
+ *     and should be written without compression, zero otherwise.
+ */
+static int guac_socket_zstd_is_raw(guac_socket_zstd_data* data,
+        Guacamole::GuacServerInstruction::Reader instruction) {
+
+    unsigned int index;
+    bool precompressed;
+
+    switch (instruction.which()) {
+
+        /* Images are always compressed */
+        case Guacamole::GuacServerInstruction::IMG:
+            index = instruction.getImg().getStream();
+            precompressed = true;
+            break;
+
+        /* As is video */
+        case Guacamole::GuacServerInstruction::VIDEO:
+            index = instruction.getVideo().getStream();
+            precompressed = true;
+            break;
+
+        /* Audio is compressed unless it is raw PCM ("audio/L8" or
+         * "audio/L16") */
+        case Guacamole::GuacServerInstruction::AUDIO:
+            index = instruction.getAudio().getStream();
+            precompressed = strncmp(instruction.getAudio().getMimetype().cStr(),
+                    "audio/L", 7) != 0;
+            break;
+
+        /* Streams may be reused once ended */
+        case Guacamole::GuacServerInstruction::END:
+            index = instruction.getEnd();
+            precompressed = false;
+            break;
+
+        /* Blobs are written raw only for streams noted above */
+        case Guacamole::GuacServerInstruction::BLOB:
+            index = instruction.getBlob().getStream();
+            return index < GUAC_SOCKET_ZSTD_MAX_STREAM_INDEX
+                && (data->precompressed[index / 8] & (1 << (index % 8)));
+
+        default:
+            return 0;
+
+    }
+
+    /* Note whether the stream's blobs are already compressed */
+    if (index < GUAC_SOCKET_ZSTD_MAX_STREAM_INDEX) {
+        if (precompressed)
+            data->precompressed[index / 8] |= 1 << (index % 8);
+        else
+            data->precompressed[index / 8] &= ~(1 << (index % 8));
+    }
+
+    return 0;
+
+}
+
+/**
+ * Writes the given instruction to the underlying socket, compressing it
+ * unless it contains data which is already compressed.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param message
+ *     The capnp::MessageBuilder containing the instruction to write.
+ *
+ * @return
+ *     Zero on success, or -1 if an error occurs.
+ */
+static ssize_t guac_socket_zstd_write_handler(guac_socket* socket,
+        void* message) {
+
+    guac_socket_zstd_data* data = (guac_socket_zstd_data*) socket->data;
+    capnp::MessageBuilder* builder = static_cast<capnp::MessageBuilder*>(message);
+    auto instruction = builder->getRoot<Guacamole::GuacServerInstruction>();
+
+    int retval;
+
+    /* Acquire exclusive access to compressor */
+    pthread_mutex_lock(&(data->buffer_lock));
+
+    /* Encode instruction */
+    data->packed.clear();
+    capnp::writePackedMessage(data->packed, *builder);
+    auto packed = data->packed.getArray();
+
+    data->stats.bytes_in += packed.size();
+
+    /* Pass already-compressed data through, after any compressed data
+     * which must precede it */
+    if (guac_socket_zstd_is_raw(data, instruction)) {
+        unsigned char header[4];
+        data->stats.bytes_raw += packed.size();
+        retval = guac_socket_zstd_compress(data, NULL, 0, ZSTD_e_flush)
+            || guac_socket_zstd_write_chunk(data, header, packed.begin(),
+                    packed.size(), GUAC_SOCKET_ZSTD_RAW);
+    }
+
+    /* Compress all other instructions, flushing at the end of each frame */
+    else
+        retval = guac_socket_zstd_compress(data, packed.begin(), packed.size(),
+                instruction.isSync() ? ZSTD_e_flush : ZSTD_e_continue);
+
+    /* Relinquish exclusive access to compressor */
+    pthread_mutex_unlock(&(data->buffer_lock));
+
+    return retval ? -1 : 0;
+
+}
+
+/**
+ * Compresses the given raw bytes, as written with guac_socket_write(), in
+ * sequence with any instructions written to the socket.
+ *
+ * @param socket
+ *     The guac_socket being written to.
+ *
+ * @param buf
+ *     The buffer containing the data to write.
+ *
+ * @param count
+ *     The number of bytes to write from the buffer.
+ *
+ * @return
+ *     The number of bytes written, or -1 if an error occurs.
+ */
+static ssize_t guac_socket_zstd_raw_write_handler(guac_socket* socket,
+        const void* buf, size_t count) {
+
+    guac_socket_zstd_data* data = (guac_socket_zstd_data*) socket->data;
+    int retval;
+
+    pthread_mutex_lock(&(data->buffer_lock));
+    data->stats.bytes_in += count;
+    retval = guac_socket_zstd_compress(data, buf, count, ZSTD_e_continue);
+    pthread_mutex_unlock(&(data->buffer_lock));
+
+    return retval ? -1 : (ssize_t) count;
+
+}
+
+/**
+ * Writes all data buffered within the compressor to the underlying socket,
+ * flushing that socket.
+ *
+ * @param socket
+ *     The guac_socket to flush.
+ *
+ * @return
+ *     Zero if the flush operation was successful, non-zero otherwise.
+ */
+static ssize_t guac_socket_zstd_flush_handler(guac_socket* socket) {
+
+    guac_socket_zstd_data* data = (guac_socket_zstd_data*) socket->data;
+    int retval;
+
+    pthread_mutex_lock(&(data->buffer_lock));
+    retval = guac_socket_zstd_compress(data, NULL, 0, ZSTD_e_flush);
+    pthread_mutex_unlock(&(data->buffer_lock));
+
+    if (retval)
+        return 1;
+
+    return guac_socket_flush(data->socket);
+
+}
+
+/**
+ * Reads from the underlying socket. Incoming data is never compressed.
+ *
+ * @param socket
+ *     The guac_socket being read from.
+ *
+ * @param buf
+ *     The buffer to read into.
+ *
+ * @param count
+ *     The maximum number of bytes to read.
+ *
+ * @return
+ *     The number of bytes read, or -1 if an error occurs.
+ */
+static ssize_t guac_socket_zstd_read_handler(guac_socket* socket,
+        void* buf, size_t count) {
+
+    guac_socket_zstd_data* data = (guac_socket_zstd_data*) socket->data;
+    return guac_socket_read(data->socket, buf, count);
+
+}
+
+/**
+ * Waits for data on the underlying socket.
+ *
+ * @param socket
+ *     The guac_socket to wait for.
+ *
+ * @param usec_timeout
+ *     The maximum amount of time to wait for data, in microseconds, or -1 to
+ *     potentially wait forever.
+ *
+ * @return
+ *     A positive value on success, zero if the timeout elapsed and no data is
+ *     available, or a negative value if an error occurs.
+ */
+static int guac_socket_zstd_select_handler(guac_socket* socket,
+        int usec_timeout) {
+
+    guac_socket_zstd_data* data = (guac_socket_zstd_data*) socket->data;
+    return guac_socket_select(data->socket, usec_timeout);
+
+}
+
+/**
+ * Acquires exclusive access to the underlying socket.
+ *
+ * @param socket
+ *     The guac_socket to which exclusive access is required.
+ */
+static void guac_socket_zstd_lock_handler(guac_socket* socket) {
+
+    guac_socket_zstd_data* data = (guac_socket_zstd_data*) socket->data;
+    guac_socket_instruction_begin(data->socket);
+
+}
+
+/**
+ * Relinquishes exclusive access to the underlying socket.
+ *
+ * @param socket
+ *     The guac_socket to which exclusive access is no longer required.
+ */
+static void guac_socket_zstd_unlock_handler(guac_socket* socket) {
+
+    guac_socket_zstd_data* data = (guac_socket_zstd_data*) socket->data;
+    guac_socket_instruction_end(data->socket);
+
+}
+
+/**
+ * Ends the zstd stream and frees all data associated with the given socket.
+ * The underlying socket is not freed.
+ *
+ * @param socket
+ *     The guac_socket whose associated data should be freed.
+ *
+ * @return
+ *     Always zero.
+ */
+static int guac_socket_zstd_free_handler(guac_socket* socket) {
+
+    guac_socket_zstd_data* data = (guac_socket_zstd_data*) socket->data;
+
+    /* Properly end the stream (failures are irrelevant at this point) */
+    if (!guac_socket_zstd_compress(data, NULL, 0, ZSTD_e_end))
+        guac_socket_flush(data->socket);
+
+    ZSTD_freeCCtx(data->context);
+    pthread_mutex_destroy(&(data->buffer_lock));
+
+    delete data;
+    return 0;
+
+}
+
+guac_socket* guac_socket_zstd(guac_socket* socket, int level) {
+
+    ZSTD_CCtx* context = ZSTD_createCCtx();
+    if (context == NULL) {
+        guac_error = GUAC_STATUS_NO_MEMORY;
+        guac_error_message = "Could not allocate compression context";
+        return NULL;
+    }
+
+    ZSTD_CCtx_setParameter(context, ZSTD_c_compressionLevel, level);
+
+    /* Announce compression before anything compressed is written */
+    if (guac_socket_write(socket, GUAC_SOCKET_ZSTD_PREAMBLE,
+                strlen(GUAC_SOCKET_ZSTD_PREAMBLE))) {
+        ZSTD_freeCCtx(context);
+        return NULL;
+    }
+
+    guac_socket* compressed = guac_socket_alloc();
+    if (compressed == NULL) {
+        ZSTD_freeCCtx(context);
+        return NULL;
+    }
+
+    guac_socket_zstd_data* data = new guac_socket_zstd_data();
+    data->socket = socket;
+    data->context = context;
+    data->stats.bytes_out = strlen(GUAC_SOCKET_ZSTD_PREAMBLE);
+    pthread_mutex_init(&(data->buffer_lock), NULL);
+
+    compressed->data = data;
+    compressed->read_handler   = guac_socket_zstd_read_handler;
+    compressed->write_handler  = guac_socket_zstd_write_handler;
+    compressed->raw_write_handler = guac_socket_zstd_raw_write_handler;
+    compressed->select_handler = guac_socket_zstd_select_handler;
+    compressed->lock_handler   = guac_socket_zstd_lock_handler;
+    compressed->unlock_handler = guac_socket_zstd_unlock_handler;
+    compressed->flush_handler  = guac_socket_zstd_flush_handler;
+    compressed->free_handler   = guac_socket_zstd_free_handler;
+
+    return compressed;
+
+}
+
+void guac_socket_zstd_get_stats(guac_socket* socket,
+        guac_socket_zstd_stats* stats) {
+
+    guac_socket_zstd_data* data = (guac_socket_zstd_data*) socket->data;
+
+    pthread_mutex_lock(&(data->buffer_lock));
+    *stats = data->stats;
+    pthread_mutex_unlock(&(data->buffer_lock));
+
+}
+
@@ -22,6 +22,7 @@
 #include "error.h"
 #include "protocol.h"
 #include "socket.h"
+#include "timer.h"
 #include "timestamp.h"
 
 #include <inttypes.h>
@@ -42,30 +43,42 @@ char __guac_socket_BASE64_CHARACTERS[64] = {
     '8', '9', '+', '/'
 };
 
-static void* __guac_socket_keep_alive_thread(void* data) {
+/**
+ * Callback invoked by the timer service for each socket requiring keep-alive.
+ * A "nop" is sent if nothing has been written to the socket for the
+ * keep-alive interval, and the timer is rescheduled for the point at which
+ * the socket will next have been idle for that long.
+ *
+ * @param timer
+ *     The keep-alive timer of the socket.
+ *
+ * @param data
+ *     The guac_socket requiring keep-alive.
+ */
+static void __guac_socket_keep_alive(guac_timer* timer, void* data) {
 
-    /* Socket keep-alive loop */
     guac_socket* socket = (guac_socket*) data;
-    while (socket->state == GUAC_SOCKET_OPEN) {
 
-        /* Send NOP keep-alive if it's been a while since the last output */
-        guac_timestamp timestamp = guac_timestamp_current();
-        if (timestamp - socket->last_write_timestamp >
-                GUAC_SOCKET_KEEP_ALIVE_INTERVAL) {
+    /* Stop once socket is closed */
+    if (socket->state != GUAC_SOCKET_OPEN)
+        return;
 
-            /* Send NOP */
-            if (guac_protocol_send_nop(socket)
-                || guac_socket_flush(socket))
-                break;
+    /* Send NOP keep-alive if it's been a while since the last output */
+    guac_timestamp timestamp = guac_timestamp_current();
+    guac_timestamp idle = timestamp - socket->last_write_timestamp;
+    if (idle >= GUAC_SOCKET_KEEP_ALIVE_INTERVAL) {
 
-        }
+        /* Stop on error */
+        if (guac_protocol_send_nop(socket)
+            || guac_socket_flush(socket))
+            return;
 
-        /* Sleep until next keep-alive check */
-        guac_timestamp_msleep(GUAC_SOCKET_KEEP_ALIVE_INTERVAL);
+        idle = 0;
 
     }
 
-    return NULL;
+    /* Check again once the socket may next require a keep-alive */
+    guac_timer_schedule(timer, GUAC_SOCKET_KEEP_ALIVE_INTERVAL - idle);
 
 }
 
@@ -108,11 +121,12 @@ guac_socket* guac_socket_alloc() {
     socket->last_write_timestamp = guac_timestamp_current();
 
     /* No keep alive ping by default */
-    socket->__keep_alive_enabled = 0;
+    socket->__keep_alive = NULL;
 
     /* No handlers yet */
     socket->read_handler   = NULL;
     socket->write_handler  = NULL;
+    socket->raw_write_handler = NULL;
     socket->select_handler = NULL;
     socket->free_handler   = NULL;
     socket->flush_handler  = NULL;
@@ -125,6 +139,20 @@ guac_socket* guac_socket_alloc() {
 
 void guac_socket_require_keep_alive(guac_socket* socket) {
 
+    /* Keep-alive need only be enabled once */
+    if (socket->__keep_alive != NULL)
+        return;
+
+    socket->__keep_alive = guac_timer_alloc(__guac_socket_keep_alive, socket);
+    if (socket->__keep_alive == NULL)
+        return;
+
+    /* Begin checking periodically for inactivity */
+    if (guac_timer_schedule(socket->__keep_alive,
+                GUAC_SOCKET_KEEP_ALIVE_INTERVAL)) {
+        guac_timer_free(socket->__keep_alive);
+        socket->__keep_alive = NULL;
+    }
 
 }
 
@@ -146,6 +174,10 @@ void guac_socket_instruction_end(guac_socket* socket) {
 
 void guac_socket_free(guac_socket* socket) {
 
+    /* Stop keep-alive (waiting for any in-progress ping) before the socket
+     * is torn down */
+    guac_timer_free(socket->__keep_alive);
+
     guac_socket_flush(socket);
 
     /* Call free handler if defined */
@@ -155,15 +187,40 @@ void guac_socket_free(guac_socket* socket) {
     /* Mark as closed */
     socket->state = GUAC_SOCKET_CLOSED;
 
-    /* Wait for keep-alive, if enabled */
-    if (socket->__keep_alive_enabled)
-        pthread_join(socket->__keep_alive_thread, NULL);
-
     free(socket);
 }
 
+ssize_t guac_socket_write(guac_socket* socket, const void* buf, size_t count) {
+
+    const char* buffer = buf;
+
+    /* If no handler is defined, discard data */
+    if (socket->raw_write_handler == NULL)
+        return 0;
+
+    /* Write until completely written */
+    while (count > 0) {
+
+        /* Attempt to write, return on error */
+        ssize_t written = socket->raw_write_handler(socket, buffer, count);
+        if (written < 0)
+            return 1;
+
+        /* Advance buffer to next chunk */
+        buffer += written;
+        count  -= written;
+
+    }
+
+    return 0;
+
+}
+
 ssize_t guac_socket_flush(guac_socket* socket) {
 
+    /* Data reaches the other side only once flushed */
+    socket->last_write_timestamp = guac_timestamp_current();
+
     /* If handler defined, call it. */
     if (socket->flush_handler)
         return socket->flush_handler(socket);
@@ -0,0 +1,113 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "table.h"
+
+#include <stdlib.h>
+
+guac_table* guac_table_alloc(size_t element_size, int chunk_size,
+        int max_size, guac_table_init_handler* init_handler) {
+
+    guac_table* table = malloc(sizeof(guac_table));
+    if (table == NULL)
+        return NULL;
+
+    /* Allocate array of chunk pointers, with no chunks yet allocated */
+    int num_chunks = (max_size + chunk_size - 1) / chunk_size;
+    table->__chunks = calloc(num_chunks, sizeof(void*));
+    if (table->__chunks == NULL) {
+        free(table);
+        return NULL;
+    }
+
+    table->element_size = element_size;
+    table->chunk_size = chunk_size;
+    table->max_size = max_size;
+    table->init_handler = init_handler;
+
+    return table;
+
+}
+
+void guac_table_free(guac_table* table) {
+
+    int i;
+    int num_chunks = (table->max_size + table->chunk_size - 1)
+        / table->chunk_size;
+
+    /* Free all allocated chunks */
+    for (i = 0; i < num_chunks; i++)
+        free(table->__chunks[i]);
+
+    free(table->__chunks);
+    free(table);
+
+}
+
+void* guac_table_get(guac_table* table, int index) {
+
+    /* Validate index */
+    if (index < 0 || index >= table->max_size)
+        return NULL;
+
+    char* chunk = __atomic_load_n(&(table->__chunks[index / table->chunk_size]),
+            __ATOMIC_ACQUIRE);
+
+    /* Element does not exist if its chunk has not been allocated */
+    if (chunk == NULL)
+        return NULL;
+
+    return chunk + (index % table->chunk_size) * table->element_size;
+
+}
+
+void* guac_table_acquire(guac_table* table, int index) {
+
+    /* Use existing element if possible */
+    void* element = guac_table_get(table, index);
+    if (element != NULL || index < 0 || index >= table->max_size)
+        return element;
+
+    int i;
+    void** slot = &(table->__chunks[index / table->chunk_size]);
+
+    /* Allocate and initialize new chunk */
+    char* chunk = calloc(table->chunk_size, table->element_size);
+    if (chunk == NULL)
+        return NULL;
+
+    if (table->init_handler != NULL) {
+        for (i = 0; i < table->chunk_size; i++)
+            table->init_handler(chunk + i * table->element_size);
+    }
+
+    /* Publish new chunk, deferring to any chunk published concurrently */
+    void* existing = NULL;
+    if (!__atomic_compare_exchange_n(slot, &existing, (void*) chunk, 0,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(chunk);
+        chunk = existing;
+    }
+
+    return chunk + (index % table->chunk_size) * table->element_size;
+
+}
+
@@ -0,0 +1,455 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "timer.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+/**
+ * The mask which, when applied to a tick value shifted for a particular level
+ * of the timer wheel, produces the index of the corresponding slot.
+ */
+#define GUAC_TIMER_WHEEL_MASK (GUAC_TIMER_WHEEL_SIZE - 1)
+
+/**
+ * Lock guarding all state of the timer service, including the contents of
+ * every pending timer.
+ */
+static pthread_mutex_t __guac_timer_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Condition signalled whenever the timer service thread may need to wake
+ * earlier than planned (a timer has been scheduled) or whenever a timer
+ * callback has finished running.
+ */
+static pthread_cond_t __guac_timer_cond;
+
+/**
+ * The timer service thread.
+ */
+static pthread_t __guac_timer_thread;
+
+/**
+ * Whether the timer service thread has been started.
+ */
+static int __guac_timer_started = 0;
+
+/**
+ * The time at which the timer service was started, in milliseconds, as
+ * returned by __guac_timer_now(). All ticks are relative to this time.
+ */
+static uint64_t __guac_timer_base;
+
+/**
+ * The next tick of the timer wheel which has not yet been processed.
+ */
+static uint64_t __guac_timer_tick;
+
+/**
+ * The number of timers currently pending.
+ */
+static int __guac_timer_pending = 0;
+
+/**
+ * All slots of all levels of the timer wheel, each slot being a linked list
+ * of pending timers.
+ */
+static guac_timer* __guac_timer_wheel[GUAC_TIMER_WHEEL_LEVELS][GUAC_TIMER_WHEEL_SIZE];
+
+/**
+ * Returns the current value of the monotonic clock used by the timer
+ * service, in milliseconds.
+ *
+ * @return
+ *     The current time, in milliseconds.
+ */
+static uint64_t __guac_timer_now() {
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+}
+
+/**
+ * Returns the current tick of the timer service. The timer service lock must
+ * be held and the timer service must have been started.
+ *
+ * @return
+ *     The current tick.
+ */
+static uint64_t __guac_timer_current_tick() {
+    return (__guac_timer_now() - __guac_timer_base) / GUAC_TIMER_RESOLUTION;
+}
+
+/**
+ * Inserts the given timer into the slot of the timer wheel appropriate for
+ * its expiration tick. Timers which have already expired are placed in the
+ * next slot to be processed. The timer service lock must be held.
+ *
+ * @param timer
+ *     The timer to insert, which must not currently be pending.
+ */
+static void __guac_timer_insert(guac_timer* timer) {
+
+    uint64_t expires = timer->__expires;
+    int level;
+
+    if (expires < __guac_timer_tick)
+        expires = __guac_timer_tick;
+
+    /* Find the lowest level covering the remaining delay */
+    uint64_t delta = expires - __guac_timer_tick;
+    for (level = 0; level < GUAC_TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < ((uint64_t) 1 << ((level + 1) * GUAC_TIMER_WHEEL_BITS)))
+            break;
+    }
+
+    /* Park timers beyond the range of the wheel in the furthest slot of the
+     * highest level, to be reinserted when that slot is cascaded */
+    uint64_t max = ((uint64_t) 1 << (GUAC_TIMER_WHEEL_LEVELS
+                * GUAC_TIMER_WHEEL_BITS)) - 1;
+    if (delta > max)
+        expires = __guac_timer_tick + max;
+
+    int slot = (expires >> (level * GUAC_TIMER_WHEEL_BITS))
+        & GUAC_TIMER_WHEEL_MASK;
+
+    /* Link at head of slot */
+    guac_timer** head = &__guac_timer_wheel[level][slot];
+    timer->__next = *head;
+    timer->__pprev = head;
+    if (*head != NULL)
+        (*head)->__pprev = &timer->__next;
+    *head = timer;
+
+}
+
+/**
+ * Removes the given timer from the timer wheel. The timer service lock must
+ * be held, and the timer must currently be pending.
+ *
+ * @param timer
+ *     The timer to remove.
+ */
+static void __guac_timer_remove(guac_timer* timer) {
+
+    *timer->__pprev = timer->__next;
+    if (timer->__next != NULL)
+        timer->__next->__pprev = timer->__pprev;
+
+    timer->__next = NULL;
+    timer->__pprev = NULL;
+
+}
+
+/**
+ * Removes and returns all timers within the given slot of the timer wheel.
+ * The timer service lock must be held. The __pprev member of the first timer
+ * in the returned list still refers to the slot, and must be updated by the
+ * caller if timers will be removed individually from the list.
+ *
+ * @param level
+ *     The level of the timer wheel containing the slot.
+ *
+ * @param slot
+ *     The index of the slot within the given level.
+ *
+ * @return
+ *     A linked list of all timers which were in the slot, or NULL if the
+ *     slot was empty.
+ */
+static guac_timer* __guac_timer_take_slot(int level, int slot) {
+
+    guac_timer* list = __guac_timer_wheel[level][slot];
+    __guac_timer_wheel[level][slot] = NULL;
+
+    return list;
+
+}
+
+/**
+ * Processes the next tick of the timer wheel, cascading timers from higher
+ * levels as lower levels wrap and firing all timers which have expired. The
+ * timer service lock must be held. The lock is released while each timer
+ * callback runs.
+ */
+static void __guac_timer_process_tick() {
+
+    uint64_t tick = __guac_timer_tick;
+    int level;
+
+    /* Cascade higher levels each time the level below wraps */
+    for (level = 1; level < GUAC_TIMER_WHEEL_LEVELS; level++) {
+
+        if (((tick >> ((level - 1) * GUAC_TIMER_WHEEL_BITS))
+                    & GUAC_TIMER_WHEEL_MASK) != 0)
+            break;
+
+        int slot = (tick >> (level * GUAC_TIMER_WHEEL_BITS))
+            & GUAC_TIMER_WHEEL_MASK;
+
+        guac_timer* current = __guac_timer_take_slot(level, slot);
+        while (current != NULL) {
+            guac_timer* next = current->__next;
+            __guac_timer_insert(current);
+            current = next;
+        }
+
+    }
+
+    /* Fire all timers in current slot, one at a time (the list is detached
+     * from the wheel, but callbacks may cancel or reschedule any timer) */
+    guac_timer* expired = __guac_timer_take_slot(0,
+            tick & GUAC_TIMER_WHEEL_MASK);
+
+    if (expired != NULL)
+        expired->__pprev = &expired;
+
+    /* Advance before firing, such that timers scheduled by callbacks are
+     * positioned relative to the ticks which remain */
+    __guac_timer_tick = tick + 1;
+
+    while (expired != NULL) {
+
+        guac_timer* timer = expired;
+        __guac_timer_remove(timer);
+
+        /* Timers parked beyond the range of the wheel may not yet be due */
+        if (timer->__expires > tick) {
+            __guac_timer_insert(timer);
+            continue;
+        }
+
+        /* Invoke callback without holding the lock */
+        __guac_timer_pending--;
+        timer->__running = 1;
+        pthread_mutex_unlock(&__guac_timer_lock);
+
+        timer->callback(timer, timer->data);
+
+        pthread_mutex_lock(&__guac_timer_lock);
+        timer->__running = 0;
+        pthread_cond_broadcast(&__guac_timer_cond);
+
+    }
+
+}
+
+/**
+ * Returns the next tick at which the timer service thread must wake: either
+ * the next tick having a non-empty slot within the lowest level of the timer
+ * wheel, or the next tick at which the lowest level wraps and higher levels
+ * must be cascaded, whichever is sooner. The timer service lock must be
+ * held.
+ *
+ * @return
+ *     The next tick requiring processing.
+ */
+static uint64_t __guac_timer_next_tick() {
+
+    uint64_t tick = __guac_timer_tick;
+
+    do {
+
+        if (__guac_timer_wheel[0][tick & GUAC_TIMER_WHEEL_MASK] != NULL)
+            return tick;
+
+        tick++;
+
+    } while ((tick & GUAC_TIMER_WHEEL_MASK) != 0);
+
+    return tick;
+
+}
+
+/**
+ * The main function of the timer service thread. Pending timers are fired
+ * as they expire. While no timers are pending, this thread sleeps until a
+ * timer is scheduled.
+ *
+ * @param data
+ *     Ignored.
+ *
+ * @return
+ *     Never returns.
+ */
+static void* __guac_timer_thread_main(void* data) {
+
+    pthread_mutex_lock(&__guac_timer_lock);
+
+    for (;;) {
+
+        /* Sleep indefinitely while idle */
+        if (__guac_timer_pending == 0) {
+            pthread_cond_wait(&__guac_timer_cond, &__guac_timer_lock);
+            continue;
+        }
+
+        /* Process all ticks which have elapsed, skipping directly past any
+         * sequence of empty slots */
+        uint64_t current = __guac_timer_current_tick();
+        uint64_t next = __guac_timer_next_tick();
+        if (next <= current) {
+            __guac_timer_tick = next;
+            __guac_timer_process_tick();
+            continue;
+        }
+
+        /* Otherwise, wait until the next tick requiring processing (or until
+         * a timer is scheduled, which may require waking sooner) */
+        uint64_t wake = __guac_timer_base + next * GUAC_TIMER_RESOLUTION;
+        struct timespec deadline = {
+            .tv_sec  = wake / 1000,
+            .tv_nsec = (wake % 1000) * 1000000
+        };
+
+        pthread_cond_timedwait(&__guac_timer_cond, &__guac_timer_lock,
+                &deadline);
+
+    }
+
+    return NULL;
+
+}
+
+/**
+ * Starts the timer service thread if not already started. The timer service
+ * lock must be held.
+ *
+ * @return
+ *     Zero if the timer service is running, non-zero if it could not be
+ *     started.
+ */
+static int __guac_timer_start() {
+
+    if (__guac_timer_started)
+        return 0;
+
+    /* Timeouts are measured against the monotonic clock */
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&__guac_timer_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    __guac_timer_base = __guac_timer_now();
+    __guac_timer_tick = 0;
+
+    if (pthread_create(&__guac_timer_thread, NULL,
+                __guac_timer_thread_main, NULL)) {
+        pthread_cond_destroy(&__guac_timer_cond);
+        return 1;
+    }
+
+    pthread_detach(__guac_timer_thread);
+    __guac_timer_started = 1;
+    return 0;
+
+}
+
+guac_timer* guac_timer_alloc(guac_timer_callback* callback, void* data) {
+
+    guac_timer* timer = malloc(sizeof(guac_timer));
+    if (timer == NULL)
+        return NULL;
+
+    timer->callback = callback;
+    timer->data = data;
+    timer->__expires = 0;
+    timer->__next = NULL;
+    timer->__pprev = NULL;
+    timer->__running = 0;
+
+    return timer;
+
+}
+
+int guac_timer_schedule(guac_timer* timer, int delay) {
+
+    pthread_mutex_lock(&__guac_timer_lock);
+
+    if (__guac_timer_start()) {
+        pthread_mutex_unlock(&__guac_timer_lock);
+        return 1;
+    }
+
+    /* Remove from wheel if already pending */
+    if (timer->__pprev != NULL)
+        __guac_timer_remove(timer);
+
+    /* If the wheel is empty, the service thread may have been idle for some
+     * time; resynchronize rather than turning through every elapsed tick */
+    else if (__guac_timer_pending++ == 0)
+        __guac_timer_tick = __guac_timer_current_tick();
+
+    /* Round up such that the timer never fires early */
+    timer->__expires = __guac_timer_current_tick()
+        + (delay + GUAC_TIMER_RESOLUTION - 1) / GUAC_TIMER_RESOLUTION + 1;
+
+    __guac_timer_insert(timer);
+
+    /* Wake service thread, as it may need to wake sooner than planned */
+    pthread_cond_broadcast(&__guac_timer_cond);
+    pthread_mutex_unlock(&__guac_timer_lock);
+
+    return 0;
+
+}
+
+void guac_timer_cancel(guac_timer* timer) {
+
+    pthread_mutex_lock(&__guac_timer_lock);
+
+    /* Remove from wheel if pending */
+    if (timer->__pprev != NULL) {
+        __guac_timer_remove(timer);
+        __guac_timer_pending--;
+    }
+
+    /* Wait for callback to finish, unless called from that callback */
+    if (__guac_timer_started
+            && !pthread_equal(pthread_self(), __guac_timer_thread)) {
+        while (timer->__running)
+            pthread_cond_wait(&__guac_timer_cond, &__guac_timer_lock);
+    }
+
+    pthread_mutex_unlock(&__guac_timer_lock);
+
+}
+
+void guac_timer_free(guac_timer* timer) {
+
+    /* Do nothing if no timer provided */
+    if (timer == NULL)
+        return;
+
+    guac_timer_cancel(timer);
+    free(timer);
+
+}
+
@@ -23,6 +23,7 @@
 #include "object.h"
 #include "protocol.h"
 #include "stream.h"
+#include "table.h"
 #include "timestamp.h"
 #include "user.h"
 #include "user-handlers.h"
@@ -168,8 +169,10 @@ int __guac_handle_key(guac_user* user, Guacamole::GuacClientInstruction::Reader
  */
 static guac_stream* __get_input_stream(guac_user* user, int stream_index) {
 
-    /* Validate stream index */
-    if (stream_index < 0 || stream_index >= GUAC_USER_MAX_STREAMS) {
+    /* Validate stream index, allocating storage for stream as needed */
+    guac_stream* stream = static_cast<guac_stream*>(
+            guac_table_acquire(user->__input_streams, stream_index));
+    if (stream == NULL) {
 
         guac_stream dummy_stream;
         dummy_stream.index = stream_index;
@@ -179,7 +182,7 @@ static guac_stream* __get_input_stream(guac_user* user, int stream_index) {
         return NULL;
     }
 
-    return &(user->__input_streams[stream_index]);
+    return stream;
 
 }
 
@@ -392,12 +395,12 @@ int __guac_handle_ack(guac_user* user, Guacamole::GuacClientInstruction::Reader
     /* Determine index within user-level array of streams */
     stream_index /= 2;
 
-    /* Validate stream index */
-    if (stream_index < 0 || stream_index >= GUAC_USER_MAX_STREAMS)
+    /* Validate stream index (streams never allocated cannot be acked) */
+    stream = static_cast<guac_stream*>(
+            guac_table_get(user->__output_streams, stream_index));
+    if (stream == NULL)
         return 0;
 
-    stream = &(user->__output_streams[stream_index]);
-
     /* Validate initialization of stream */
     if (stream->index == GUAC_USER_CLOSED_STREAM_INDEX)
         return 0;
@@ -474,11 +477,11 @@ int __guac_handle_get(guac_user* user, Guacamole::GuacClientInstruction::Reader
 
     /* Validate object index */
     int object_index = get.getObject();
-    if (object_index < 0 || object_index >= GUAC_USER_MAX_OBJECTS)
+    object = static_cast<guac_object*>(
+            guac_table_get(user->__objects, object_index));
+    if (object == NULL)
         return 0;
 
-    object = &(user->__objects[object_index]);
-
     /* Validate initialization of object */
     if (object->index == GUAC_USER_UNDEFINED_OBJECT_INDEX)
         return 0;
@@ -509,11 +512,11 @@ int __guac_handle_put(guac_user* user, Guacamole::GuacClientInstruction::Reader
 
     /* Validate object index */
     int object_index = put.getObject();
-    if (object_index < 0 || object_index >= GUAC_USER_MAX_OBJECTS)
+    object = static_cast<guac_object*>(
+            guac_table_get(user->__objects, object_index));
+    if (object == NULL)
         return 0;
 
-    object = &(user->__objects[object_index]);
-
     /* Validate initialization of object */
     if (object->index == GUAC_USER_UNDEFINED_OBJECT_INDEX)
         return 0;
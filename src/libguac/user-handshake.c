@@ -26,6 +26,11 @@
 #include "socket.h"
 #include "user.h"
 
+#ifdef ENABLE_ZSTD
+#include "socket-zstd.h"
+#endif
+
+#include <inttypes.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
@@ -171,6 +176,37 @@ static void guac_free_mimetypes(char** mimetypes) {
 
 }
 
+#ifdef ENABLE_ZSTD
+/**
+ * Returns whether the outgoing stream should be compressed, given the
+ * arguments of the "compress" instruction received during the handshake.
+ * Each argument is the name of a compressed transport supported by the
+ * client.
+ *
+ * @param argc
+ *     The number of arguments of the "compress" instruction.
+ *
+ * @param argv
+ *     The arguments of the "compress" instruction.
+ *
+ * @return
+ *     Non-zero if the outgoing stream should be compressed, zero otherwise.
+ */
+static int guac_user_select_compression(int argc, char** argv) {
+
+    int i;
+
+    /* zstd is the only compressed transport currently supported */
+    for (i = 0; i < argc; i++) {
+        if (strcmp(argv[i], GUAC_SOCKET_ZSTD_FORMAT) == 0)
+            return 1;
+    }
+
+    return 0;
+
+}
+#endif
+
 /**
  * The thread which handles all user input, calling event handlers for received
  * instructions.
@@ -385,22 +421,75 @@ int guac_user_handle_connection(guac_user* user, int usec_timeout) {
     char** image_mimetypes = guac_copy_mimetypes(parser->argv, parser->argc);
     user->info.image_mimetypes = (const char**) image_mimetypes;
 
-    /* Get args from connect instruction */
-    if (guac_parser_expect(parser, socket, usec_timeout, "connect")) {
+#ifdef ENABLE_ZSTD
+    int compress = 0;
+#endif
 
-        /* Log error */
-        guac_user_log_handshake_failure(user);
-        guac_user_log_guac_error(user, GUAC_LOG_DEBUG,
-                "Error reading \"connect\"");
+    /* Handle any optional instructions preceding "connect" */
+    for (;;) {
+
+        /* Get args from connect instruction */
+        if (guac_parser_read(parser, socket, usec_timeout)) {
+
+            /* Log error */
+            guac_user_log_handshake_failure(user);
+            guac_user_log_guac_error(user, GUAC_LOG_DEBUG,
+                    "Error reading \"connect\"");
+
+            guac_parser_free(parser);
+            return 1;
+        }
+
+        if (strcmp(parser->opcode, "connect") == 0)
+            break;
+
+        /* Note whether the client can accept a compressed stream (ignored
+         * if compression is not supported) */
+        if (strcmp(parser->opcode, "compress") == 0) {
+#ifdef ENABLE_ZSTD
+            compress = guac_user_select_compression(parser->argc,
+                    parser->argv);
+#endif
+        }
+
+        /* No other instructions are allowed */
+        else {
+
+            guac_error = GUAC_STATUS_PROTOCOL_ERROR;
+            guac_error_message = "Instruction read did not have expected "
+                                 "opcode";
+
+            /* Log error */
+            guac_user_log_handshake_failure(user);
+            guac_user_log_guac_error(user, GUAC_LOG_DEBUG,
+                    "Error reading \"connect\"");
+
+            guac_parser_free(parser);
+            return 1;
+        }
 
-        guac_parser_free(parser);
-        return 1;
     }
 
     /* Acknowledge connection availability */
     guac_protocol_send_ready(socket, client->connection_id);
     guac_socket_flush(socket);
 
+#ifdef ENABLE_ZSTD
+    /* Compress everything following "ready", if negotiated */
+    guac_socket* compressed = NULL;
+    if (compress) {
+
+        compressed = guac_socket_zstd(socket, GUAC_SOCKET_ZSTD_LEVEL);
+        if (compressed != NULL)
+            user->socket = compressed;
+
+        else
+            guac_user_log_guac_error(user, GUAC_LOG_WARNING,
+                    "Outgoing stream will not be compressed");
+
+    }
+#endif
+
     /* Attempt join */
     if (guac_client_add_user(client, user, parser->argc, parser->argv))
         guac_client_log(client, GUAC_LOG_ERROR, "User \"%s\" could NOT "
@@ -423,6 +512,25 @@ int guac_user_handle_connection(guac_user* user, int usec_timeout) {
 
     }
 
+#ifdef ENABLE_ZSTD
+    /* Report effectiveness of compression, restoring original socket */
+    if (compressed != NULL) {
+
+        guac_socket_zstd_stats stats;
+        guac_socket_zstd_get_stats(compressed, &stats);
+
+        guac_user_log(user, GUAC_LOG_DEBUG, "Outgoing stream compressed "
+                "from %" PRIu64 " to %" PRIu64 " bytes (%" PRIu64 " bytes "
+                "passed through uncompressed) using %" PRIu64 " ms of CPU "
+                "time.", stats.bytes_in, stats.bytes_out, stats.bytes_raw,
+                stats.compress_usec / 1000);
+
+        user->socket = socket;
+        guac_socket_free(compressed);
+
+    }
+#endif
+
     /* Free mimetype lists */
     guac_free_mimetypes(audio_mimetypes);
     guac_free_mimetypes(video_mimetypes);
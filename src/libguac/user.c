@@ -28,6 +28,7 @@
 #include "protocol.h"
 #include "socket.h"
 #include "stream.h"
+#include "table.h"
 #include "timestamp.h"
 #include "user.h"
 
@@ -36,10 +37,31 @@
 #include <stdlib.h>
 #include <string.h>
 
+/**
+ * Initializes the given newly-allocated user-level stream as closed. The
+ * signature of this function is dictated by guac_table_init_handler.
+ *
+ * @param element
+ *     The guac_stream to initialize.
+ */
+static void guac_user_init_stream(void* element) {
+    ((guac_stream*) element)->index = GUAC_USER_CLOSED_STREAM_INDEX;
+}
+
+/**
+ * Initializes the given newly-allocated object as undefined. The signature of
+ * this function is dictated by guac_table_init_handler.
+ *
+ * @param element
+ *     The guac_object to initialize.
+ */
+static void guac_user_init_object(void* element) {
+    ((guac_object*) element)->index = GUAC_USER_UNDEFINED_OBJECT_INDEX;
+}
+
 guac_user* guac_user_alloc() {
 
     guac_user* user = calloc(1, sizeof(guac_user));
-    int i;
 
     user->last_received_timestamp = guac_timestamp_current();
     user->last_frame_duration = 0;
@@ -49,22 +71,21 @@ guac_user* guac_user_alloc() {
     /* Allocate stream pool */
     user->__stream_pool = guac_pool_alloc(0);
 
-    /* Initialze streams */
-    user->__input_streams = malloc(sizeof(guac_stream) * GUAC_USER_MAX_STREAMS);
-    user->__output_streams = malloc(sizeof(guac_stream) * GUAC_USER_MAX_STREAMS);
-
-    for (i=0; i<GUAC_USER_MAX_STREAMS; i++) {
-        user->__input_streams[i].index = GUAC_USER_CLOSED_STREAM_INDEX;
-        user->__output_streams[i].index = GUAC_USER_CLOSED_STREAM_INDEX;
-    }
+    /* Initialze streams (storage is allocated as streams are used) */
+    user->__input_streams = guac_table_alloc(sizeof(guac_stream),
+            GUAC_USER_STREAM_CHUNK_SIZE, GUAC_USER_MAX_STREAMS,
+            guac_user_init_stream);
+    user->__output_streams = guac_table_alloc(sizeof(guac_stream),
+            GUAC_USER_STREAM_CHUNK_SIZE, GUAC_USER_MAX_STREAMS,
+            guac_user_init_stream);
 
     /* Allocate object pool */
     user->__object_pool = guac_pool_alloc(0);
 
-    /* Initialize objects */
-    user->__objects = malloc(sizeof(guac_object) * GUAC_USER_MAX_OBJECTS);
-    for (i=0; i<GUAC_USER_MAX_OBJECTS; i++)
-        user->__objects[i].index = GUAC_USER_UNDEFINED_OBJECT_INDEX;
+    /* Initialize objects (storage is allocated as objects are used) */
+    user->__objects = guac_table_alloc(sizeof(guac_object),
+            GUAC_USER_OBJECT_CHUNK_SIZE, GUAC_USER_MAX_OBJECTS,
+            guac_user_init_object);
 
     return user;
 
@@ -73,14 +94,14 @@ guac_user* guac_user_alloc() {
 void guac_user_free(guac_user* user) {
 
     /* Free streams */
-    free(user->__input_streams);
-    free(user->__output_streams);
+    guac_table_free(user->__input_streams);
+    guac_table_free(user->__output_streams);
 
     /* Free stream pool */
     guac_pool_free(user->__stream_pool);
 
     /* Free objects */
-    free(user->__objects);
+    guac_table_free(user->__objects);
 
     /* Free object pool */
     guac_pool_free(user->__object_pool);
@@ -97,14 +118,23 @@ guac_stream* guac_user_alloc_stream(guac_user* user) {
     int stream_index;
 
     /* Refuse to allocate beyond maximum */
-    if (user->__stream_pool->active == GUAC_USER_MAX_STREAMS)
+    if (__atomic_load_n(&(user->__stream_pool->active), __ATOMIC_RELAXED)
+            >= GUAC_USER_MAX_STREAMS)
         return NULL;
 
     /* Allocate stream */
     stream_index = guac_pool_next_int(user->__stream_pool);
+    if (stream_index < 0)
+        return NULL;
+
+    /* Allocate storage for stream if not yet allocated */
+    allocd_stream = guac_table_acquire(user->__output_streams, stream_index);
+    if (allocd_stream == NULL) {
+        guac_pool_free_int(user->__stream_pool, stream_index);
+        return NULL;
+    }
 
     /* Initialize stream with even index (odd indices are client-level) */
-    allocd_stream = &(user->__output_streams[stream_index]);
     allocd_stream->index = stream_index * 2;
     allocd_stream->data = NULL;
     allocd_stream->ack_handler = NULL;
@@ -131,14 +161,23 @@ guac_object* guac_user_alloc_object(guac_user* user) {
     int object_index;
 
     /* Refuse to allocate beyond maximum */
-    if (user->__object_pool->active == GUAC_USER_MAX_OBJECTS)
+    if (__atomic_load_n(&(user->__object_pool->active), __ATOMIC_RELAXED)
+            >= GUAC_USER_MAX_OBJECTS)
         return NULL;
 
     /* Allocate object */
     object_index = guac_pool_next_int(user->__object_pool);
+    if (object_index < 0)
+        return NULL;
+
+    /* Allocate storage for object if not yet allocated */
+    allocd_object = guac_table_acquire(user->__objects, object_index);
+    if (allocd_object == NULL) {
+        guac_pool_free_int(user->__object_pool, object_index);
+        return NULL;
+    }
 
     /* Initialize object */
-    allocd_object = &(user->__objects[object_index]);
     allocd_object->index = object_index;
     allocd_object->data = NULL;
     allocd_object->get_handler = NULL;
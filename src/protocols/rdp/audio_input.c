@@ -30,9 +30,10 @@
 #include <guacamole/stream.h>
 #include <guacamole/user.h>
 
-#include <assert.h>
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 
 /**
@@ -199,6 +200,115 @@ guac_rdp_audio_buffer* guac_rdp_audio_buffer_alloc() {
     return buffer;
 }
 
+/**
+ * Returns the greatest common divisor of the two given positive integers.
+ *
+ * @param a
+ *     The first integer.
+ *
+ * @param b
+ *     The second integer.
+ *
+ * @return
+ *     The greatest common divisor of a and b.
+ */
+static int guac_rdp_audio_gcd(int a, int b) {
+
+    while (b != 0) {
+        int remainder = a % b;
+        a = b;
+        b = remainder;
+    }
+
+    return a;
+
+}
+
+/**
+ * Precomputes the resampling steps for the input and output formats of the
+ * given audio buffer, as well as the number of taps of the low-pass filter
+ * applied prior to downsampling. As the input and output rates are integers,
+ * the position of each output frame relative to the input frames repeats
+ * every (output rate / gcd) output frames, and thus only a single period of
+ * steps need be calculated.
+ *
+ * @param audio_buffer
+ *     The audio buffer whose resampling steps should be calculated.
+ *
+ * @return
+ *     Zero if the steps were calculated successfully, non-zero if the input
+ *     or output formats are invalid or memory could not be allocated.
+ */
+static int guac_rdp_audio_buffer_init_steps(
+        guac_rdp_audio_buffer* audio_buffer) {
+
+    int in_rate = audio_buffer->in_format.rate;
+    int out_rate = audio_buffer->out_format.rate;
+
+    if (in_rate <= 0 || out_rate <= 0)
+        return 1;
+
+    int gcd = guac_rdp_audio_gcd(in_rate, out_rate);
+    int period_length = out_rate / gcd;
+    int period_frames = in_rate / gcd;
+
+    guac_rdp_audio_step* steps = malloc(sizeof(guac_rdp_audio_step)
+            * period_length);
+    if (steps == NULL)
+        return 1;
+
+    /* Map each output frame within the period to its exact position within
+     * the input frames, split into a whole frame offset and a fixed-point
+     * fraction */
+    for (int i = 0; i < period_length; i++) {
+        int64_t position = (int64_t) i * period_frames;
+        steps[i].offset = position / period_length;
+        steps[i].weight = ((position % period_length)
+                << GUAC_RDP_AUDIO_STEP_PRECISION) / period_length;
+    }
+
+    /* Average enough input frames to attenuate content above the output
+     * Nyquist frequency when downsampling */
+    int taps = (in_rate + out_rate - 1) / out_rate;
+    if (taps > GUAC_RDP_AUDIO_MAX_FILTER_TAPS)
+        taps = GUAC_RDP_AUDIO_MAX_FILTER_TAPS;
+
+    audio_buffer->steps = steps;
+    audio_buffer->period_length = period_length;
+    audio_buffer->period_frames = period_frames;
+    audio_buffer->filter_taps = taps;
+
+    return 0;
+
+}
+
+/**
+ * Resets the resampling state of the given audio buffer, discarding any
+ * buffered input and any precomputed resampling steps. This function must be
+ * invoked whenever the input or output formats change, or when a new audio
+ * stream begins. The audio buffer lock must be held.
+ *
+ * @param audio_buffer
+ *     The audio buffer whose resampling state should be reset.
+ */
+static void guac_rdp_audio_buffer_reset(guac_rdp_audio_buffer* audio_buffer) {
+
+    free(audio_buffer->steps);
+    audio_buffer->steps = NULL;
+
+    audio_buffer->partial_length = 0;
+    audio_buffer->frames_length = 0;
+    audio_buffer->current_step = 0;
+    audio_buffer->period_offset = 0;
+
+    audio_buffer->filter_index = 0;
+    audio_buffer->filter_sum[0] = 0;
+    audio_buffer->filter_sum[1] = 0;
+    memset(audio_buffer->filter_history, 0,
+            sizeof(audio_buffer->filter_history));
+
+}
+
 /**
  * Sends an "ack" instruction over the socket associated with the Guacamole
  * stream over which audio data is being received. The "ack" instruction will
@@ -249,6 +359,9 @@ void guac_rdp_audio_buffer_set_stream(guac_rdp_audio_buffer* audio_buffer,
     audio_buffer->in_format.channels = channels;
     audio_buffer->in_format.bps = bps;
 
+    /* Any buffered audio is in the previous format */
+    guac_rdp_audio_buffer_reset(audio_buffer);
+
     /* Acknowledge stream creation (if buffer is ready to receive) */
     guac_rdp_audio_buffer_ack(audio_buffer,
             "OK", GUAC_PROTOCOL_STATUS_SUCCESS);
@@ -273,6 +386,9 @@ void guac_rdp_audio_buffer_set_output(guac_rdp_audio_buffer* audio_buffer,
     audio_buffer->out_format.channels = channels;
     audio_buffer->out_format.bps = bps;
 
+    /* Any buffered audio is in the previous format */
+    guac_rdp_audio_buffer_reset(audio_buffer);
+
     pthread_mutex_unlock(&(audio_buffer->lock));
 
 }
@@ -287,6 +403,7 @@ void guac_rdp_audio_buffer_begin(guac_rdp_audio_buffer* audio_buffer,
     audio_buffer->bytes_written = 0;
     audio_buffer->flush_handler = flush_handler;
     audio_buffer->data = data;
+    guac_rdp_audio_buffer_reset(audio_buffer);
 
     /* Calculate size of each packet in bytes */
     audio_buffer->packet_size = packet_frames
@@ -306,128 +423,177 @@ void guac_rdp_audio_buffer_begin(guac_rdp_audio_buffer* audio_buffer,
 }
 
 /**
- * Reads a single sample from the given buffer of data, using the input
- * format defined within the given audio buffer. Each read sample is
- * translated to a signed 16-bit value, even if the input format is 8-bit.
- * The offset into the given buffer will be determined according to the
- * input and output formats, the number of bytes sent thus far, and the
- * number of bytes received (excluding the contents of the buffer).
+ * Converts the given block of complete input frames to signed 16-bit samples
+ * having the number of channels of the output format, appending the result to
+ * the frames buffer of the given audio buffer. If the input is being
+ * downsampled, the converted frames are additionally low-pass filtered.
  *
  * @param audio_buffer
- *     The audio buffer dictating the format of the given data buffer, as
- *     well as the offset from which the sample should be read.
- *
- * @param buffer
- *     The buffer of raw PCM audio data from which the sample should be read.
- *     This buffer MUST NOT contain data already taken into account by the
- *     audio buffer's total_bytes_received counter.
+ *     The audio buffer dictating the input and output formats, and to which
+ *     the converted frames should be appended.
  *
- * @param length
- *     The number of bytes within the given buffer of PCM data.
+ * @param data
+ *     The raw PCM audio data to convert, in the input format.
  *
- * @param sample
- *     A pointer to the int16_t in which the read sample should be stored. If
- *     the input format is 8-bit, the sample will be shifted left by 8 bits
- *     to produce a 16-bit sample.
+ * @param count
+ *     The number of complete input frames within the given data.
  *
  * @return
- *     Non-zero if a sample was successfully read, zero if no data remains
- *     within the given buffer that has not already been mapped to an
- *     output sample.
+ *     Zero on success, non-zero if the frames buffer could not be grown to
+ *     accommodate the converted frames.
  */
-static int guac_rdp_audio_buffer_read_sample(
-        guac_rdp_audio_buffer* audio_buffer, const char* buffer, int length,
-        int16_t* sample) {
+static int guac_rdp_audio_buffer_convert(guac_rdp_audio_buffer* audio_buffer,
+        const char* data, int count) {
 
     int in_bps = audio_buffer->in_format.bps;
-    int in_rate = audio_buffer->in_format.rate;
     int in_channels = audio_buffer->in_format.channels;
-
-    int out_bps = audio_buffer->out_format.bps;
-    int out_rate = audio_buffer->out_format.rate;
     int out_channels = audio_buffer->out_format.channels;
 
-    /* Calculate position within audio output */
-    int current_sample  = audio_buffer->total_bytes_sent / out_bps;
-    int current_frame   = current_sample / out_channels;
-    int current_channel = current_sample % out_channels;
+    /* Grow frames buffer as necessary */
+    int required = audio_buffer->frames_length + count;
+    if (required > audio_buffer->frames_size) {
 
-    /* Map output channel to input channel */
-    if (current_channel >= in_channels)
-        current_channel = in_channels - 1;
+        int size = audio_buffer->frames_size * 2;
+        if (size < required)
+            size = required;
 
-    /* Transform output position to input position */
-    current_frame = (int) current_frame * ((double) in_rate / out_rate);
-    current_sample = current_frame * in_channels + current_channel;
+        int16_t* frames = realloc(audio_buffer->frames,
+                sizeof(int16_t) * out_channels * size);
+        if (frames == NULL)
+            return 1;
 
-    /* Calculate offset within given buffer from absolute input position */
-    int offset = current_sample * in_bps
-               - audio_buffer->total_bytes_received;
+        audio_buffer->frames = frames;
+        audio_buffer->frames_size = size;
 
-    /* It should be impossible for the offset to ever go negative */
-    assert(offset >= 0);
+    }
 
-    /* Apply offset to buffer */
-    buffer += offset;
-    length -= offset;
+    int16_t* output = audio_buffer->frames
+                    + audio_buffer->frames_length * out_channels;
+
+    /* Convert each output channel independently, reusing the last input
+     * channel for any output channels beyond those received. These loops
+     * have no dependencies between iterations and are straightforwardly
+     * vectorized by the compiler. */
+    for (int channel = 0; channel < out_channels; channel++) {
+
+        int in_channel = channel;
+        if (in_channel >= in_channels)
+            in_channel = in_channels - 1;
+
+        /* 16-bit input is copied directly (input may not be aligned) */
+        if (in_bps == 2) {
+            const char* current = data + in_channel * 2;
+            for (int i = 0; i < count; i++) {
+                int16_t sample;
+                memcpy(&sample, current + i * in_channels * 2, 2);
+                output[i * out_channels + channel] = sample;
+            }
+        }
 
-    /* Read only if sufficient data is present in the given buffer */
-    if (length < in_bps)
-        return 0;
+        /* 8-bit input is scaled up to 16-bit */
+        else {
+            const int8_t* current = (const int8_t*) data + in_channel;
+            for (int i = 0; i < count; i++)
+                output[i * out_channels + channel] =
+                    current[i * in_channels] * 256;
+        }
 
-    /* Simply read sample directly if input is 16-bit */
-    if (in_bps == 2) {
-        *sample = *((int16_t*) buffer);
-        return 1;
     }
 
-    /* Translate to 16-bit if input is 8-bit */
-    if (in_bps == 1) {
-        *sample = *buffer << 8;
-        return 1;
+    audio_buffer->frames_length += count;
+
+    /* Apply moving-average low-pass filter if downsampling */
+    int taps = audio_buffer->filter_taps;
+    if (taps > 1) {
+
+        int scale = (1 << 16) / taps;
+        int index = audio_buffer->filter_index;
+
+        for (int i = 0; i < count; i++) {
+
+            int16_t* history = audio_buffer->filter_history[index];
+
+            for (int channel = 0; channel < out_channels; channel++) {
+                int16_t* sample = &output[i * out_channels + channel];
+                int sum = audio_buffer->filter_sum[channel]
+                        - history[channel] + *sample;
+                audio_buffer->filter_sum[channel] = sum;
+                history[channel] = *sample;
+                *sample = (sum * scale) >> 16;
+            }
+
+            if (++index == taps)
+                index = 0;
+
+        }
+
+        audio_buffer->filter_index = index;
+
     }
 
-    /* Accepted audio formats are required to be 8- or 16-bit */
     return 0;
 
 }
 
-void guac_rdp_audio_buffer_write(guac_rdp_audio_buffer* audio_buffer,
-        char* buffer, int length) {
+/**
+ * Resamples as many buffered input frames as possible to the output rate,
+ * writing the result to the packet buffer of the given audio buffer, and
+ * flushing that packet buffer each time it becomes full. Each output frame is
+ * linearly interpolated between the two nearest input frames using the
+ * precomputed resampling steps. Input frames which will not be needed by any
+ * future output frame are discarded.
+ *
+ * @param audio_buffer
+ *     The audio buffer whose buffered input frames should be resampled.
+ */
+static void guac_rdp_audio_buffer_resample(
+        guac_rdp_audio_buffer* audio_buffer) {
 
-    int16_t sample;
+    int out_bps = audio_buffer->out_format.bps;
+    int channels = audio_buffer->out_format.channels;
+    int frame_size = channels * out_bps;
 
-    pthread_mutex_lock(&(audio_buffer->lock));
+    const int16_t* frames = audio_buffer->frames;
+    const guac_rdp_audio_step* steps = audio_buffer->steps;
 
-    /* Ignore packet if there is no buffer */
-    if (audio_buffer->packet_size == 0 || audio_buffer->packet == NULL) {
-        pthread_mutex_unlock(&(audio_buffer->lock));
-        return;
-    }
+    int current_step = audio_buffer->current_step;
+    int period_offset = audio_buffer->period_offset;
 
-    int out_bps = audio_buffer->out_format.bps;
+    /* Stop once the next output frame would depend on input not yet
+     * received */
+    int offset;
+    while ((offset = period_offset + steps[current_step].offset) + 1
+            < audio_buffer->frames_length) {
 
-    /* Continuously write packets until no data remains */
-    while (guac_rdp_audio_buffer_read_sample(audio_buffer,
-                buffer, length, &sample) > 0) {
+        const int16_t* a = frames + offset * channels;
+        const int16_t* b = a + channels;
+        int weight = steps[current_step].weight;
 
         char* current = audio_buffer->packet + audio_buffer->bytes_written;
 
-        /* Store as 16-bit or 8-bit, depending on output format */
-        if (out_bps == 2)
-            *((int16_t*) current) = sample;
-        else if (out_bps == 1)
-            *current = sample >> 8;
+        for (int channel = 0; channel < channels; channel++) {
+
+            int sample = a[channel] + (((b[channel] - a[channel]) * weight)
+                    >> GUAC_RDP_AUDIO_STEP_PRECISION);
 
-        /* Accepted audio formats are required to be 8- or 16-bit */
-        else
-            assert(0);
+            /* Store as 16-bit or 8-bit, depending on output format */
+            if (out_bps == 2) {
+                int16_t value = sample;
+                memcpy(current + channel * 2, &value, 2);
+            }
+            else
+                current[channel] = sample >> 8;
 
-        /* Update byte counters */
-        audio_buffer->bytes_written += out_bps;
-        audio_buffer->total_bytes_sent += out_bps;
+        }
+
+        /* Advance to next step, wrapping around to the next period */
+        if (++current_step == audio_buffer->period_length) {
+            current_step = 0;
+            period_offset += audio_buffer->period_frames;
+        }
 
         /* Invoke flush handler if full */
+        audio_buffer->bytes_written += frame_size;
         if (audio_buffer->bytes_written == audio_buffer->packet_size) {
 
             /* Only actually invoke if defined */
@@ -440,10 +606,95 @@ void guac_rdp_audio_buffer_write(guac_rdp_audio_buffer* audio_buffer,
 
         }
 
-    } /* end packet write loop */
+    }
+
+    /* Discard all input frames preceding the current period, which will
+     * never again be referenced */
+    int discard = period_offset;
+    if (discard > audio_buffer->frames_length)
+        discard = audio_buffer->frames_length;
+
+    if (discard > 0) {
+        audio_buffer->frames_length -= discard;
+        memmove(audio_buffer->frames, audio_buffer->frames + discard * channels,
+                sizeof(int16_t) * channels * audio_buffer->frames_length);
+        period_offset -= discard;
+    }
+
+    audio_buffer->current_step = current_step;
+    audio_buffer->period_offset = period_offset;
+
+}
+
+void guac_rdp_audio_buffer_write(guac_rdp_audio_buffer* audio_buffer,
+        char* buffer, int length) {
+
+    pthread_mutex_lock(&(audio_buffer->lock));
+
+    /* Ignore packet if there is no buffer */
+    if (audio_buffer->packet_size == 0 || audio_buffer->packet == NULL) {
+        pthread_mutex_unlock(&(audio_buffer->lock));
+        return;
+    }
+
+    /* Accepted audio formats are required to be 8- or 16-bit, mono or
+     * stereo */
+    guac_rdp_audio_format* in_format = &(audio_buffer->in_format);
+    guac_rdp_audio_format* out_format = &(audio_buffer->out_format);
+    if (in_format->bps < 1 || in_format->bps > 2
+            || out_format->bps < 1 || out_format->bps > 2
+            || in_format->channels < 1 || in_format->channels > 2
+            || out_format->channels < 1 || out_format->channels > 2) {
+        pthread_mutex_unlock(&(audio_buffer->lock));
+        return;
+    }
+
+    /* Calculate resampling steps if not yet known for current formats */
+    if (audio_buffer->steps == NULL
+            && guac_rdp_audio_buffer_init_steps(audio_buffer)) {
+        pthread_mutex_unlock(&(audio_buffer->lock));
+        return;
+    }
+
+    int in_frame_size = in_format->bps * in_format->channels;
+
+    /* Complete any partial frame from the previous write */
+    if (audio_buffer->partial_length > 0) {
+
+        int remaining = in_frame_size - audio_buffer->partial_length;
+        if (remaining > length)
+            remaining = length;
+
+        memcpy(audio_buffer->partial + audio_buffer->partial_length,
+                buffer, remaining);
+
+        audio_buffer->partial_length += remaining;
+        buffer += remaining;
+        length -= remaining;
+
+        if (audio_buffer->partial_length == in_frame_size) {
+            guac_rdp_audio_buffer_convert(audio_buffer,
+                    audio_buffer->partial, 1);
+            audio_buffer->partial_length = 0;
+        }
+
+    }
+
+    /* Convert all complete frames as a single block, saving any trailing
+     * partial frame for the next write */
+    int count = length / in_frame_size;
+    if (count > 0)
+        guac_rdp_audio_buffer_convert(audio_buffer, buffer, count);
+
+    int leftover = length - count * in_frame_size;
+    if (leftover > 0) {
+        memcpy(audio_buffer->partial + audio_buffer->partial_length,
+                buffer + count * in_frame_size, leftover);
+        audio_buffer->partial_length += leftover;
+    }
 
-    /* Track current position in audio stream */
-    audio_buffer->total_bytes_received += length;
+    /* Write as many packets as the received data allows */
+    guac_rdp_audio_buffer_resample(audio_buffer);
 
     pthread_mutex_unlock(&(audio_buffer->lock));
 
@@ -466,9 +717,8 @@ void guac_rdp_audio_buffer_end(guac_rdp_audio_buffer* audio_buffer) {
     audio_buffer->packet_size = 0;
     audio_buffer->flush_handler = NULL;
 
-    /* Reset I/O counters */
-    audio_buffer->total_bytes_sent = 0;
-    audio_buffer->total_bytes_received = 0;
+    /* Reset resampling state */
+    guac_rdp_audio_buffer_reset(audio_buffer);
 
     /* Free packet (if any) */
     free(audio_buffer->packet);
@@ -481,6 +731,8 @@ void guac_rdp_audio_buffer_end(guac_rdp_audio_buffer* audio_buffer) {
 void guac_rdp_audio_buffer_free(guac_rdp_audio_buffer* audio_buffer) {
     pthread_mutex_destroy(&(audio_buffer->lock));
     free(audio_buffer->packet);
+    free(audio_buffer->frames);
+    free(audio_buffer->steps);
     free(audio_buffer);
 }
 
@@ -28,6 +28,7 @@
 #include <guacamole/user.h>
 
 #include <pthread.h>
+#include <stdint.h>
 
 /**
  * Handler which is invoked when a guac_rdp_audio_buffer's internal packet
@@ -48,6 +49,43 @@
 typedef void guac_rdp_audio_buffer_flush_handler(char* buffer, int length,
         void* data);
 
+/**
+ * The maximum number of input frames averaged by the low-pass filter applied
+ * when downsampling received audio. Higher ratios between the input and
+ * output rates are still supported, but will be filtered less aggressively.
+ */
+#define GUAC_RDP_AUDIO_MAX_FILTER_TAPS 8
+
+/**
+ * The number of fractional bits within the interpolation weight of each
+ * guac_rdp_audio_step.
+ */
+#define GUAC_RDP_AUDIO_STEP_PRECISION 15
+
+/**
+ * A single precomputed step of the conversion between the input and output
+ * sample rates, describing the position of one output frame relative to the
+ * input frames of the current resampling period.
+ */
+typedef struct guac_rdp_audio_step {
+
+    /**
+     * The index of the input frame at or immediately before the output frame,
+     * relative to the start of the current period.
+     */
+    int offset;
+
+    /**
+     * The distance between the input frame at the given offset and the output
+     * frame, as a fixed-point fraction of one input frame having
+     * GUAC_RDP_AUDIO_STEP_PRECISION fractional bits. The output frame is
+     * linearly interpolated between the input frames at offset and offset + 1
+     * using this weight.
+     */
+    int weight;
+
+} guac_rdp_audio_step;
+
 /**
  * A description of an arbitrary PCM audio format.
  */
@@ -122,16 +160,89 @@ typedef struct guac_rdp_audio_buffer {
     int bytes_written;
 
     /**
-     * The total number of bytes having ever been received by the Guacamole
-     * server for the current audio stream.
+     * Bytes of an incomplete input frame left over from the previous call to
+     * guac_rdp_audio_buffer_write(). As input samples are at most 16-bit
+     * stereo, an input frame is never larger than four bytes.
+     */
+    char partial[4];
+
+    /**
+     * The number of bytes currently stored within the partial buffer.
+     */
+    int partial_length;
+
+    /**
+     * Received audio which has been converted to signed 16-bit samples having
+     * the number of channels of the output format, but which has not yet been
+     * resampled to the output rate.
+     */
+    int16_t* frames;
+
+    /**
+     * The number of frames currently stored within the frames buffer.
+     */
+    int frames_length;
+
+    /**
+     * The number of frames for which space has been allocated within the
+     * frames buffer.
+     */
+    int frames_size;
+
+    /**
+     * Precomputed resampling steps for a single period of the conversion
+     * between the input and output rates, or NULL if the steps have not yet
+     * been calculated for the current formats. The input and output rates are
+     * related by a rational factor, thus the positions of output frames
+     * relative to input frames repeat exactly every period.
+     */
+    guac_rdp_audio_step* steps;
+
+    /**
+     * The number of output frames (and thus steps) within each period.
+     */
+    int period_length;
+
+    /**
+     * The number of input frames consumed by each period.
+     */
+    int period_frames;
+
+    /**
+     * The index of the step which will produce the next output frame.
+     */
+    int current_step;
+
+    /**
+     * The index, within the frames buffer, of the first input frame of the
+     * current period.
+     */
+    int period_offset;
+
+    /**
+     * The number of input frames averaged by the low-pass filter applied
+     * prior to downsampling. If the input is not being downsampled, this will
+     * be 1 and no filtering is performed.
+     */
+    int filter_taps;
+
+    /**
+     * The most recent converted input frames, for each output channel, from
+     * which the low-pass filter average is calculated. This is used as a ring
+     * buffer of filter_taps entries.
+     */
+    int16_t filter_history[GUAC_RDP_AUDIO_MAX_FILTER_TAPS][2];
+
+    /**
+     * The index within filter_history of the oldest frame.
      */
-    int total_bytes_received;
+    int filter_index;
 
     /**
-     * The total number of bytes having ever been sent to the RDP server for
-     * the current audio stream.
+     * The running sum of all frames within filter_history, for each output
+     * channel.
      */
-    int total_bytes_sent;
+    int filter_sum[2];
 
     /**
      * All audio data being prepared for sending to the AUDIO_INPUT channel.
@@ -28,6 +28,9 @@
 #include "rdp_bitmap.h"
 #include "rdp_cliprdr.h"
 #include "rdp_gdi.h"
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+#include "rdp_gfx.h"
+#endif
 #include "rdp_glyph.h"
 #include "rdp_pointer.h"
 #include "rdp_stream.h"
@@ -67,6 +70,11 @@
 #endif
 #include <freerdp/event.h>
 
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+#include <freerdp/client/cmdline.h>
+#include <freerdp/client/rdpgfx.h>
+#endif
+
 #ifdef LEGACY_FREERDP
 #include "compat/rail.h"
 #else
@@ -178,6 +186,13 @@ static void guac_rdp_channel_connected(rdpContext* context,
         }
 #endif
     }
+
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    /* Render graphics pipeline updates directly to the display */
+    if (strcmp(e->name, RDPGFX_DVC_CHANNEL_NAME) == 0)
+        guac_rdp_gfx_connect(context, (RdpgfxClientContext*) e->pInterface);
+#endif
+
 		if (strcmp(e->name, CLIPRDR_SVC_CHANNEL_NAME) == 0)
 		{
 			CliprdrClientContext* cliprdr = (CliprdrClientContext*) e->pInterface;
@@ -200,6 +215,11 @@ static void guac_rdp_channel_disconnected(
 			ClipboardDestroy(cliprdr->custom);
 		}
 
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    if (strcmp(e->name, RDPGFX_DVC_CHANNEL_NAME) == 0)
+        guac_rdp_gfx_disconnect(context, (RdpgfxClientContext*) e->pInterface);
+#endif
+
 }
 
 static BOOL rdp_freerdp_client_load_static_channel_addin(rdpChannels* channels,
@@ -269,6 +289,36 @@ BOOL rdp_freerdp_pre_connect(freerdp* instance) {
         guac_rdp_disp_load_plugin(instance->context, dvc_list);
 #endif
 
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    /* Load "rdpgfx" plugin, carried over "drdynvc", for the graphics
+     * pipeline */
+    if (!settings->disable_gfx) {
+
+        char* params[] = { "rdpgfx" };
+
+        if (!freerdp_client_add_dynamic_channel(instance->settings, 1, params)
+                || !rdp_freerdp_client_load_static_channel_addin(channels,
+                    instance->settings, "drdynvc", instance->settings))
+            guac_client_log(client, GUAC_LOG_WARNING,
+                    "Failed to load rdpgfx plugin. The graphics pipeline "
+                    "will not be used.");
+
+        /* Advertise the pipeline only if it can actually be served */
+        else {
+
+            instance->settings->SupportGraphicsPipeline = TRUE;
+
+            /* Handle RDPGFX PDUs within the RDP thread, serialized with all
+             * other drawing to the display (see
+             * rdp_guac_client_wait_for_messages()), rather than within the
+             * "drdynvc" worker thread */
+            instance->settings->SynchronousDynamicChannels = TRUE;
+
+        }
+
+    }
+#endif
+
     /* Load clipboard plugin */
     if (freerdp_channels_load_plugin(channels, instance->settings,
                 "cliprdr", NULL))
@@ -347,8 +397,9 @@ static BOOL rdp_freerdp_post_connect(freerdp* instance) {
     rdpPointer pointer;
     rdpPrimaryUpdate* primary;
 
-		if (!gdi_init(instance, PIXEL_FORMAT_XRGB32))
-			return FALSE;
+    /* Render GDI output directly into the Guacamole display */
+    if (!guac_rdp_gdi_init(instance))
+        return FALSE;
 
     /* Init color conversion structure */
     ((rdp_freerdp_context*) context)->clrconv = calloc(1, sizeof(rdpPalette));
@@ -564,7 +615,13 @@ static int rdp_guac_client_wait_for_messages(guac_client* client,
 				return -1;
 		}
 
-			if (!freerdp_check_event_handles(rdp_inst->context))
+    /* Handle pending messages (including any synchronous channel PDUs)
+     * while no other thread may touch the RDP session or its GDI */
+    pthread_mutex_lock(&(rdp_client->rdp_lock));
+    BOOL handled = freerdp_check_event_handles(rdp_inst->context);
+    pthread_mutex_unlock(&(rdp_client->rdp_lock));
+
+			if (!handled)
 			{
 //				if (wf_auto_reconnect(instance))
 //					continue;
@@ -609,6 +666,10 @@ static int guac_rdp_handle_connection(guac_client* client) {
 
     rdp_client->current_surface = rdp_client->display->default_surface;
 
+    /* Create cache accounting, limiting memory consumed by cached bitmaps */
+    rdp_client->bitmap_cache = guac_rdp_bitmap_cache_alloc(
+            (size_t) settings->cache_memory_limit * 1024 * 1024);
+
     rdp_client->requested_clipboard_format = CF_TEXT;
     rdp_client->available_svc = guac_common_list_alloc();
 
@@ -755,6 +816,11 @@ static int guac_rdp_handle_connection(guac_client* client) {
     freerdp_free(rdp_inst);
     rdp_client->rdp_inst = NULL;
 
+    /* Report and free cache accounting (all bitmaps are now freed) */
+    guac_rdp_bitmap_cache_log(client, rdp_client->bitmap_cache);
+    guac_rdp_bitmap_cache_free(rdp_client->bitmap_cache);
+    rdp_client->bitmap_cache = NULL;
+
     /* Free SVC list */
     guac_common_list_free(rdp_client->available_svc);
 
@@ -29,6 +29,7 @@
 #include "common/surface.h"
 #include "guac_rdpsnd/rdpsnd_service.h"
 #include "keyboard.h"
+#include "rdp_bitmap.h"
 #include "rdp_settings.h"
 
 #include <freerdp/freerdp.h>
@@ -87,6 +88,12 @@ typedef struct guac_rdp_client {
      */
     guac_common_surface* current_surface;
 
+    /**
+     * Memory accounting and eviction state for all cached bitmaps and
+     * offscreen surfaces of the current connection.
+     */
+    guac_rdp_bitmap_cache* bitmap_cache;
+
     /**
      * The current state of the keyboard with respect to the RDP session.
      */
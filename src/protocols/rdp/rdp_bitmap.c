@@ -35,18 +35,317 @@
 #include <winpr/wtypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+/**
+ * The current state of the decoder of PNG data retained for an evicted
+ * bitmap.
+ */
+typedef struct guac_rdp_bitmap_png_read_state {
+
+    /**
+     * The next unread byte of PNG data. This pointer is advanced as data is
+     * read.
+     */
+    const unsigned char* data;
+
+    /**
+     * The number of bytes of PNG data remaining to be read.
+     */
+    unsigned int length;
+
+} guac_rdp_bitmap_png_read_state;
+
+/**
+ * Fills the given buffer with PNG data retained for an evicted bitmap. The
+ * behavior of this function is dictated by cairo_read_func_t.
+ *
+ * @param closure
+ *     The current state of the PNG decoding process (an instance of
+ *     guac_rdp_bitmap_png_read_state).
+ *
+ * @param data
+ *     The buffer to fill.
+ *
+ * @param length
+ *     The number of bytes to fill within the buffer.
+ *
+ * @return
+ *     CAIRO_STATUS_SUCCESS if the entire buffer was filled,
+ *     CAIRO_STATUS_READ_ERROR otherwise.
+ */
+static cairo_status_t guac_rdp_bitmap_png_read(void* closure,
+        unsigned char* data, unsigned int length) {
+
+    guac_rdp_bitmap_png_read_state* state =
+        (guac_rdp_bitmap_png_read_state*) closure;
+
+    /* Fail if more data is requested than remains */
+    if (length > state->length)
+        return CAIRO_STATUS_READ_ERROR;
+
+    memcpy(data, state->data, length);
+    state->data += length;
+    state->length -= length;
+
+    return CAIRO_STATUS_SUCCESS;
+
+}
+
+/**
+ * Removes the given bitmap from the least-recently-used list of the given
+ * cache. The bitmap must currently be within that list.
+ *
+ * @param cache
+ *     The cache containing the bitmap.
+ *
+ * @param bitmap
+ *     The bitmap to remove.
+ */
+static void guac_rdp_bitmap_cache_unlink(guac_rdp_bitmap_cache* cache,
+        guac_rdp_bitmap* bitmap) {
+
+    if (bitmap->prev != NULL)
+        bitmap->prev->next = bitmap->next;
+    else
+        cache->head = bitmap->next;
+
+    if (bitmap->next != NULL)
+        bitmap->next->prev = bitmap->prev;
+    else
+        cache->tail = bitmap->prev;
+
+    bitmap->prev = NULL;
+    bitmap->next = NULL;
+
+}
+
+/**
+ * Adds the given bitmap to the least-recently-used list of the given cache
+ * as the most recently used bitmap. The bitmap must not currently be within
+ * that list.
+ *
+ * @param cache
+ *     The cache which should contain the bitmap.
+ *
+ * @param bitmap
+ *     The bitmap to add.
+ */
+static void guac_rdp_bitmap_cache_push(guac_rdp_bitmap_cache* cache,
+        guac_rdp_bitmap* bitmap) {
+
+    bitmap->prev = NULL;
+    bitmap->next = cache->head;
+
+    if (cache->head != NULL)
+        cache->head->prev = bitmap;
+    else
+        cache->tail = bitmap;
+
+    cache->head = bitmap;
+
+}
+
+/**
+ * Evicts the given cached bitmap, freeing its layer. If the bitmap has been
+ * drawn to, its contents are first retained as PNG such that they can be
+ * restored when the bitmap is next cached.
+ *
+ * @param rdp_client
+ *     The RDP client data of the connection using the bitmap.
+ *
+ * @param bitmap
+ *     The cached bitmap to evict.
+ *
+ * @return
+ *     Zero if the bitmap was evicted, non-zero if its contents could not be
+ *     retained and the bitmap must remain cached.
+ */
+static int guac_rdp_bitmap_evict(guac_rdp_client* rdp_client,
+        guac_rdp_bitmap* bitmap) {
+
+    guac_rdp_bitmap_cache* cache = rdp_client->bitmap_cache;
+    guac_common_display_layer* buffer = bitmap->layer;
+
+    /* Offscreen surfaces cannot be recreated from image data */
+    if (bitmap->drawn) {
+
+        int length;
+        unsigned char* data = guac_common_surface_export(buffer->surface,
+                &length);
+
+        if (data == NULL)
+            return 1;
+
+        bitmap->evicted = data;
+        bitmap->evicted_length = length;
+        cache->evicted_usage += length;
+
+    }
+
+    guac_rdp_bitmap_cache_unlink(cache, bitmap);
+    cache->usage -= bitmap->size;
+    cache->entries--;
+    cache->evictions++;
+
+    guac_common_display_free_buffer(rdp_client->display, buffer);
+    bitmap->layer = NULL;
+    bitmap->size = 0;
+
+    return 0;
+
+}
+
+/**
+ * Evicts least recently used bitmaps until the given number of additional
+ * bytes can be cached without exceeding the cache memory limit, or until no
+ * further bitmaps can be evicted. The current drawing surface is never
+ * evicted.
+ *
+ * @param rdp_client
+ *     The RDP client data of the connection whose cache should be reduced.
+ *
+ * @param size
+ *     The number of bytes about to be cached.
+ */
+static void guac_rdp_bitmap_cache_reserve(guac_rdp_client* rdp_client,
+        size_t size) {
+
+    guac_rdp_bitmap_cache* cache = rdp_client->bitmap_cache;
+
+    /* Nothing to do if memory is not limited */
+    if (cache == NULL || cache->limit == 0)
+        return;
+
+    guac_rdp_bitmap* current = cache->tail;
+    while (current != NULL && cache->usage + size > cache->limit) {
+
+        guac_rdp_bitmap* prev = current->prev;
+
+        if (current->layer->surface != rdp_client->current_surface)
+            guac_rdp_bitmap_evict(rdp_client, current);
+
+        current = prev;
+
+    }
+
+}
+
+/**
+ * Restores the contents of the given previously-evicted bitmap from its
+ * retained PNG data, freeing that data.
+ *
+ * @param client
+ *     The guac_client associated with the current RDP session.
+ *
+ * @param bitmap
+ *     The evicted bitmap whose contents should be restored.
+ *
+ * @param buffer
+ *     The newly-allocated layer which should receive the bitmap contents.
+ */
+static void guac_rdp_bitmap_restore(guac_client* client,
+        guac_rdp_bitmap* bitmap, guac_common_display_layer* buffer) {
+
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_bitmap_cache* cache = rdp_client->bitmap_cache;
+
+    guac_rdp_bitmap_png_read_state state = {
+        .data = bitmap->evicted,
+        .length = bitmap->evicted_length
+    };
+
+    /* Decode and draw retained contents */
+    cairo_surface_t* image = cairo_image_surface_create_from_png_stream(
+            guac_rdp_bitmap_png_read, &state);
+
+    if (cairo_surface_status(image) == CAIRO_STATUS_SUCCESS)
+        guac_common_surface_draw(buffer->surface, 0, 0, image);
+    else
+        guac_client_log(client, GUAC_LOG_WARNING, "Contents of evicted "
+                "offscreen surface could not be restored.");
+
+    cairo_surface_destroy(image);
+
+    /* Retained data is no longer needed */
+    cache->evicted_usage -= bitmap->evicted_length;
+    cache->restores++;
+
+    free(bitmap->evicted);
+    bitmap->evicted = NULL;
+    bitmap->evicted_length = 0;
+
+}
+
+guac_rdp_bitmap_cache* guac_rdp_bitmap_cache_alloc(size_t limit) {
+
+    guac_rdp_bitmap_cache* cache = calloc(1, sizeof(guac_rdp_bitmap_cache));
+    if (cache == NULL)
+        return NULL;
+
+    cache->limit = limit;
+    return cache;
+
+}
+
+void guac_rdp_bitmap_cache_log(guac_client* client,
+        guac_rdp_bitmap_cache* cache) {
+
+    if (cache == NULL)
+        return;
+
+    guac_client_log(client, GUAC_LOG_INFO, "Bitmap cache: %i entries using "
+            "%lu bytes (peak %lu bytes, limit %lu bytes), %i evictions, "
+            "%i restores, %lu bytes retained for evicted offscreen "
+            "surfaces.", cache->entries, (unsigned long) cache->usage,
+            (unsigned long) cache->peak, (unsigned long) cache->limit,
+            cache->evictions, cache->restores,
+            (unsigned long) cache->evicted_usage);
+
+}
+
+void guac_rdp_bitmap_cache_free(guac_rdp_bitmap_cache* cache) {
+    free(cache);
+}
+
+void guac_rdp_bitmap_touch(rdpContext* context, rdpBitmap* bitmap) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_bitmap_cache* cache = rdp_client->bitmap_cache;
+    guac_rdp_bitmap* rdp_bitmap = (guac_rdp_bitmap*) bitmap;
+
+    /* Only cached bitmaps are tracked */
+    if (cache == NULL || rdp_bitmap->layer == NULL
+            || cache->head == rdp_bitmap)
+        return;
+
+    guac_rdp_bitmap_cache_unlink(cache, rdp_bitmap);
+    guac_rdp_bitmap_cache_push(cache, rdp_bitmap);
+
+}
 
 void guac_rdp_cache_bitmap(rdpContext* context, rdpBitmap* bitmap) {
 
     guac_client* client = ((rdp_freerdp_context*) context)->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_rdp_bitmap_cache* cache = rdp_client->bitmap_cache;
+    guac_rdp_bitmap* rdp_bitmap = (guac_rdp_bitmap*) bitmap;
+
+    /* Make room within cache memory limit */
+    size_t size = (size_t) bitmap->width * bitmap->height * 4;
+    guac_rdp_bitmap_cache_reserve(rdp_client, size);
 
     /* Allocate buffer */
     guac_common_display_layer* buffer = guac_common_display_alloc_buffer(
             rdp_client->display, bitmap->width, bitmap->height);
 
-    /* Cache image data if present */
-    if (bitmap->data != NULL) {
+    /* Restore contents of previously-evicted offscreen surface */
+    if (rdp_bitmap->evicted != NULL)
+        guac_rdp_bitmap_restore(client, rdp_bitmap, buffer);
+
+    /* Otherwise, cache image data if present */
+    else if (bitmap->data != NULL) {
 
         /* Create surface from image data */
         cairo_surface_t* image = cairo_image_surface_create_for_data(
@@ -62,7 +361,20 @@ void guac_rdp_cache_bitmap(rdpContext* context, rdpBitmap* bitmap) {
     }
 
     /* Store buffer reference in bitmap */
-    ((guac_rdp_bitmap*) bitmap)->layer = buffer;
+    rdp_bitmap->layer = buffer;
+
+    /* Account for cached bitmap as most recently used */
+    if (cache != NULL) {
+
+        rdp_bitmap->size = size;
+        guac_rdp_bitmap_cache_push(cache, rdp_bitmap);
+
+        cache->entries++;
+        cache->usage += size;
+        if (cache->usage > cache->peak)
+            cache->peak = cache->usage;
+
+    }
 
 }
 
@@ -113,6 +425,14 @@ BOOL guac_rdp_bitmap_new(rdpContext* context, rdpBitmap* bitmap) {
     /* Start at zero usage */
     ((guac_rdp_bitmap*) bitmap)->used = 0;
 
+    /* Not yet drawn to, evicted, or tracked by the cache */
+    ((guac_rdp_bitmap*) bitmap)->drawn = 0;
+    ((guac_rdp_bitmap*) bitmap)->evicted = NULL;
+    ((guac_rdp_bitmap*) bitmap)->evicted_length = 0;
+    ((guac_rdp_bitmap*) bitmap)->size = 0;
+    ((guac_rdp_bitmap*) bitmap)->prev = NULL;
+    ((guac_rdp_bitmap*) bitmap)->next = NULL;
+
 		return TRUE;
 
 }
@@ -128,8 +448,14 @@ BOOL guac_rdp_bitmap_paint(rdpContext* context, rdpBitmap* bitmap) {
     int height = bitmap->bottom - bitmap->top + 1;
 
     /* If not cached, cache if necessary */
-    if (buffer == NULL && ((guac_rdp_bitmap*) bitmap)->used >= 1)
+    if (buffer == NULL && ((guac_rdp_bitmap*) bitmap)->used >= 1) {
         guac_rdp_cache_bitmap(context, bitmap);
+        buffer = ((guac_rdp_bitmap*) bitmap)->layer;
+    }
+
+    /* Otherwise, this use keeps the cached copy from being evicted */
+    else
+        guac_rdp_bitmap_touch(context, bitmap);
 
     /* If cached, retrieve from cache */
     if (buffer != NULL)
@@ -165,12 +491,33 @@ void guac_rdp_bitmap_free(rdpContext* context, rdpBitmap* bitmap) {
 
     guac_client* client = ((rdp_freerdp_context*) context)->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
-    guac_common_display_layer* buffer = ((guac_rdp_bitmap*) bitmap)->layer;
+    guac_rdp_bitmap_cache* cache = rdp_client->bitmap_cache;
+    guac_rdp_bitmap* rdp_bitmap = (guac_rdp_bitmap*) bitmap;
+    guac_common_display_layer* buffer = rdp_bitmap->layer;
 
     /* If cached, free buffer */
-    if (buffer != NULL)
+    if (buffer != NULL) {
+
+        if (cache != NULL) {
+            guac_rdp_bitmap_cache_unlink(cache, rdp_bitmap);
+            cache->usage -= rdp_bitmap->size;
+            cache->entries--;
+        }
+
         guac_common_display_free_buffer(rdp_client->display, buffer);
 
+    }
+
+    /* Discard any contents retained after eviction */
+    if (rdp_bitmap->evicted != NULL) {
+
+        if (cache != NULL)
+            cache->evicted_usage -= rdp_bitmap->evicted_length;
+
+        free(rdp_bitmap->evicted);
+
+    }
+
     /* NOTE: FreeRDP-allocated memory for the rdpBitmap will NOT be
      * automatically released after this free handler is invoked, thus we must
      * do so manually here */
@@ -199,10 +546,15 @@ BOOL guac_rdp_bitmap_setsurface(rdpContext* context, rdpBitmap* bitmap, BOOL pri
         /* If not available as a surface, make available. */
         if (((guac_rdp_bitmap*) bitmap)->layer == NULL)
             guac_rdp_cache_bitmap(context, bitmap);
+        else
+            guac_rdp_bitmap_touch(context, bitmap);
 
         rdp_client->current_surface =
             ((guac_rdp_bitmap*) bitmap)->layer->surface;
 
+        /* Contents will now diverge from the original image data */
+        ((guac_rdp_bitmap*) bitmap)->drawn = 1;
+
     }
 
 		return TRUE;
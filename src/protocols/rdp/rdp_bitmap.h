@@ -25,8 +25,12 @@
 #include "common/display.h"
 
 #include <freerdp/freerdp.h>
+#include <guacamole/client.h>
 #include <guacamole/layer.h>
 #include <winpr/wtypes.h>
+
+#include <stddef.h>
+
 /**
  * Guacamole-specific rdpBitmap data.
  */
@@ -47,13 +51,157 @@ typedef struct guac_rdp_bitmap {
      */
     int used;
 
+    /**
+     * Non-zero if this bitmap has been used as an offscreen drawing surface,
+     * in which case its contents can no longer be recreated from the
+     * original image data.
+     */
+    int drawn;
+
+    /**
+     * PNG-encoded contents of this bitmap, retained if the bitmap was drawn
+     * to prior to its layer being evicted from the cache, or NULL if the
+     * bitmap can be recreated from its image data.
+     */
+    unsigned char* evicted;
+
+    /**
+     * The number of bytes of PNG data within evicted.
+     */
+    int evicted_length;
+
+    /**
+     * The number of bytes of cache memory consumed by the layer of this
+     * bitmap, or zero if the bitmap is not currently cached.
+     */
+    size_t size;
+
+    /**
+     * The next most recently used cached bitmap, or NULL if this bitmap is
+     * the most recently used or is not cached.
+     */
+    struct guac_rdp_bitmap* prev;
+
+    /**
+     * The next least recently used cached bitmap, or NULL if this bitmap is
+     * the least recently used or is not cached.
+     */
+    struct guac_rdp_bitmap* next;
+
 } guac_rdp_bitmap;
 
+/**
+ * Memory accounting for all cached bitmaps and offscreen surfaces of an RDP
+ * connection. Cached bitmaps are kept in least-recently-used order, and the
+ * least recently used are evicted as needed to remain within the configured
+ * memory limit. Evicted bitmaps are transparently recached when next used.
+ */
+typedef struct guac_rdp_bitmap_cache {
+
+    /**
+     * The maximum number of bytes which may be consumed by cached bitmaps,
+     * or zero if cache memory is not limited.
+     */
+    size_t limit;
+
+    /**
+     * The number of bytes currently consumed by cached bitmaps.
+     */
+    size_t usage;
+
+    /**
+     * The largest number of bytes consumed by cached bitmaps at any one time.
+     */
+    size_t peak;
+
+    /**
+     * The number of bytes of PNG data retained for evicted bitmaps which
+     * were drawn to.
+     */
+    size_t evicted_usage;
+
+    /**
+     * The number of bitmaps currently cached.
+     */
+    int entries;
+
+    /**
+     * The total number of times a cached bitmap has been evicted.
+     */
+    int evictions;
+
+    /**
+     * The total number of times an evicted bitmap has been recached.
+     */
+    int restores;
+
+    /**
+     * The most recently used cached bitmap, or NULL if no bitmaps are cached.
+     */
+    guac_rdp_bitmap* head;
+
+    /**
+     * The least recently used cached bitmap, or NULL if no bitmaps are
+     * cached.
+     */
+    guac_rdp_bitmap* tail;
+
+} guac_rdp_bitmap_cache;
+
+/**
+ * Allocates a new, empty bitmap cache which will remain within the given
+ * memory limit.
+ *
+ * @param limit
+ *     The maximum number of bytes which may be consumed by cached bitmaps,
+ *     or zero if cache memory should not be limited.
+ *
+ * @return
+ *     A newly-allocated bitmap cache, or NULL if allocation fails.
+ */
+guac_rdp_bitmap_cache* guac_rdp_bitmap_cache_alloc(size_t limit);
+
+/**
+ * Logs the current and peak memory consumption of the given bitmap cache,
+ * along with the number of evictions which have occurred.
+ *
+ * @param client
+ *     The guac_client associated with the RDP connection using the cache.
+ *
+ * @param cache
+ *     The bitmap cache to report on.
+ */
+void guac_rdp_bitmap_cache_log(guac_client* client,
+        guac_rdp_bitmap_cache* cache);
+
+/**
+ * Frees the given bitmap cache. All bitmaps within the cache must already
+ * have been freed. If the given cache is NULL, this function has no effect.
+ *
+ * @param cache
+ *     The bitmap cache to free, which may be NULL.
+ */
+void guac_rdp_bitmap_cache_free(guac_rdp_bitmap_cache* cache);
+
+/**
+ * Marks the given bitmap as most recently used, if it is currently cached,
+ * such that it will be the last to be evicted from the cache.
+ *
+ * @param context
+ *     The rdpContext associated with the current RDP session.
+ *
+ * @param bitmap
+ *     The bitmap which was used.
+ */
+void guac_rdp_bitmap_touch(rdpContext* context, rdpBitmap* bitmap);
+
 /**
  * Caches the given bitmap immediately, storing its data in a remote Guacamole
  * buffer. As RDP bitmaps are frequently created, used once, and immediately
  * destroyed, we defer actual remote-side caching of RDP bitmaps until they are
- * used at least once.
+ * used at least once. If necessary, less recently used bitmaps are evicted
+ * from the cache to remain within its memory limit, and bitmaps which were
+ * themselves previously evicted are restored.
  *
  * @param context
  *     The rdpContext associated with the current RDP session.
@@ -190,11 +190,11 @@ UINT guac_rdp_process_cb_data_request(CliprdrClientContext* context,
     switch (format_data_request->requestedFormatId) {
 
         case CF_TEXT:
-            writer = GUAC_WRITE_CP1252;
+            writer = GUAC_WRITE_CP1252_CRLF;
             break;
 
         case CF_UNICODETEXT:
-            writer = GUAC_WRITE_UTF16;
+            writer = GUAC_WRITE_UTF16_CRLF;
             break;
 
         default:
@@ -208,7 +208,7 @@ UINT guac_rdp_process_cb_data_request(CliprdrClientContext* context,
     /* Set data and size */
 		data_response.msgFlags = CB_RESPONSE_OK;
     data_response.requestedFormatData = (BYTE*) output;
-    guac_iconv(GUAC_READ_UTF8, &input, rdp_client->clipboard->length,
+    guac_iconv(GUAC_READ_UTF8_NORMALIZED, &input, rdp_client->clipboard->length,
                writer, &output, GUAC_RDP_CLIPBOARD_MAX_LENGTH);
     data_response.dataLen = ((BYTE*) output) - data_response.requestedFormatData;
 
@@ -235,12 +235,12 @@ UINT guac_rdp_process_cb_data_response(CliprdrClientContext* context,
 
         /* Non-Unicode */
         case CF_TEXT:
-            reader = GUAC_READ_CP1252;
+            reader = GUAC_READ_CP1252_NORMALIZED;
             break;
 
         /* Unicode (UTF-16) */
         case CF_UNICODETEXT:
-            reader = GUAC_READ_UTF16;
+            reader = GUAC_READ_UTF16_NORMALIZED;
             break;
 
         default:
@@ -64,12 +64,14 @@ guac_rdp_fs* guac_rdp_fs_alloc(guac_client* client, const char* drive_path,
     fs->drive_path = strdup(drive_path);
     fs->file_id_pool = guac_pool_alloc(0);
     fs->open_files = 0;
+    fs->dircache = guac_common_dircache_alloc(GUAC_COMMON_DIRCACHE_TTL);
 
     return fs;
 
 }
 
 void guac_rdp_fs_free(guac_rdp_fs* fs) {
+    guac_common_dircache_free(fs->dircache);
     guac_pool_free(fs->file_id_pool);
     free(fs->drive_path);
     free(fs);
@@ -314,6 +316,10 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
 
     }
 
+    /* Any cached listing of the parent directory may become stale */
+    if (flags & O_CREAT)
+        guac_common_dircache_invalidate(fs->dircache, real_path);
+
     /* Create directory first, if necessary */
     if ((create_options & FILE_DIRECTORY_FILE) && (flags & O_CREAT)) {
 
@@ -357,7 +363,8 @@ int guac_rdp_fs_open(guac_rdp_fs* fs, const char* path,
     file = &(fs->files[file_id]);
     file->id = file_id;
     file->fd  = fd;
-    file->dir = NULL;
+    file->listing = NULL;
+    file->listing_index = 0;
     file->dir_pattern[0] = '\0';
     file->absolute_path = strdup(normalized_path);
     file->real_path = strdup(real_path);
@@ -479,6 +486,10 @@ int guac_rdp_fs_rename(guac_rdp_fs* fs, int file_id,
             "%s: Renaming \"%s\" -> \"%s\"",
             __func__, file->real_path, real_path);
 
+    /* Cached listings of both source and destination are now stale */
+    guac_common_dircache_invalidate(fs->dircache, file->real_path);
+    guac_common_dircache_invalidate(fs->dircache, real_path);
+
     /* Perform rename */
     if (rename(file->real_path, real_path)) {
         guac_client_log(fs->client, GUAC_LOG_DEBUG,
@@ -501,6 +512,9 @@ int guac_rdp_fs_delete(guac_rdp_fs* fs, int file_id) {
         return GUAC_RDP_FS_EINVAL;
     }
 
+    /* Any cached listing of the file or its parent is now stale */
+    guac_common_dircache_invalidate(fs->dircache, file->real_path);
+
     /* If directory, attempt removal */
     if (file->attributes & FILE_ATTRIBUTE_DIRECTORY) {
         if (rmdir(file->real_path)) {
@@ -559,9 +573,9 @@ void guac_rdp_fs_close(guac_rdp_fs* fs, int file_id) {
             "%s: Closed \"%s\" (file_id=%i)",
             __func__, file->absolute_path, file_id);
 
-    /* Close directory, if open */
-    if (file->dir != NULL)
-        closedir(file->dir);
+    /* Release directory listing, if read */
+    if (file->listing != NULL)
+        guac_common_dircache_release(fs->dircache, file->listing);
 
     /* Close file */
     close(file->fd);
@@ -588,19 +602,41 @@ const char* guac_rdp_fs_read_dir(guac_rdp_fs* fs, int file_id) {
 
     file = &(fs->files[file_id]);
 
-    /* Open directory if not yet open, stop if error */
-    if (file->dir == NULL) {
-        file->dir = fdopendir(file->fd);
-        if (file->dir == NULL)
-            return NULL;
+    /* Read entire directory if not yet read and not cached */
+    if (file->listing == NULL) {
+
+        file->listing = guac_common_dircache_get(fs->dircache,
+                file->real_path);
+
+        if (file->listing == NULL) {
+
+            /* Stop if error */
+            DIR* dir = opendir(file->real_path);
+            if (dir == NULL)
+                return NULL;
+
+            file->listing = guac_common_dircache_listing_alloc(
+                    file->real_path);
+
+            /* Read all entries (only names are needed here, so entries are
+             * not stat'd to determine whether they are directories) */
+            while ((result = readdir(dir)) != NULL)
+                guac_common_dircache_listing_add(file->listing,
+                        result->d_name, 0);
+
+            closedir(dir);
+            guac_common_dircache_put(fs->dircache, file->listing);
+
+        }
+
     }
 
-    /* Read next entry, stop if error or no more entries */
-    if ((result = readdir(file->dir)) == NULL)
+    /* Stop if no more entries */
+    if (file->listing_index >= file->listing->length)
         return NULL;
 
     /* Return filename */
-    return result->d_name;
+    return file->listing->entries[file->listing_index++].name;
 
 }
 
@@ -34,6 +34,8 @@
 
 #include "config.h"
 
+#include "common/dircache.h"
+
 #include <guacamole/client.h>
 #include <guacamole/pool.h>
 
@@ -211,10 +213,18 @@ typedef struct guac_rdp_fs_file {
     int fd;
 
     /**
-     * Associated directory stream, if any. This field only applies
-     * if the file is being used as a directory.
+     * The contents of the directory, if the file is a directory which is
+     * being read with guac_rdp_fs_read_dir(). The listing is shared with the
+     * directory cache of the filesystem, and is NULL until the directory is
+     * first read.
+     */
+    guac_common_dircache_listing* listing;
+
+    /**
+     * The index of the next entry within the directory listing to be
+     * returned by guac_rdp_fs_read_dir().
      */
-    DIR* dir;
+    int listing_index;
 
     /**
      * The pattern the check directory contents against, if any.
@@ -283,6 +293,13 @@ typedef struct guac_rdp_fs {
      */
     guac_rdp_fs_file files[GUAC_RDP_FS_MAX_FILES];
 
+    /**
+     * Cache of recently-read directories, keyed by real path. Listings are
+     * invalidated when files are created, renamed, or deleted through this
+     * filesystem.
+     */
+    guac_common_dircache* dircache;
+
 } guac_rdp_fs;
 
 /**
@@ -627,7 +644,9 @@ int guac_rdp_fs_convert_path(const char* parent, const char* rel_path,
 
 /**
  * Returns the next filename within the directory having the given file ID,
- * or NULL if no more files.
+ * or NULL if no more files. The contents of the directory are read in their
+ * entirety upon the first call, and are cached such that directories read
+ * repeatedly need not be read from disk each time.
  *
  * @param fs
  *     The filesystem containing the file to read directory entries from.
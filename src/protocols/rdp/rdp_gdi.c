@@ -28,6 +28,7 @@
 
 #include <cairo/cairo.h>
 #include <freerdp/freerdp.h>
+#include <freerdp/gdi/gdi.h>
 #include <guacamole/client.h>
 #include <guacamole/protocol.h>
 #include <winpr/wtypes.h>
@@ -289,9 +290,11 @@ BOOL guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt) {
             }
 
             /* Otherwise, copy */
-            else
+            else {
+                guac_rdp_bitmap_touch(context, memblt->bitmap);
                 guac_common_surface_copy(bitmap->layer->surface,
                         x_src, y_src, w, h, current_surface, x, y);
+            }
 
             /* Increment usage counter */
             ((guac_rdp_bitmap*) bitmap)->used++;
@@ -310,6 +313,8 @@ BOOL guac_rdp_gdi_memblt(rdpContext* context, MEMBLT_ORDER* memblt) {
             /* If not available as a surface, make available. */
             if (bitmap->layer == NULL)
                 guac_rdp_cache_bitmap(context, memblt->bitmap);
+            else
+                guac_rdp_bitmap_touch(context, memblt->bitmap);
 
             guac_common_surface_transfer(bitmap->layer->surface,
                     x_src, y_src, w, h,
@@ -433,10 +438,50 @@ BOOL guac_rdp_gdi_set_bounds(rdpContext* context, const rdpBounds* bounds) {
 
 }
 
+BOOL guac_rdp_gdi_init(freerdp* instance) {
+
+    rdpContext* context = instance->context;
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_common_surface* surface = rdp_client->display->default_surface;
+
+    /* Ensure the surface buffer is large enough for the negotiated size */
+    guac_common_surface_resize(surface,
+            guac_rdp_get_width(instance),
+            guac_rdp_get_height(instance));
+
+    /* Render directly into the surface buffer, which remains owned by the
+     * surface (no free function is provided to FreeRDP) */
+    return gdi_init_ex(instance, GUAC_RDP_GDI_PIXEL_FORMAT, surface->stride,
+            surface->buffer, NULL);
+
+}
+
 BOOL guac_rdp_gdi_end_paint(rdpContext* context) {
 
-    /* IGNORE */
-		return TRUE;
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+    guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_common_surface* surface = rdp_client->display->default_surface;
+
+    rdpGdi* gdi = context->gdi;
+    HGDI_WND hwnd = gdi->primary->hdc->hwnd;
+
+    /* Nothing to do if the GDI itself has drawn nothing */
+    if (hwnd->invalid->null)
+        return TRUE;
+
+    /* Report each region drawn by the GDI to the surface */
+    for (int i = 0; i < hwnd->ninvalid; i++) {
+        HGDI_RGN region = &(hwnd->cinvalid[i]);
+        guac_common_surface_invalidate(surface,
+                region->x, region->y, region->w, region->h);
+    }
+
+    /* All regions have now been accounted for */
+    hwnd->invalid->null = TRUE;
+    hwnd->ninvalid = 0;
+
+    return TRUE;
 
 }
 
@@ -444,19 +489,23 @@ BOOL guac_rdp_gdi_desktop_resize(rdpContext* context) {
 
     guac_client* client = ((rdp_freerdp_context*) context)->client;
     guac_rdp_client* rdp_client = (guac_rdp_client*) client->data;
+    guac_common_surface* surface = rdp_client->display->default_surface;
+
+    int width = guac_rdp_get_width(context->instance);
+    int height = guac_rdp_get_height(context->instance);
 
-    guac_common_surface_resize(rdp_client->display->default_surface,
-            guac_rdp_get_width(context->instance),
-            guac_rdp_get_height(context->instance));
+    guac_common_surface_resize(surface, width, height);
+    guac_common_surface_reset_clip(surface);
 
-    guac_common_surface_reset_clip(rdp_client->display->default_surface);
+    /* Point the GDI at the reallocated surface buffer */
+    if (!gdi_resize_ex(context->gdi, width, height, surface->stride,
+                GUAC_RDP_GDI_PIXEL_FORMAT, surface->buffer, NULL))
+        return FALSE;
 
     guac_client_log(client, GUAC_LOG_DEBUG, "Server resized display to %ix%i",
-            guac_rdp_get_width(context->instance),
-            guac_rdp_get_height(context->instance));
+            width, height);
 
-		return TRUE;
+    return TRUE;
 
 }
 
-
@@ -23,9 +23,22 @@
 
 #include "config.h"
 
+#include <freerdp/codec/color.h>
 #include <freerdp/freerdp.h>
 #include <guacamole/protocol.h>
 
+/**
+ * The FreeRDP pixel format which matches the in-memory layout of the 32-bit
+ * ARGB pixels of a guac_common_surface (Cairo's CAIRO_FORMAT_ARGB32, which is
+ * stored in native byte order). FreeRDP names pixel formats by the order of
+ * their components in memory.
+ */
+#ifdef WORDS_BIGENDIAN
+#define GUAC_RDP_GDI_PIXEL_FORMAT PIXEL_FORMAT_ARGB32
+#else
+#define GUAC_RDP_GDI_PIXEL_FORMAT PIXEL_FORMAT_BGRA32
+#endif
+
 /**
  * Translates a standard RDP ROP3 value into a guac_composite_mode. Valid
  * ROP3 operations indexes are listed in the RDP protocol specifications:
@@ -128,8 +141,25 @@ BOOL guac_rdp_gdi_palette_update(rdpContext* context, const PALETTE_UPDATE* pale
 BOOL guac_rdp_gdi_set_bounds(rdpContext* context, const rdpBounds* bounds);
 
 /**
- * Handler called when a paint operation is complete. We don't actually
- * use this, but FreeRDP requires it. Calling this function has no effect.
+ * Initializes FreeRDP's GDI such that it renders directly into the buffer of
+ * the default surface of the Guacamole display, rather than allocating a
+ * separate framebuffer. The default surface is first resized to match the
+ * dimensions of the RDP session. Any regions of the buffer modified by the
+ * GDI are later reported to the surface by guac_rdp_gdi_end_paint().
+ *
+ * @param instance
+ *     The FreeRDP instance that has just connected.
+ *
+ * @return
+ *     TRUE if the GDI was initialized successfully, FALSE otherwise.
+ */
+BOOL guac_rdp_gdi_init(freerdp* instance);
+
+/**
+ * Handler called when a paint operation is complete. Any regions of the
+ * default surface which were drawn by FreeRDP's GDI, rather than by the
+ * Guacamole handlers for RDP orders, are marked as modified such that they
+ * will be sent to connected users.
  *
  * @param context
  *     The rdpContext associated with the current RDP session.
@@ -140,7 +170,8 @@ BOOL guac_rdp_gdi_end_paint(rdpContext* context);
  * Handler called when the desktop dimensions change, either from a
  * true desktop resize event received by the RDP client, or due to
  * a revised size given by the server during initial connection
- * negotiation.
+ * negotiation. As the default surface and FreeRDP's GDI share the same
+ * framebuffer, the GDI is resized to use the reallocated surface buffer.
  *
  * The new screen size will be made available within the settings associated
  * with the given context.
@@ -0,0 +1,835 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "client.h"
+#include "common/display.h"
+#include "common/surface.h"
+#include "rdp.h"
+#include "rdp_gdi.h"
+#include "rdp_gfx.h"
+
+#include <freerdp/channels/rdpgfx.h>
+#include <freerdp/client/rdpgfx.h>
+#include <freerdp/codec/clear.h>
+#include <freerdp/codec/color.h>
+#include <freerdp/codec/planar.h>
+#include <freerdp/codec/progressive.h>
+#include <freerdp/codec/region.h>
+#include <freerdp/codec/rfx.h>
+#include <freerdp/freerdp.h>
+#include <guacamole/client.h>
+#include <winpr/wtypes.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+
+/**
+ * Returns the guac_client associated with the given graphics pipeline
+ * channel, as stored by guac_rdp_gfx_connect().
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @return
+ *     The guac_client associated with the given channel.
+ */
+static guac_client* guac_rdp_gfx_get_client(RdpgfxClientContext* gfx) {
+    rdpContext* context = (rdpContext*) gfx->custom;
+    return ((rdp_freerdp_context*) context)->client;
+}
+
+/**
+ * Returns the Guacamole display of the RDP session associated with the given
+ * graphics pipeline channel.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @return
+ *     The display of the associated RDP session.
+ */
+static guac_common_display* guac_rdp_gfx_get_display(
+        RdpgfxClientContext* gfx) {
+    guac_client* client = guac_rdp_gfx_get_client(gfx);
+    return ((guac_rdp_client*) client->data)->display;
+}
+
+/**
+ * Returns the surface having the given ID, as previously created by the RDP
+ * server, logging a warning if no such surface exists.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param surface_id
+ *     The ID of the surface to retrieve.
+ *
+ * @return
+ *     The surface having the given ID, or NULL if no such surface exists.
+ */
+static guac_rdp_gfx_surface* guac_rdp_gfx_get_surface(
+        RdpgfxClientContext* gfx, UINT16 surface_id) {
+
+    guac_rdp_gfx_surface* surface =
+        (guac_rdp_gfx_surface*) gfx->GetSurfaceData(gfx, surface_id);
+
+    if (surface == NULL)
+        guac_client_log(guac_rdp_gfx_get_client(gfx), GUAC_LOG_WARNING,
+                "RDPGFX command references nonexistent surface %i.",
+                surface_id);
+
+    return surface;
+
+}
+
+/**
+ * Frees the given cache slot, if allocated, returning its buffer to the
+ * display.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param cache_slot
+ *     The index of the cache slot to free.
+ */
+static void guac_rdp_gfx_free_cache_slot(RdpgfxClientContext* gfx,
+        UINT16 cache_slot) {
+
+    guac_common_display_layer* buffer =
+        (guac_common_display_layer*) gfx->GetCacheSlotData(gfx, cache_slot);
+
+    if (buffer == NULL)
+        return;
+
+    guac_common_display_free_buffer(guac_rdp_gfx_get_display(gfx), buffer);
+    gfx->SetCacheSlotData(gfx, cache_slot, NULL);
+
+}
+
+/**
+ * Frees the surface having the given ID, if it exists, including any
+ * backing buffer and codec state.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param surface_id
+ *     The ID of the surface to free.
+ */
+static void guac_rdp_gfx_free_surface(RdpgfxClientContext* gfx,
+        UINT16 surface_id) {
+
+    guac_rdp_gfx_surface* surface =
+        (guac_rdp_gfx_surface*) gfx->GetSurfaceData(gfx, surface_id);
+
+    if (surface == NULL)
+        return;
+
+    /* Free backing buffer (surfaces mapped to output have none) */
+    if (surface->buffer != NULL)
+        guac_common_display_free_buffer(guac_rdp_gfx_get_display(gfx),
+                surface->buffer);
+
+    /* Free progressive codec state associated with surface */
+    rdpContext* context = (rdpContext*) gfx->custom;
+    progressive_delete_surface_context(context->codecs->progressive,
+            surface_id);
+
+    gfx->SetSurfaceData(gfx, surface_id, NULL);
+    free(surface);
+
+}
+
+/**
+ * Frees all surfaces and cache slots allocated via the given graphics
+ * pipeline channel.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ */
+static void guac_rdp_gfx_free_all(RdpgfxClientContext* gfx) {
+
+    UINT16* surface_ids;
+    UINT16 count;
+
+    /* Free all surfaces */
+    if (gfx->GetSurfaceIds(gfx, &surface_ids, &count) == CHANNEL_RC_OK) {
+
+        for (int i = 0; i < count; i++)
+            guac_rdp_gfx_free_surface(gfx, surface_ids[i]);
+
+        free(surface_ids);
+
+    }
+
+    /* Free all cache slots */
+    for (int i = 0; i <= RDPGFX_CACHE_ENTRY_MAX_COUNT; i++)
+        guac_rdp_gfx_free_cache_slot(gfx, i);
+
+}
+
+/**
+ * Handler for the RDPGFX ResetGraphics PDU, which deletes all surfaces and
+ * cache entries and establishes the size of the output.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param reset_graphics
+ *     The received ResetGraphics PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the PDU was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_reset_graphics(RdpgfxClientContext* gfx,
+        const RDPGFX_RESET_GRAPHICS_PDU* reset_graphics) {
+
+    rdpContext* context = (rdpContext*) gfx->custom;
+    guac_rdp_client* rdp_client =
+        (guac_rdp_client*) guac_rdp_gfx_get_client(gfx)->data;
+    guac_common_surface* default_surface = rdp_client->display->default_surface;
+
+    UINT result = CHANNEL_RC_OK;
+
+    /* The buffer shared with the GDI is reallocated by the resize, and must
+     * not be replaced while the GDI may still be drawing to it */
+    pthread_mutex_lock(&(rdp_client->rdp_lock));
+
+    guac_rdp_gfx_free_all(gfx);
+
+    /* Resize output, keeping the GDI pointed at the surface buffer */
+    guac_common_surface_resize(default_surface,
+            reset_graphics->width, reset_graphics->height);
+    guac_common_surface_reset_clip(default_surface);
+
+    if (!gdi_resize_ex(context->gdi, reset_graphics->width,
+                reset_graphics->height, default_surface->stride,
+                GUAC_RDP_GDI_PIXEL_FORMAT, default_surface->buffer, NULL))
+        result = ERROR_INTERNAL_ERROR;
+
+    pthread_mutex_unlock(&(rdp_client->rdp_lock));
+    return result;
+
+}
+
+/**
+ * Handler for the RDPGFX CreateSurface PDU, which allocates a new off-screen
+ * surface backed by a Guacamole buffer.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param create_surface
+ *     The received CreateSurface PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the PDU was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_create_surface(RdpgfxClientContext* gfx,
+        const RDPGFX_CREATE_SURFACE_PDU* create_surface) {
+
+    rdpContext* context = (rdpContext*) gfx->custom;
+
+    /* Replace any existing surface having the same ID */
+    guac_rdp_gfx_free_surface(gfx, create_surface->surfaceId);
+
+    guac_rdp_gfx_surface* surface = calloc(1, sizeof(guac_rdp_gfx_surface));
+    if (surface == NULL)
+        return CHANNEL_RC_NO_MEMORY;
+
+    surface->id = create_surface->surfaceId;
+    surface->width = create_surface->width;
+    surface->height = create_surface->height;
+    surface->alpha =
+        (create_surface->pixelFormat == GFX_PIXEL_FORMAT_ARGB_8888);
+
+    /* Surfaces are off-screen until mapped to the output */
+    guac_common_display* display = guac_rdp_gfx_get_display(gfx);
+    surface->buffer = guac_common_display_alloc_buffer(display,
+            surface->width, surface->height);
+    if (surface->buffer == NULL) {
+        free(surface);
+        return CHANNEL_RC_NO_MEMORY;
+    }
+
+    surface->surface = surface->buffer->surface;
+
+    /* Progressive codec state is maintained per surface */
+    if (progressive_create_surface_context(context->codecs->progressive,
+                surface->id, surface->width, surface->height) < 0) {
+        guac_common_display_free_buffer(display, surface->buffer);
+        free(surface);
+        return CHANNEL_RC_NO_MEMORY;
+    }
+
+    return gfx->SetSurfaceData(gfx, surface->id, surface);
+
+}
+
+/**
+ * Handler for the RDPGFX DeleteSurface PDU.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param delete_surface
+ *     The received DeleteSurface PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the PDU was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_delete_surface(RdpgfxClientContext* gfx,
+        const RDPGFX_DELETE_SURFACE_PDU* delete_surface) {
+
+    guac_rdp_gfx_free_surface(gfx, delete_surface->surfaceId);
+    return CHANNEL_RC_OK;
+
+}
+
+/**
+ * Handler for the RDPGFX MapSurfaceToOutput PDU. The contents of the
+ * surface, if any, are copied to the default surface at the given origin,
+ * after which the default surface backs the surface directly and its buffer
+ * is freed.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param map_surface
+ *     The received MapSurfaceToOutput PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the PDU was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_map_surface_to_output(RdpgfxClientContext* gfx,
+        const RDPGFX_MAP_SURFACE_TO_OUTPUT_PDU* map_surface) {
+
+    guac_common_display* display = guac_rdp_gfx_get_display(gfx);
+
+    guac_rdp_gfx_surface* surface = guac_rdp_gfx_get_surface(gfx,
+            map_surface->surfaceId);
+    if (surface == NULL)
+        return ERROR_INTERNAL_ERROR;
+
+    int x = map_surface->outputOriginX;
+    int y = map_surface->outputOriginY;
+
+    /* Move existing contents from backing buffer to output */
+    if (surface->buffer != NULL) {
+        guac_common_surface_copy(surface->surface, surface->x, surface->y,
+                surface->width, surface->height,
+                display->default_surface, x, y);
+        guac_common_display_free_buffer(display, surface->buffer);
+        surface->buffer = NULL;
+    }
+
+    /* Draw directly to output from now on */
+    surface->surface = display->default_surface;
+    surface->x = x;
+    surface->y = y;
+
+    return CHANNEL_RC_OK;
+
+}
+
+/**
+ * Handler for the RDPGFX SolidFill PDU, which fills rectangles of a surface
+ * with a single color. Each rectangle is sent as a simple rectangle fill.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param solid_fill
+ *     The received SolidFill PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the PDU was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_solid_fill(RdpgfxClientContext* gfx,
+        const RDPGFX_SOLID_FILL_PDU* solid_fill) {
+
+    guac_rdp_gfx_surface* surface = guac_rdp_gfx_get_surface(gfx,
+            solid_fill->surfaceId);
+    if (surface == NULL)
+        return ERROR_INTERNAL_ERROR;
+
+    const RDPGFX_COLOR32* color = &(solid_fill->fillPixel);
+    int alpha = surface->alpha ? color->XA : 0xFF;
+
+    for (int i = 0; i < solid_fill->fillRectCount; i++) {
+
+        const RECTANGLE_16* rect = &(solid_fill->fillRects[i]);
+
+        guac_common_surface_set(surface->surface,
+                surface->x + rect->left, surface->y + rect->top,
+                rect->right - rect->left, rect->bottom - rect->top,
+                color->R, color->G, color->B, alpha);
+
+    }
+
+    return CHANNEL_RC_OK;
+
+}
+
+/**
+ * Handler for the RDPGFX SurfaceToSurface PDU, which copies a rectangle of
+ * one surface to any number of locations within another (or the same)
+ * surface. Each copy is performed by the Guacamole client.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param surface_to_surface
+ *     The received SurfaceToSurface PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the PDU was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_surface_to_surface(RdpgfxClientContext* gfx,
+        const RDPGFX_SURFACE_TO_SURFACE_PDU* surface_to_surface) {
+
+    guac_rdp_gfx_surface* src = guac_rdp_gfx_get_surface(gfx,
+            surface_to_surface->surfaceIdSrc);
+    guac_rdp_gfx_surface* dst = guac_rdp_gfx_get_surface(gfx,
+            surface_to_surface->surfaceIdDest);
+    if (src == NULL || dst == NULL)
+        return ERROR_INTERNAL_ERROR;
+
+    const RECTANGLE_16* rect = &(surface_to_surface->rectSrc);
+    int width = rect->right - rect->left;
+    int height = rect->bottom - rect->top;
+
+    for (int i = 0; i < surface_to_surface->destPtsCount; i++) {
+
+        const RDPGFX_POINT16* point = &(surface_to_surface->destPts[i]);
+
+        guac_common_surface_copy(src->surface,
+                src->x + rect->left, src->y + rect->top, width, height,
+                dst->surface, dst->x + point->x, dst->y + point->y);
+
+    }
+
+    return CHANNEL_RC_OK;
+
+}
+
+/**
+ * Handler for the RDPGFX SurfaceToCache PDU, which stores a rectangle of a
+ * surface within a cache slot. Each cache slot is backed by a Guacamole
+ * buffer, such that the cached image data never need be sent again.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param surface_to_cache
+ *     The received SurfaceToCache PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the PDU was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_surface_to_cache(RdpgfxClientContext* gfx,
+        const RDPGFX_SURFACE_TO_CACHE_PDU* surface_to_cache) {
+
+    guac_rdp_gfx_surface* surface = guac_rdp_gfx_get_surface(gfx,
+            surface_to_cache->surfaceId);
+    if (surface == NULL)
+        return ERROR_INTERNAL_ERROR;
+
+    const RECTANGLE_16* rect = &(surface_to_cache->rectSrc);
+    int width = rect->right - rect->left;
+    int height = rect->bottom - rect->top;
+
+    /* Replace any existing cache entry */
+    guac_rdp_gfx_free_cache_slot(gfx, surface_to_cache->cacheSlot);
+
+    guac_common_display_layer* buffer = guac_common_display_alloc_buffer(
+            guac_rdp_gfx_get_display(gfx), width, height);
+    if (buffer == NULL)
+        return CHANNEL_RC_NO_MEMORY;
+
+    guac_common_surface_copy(surface->surface,
+            surface->x + rect->left, surface->y + rect->top, width, height,
+            buffer->surface, 0, 0);
+
+    return gfx->SetCacheSlotData(gfx, surface_to_cache->cacheSlot, buffer);
+
+}
+
+/**
+ * Handler for the RDPGFX CacheToSurface PDU, which copies the contents of a
+ * cache slot to any number of locations within a surface.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param cache_to_surface
+ *     The received CacheToSurface PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the PDU was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_cache_to_surface(RdpgfxClientContext* gfx,
+        const RDPGFX_CACHE_TO_SURFACE_PDU* cache_to_surface) {
+
+    guac_rdp_gfx_surface* surface = guac_rdp_gfx_get_surface(gfx,
+            cache_to_surface->surfaceId);
+    if (surface == NULL)
+        return ERROR_INTERNAL_ERROR;
+
+    guac_common_display_layer* buffer = (guac_common_display_layer*)
+        gfx->GetCacheSlotData(gfx, cache_to_surface->cacheSlot);
+
+    if (buffer == NULL) {
+        guac_client_log(guac_rdp_gfx_get_client(gfx), GUAC_LOG_WARNING,
+                "RDPGFX command references empty cache slot %i.",
+                cache_to_surface->cacheSlot);
+        return ERROR_INTERNAL_ERROR;
+    }
+
+    for (int i = 0; i < cache_to_surface->destPtsCount; i++) {
+
+        const RDPGFX_POINT16* point = &(cache_to_surface->destPts[i]);
+
+        guac_common_surface_copy(buffer->surface, 0, 0,
+                buffer->surface->width, buffer->surface->height,
+                surface->surface, surface->x + point->x,
+                surface->y + point->y);
+
+    }
+
+    return CHANNEL_RC_OK;
+
+}
+
+/**
+ * Handler for the RDPGFX EvictCacheEntry PDU.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param evict_cache_entry
+ *     The received EvictCacheEntry PDU.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the PDU was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_evict_cache_entry(RdpgfxClientContext* gfx,
+        const RDPGFX_EVICT_CACHE_ENTRY_PDU* evict_cache_entry) {
+
+    guac_rdp_gfx_free_cache_slot(gfx, evict_cache_entry->cacheSlot);
+    return CHANNEL_RC_OK;
+
+}
+
+/**
+ * Marks each rectangle within the given region as modified within the given
+ * guac_common_surface.
+ *
+ * @param target
+ *     The guac_common_surface containing the modified region.
+ *
+ * @param region
+ *     The modified region, in coordinates relative to the given
+ *     guac_common_surface.
+ */
+static void guac_rdp_gfx_invalidate_region(guac_common_surface* target,
+        REGION16* region) {
+
+    UINT32 count;
+    const RECTANGLE_16* rects = region16_rects(region, &count);
+
+    for (UINT32 i = 0; i < count; i++)
+        guac_common_surface_invalidate(target,
+                rects[i].left, rects[i].top,
+                rects[i].right - rects[i].left,
+                rects[i].bottom - rects[i].top);
+
+}
+
+/**
+ * The state of a single RDPGFX surface command while its image data is
+ * decoded into the buffer of the target guac_common_surface.
+ */
+typedef struct guac_rdp_gfx_decode_state {
+
+    /**
+     * The codecs of the RDP session.
+     */
+    rdpCodecs* codecs;
+
+    /**
+     * The surface command being decoded.
+     */
+    const RDPGFX_SURFACE_COMMAND* cmd;
+
+    /**
+     * The RDPGFX surface targeted by the command.
+     */
+    guac_rdp_gfx_surface* surface;
+
+    /**
+     * The X coordinate of the upper-left corner of the command's rectangle,
+     * relative to the target guac_common_surface.
+     */
+    int x;
+
+    /**
+     * The Y coordinate of the upper-left corner of the command's rectangle,
+     * relative to the target guac_common_surface.
+     */
+    int y;
+
+    /**
+     * The region actually drawn by the codec, relative to the target
+     * guac_common_surface.
+     */
+    REGION16 region;
+
+} guac_rdp_gfx_decode_state;
+
+/**
+ * Decodes the image data of an RDPGFX surface command directly into the
+ * buffer of the target guac_common_surface, recording the region drawn. This
+ * function is invoked via guac_common_surface_modify(), and thus runs with
+ * the surface locked.
+ *
+ * @param target
+ *     The guac_common_surface receiving the decoded image data.
+ *
+ * @param data
+ *     The guac_rdp_gfx_decode_state describing the command.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the command was decoded successfully, an error code
+ *     otherwise.
+ */
+static int guac_rdp_gfx_decode(guac_common_surface* target, void* data) {
+
+    guac_rdp_gfx_decode_state* state = (guac_rdp_gfx_decode_state*) data;
+    const RDPGFX_SURFACE_COMMAND* cmd = state->cmd;
+    guac_rdp_gfx_surface* surface = state->surface;
+    rdpCodecs* codecs = state->codecs;
+
+    int x = state->x;
+    int y = state->y;
+
+    /* Refuse to decode anything outside the backing surface */
+    if (x + cmd->width > target->width || y + cmd->height > target->height)
+        return ERROR_INVALID_DATA;
+
+    switch (cmd->codecId) {
+
+        /* Raw pixel data */
+        case RDPGFX_CODECID_UNCOMPRESSED:
+            if (cmd->length < cmd->width * cmd->height * 4
+                    || !freerdp_image_copy(target->buffer,
+                        GUAC_RDP_GDI_PIXEL_FORMAT, target->stride, x, y,
+                        cmd->width, cmd->height, cmd->data, cmd->format,
+                        cmd->width * 4, 0, 0, NULL, FREERDP_FLIP_NONE))
+                return ERROR_INVALID_DATA;
+            break;
+
+        /* Planar (RLE-compressed color planes) */
+        case RDPGFX_CODECID_PLANAR:
+            if (!planar_decompress(codecs->planar, cmd->data, cmd->length,
+                        cmd->width, cmd->height, target->buffer,
+                        GUAC_RDP_GDI_PIXEL_FORMAT, target->stride, x, y,
+                        cmd->width, cmd->height, FALSE))
+                return ERROR_INVALID_DATA;
+            break;
+
+        /* ClearCodec (draws upon existing surface contents) */
+        case RDPGFX_CODECID_CLEARCODEC:
+            if (clear_decompress(codecs->clear, cmd->data, cmd->length,
+                        cmd->width, cmd->height, target->buffer,
+                        GUAC_RDP_GDI_PIXEL_FORMAT, target->stride, x, y,
+                        target->width, target->height, NULL) < 0)
+                return ERROR_INVALID_DATA;
+            break;
+
+        /* RemoteFX, which reports the regions actually drawn relative to the
+         * backing surface */
+        case RDPGFX_CODECID_CAVIDEO:
+            if (!rfx_process_message(codecs->rfx, cmd->data, cmd->length,
+                        x, y, target->buffer, GUAC_RDP_GDI_PIXEL_FORMAT,
+                        target->stride, target->height, &state->region))
+                return ERROR_INVALID_DATA;
+            return CHANNEL_RC_OK;
+
+        /* Progressive RemoteFX, which reports the regions actually drawn
+         * relative to the backing surface */
+        case RDPGFX_CODECID_CAPROGRESSIVE:
+
+            /* Tiles may be anywhere within the surface */
+            if (surface->x + surface->width > target->width
+                    || surface->y + surface->height > target->height)
+                return ERROR_INVALID_DATA;
+
+            if (progressive_decompress(codecs->progressive, cmd->data,
+                        cmd->length, target->buffer,
+                        GUAC_RDP_GDI_PIXEL_FORMAT, target->stride,
+                        surface->x, surface->y, &state->region,
+                        cmd->surfaceId) < 0)
+                return ERROR_INVALID_DATA;
+            return CHANNEL_RC_OK;
+
+        /* Unsupported codecs are filtered out before decoding */
+        default:
+            return ERROR_INVALID_DATA;
+
+    }
+
+    /* Entire rectangle of command has been redrawn */
+    RECTANGLE_16 rect = {
+        .left   = x,
+        .top    = y,
+        .right  = x + cmd->width,
+        .bottom = y + cmd->height
+    };
+
+    if (!region16_union_rect(&state->region, &state->region, &rect))
+        return CHANNEL_RC_NO_MEMORY;
+
+    return CHANNEL_RC_OK;
+
+}
+
+/**
+ * Handler for RDPGFX surface commands (WireToSurface1 and WireToSurface2
+ * PDUs), which contain compressed image data for a rectangle of a surface.
+ * The image data is decoded directly into the buffer of the backing
+ * guac_common_surface while that surface is locked, and the affected
+ * rectangles are then marked as modified such that they will be encoded and
+ * sent with the next flush.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel.
+ *
+ * @param cmd
+ *     The received surface command.
+ *
+ * @return
+ *     CHANNEL_RC_OK if the command was handled successfully, an error code
+ *     otherwise.
+ */
+static UINT guac_rdp_gfx_surface_command(RdpgfxClientContext* gfx,
+        const RDPGFX_SURFACE_COMMAND* cmd) {
+
+    rdpContext* context = (rdpContext*) gfx->custom;
+    guac_client* client = guac_rdp_gfx_get_client(gfx);
+
+    guac_rdp_gfx_surface* surface = guac_rdp_gfx_get_surface(gfx,
+            cmd->surfaceId);
+    if (surface == NULL)
+        return ERROR_INTERNAL_ERROR;
+
+    guac_common_surface* target = surface->surface;
+
+    guac_rdp_gfx_decode_state state = {
+        .codecs  = context->codecs,
+        .cmd     = cmd,
+        .surface = surface,
+        .x       = surface->x + cmd->left,
+        .y       = surface->y + cmd->top
+    };
+
+    /* Refuse to decode anything outside the RDPGFX surface */
+    if (cmd->left + cmd->width > surface->width
+            || cmd->top + cmd->height > surface->height) {
+        guac_client_log(client, GUAC_LOG_WARNING, "RDPGFX surface command "
+                "exceeds bounds of surface %i.", cmd->surfaceId);
+        return ERROR_INVALID_DATA;
+    }
+
+    switch (cmd->codecId) {
+
+        case RDPGFX_CODECID_UNCOMPRESSED:
+        case RDPGFX_CODECID_PLANAR:
+        case RDPGFX_CODECID_CLEARCODEC:
+        case RDPGFX_CODECID_CAVIDEO:
+        case RDPGFX_CODECID_CAPROGRESSIVE:
+            break;
+
+        /* H.264 is not advertised, and alpha-only updates are unsupported */
+        default:
+            guac_client_log(client, GUAC_LOG_DEBUG, "Ignoring RDPGFX surface "
+                    "command using unsupported codec 0x%X.", cmd->codecId);
+            return CHANNEL_RC_OK;
+
+    }
+
+    region16_init(&state.region);
+
+    UINT result = guac_common_surface_modify(target,
+            guac_rdp_gfx_decode, &state);
+
+    /* Report everything drawn, even if decoding ultimately failed */
+    guac_rdp_gfx_invalidate_region(target, &state.region);
+    region16_uninit(&state.region);
+
+    return result;
+
+}
+
+void guac_rdp_gfx_connect(rdpContext* context, RdpgfxClientContext* gfx) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+
+    gfx->custom = context;
+
+    gfx->ResetGraphics = guac_rdp_gfx_reset_graphics;
+    gfx->CreateSurface = guac_rdp_gfx_create_surface;
+    gfx->DeleteSurface = guac_rdp_gfx_delete_surface;
+    gfx->MapSurfaceToOutput = guac_rdp_gfx_map_surface_to_output;
+    gfx->SolidFill = guac_rdp_gfx_solid_fill;
+    gfx->SurfaceToSurface = guac_rdp_gfx_surface_to_surface;
+    gfx->SurfaceToCache = guac_rdp_gfx_surface_to_cache;
+    gfx->CacheToSurface = guac_rdp_gfx_cache_to_surface;
+    gfx->EvictCacheEntry = guac_rdp_gfx_evict_cache_entry;
+    gfx->SurfaceCommand = guac_rdp_gfx_surface_command;
+
+    guac_client_log(client, GUAC_LOG_DEBUG,
+            "Graphics pipeline (RDPGFX) channel connected.");
+
+}
+
+void guac_rdp_gfx_disconnect(rdpContext* context, RdpgfxClientContext* gfx) {
+
+    guac_client* client = ((rdp_freerdp_context*) context)->client;
+
+    guac_rdp_gfx_free_all(gfx);
+    gfx->custom = NULL;
+
+    guac_client_log(client, GUAC_LOG_DEBUG,
+            "Graphics pipeline (RDPGFX) channel disconnected.");
+
+}
+
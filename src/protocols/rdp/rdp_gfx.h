@@ -0,0 +1,120 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#ifndef GUAC_RDP_GFX_H
+#define GUAC_RDP_GFX_H
+
+#include "config.h"
+
+#include "common/display.h"
+#include "common/surface.h"
+
+#include <freerdp/client/rdpgfx.h>
+#include <freerdp/freerdp.h>
+
+/**
+ * A surface created by the RDP server via the graphics pipeline (RDPGFX).
+ * Surfaces which have not been mapped to the output are backed by Guacamole
+ * buffers, while a surface which has been mapped to the output is backed
+ * directly by the default surface of the display, offset by the origin given
+ * when the surface was mapped.
+ */
+typedef struct guac_rdp_gfx_surface {
+
+    /**
+     * The ID assigned to this surface by the RDP server.
+     */
+    UINT16 id;
+
+    /**
+     * The width of this surface, in pixels.
+     */
+    int width;
+
+    /**
+     * The height of this surface, in pixels.
+     */
+    int height;
+
+    /**
+     * Whether this surface has an alpha channel (GFX_PIXEL_FORMAT_ARGB_8888).
+     * If zero, all pixels are treated as opaque.
+     */
+    int alpha;
+
+    /**
+     * The Guacamole buffer backing this surface, or NULL if this surface has
+     * been mapped to the output and is thus backed by the default surface.
+     */
+    guac_common_display_layer* buffer;
+
+    /**
+     * The guac_common_surface which receives all drawing operations for this
+     * surface. This will be the surface of the backing buffer, or the default
+     * surface of the display if this surface has been mapped to the output.
+     */
+    guac_common_surface* surface;
+
+    /**
+     * The X coordinate within the backing guac_common_surface of the
+     * upper-left corner of this surface.
+     */
+    int x;
+
+    /**
+     * The Y coordinate within the backing guac_common_surface of the
+     * upper-left corner of this surface.
+     */
+    int y;
+
+} guac_rdp_gfx_surface;
+
+/**
+ * Handles the connection of the graphics pipeline dynamic virtual channel,
+ * assigning the handlers which translate RDPGFX commands into operations on
+ * the Guacamole display. Solid fills become rectangle fills, copies between
+ * surfaces and cache slots become copies between Guacamole layers and
+ * buffers (performed entirely by the client), and compressed tiles are
+ * decoded directly into the backing surface.
+ *
+ * @param context
+ *     The rdpContext associated with the current RDP session.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel which has just
+ *     connected.
+ */
+void guac_rdp_gfx_connect(rdpContext* context, RdpgfxClientContext* gfx);
+
+/**
+ * Handles the disconnection of the graphics pipeline dynamic virtual
+ * channel, freeing all surfaces and cache entries which remain allocated.
+ *
+ * @param context
+ *     The rdpContext associated with the current RDP session.
+ *
+ * @param gfx
+ *     The client context of the graphics pipeline channel which is
+ *     disconnecting.
+ */
+void guac_rdp_gfx_disconnect(rdpContext* context, RdpgfxClientContext* gfx);
+
+#endif
+
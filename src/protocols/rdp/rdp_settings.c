@@ -71,6 +71,7 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "disable-bitmap-caching",
     "disable-offscreen-caching",
     "disable-glyph-caching",
+    "cache-memory-limit",
     "preconnection-id",
     "preconnection-blob",
 
@@ -97,6 +98,7 @@ const char* GUAC_RDP_CLIENT_ARGS[] = {
     "resize-method",
     "enable-audio-input",
     "read-only",
+    "disable-gfx",
 
 #ifdef HAVE_FREERDP_GATEWAY_SUPPORT
     "gateway-hostname",
@@ -337,6 +339,13 @@ enum RDP_ARGS_IDX {
      */
     IDX_DISABLE_GLYPH_CACHING,
 
+    /**
+     * The maximum amount of memory which may be consumed by cached bitmaps
+     * and offscreen surfaces, in megabytes. If zero, cache memory is not
+     * limited. By default, GUAC_RDP_DEFAULT_CACHE_MEMORY_LIMIT is used.
+     */
+    IDX_CACHE_MEMORY_LIMIT,
+
     /**
      * The preconnection ID to send within the preconnection PDU when
      * initiating an RDP connection, if any.
@@ -482,6 +491,12 @@ enum RDP_ARGS_IDX {
      */
     IDX_READ_ONLY,
 
+    /**
+     * "true" if the graphics pipeline (RDPGFX) should NOT be used even if
+     * supported by FreeRDP and the RDP server, "false" or blank otherwise.
+     */
+    IDX_DISABLE_GFX,
+
 #ifdef HAVE_FREERDP_GATEWAY_SUPPORT
     /**
      * The hostname of the remote desktop gateway that should be used as an
@@ -677,6 +692,11 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_READ_ONLY, 0);
 
+    /* Graphics pipeline */
+    settings->disable_gfx =
+        guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_DISABLE_GFX, 0);
+
     /* Client name */
     settings->client_name =
         guac_user_parse_args_string(user, GUAC_RDP_CLIENT_ARGS, argv,
@@ -747,10 +767,36 @@ guac_rdp_settings* guac_rdp_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_RDP_CLIENT_ARGS, argv,
                 IDX_DISABLE_GLYPH_CACHING, 0);
 
-    /* Session color depth */
+    /* Memory budget for cached bitmaps and offscreen surfaces */
+    settings->cache_memory_limit =
+        guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
+                IDX_CACHE_MEMORY_LIMIT, GUAC_RDP_DEFAULT_CACHE_MEMORY_LIMIT);
+
+    if (settings->cache_memory_limit < 0)
+        settings->cache_memory_limit = GUAC_RDP_DEFAULT_CACHE_MEMORY_LIMIT;
+
+    /* Session color depth (the graphics pipeline requires its own depth,
+     * which is thus the default while the pipeline is enabled) */
+    int default_depth = RDP_DEFAULT_DEPTH;
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    if (!settings->disable_gfx)
+        default_depth = RDP_GFX_DEPTH;
+#endif
+
     settings->color_depth = 
         guac_user_parse_args_int(user, GUAC_RDP_CLIENT_ARGS, argv,
-                IDX_COLOR_DEPTH, RDP_DEFAULT_DEPTH);
+                IDX_COLOR_DEPTH, default_depth);
+
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    /* Honor any explicitly-requested color depth over the graphics
+     * pipeline */
+    if (!settings->disable_gfx && settings->color_depth != RDP_GFX_DEPTH) {
+        guac_user_log(user, GUAC_LOG_INFO, "The graphics pipeline requires "
+                "%i-bit color and will not be used at the requested color "
+                "depth of %i bits.", RDP_GFX_DEPTH, settings->color_depth);
+        settings->disable_gfx = 1;
+    }
+#endif
 
     /* Preconnection ID */
     settings->preconnection_id = -1;
@@ -1187,6 +1233,17 @@ void guac_rdp_push_settings(guac_rdp_settings* guac_settings, freerdp* rdp) {
     rdp_settings->KeyboardLayout = guac_settings->server_layout->freerdp_keyboard_layout;
 #endif
 
+    /* Graphics pipeline codecs (H.264 is not supported). The pipeline itself
+     * is only advertised once the rdpgfx plugin has loaded. */
+#ifdef HAVE_FREERDP_GFX_SUPPORT
+    if (!guac_settings->disable_gfx) {
+        rdp_settings->SupportDynamicChannels = TRUE;
+        rdp_settings->GfxProgressive = TRUE;
+        rdp_settings->GfxH264 = FALSE;
+        rdp_settings->GfxAVC444 = FALSE;
+    }
+#endif
+
     /* Performance flags */
 #ifdef LEGACY_RDPSETTINGS
 
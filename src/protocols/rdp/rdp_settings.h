@@ -53,11 +53,23 @@
  */
 #define RDP_DEFAULT_DEPTH  16 
 
+/**
+ * The color depth required by the graphics pipeline (RDPGFX), in bits. This
+ * is also the default color depth while the graphics pipeline is enabled.
+ */
+#define RDP_GFX_DEPTH 32
+
 /**
  * The filename to use for the screen recording, if not specified.
  */
 #define GUAC_RDP_DEFAULT_RECORDING_NAME "recording"
 
+/**
+ * The default maximum amount of memory which may be consumed by cached RDP
+ * bitmaps and offscreen surfaces, in megabytes.
+ */
+#define GUAC_RDP_DEFAULT_CACHE_MEMORY_LIMIT 64
+
 /**
  * All supported combinations of security types.
  */
@@ -146,6 +158,13 @@ typedef struct guac_rdp_settings {
      */
     int read_only;
 
+    /**
+     * Whether the graphics pipeline (RDPGFX) should be disabled, falling back
+     * to legacy GDI orders and bitmap updates. The graphics pipeline is also
+     * disabled if a color depth other than RDP_GFX_DEPTH is requested.
+     */
+    int disable_gfx;
+
     /**
      * The color depth of the display to request, in bits.
      */
@@ -327,6 +346,14 @@ typedef struct guac_rdp_settings {
      */
     int disable_glyph_caching;
 
+    /**
+     * The maximum amount of memory which may be consumed by cached RDP
+     * bitmaps and offscreen surfaces, in megabytes. Least-recently-used
+     * entries are evicted once this limit is reached. If zero, cache memory
+     * is not limited.
+     */
+    int cache_memory_limit;
+
     /**
      * The preconnection ID to send within the preconnection PDU when
      * initiating an RDP connection, if any. If no preconnection ID is
@@ -223,7 +223,8 @@ void* ssh_client_thread(void* data) {
         guac_terminal_create_typescript(ssh_client->term,
                 settings->typescript_path,
                 settings->typescript_name,
-                settings->create_typescript_path);
+                settings->create_typescript_path,
+                settings->typescript_compress);
     }
 
     /* Get user and credentials */
@@ -380,21 +381,31 @@ void* ssh_client_thread(void* data) {
         else
             timeout = GUAC_SSH_DEFAULT_POLL_TIMEOUT;
 
-        /* Read terminal data */
-        bytes_read = libssh2_channel_read(ssh_client->term_channel,
-                buffer, sizeof(buffer));
+        /* Read all terminal data currently available, releasing the channel
+         * while each chunk is written so that input is not held up */
+        int written = 0;
+        while ((bytes_read = libssh2_channel_read(ssh_client->term_channel,
+                        buffer, sizeof(buffer))) > 0) {
 
-        pthread_mutex_unlock(&(ssh_client->term_channel_lock));
+            pthread_mutex_unlock(&(ssh_client->term_channel_lock));
+
+            /* Attempt to write data received */
+            written = guac_terminal_write(ssh_client->term, buffer, bytes_read);
+            total_read += bytes_read;
+
+            pthread_mutex_lock(&(ssh_client->term_channel_lock));
 
-        /* Attempt to write data received. Exit on failure. */
-        if (bytes_read > 0) {
-            int written = guac_terminal_write(ssh_client->term, buffer, bytes_read);
-            if (written < 0)
+            if (written < 0 || client->state == GUAC_CLIENT_STOPPING)
                 break;
 
-            total_read += bytes_read;
         }
 
+        pthread_mutex_unlock(&(ssh_client->term_channel_lock));
+
+        /* Exit on failure */
+        if (written < 0)
+            break;
+
         else if (bytes_read < 0 && bytes_read != LIBSSH2_ERROR_EAGAIN)
             break;
 
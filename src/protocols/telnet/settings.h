@@ -164,6 +164,11 @@ typedef struct guac_telnet_settings {
      */
     bool create_typescript_path;
 
+    /**
+     * Whether the typescript data file should be compressed with zstd.
+     */
+    bool typescript_compress;
+
     /**
      * The path in which the screen recording should be saved, if enabled. If
      * no screen recording should be saved, this will be NULL.
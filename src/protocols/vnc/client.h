@@ -44,6 +44,13 @@
  */
 #define GUAC_VNC_FRAME_START_TIMEOUT 1000000
 
+/**
+ * The maximum amount of time to wait for a lagging client before reading
+ * further messages from the VNC server, in milliseconds. Processing lag is
+ * re-evaluated after each wait.
+ */
+#define GUAC_VNC_MAX_LAG_WAIT 250
+
 /**
  * The number of milliseconds to wait between connection attempts.
  */
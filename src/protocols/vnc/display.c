@@ -21,7 +21,9 @@
 
 #include "client.h"
 #include "common/iconv.h"
+#include "common/rect.h"
 #include "common/surface.h"
+#include "display.h"
 #include "vnc.h"
 
 #include <cairo/cairo.h>
@@ -42,7 +44,32 @@
 #include <stdint.h>
 #include <stdlib.h>
 
-void guac_vnc_update(rfbClient* client, int x, int y, int w, int h) {
+/**
+ * Converts the given rectangle of the VNC framebuffer to 32-bit RGB, drawing
+ * the result to the default layer of the display.
+ *
+ * @param client
+ *     The VNC client associated with the VNC session whose framebuffer
+ *     should be drawn.
+ *
+ * @param buffer
+ *     A buffer which is large enough to contain the converted image data of
+ *     the given rectangle.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the rectangle to draw.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the rectangle to draw.
+ *
+ * @param w
+ *     The width of the rectangle to draw, in pixels.
+ *
+ * @param h
+ *     The height of the rectangle to draw, in pixels.
+ */
+static void guac_vnc_draw_rect(rfbClient* client, unsigned char* buffer,
+        int x, int y, int w, int h) {
 
     guac_client* gc = rfbClientGetClientData(client, GUAC_VNC_CLIENT_KEY);
     guac_vnc_client* vnc_client = (guac_vnc_client*) gc->data;
@@ -51,7 +78,6 @@ void guac_vnc_update(rfbClient* client, int x, int y, int w, int h) {
 
     /* Cairo image buffer */
     int stride;
-    unsigned char* buffer;
     unsigned char* buffer_row_current;
     cairo_surface_t* surface;
 
@@ -60,15 +86,8 @@ void guac_vnc_update(rfbClient* client, int x, int y, int w, int h) {
     unsigned int fb_stride;
     unsigned char* fb_row_current;
 
-    /* Ignore extra update if already handled by copyrect */
-    if (vnc_client->copy_rect_used) {
-        vnc_client->copy_rect_used = 0;
-        return;
-    }
-
     /* Init Cairo buffer */
     stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, w);
-    buffer = malloc(h*stride);
     buffer_row_current = buffer;
 
     bpp = client->format.bitsPerPixel/8;
@@ -133,6 +152,107 @@ void guac_vnc_update(rfbClient* client, int x, int y, int w, int h) {
 
     /* Free surface */
     cairo_surface_destroy(surface);
+
+}
+
+void guac_vnc_update(rfbClient* client, int x, int y, int w, int h) {
+
+    guac_client* gc = rfbClientGetClientData(client, GUAC_VNC_CLIENT_KEY);
+    guac_vnc_client* vnc_client = (guac_vnc_client*) gc->data;
+
+    /* Ignore extra update if already handled by copyrect */
+    if (vnc_client->copy_rect_used) {
+        vnc_client->copy_rect_used = 0;
+        return;
+    }
+
+    /* Ignore extra update if already handled as JPEG (the framebuffer has
+     * not been updated) */
+    if (vnc_client->jpeg_rect_used) {
+        vnc_client->jpeg_rect_used = 0;
+        return;
+    }
+
+    /* Ignore empty updates */
+    if (w <= 0 || h <= 0)
+        return;
+
+    guac_common_rect* pending = vnc_client->pending_updates;
+    int length = vnc_client->pending_updates_length;
+
+    /* Extend the most recent pending rectangle if the two rectangles
+     * together form a single larger rectangle, as is typical of the strips
+     * and tiles sent by most encodings. Only pixels actually updated by the
+     * server may be converted, as regions handled via CopyRect or JPEG are
+     * not reflected within the framebuffer. */
+    if (length > 0) {
+
+        guac_common_rect* last = &pending[length - 1];
+
+        /* Vertically adjacent, same horizontal extent */
+        if (last->x == x && last->width == w && last->y + last->height == y) {
+            last->height += h;
+            return;
+        }
+
+        /* Horizontally adjacent, same vertical extent */
+        if (last->y == y && last->height == h && last->x + last->width == x) {
+            last->width += w;
+            return;
+        }
+
+    }
+
+    /* Make room for new rectangle if necessary */
+    if (length == GUAC_VNC_MAX_PENDING_UPDATES) {
+        guac_vnc_flush_updates(client);
+        length = 0;
+    }
+
+    guac_common_rect_init(&pending[length], x, y, w, h);
+    vnc_client->pending_updates_length = length + 1;
+
+}
+
+void guac_vnc_flush_updates(rfbClient* client) {
+
+    guac_client* gc = rfbClientGetClientData(client, GUAC_VNC_CLIENT_KEY);
+    guac_vnc_client* vnc_client = (guac_vnc_client*) gc->data;
+
+    int i;
+    int length = vnc_client->pending_updates_length;
+    guac_common_rect* pending = vnc_client->pending_updates;
+
+    if (length == 0)
+        return;
+
+    vnc_client->pending_updates_length = 0;
+
+    /* Determine size of conversion buffer needed for largest rectangle */
+    size_t buffer_size = 0;
+    for (i = 0; i < length; i++) {
+
+        size_t size = (size_t) pending[i].height
+            * cairo_format_stride_for_width(CAIRO_FORMAT_RGB24,
+                    pending[i].width);
+
+        if (size > buffer_size)
+            buffer_size = size;
+
+    }
+
+    /* Convert all pending rectangles using the same buffer */
+    unsigned char* buffer = malloc(buffer_size);
+    if (buffer == NULL) {
+        guac_client_log(gc, GUAC_LOG_WARNING, "Unable to allocate buffer "
+                "for converting VNC framebuffer updates.");
+        return;
+    }
+
+    for (i = 0; i < length; i++)
+        guac_vnc_draw_rect(client, buffer, pending[i].x, pending[i].y,
+                pending[i].width, pending[i].height);
+
     free(buffer);
 
 }
@@ -142,6 +262,9 @@ void guac_vnc_copyrect(rfbClient* client, int src_x, int src_y, int w, int h, in
     guac_client* gc = rfbClientGetClientData(client, GUAC_VNC_CLIENT_KEY);
     guac_vnc_client* vnc_client = (guac_vnc_client*) gc->data;
 
+    /* Source may depend on updates received earlier in the same message */
+    guac_vnc_flush_updates(client);
+
     /* Copy specified rectangle within default layer */
     guac_common_surface_copy(vnc_client->display->default_surface,
             src_x, src_y, w, h,
@@ -151,6 +274,30 @@ void guac_vnc_copyrect(rfbClient* client, int src_x, int src_y, int w, int h, in
 
 }
 
+#ifdef HAVE_RFBCLIENT_GOTJPEG
+rfbBool guac_vnc_jpeg(rfbClient* client, const uint8_t* buffer, int length,
+        int x, int y, int w, int h) {
+
+    guac_client* gc = rfbClientGetClientData(client, GUAC_VNC_CLIENT_KEY);
+    guac_vnc_client* vnc_client = (guac_vnc_client*) gc->data;
+
+    /* Preserve order relative to updates received earlier */
+    guac_vnc_flush_updates(client);
+
+    /* Draw JPEG within default layer, decoding only if needed */
+    if (guac_common_surface_draw_jpeg(vnc_client->display->default_surface,
+                x, y, w, h, buffer, length)) {
+        guac_client_log(gc, GUAC_LOG_WARNING, "Invalid JPEG image received "
+                "from VNC server.");
+        return FALSE;
+    }
+
+    vnc_client->jpeg_rect_used = 1;
+    return TRUE;
+
+}
+#endif
+
 void guac_vnc_set_pixel_format(rfbClient* client, int color_depth) {
     client->format.trueColour = 1;
     switch(color_depth) {
@@ -195,10 +342,13 @@ rfbBool guac_vnc_malloc_framebuffer(rfbClient* rfb_client) {
     guac_client* gc = rfbClientGetClientData(rfb_client, GUAC_VNC_CLIENT_KEY);
     guac_vnc_client* vnc_client = (guac_vnc_client*) gc->data;
 
-    /* Resize surface */
-    if (vnc_client->display != NULL)
+    /* Draw any pending updates from the old framebuffer, then resize
+     * surface */
+    if (vnc_client->display != NULL) {
+        guac_vnc_flush_updates(rfb_client);
         guac_common_surface_resize(vnc_client->display->default_surface,
                 rfb_client->width, rfb_client->height);
+    }
 
     /* Use original, wrapped proc */
     return vnc_client->rfb_MallocFrameBuffer(rfb_client);
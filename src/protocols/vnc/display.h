@@ -28,7 +28,8 @@
 /**
  * Callback invoked by libVNCServer when it receives a new binary image data.
  * the VNC server. The image itself will be stored in the designated sub-
- * rectangle of client->framebuffer.
+ * rectangle of client->framebuffer. The rectangle is only queued for
+ * conversion; it is drawn when guac_vnc_flush_updates() is next invoked.
  *
  * @param client
  *     The VNC client associated with the VNC session in which the new image
@@ -50,6 +51,21 @@
  */
 void guac_vnc_update(rfbClient* client, int x, int y, int w, int h);
 
+/**
+ * Converts and draws all framebuffer rectangles received via
+ * guac_vnc_update() which have not yet been drawn to the display. Updates are
+ * queued, rather than drawn as each rectangle is received, such that the many
+ * small rectangles of a single FramebufferUpdate message are converted
+ * together. This function must be invoked after each message from the VNC
+ * server is handled, as well as before any operation which depends on the
+ * current contents of the display.
+ *
+ * @param client
+ *     The VNC client associated with the VNC session whose pending updates
+ *     should be drawn.
+ */
+void guac_vnc_flush_updates(rfbClient* client);
+
 /**
  * Callback invoked by libVNCServer when it receives a CopyRect message.
  * CopyRect specified a rectangle of source data within the display and a
@@ -84,6 +100,45 @@ void guac_vnc_update(rfbClient* client, int x, int y, int w, int h);
 void guac_vnc_copyrect(rfbClient* client, int src_x, int src_y, int w, int h,
         int dest_x, int dest_y);
 
+#ifdef HAVE_RFBCLIENT_GOTJPEG
+/**
+ * Callback invoked by libVNCClient when a JPEG image is received as part of
+ * a Tight-encoded update, in place of decoding that image into the VNC
+ * framebuffer. The JPEG data is drawn to the default surface as-is, such
+ * that it is sent to the Guacamole client without being decoded and
+ * re-encoded.
+ *
+ * @param client
+ *     The VNC client associated with the VNC session in which the JPEG image
+ *     was received.
+ *
+ * @param buffer
+ *     The JPEG data received.
+ *
+ * @param length
+ *     The number of bytes of JPEG data.
+ *
+ * @param x
+ *     The X coordinate of the upper-left corner of the destination rectangle
+ *     in which the JPEG image should be drawn, in pixels.
+ *
+ * @param y
+ *     The Y coordinate of the upper-left corner of the destination rectangle
+ *     in which the JPEG image should be drawn, in pixels.
+ *
+ * @param w
+ *     The width of the JPEG image, in pixels.
+ *
+ * @param h
+ *     The height of the JPEG image, in pixels.
+ *
+ * @return
+ *     TRUE if the JPEG image was drawn successfully, FALSE otherwise.
+ */
+rfbBool guac_vnc_jpeg(rfbClient* client, const uint8_t* buffer, int length,
+        int x, int y, int w, int h);
+#endif
+
 /**
  * Sets the pixel format to request of the VNC server. The request will be made
  * during the connection handshake with the VNC server using the values
@@ -41,6 +41,7 @@ const char* GUAC_VNC_CLIENT_ARGS[] = {
     "cursor",
     "autoretry",
     "clipboard-encoding",
+    "disable-jpeg-passthrough",
 
 #ifdef ENABLE_VNC_REPEATER
     "dest-host",
@@ -146,6 +147,13 @@ enum VNC_ARGS_IDX {
      */
     IDX_CLIPBOARD_ENCODING,
 
+    /**
+     * "true" if JPEG images received from the VNC server should always be
+     * decoded and re-encoded, rather than being sent to the client as-is,
+     * "false" or blank otherwise.
+     */
+    IDX_DISABLE_JPEG_PASSTHROUGH,
+
 #ifdef ENABLE_VNC_REPEATER
     /**
      * The VNC host to connect to, if using a repeater.
@@ -355,6 +363,11 @@ guac_vnc_settings* guac_vnc_parse_args(guac_user* user,
         guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
                 IDX_READ_ONLY, false);
 
+    /* JPEG passthrough */
+    settings->disable_jpeg_passthrough =
+        guac_user_parse_args_boolean(user, GUAC_VNC_CLIENT_ARGS, argv,
+                IDX_DISABLE_JPEG_PASSTHROUGH, false);
+
     /* Parse color depth */
     settings->color_depth =
         guac_user_parse_args_int(user, GUAC_VNC_CLIENT_ARGS, argv,
@@ -72,6 +72,13 @@ typedef struct guac_vnc_settings {
      */
     bool read_only;
 
+    /**
+     * Whether JPEG images received from the VNC server (as part of Tight
+     * encoding) should always be decoded and re-encoded, rather than being
+     * sent to the client as-is.
+     */
+    bool disable_jpeg_passthrough;
+
 #ifdef ENABLE_VNC_REPEATER
     /**
      * The VNC host to connect to, if using a repeater.
@@ -229,6 +229,12 @@ rfbClient* guac_vnc_get_client(guac_client* client) {
     rfb_client->GotFrameBufferUpdate = guac_vnc_update;
     rfb_client->GotCopyRect = guac_vnc_copyrect;
 
+#ifdef HAVE_RFBCLIENT_GOTJPEG
+    /* Send JPEG images received via Tight encoding without re-encoding */
+    if (!vnc_settings->disable_jpeg_passthrough)
+        rfb_client->GotJpeg = guac_vnc_jpeg;
+#endif
+
     /* Do not handle clipboard and local cursor if read-only */
     if (vnc_settings->read_only == 0) {
 
@@ -498,7 +504,21 @@ void* guac_vnc_client_thread(void* data) {
                 GUAC_VNC_FRAME_START_TIMEOUT);
         if (wait_result > 0) {
 
+            /* Calculate time that client needs to catch up */
             int processing_lag = guac_client_get_processing_lag(client);
+            int time_elapsed = guac_timestamp_current() - last_frame_end;
+            int required_wait = processing_lag - time_elapsed;
+
+            /* Leave server messages unread while the client is lagging.
+             * libvncclient requests each incremental update only after the
+             * previous update has been handled, so the server accumulates
+             * any changes in the meantime and sends them together. */
+            if (required_wait > GUAC_VNC_FRAME_TIMEOUT) {
+                if (required_wait > GUAC_VNC_MAX_LAG_WAIT)
+                    required_wait = GUAC_VNC_MAX_LAG_WAIT;
+                guac_timestamp_msleep(required_wait);
+            }
+
             guac_timestamp frame_start = guac_timestamp_current();
 
             /* Read server messages until frame is built */
@@ -515,22 +535,16 @@ void* guac_vnc_client_thread(void* data) {
                     break;
                 }
 
+                /* Draw all rectangles of any FramebufferUpdate together */
+                guac_vnc_flush_updates(rfb_client);
+
                 /* Calculate time remaining in frame */
                 frame_end = guac_timestamp_current();
                 frame_remaining = frame_start + GUAC_VNC_FRAME_DURATION
                                 - frame_end;
 
-                /* Calculate time that client needs to catch up */
-                int time_elapsed = frame_end - last_frame_end;
-                int required_wait = processing_lag - time_elapsed;
-
-                /* Increase the duration of this frame if client is lagging */
-                if (required_wait > GUAC_VNC_FRAME_TIMEOUT)
-                    wait_result = guac_vnc_wait_for_messages(rfb_client,
-                            required_wait*1000);
-
                 /* Wait again if frame remaining */
-                else if (frame_remaining > 0)
+                if (frame_remaining > 0)
                     wait_result = guac_vnc_wait_for_messages(rfb_client,
                             GUAC_VNC_FRAME_TIMEOUT*1000);
                 else
@@ -552,6 +566,7 @@ void* guac_vnc_client_thread(void* data) {
 
         /* Flush frame */
         guac_common_surface_flush(vnc_client->display->default_surface);
+        guac_common_cursor_flush(vnc_client->display->cursor);
         guac_client_end_frame(client);
         guac_socket_flush(client->socket);
 
@@ -26,6 +26,7 @@
 #include "common/display.h"
 #include "common/iconv.h"
 #include "common/recording.h"
+#include "common/rect.h"
 #include "common/surface.h"
 #include "settings.h"
 
@@ -46,6 +47,13 @@
 
 #include <pthread.h>
 
+/**
+ * The maximum number of framebuffer rectangles which may be awaiting
+ * conversion at any one time. If more rectangles are received within a single
+ * FramebufferUpdate message, the pending rectangles are converted early.
+ */
+#define GUAC_VNC_MAX_PENDING_UPDATES 256
+
 /**
  * VNC-specific client data.
  */
@@ -73,6 +81,25 @@ typedef struct guac_vnc_client {
      */
     int copy_rect_used;
 
+    /**
+     * Rectangles of the VNC framebuffer which have been updated by the
+     * FramebufferUpdate message currently being handled but which have not
+     * yet been converted and drawn to the display. Adjacent rectangles are
+     * merged as they are received.
+     */
+    guac_common_rect pending_updates[GUAC_VNC_MAX_PENDING_UPDATES];
+
+    /**
+     * The number of rectangles within pending_updates.
+     */
+    int pending_updates_length;
+
+    /**
+     * Whether the latest update received by the VNC server was a JPEG image
+     * which has already been drawn by guac_vnc_jpeg().
+     */
+    int jpeg_rect_used;
+
     /**
      * Client settings, parsed from args.
      */
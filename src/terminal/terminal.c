@@ -557,6 +557,7 @@ guac_terminal* guac_terminal_create(guac_client* client,
 
     /* Init modified flag and conditional */
     term->modified = 0;
+    term->frame_output = 0;
     pthread_cond_init(&(term->modified_cond), NULL);
     pthread_mutex_init(&(term->modified_lock), NULL);
 
@@ -774,6 +775,34 @@ wait_complete:
 
 }
 
+/**
+ * Returns the number of bytes written to the terminal via
+ * guac_terminal_write() since the last frame was flushed, optionally
+ * resetting that count.
+ *
+ * @param terminal
+ *    The terminal to check.
+ *
+ * @param reset
+ *    Non-zero if the count should be reset to zero, zero otherwise.
+ *
+ * @return
+ *    The number of bytes written since the last frame was flushed.
+ */
+static int guac_terminal_get_frame_output(guac_terminal* terminal,
+        int reset) {
+
+    pthread_mutex_lock(&(terminal->modified_lock));
+
+    int frame_output = terminal->frame_output;
+    if (reset)
+        terminal->frame_output = 0;
+
+    pthread_mutex_unlock(&(terminal->modified_lock));
+    return frame_output;
+
+}
+
 int guac_terminal_render_frame(guac_terminal* terminal) {
 
     int wait_result;
@@ -784,22 +813,47 @@ int guac_terminal_render_frame(guac_terminal* terminal) {
 
         guac_timestamp frame_start = guac_timestamp_current();
 
+        /* Allow lagging users to catch up before sending more */
+        int processing_lag = guac_client_get_processing_lag(terminal->client);
+
         do {
 
+            int frame_output = guac_terminal_get_frame_output(terminal, 0);
+
+            /* Batch bulk output into longer frames, extended further by any
+             * processing lag */
+            int frame_duration = processing_lag;
+            if (frame_output >= GUAC_TERMINAL_BULK_OUTPUT)
+                frame_duration += GUAC_TERMINAL_BULK_FRAME_DURATION;
+            else
+                frame_duration += GUAC_TERMINAL_FRAME_DURATION;
+
+            if (frame_duration > GUAC_TERMINAL_MAX_FRAME_DURATION)
+                frame_duration = GUAC_TERMINAL_MAX_FRAME_DURATION;
+
             /* Calculate time remaining in frame */
             guac_timestamp frame_end = guac_timestamp_current();
-            int frame_remaining = frame_start + GUAC_TERMINAL_FRAME_DURATION
-                                - frame_end;
+            int frame_remaining = frame_start + frame_duration - frame_end;
+
+            if (frame_remaining <= 0)
+                break;
+
+            /* Flush interactive output (keystroke echo, etc.) as soon as
+             * nothing further is pending, unless users are lagging */
+            if (frame_output <= GUAC_TERMINAL_INTERACTIVE_OUTPUT
+                    && processing_lag == 0)
+                wait_result = guac_terminal_wait(terminal, 0);
 
-            /* Wait again if frame remaining */
-            if (frame_remaining > 0)
+            /* Otherwise, wait again for more data */
+            else
                 wait_result = guac_terminal_wait(terminal,
                         GUAC_TERMINAL_FRAME_TIMEOUT);
-            else
-                break;
 
         } while (wait_result > 0);
 
+        /* Output received from here on belongs to the next frame */
+        guac_terminal_get_frame_output(terminal, 1);
+
         /* Flush terminal */
         guac_terminal_lock(terminal);
         guac_terminal_flush(terminal);
@@ -966,6 +1020,11 @@ void guac_terminal_commit_cursor(guac_terminal* term) {
 
 int guac_terminal_write(guac_terminal* term, const char* c, int size) {
 
+    /* Track output volume for frame pacing */
+    pthread_mutex_lock(&(term->modified_lock));
+    term->frame_output += size;
+    pthread_mutex_unlock(&(term->modified_lock));
+
     guac_terminal_lock(term);
     while (size > 0) {
 
@@ -1708,6 +1767,7 @@ void guac_terminal_flush(guac_terminal* terminal) {
     guac_terminal_commit_cursor(terminal);
     guac_terminal_display_flush(terminal->display);
     guac_terminal_scrollbar_flush(terminal->scrollbar);
+    guac_common_cursor_flush(terminal->cursor);
 
 }
 
@@ -1909,8 +1969,9 @@ static int __guac_terminal_send_mouse(guac_terminal* term, guac_user* user,
     int released_mask =  term->mouse_mask & ~mask;
     int pressed_mask  = ~term->mouse_mask &  mask;
 
-    /* Store current mouse location/state */
+    /* Store current mouse location/state, broadcasting with next frame */
     guac_common_cursor_update(term->cursor, user, x, y, mask);
+    guac_terminal_notify(term);
 
     /* Notify scrollbar, do not handle anything handled by scrollbar */
     if (guac_terminal_scrollbar_handle_mouse(term->scrollbar, x, y, mask)) {
@@ -2184,10 +2245,20 @@ void guac_terminal_pipe_stream_close(guac_terminal* term) {
 }
 
 int guac_terminal_create_typescript(guac_terminal* term, const char* path,
-        const char* name, int create_path) {
+        const char* name, int create_path, int compress) {
+
+#ifndef ENABLE_ZSTD
+    /* Warn if compression was requested but cannot be provided */
+    if (compress)
+        guac_client_log(term->client, GUAC_LOG_WARNING,
+                "Typescript compression was requested, but guacamole-server "
+                "was built without zstd support. The typescript will not be "
+                "compressed.");
+#endif
 
     /* Create typescript */
-    term->typescript = guac_terminal_typescript_alloc(path, name, create_path);
+    term->typescript = guac_terminal_typescript_alloc(path, name, create_path,
+            compress);
 
     /* Log failure */
     if (term->typescript == NULL) {
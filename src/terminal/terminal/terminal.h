@@ -38,16 +38,44 @@
 #include <guacamole/stream.h>
 
 /**
- * The maximum duration of a single frame, in milliseconds.
+ * The maximum duration of a single frame, in milliseconds, while output is
+ * not arriving in bulk and no user is lagging behind.
  */
 #define GUAC_TERMINAL_FRAME_DURATION 40
 
+/**
+ * The maximum duration of a single frame, in milliseconds, once the output
+ * received during that frame reaches GUAC_TERMINAL_BULK_OUTPUT bytes.
+ */
+#define GUAC_TERMINAL_BULK_FRAME_DURATION 100
+
+/**
+ * The absolute maximum duration of a single frame, in milliseconds, including
+ * any extension due to client processing lag.
+ */
+#define GUAC_TERMINAL_MAX_FRAME_DURATION 250
+
 /**
  * The maximum amount of time to wait for more data before declaring a frame
  * complete, in milliseconds.
  */
 #define GUAC_TERMINAL_FRAME_TIMEOUT 10
 
+/**
+ * The maximum number of bytes of output within a frame for that output to be
+ * considered interactive (such as the echo of a keystroke). Frames containing
+ * only interactive output are flushed as soon as no further output is
+ * immediately available, rather than waiting GUAC_TERMINAL_FRAME_TIMEOUT.
+ */
+#define GUAC_TERMINAL_INTERACTIVE_OUTPUT 256
+
+/**
+ * The number of bytes of output within a frame at which that output is
+ * considered bulk output, extending the frame to
+ * GUAC_TERMINAL_BULK_FRAME_DURATION.
+ */
+#define GUAC_TERMINAL_BULK_OUTPUT 16384
+
 /**
  * The maximum number of custom tab stops.
  */
@@ -188,6 +216,13 @@ struct guac_terminal {
      */
     pthread_cond_t modified_cond;
 
+    /**
+     * The number of bytes written to the terminal via guac_terminal_write()
+     * since the last frame was flushed. The modified_lock will always be
+     * acquired before this value is altered.
+     */
+    int frame_output;
+
     /**
      * Pipe which will be the source of user input. When a terminal code
      * generates synthesized user input, that data will be written to
@@ -858,12 +893,17 @@ void guac_terminal_pipe_stream_close(guac_terminal* term);
  *     written, or non-zero if the path should be created if it does not yet
  *     exist.
  *
+ * @param compress
+ *     Non-zero if the typescript data file should be compressed with zstd,
+ *     zero otherwise. If zstd support is not available, a warning is logged
+ *     and the data file is written uncompressed.
+ *
  * @return
  *     Zero if the typescript files have been successfully created and a
  *     typescript will be written, non-zero otherwise.
  */
 int guac_terminal_create_typescript(guac_terminal* term, const char* path,
-        const char* name, int create_path);
+        const char* name, int create_path, int compress);
 
 #endif
 
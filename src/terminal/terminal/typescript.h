@@ -25,6 +25,13 @@
 
 #include <guacamole/timestamp.h>
 
+#include <pthread.h>
+#include <stddef.h>
+
+#ifdef ENABLE_ZSTD
+#include <zstd.h>
+#endif
+
 /**
  * A NULL-terminated string of raw bytes which should be written at the
  * beginning of any typescript.
@@ -70,9 +77,47 @@
  */
 #define GUAC_TERMINAL_TYPESCRIPT_TIMING_SUFFIX "timing"
 
+/**
+ * The size of the ring buffer through which flushed terminal output is passed
+ * to the typescript writer thread, in bytes. This MUST be a power of two, and
+ * MUST be large enough to hold at least one full record (a
+ * guac_terminal_typescript_record followed by the contents of a full
+ * typescript buffer).
+ */
+#define GUAC_TERMINAL_TYPESCRIPT_RING_SIZE 262144
+
+/**
+ * The zstd compression level to use for compressed typescript data files.
+ */
+#define GUAC_TERMINAL_TYPESCRIPT_ZSTD_LEVEL 3
+
+/**
+ * The header of each record stored within the ring buffer of a typescript.
+ * Each header is immediately followed by the raw terminal output described
+ * by the record.
+ */
+typedef struct guac_terminal_typescript_record {
+
+    /**
+     * The number of milliseconds elapsed between the previous flush and the
+     * flush which produced this record.
+     */
+    int elapsed;
+
+    /**
+     * The number of bytes of raw terminal output following this header.
+     */
+    int length;
+
+} guac_terminal_typescript_record;
+
 /**
  * An active typescript, consisting of a data file (raw terminal output) and
- * timing file (related timestamps and byte counts).
+ * timing file (related timestamps and byte counts). Terminal output is
+ * buffered by the terminal and, on each flush, passed through a
+ * single-producer, single-consumer ring buffer to a dedicated writer thread
+ * which performs all file I/O, such that slow typescript storage does not
+ * stall the terminal.
  */
 typedef struct guac_terminal_typescript {
 
@@ -118,6 +163,96 @@ typedef struct guac_terminal_typescript {
      */
     guac_timestamp last_flush;
 
+    /**
+     * Whether the data file is compressed with zstd. Compressed data files
+     * are written as a single zstd frame which is flushed after each record,
+     * such that all data written thus far can be decompressed (for example,
+     * with "zstd -dc") even while the typescript is still being written.
+     */
+    int compress;
+
+#ifdef ENABLE_ZSTD
+    /**
+     * The zstd compression stream used to compress the data file, or NULL if
+     * the data file is not compressed. This is used only by the writer
+     * thread.
+     */
+    ZSTD_CStream* zstd;
+
+    /**
+     * Buffer receiving compressed output from the zstd compression stream
+     * prior to that output being written to the data file.
+     */
+    void* zstd_buffer;
+
+    /**
+     * The size of zstd_buffer, in bytes.
+     */
+    size_t zstd_buffer_size;
+#endif
+
+    /**
+     * Ring buffer of pending records, each consisting of a
+     * guac_terminal_typescript_record followed by raw terminal output.
+     * Records are written by the terminal and consumed by the writer thread.
+     */
+    unsigned char ring[GUAC_TERMINAL_TYPESCRIPT_RING_SIZE];
+
+    /**
+     * The total number of bytes ever written to the ring buffer. This is
+     * modified only by the terminal and is accessed atomically.
+     */
+    size_t ring_head;
+
+    /**
+     * The total number of bytes ever consumed from the ring buffer. This is
+     * modified only by the writer thread and is accessed atomically.
+     */
+    size_t ring_tail;
+
+    /**
+     * Non-zero if the terminal is waiting for space to become available
+     * within the ring buffer. Accessed atomically.
+     */
+    int producer_waiting;
+
+    /**
+     * Non-zero if the writer thread is waiting for records to become
+     * available within the ring buffer. Accessed atomically.
+     */
+    int consumer_waiting;
+
+    /**
+     * Non-zero if the writer thread should exit once all pending records
+     * have been written. Accessed atomically.
+     */
+    int stopping;
+
+    /**
+     * Lock which must be held while waiting on or signalling either of
+     * space_available or data_available. This lock is NOT required to read
+     * from or write to the ring buffer itself.
+     */
+    pthread_mutex_t lock;
+
+    /**
+     * Condition which is signalled by the writer thread when space becomes
+     * available within the ring buffer while the terminal is waiting.
+     */
+    pthread_cond_t space_available;
+
+    /**
+     * Condition which is signalled by the terminal when records become
+     * available within the ring buffer (or the typescript is being freed)
+     * while the writer thread is waiting.
+     */
+    pthread_cond_t data_available;
+
+    /**
+     * The thread writing pending records to the data and timing files.
+     */
+    pthread_t writer_thread;
+
 } guac_terminal_typescript;
 
 /**
@@ -125,7 +260,8 @@ typedef struct guac_terminal_typescript {
  * given base name, returning an abstraction which represents those files.
  * Terminal output will be written to these new files, along with timing
  * information. If the create_path flag is non-zero, the given path will be
- * created if it does not yet exist.
+ * created if it does not yet exist. All file I/O is performed by a dedicated
+ * writer thread which runs until the typescript is freed.
  *
  * @param path
  *     The full absolute path to a directory in which the typescript files
@@ -140,12 +276,17 @@ typedef struct guac_terminal_typescript {
  *     written, or non-zero if the path should be created if it does not yet
  *     exist.
  *
+ * @param compress
+ *     Non-zero if the data file should be compressed with zstd, zero
+ *     otherwise. If guacamole-server was built without zstd support, this
+ *     flag is ignored and the data file is not compressed.
+ *
  * @return
  *     A new guac_terminal_typescript representing the typescript files
  *     requested, or NULL if creation of the typescript files failed.
  */
 guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
-        const char* name, int create_path);
+        const char* name, int create_path, int compress);
 
 /**
  * Writes a single byte of terminal data to the typescript, flushing and
@@ -162,8 +303,11 @@ void guac_terminal_typescript_write(guac_terminal_typescript* typescript,
         char c);
 
 /**
- * Flushes any pending data to the typescript, writing a new timestamp to the
- * timing file if any data was flushed.
+ * Flushes any pending data to the typescript, handing that data and its
+ * timestamp to the writer thread. The data is written to the data and timing
+ * files asynchronously. If the writer thread has fallen so far behind that
+ * its ring buffer is full, this function blocks until sufficient space is
+ * available, as typescript data is never discarded.
  *
  * @param typescript
  *     The typescript which should be flushed.
@@ -172,7 +316,8 @@ void guac_terminal_typescript_flush(guac_terminal_typescript* typescript);
 
 /**
  * Frees all resources associated with the given typescript, flushing and
- * closing the data and timing files and freeing all related memory. If the
+ * closing the data and timing files and freeing all related memory. This
+ * function blocks until the writer thread has written all pending data. If the
  * provided typescript is NULL, this function has no effect.
  *
  * @param typescript
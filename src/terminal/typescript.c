@@ -24,8 +24,10 @@
 #include <guacamole/timestamp.h>
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <sys/types.h>
@@ -108,8 +110,292 @@ static int guac_terminal_typescript_open_data_file(const char* path,
 
 }
 
+/**
+ * Writes the given data to the data file of the given typescript, compressing
+ * that data first if the typescript is compressed. If the typescript is
+ * compressed, all compressed output is flushed such that the data file can be
+ * fully decompressed up to and including the given data. Once the writer
+ * thread is running, this function may only be invoked by the writer thread.
+ *
+ * @param typescript
+ *     The typescript whose data file should be written to.
+ *
+ * @param data
+ *     The raw data to write.
+ *
+ * @param length
+ *     The number of bytes of raw data to write.
+ */
+static void guac_terminal_typescript_write_data(
+        guac_terminal_typescript* typescript, char* data,
+        size_t length) {
+
+#ifdef ENABLE_ZSTD
+    if (typescript->zstd != NULL) {
+
+        ZSTD_inBuffer input = { data, length, 0 };
+        size_t remaining;
+
+        /* Compress and write until all input is consumed and flushed */
+        do {
+
+            ZSTD_outBuffer output = {
+                typescript->zstd_buffer, typescript->zstd_buffer_size, 0
+            };
+
+            remaining = ZSTD_compressStream2(typescript->zstd, &output,
+                    &input, ZSTD_e_flush);
+            if (ZSTD_isError(remaining))
+                return;
+
+            guac_common_write(typescript->data_fd,
+                    typescript->zstd_buffer, output.pos);
+
+        } while (remaining != 0);
+
+        return;
+
+    }
+#endif
+
+    guac_common_write(typescript->data_fd, data, length);
+
+}
+
+/**
+ * Writes the given data to the data file of the given typescript, as with
+ * guac_terminal_typescript_write_data(), and then ends the data file. If the
+ * typescript is compressed, the zstd frame is completed and the compression
+ * stream is freed. No further data may be written after this function is
+ * invoked.
+ *
+ * @param typescript
+ *     The typescript whose data file should be ended.
+ *
+ * @param data
+ *     The raw data to write.
+ *
+ * @param length
+ *     The number of bytes of raw data to write.
+ */
+static void guac_terminal_typescript_end_data(
+        guac_terminal_typescript* typescript, char* data,
+        size_t length) {
+
+#ifdef ENABLE_ZSTD
+    if (typescript->zstd != NULL) {
+
+        ZSTD_inBuffer input = { data, length, 0 };
+        size_t remaining;
+
+        /* Compress and write until the frame is complete */
+        do {
+
+            ZSTD_outBuffer output = {
+                typescript->zstd_buffer, typescript->zstd_buffer_size, 0
+            };
+
+            remaining = ZSTD_compressStream2(typescript->zstd, &output,
+                    &input, ZSTD_e_end);
+            if (ZSTD_isError(remaining))
+                break;
+
+            guac_common_write(typescript->data_fd,
+                    typescript->zstd_buffer, output.pos);
+
+        } while (remaining != 0);
+
+        ZSTD_freeCStream(typescript->zstd);
+        free(typescript->zstd_buffer);
+        typescript->zstd = NULL;
+        return;
+
+    }
+#endif
+
+    guac_common_write(typescript->data_fd, data, length);
+
+}
+
+/**
+ * Copies the given data into the ring buffer of the given typescript at the
+ * given absolute position, wrapping around the end of the ring buffer as
+ * necessary. The caller must ensure sufficient space is available.
+ *
+ * @param typescript
+ *     The typescript whose ring buffer should be written to.
+ *
+ * @param position
+ *     The absolute position (total number of bytes ever written to the ring
+ *     buffer) at which the data should be stored.
+ *
+ * @param data
+ *     The data to copy into the ring buffer.
+ *
+ * @param length
+ *     The number of bytes to copy.
+ */
+static void guac_terminal_typescript_ring_put(
+        guac_terminal_typescript* typescript, size_t position,
+        const void* data, size_t length) {
+
+    size_t offset = position & (GUAC_TERMINAL_TYPESCRIPT_RING_SIZE - 1);
+    size_t contiguous = GUAC_TERMINAL_TYPESCRIPT_RING_SIZE - offset;
+
+    if (contiguous > length)
+        contiguous = length;
+
+    memcpy(typescript->ring + offset, data, contiguous);
+    memcpy(typescript->ring, (const unsigned char*) data + contiguous,
+            length - contiguous);
+
+}
+
+/**
+ * Copies data out of the ring buffer of the given typescript, starting at the
+ * given absolute position and wrapping around the end of the ring buffer as
+ * necessary. The caller must ensure that the requested data is present.
+ *
+ * @param typescript
+ *     The typescript whose ring buffer should be read from.
+ *
+ * @param position
+ *     The absolute position (total number of bytes ever written to the ring
+ *     buffer) of the first byte to copy.
+ *
+ * @param data
+ *     The buffer into which the data should be copied.
+ *
+ * @param length
+ *     The number of bytes to copy.
+ */
+static void guac_terminal_typescript_ring_get(
+        guac_terminal_typescript* typescript, size_t position,
+        void* data, size_t length) {
+
+    size_t offset = position & (GUAC_TERMINAL_TYPESCRIPT_RING_SIZE - 1);
+    size_t contiguous = GUAC_TERMINAL_TYPESCRIPT_RING_SIZE - offset;
+
+    if (contiguous > length)
+        contiguous = length;
+
+    memcpy(data, typescript->ring + offset, contiguous);
+    memcpy((unsigned char*) data + contiguous, typescript->ring,
+            length - contiguous);
+
+}
+
+/**
+ * Writes the given record to the timing and data files of the given
+ * typescript. This function may only be invoked by the writer thread.
+ *
+ * @param typescript
+ *     The typescript to write to.
+ *
+ * @param record
+ *     The header of the record to write.
+ *
+ * @param data
+ *     The raw terminal output associated with the record.
+ */
+static void guac_terminal_typescript_write_record(
+        guac_terminal_typescript* typescript,
+        const guac_terminal_typescript_record* record, char* data) {
+
+    /* Produce single line of timestamp output */
+    char timestamp_buffer[32];
+    int timestamp_length = snprintf(timestamp_buffer, sizeof(timestamp_buffer),
+            "%0.6f %i\n", record->elapsed / 1000.0, record->length);
+
+    /* Calculate actual length of timestamp line */
+    if (timestamp_length > sizeof(timestamp_buffer))
+        timestamp_length = sizeof(timestamp_buffer);
+
+    /* Write timestamp to timing file */
+    guac_common_write(typescript->timing_fd,
+            timestamp_buffer, timestamp_length);
+
+    /* Write terminal output to data file */
+    guac_terminal_typescript_write_data(typescript, data, record->length);
+
+}
+
+/**
+ * The main function of the writer thread of a typescript. Records are
+ * consumed from the ring buffer and written to the data and timing files
+ * until the typescript is being freed and no records remain.
+ *
+ * @param data
+ *     The guac_terminal_typescript whose records should be written.
+ *
+ * @return
+ *     Always NULL.
+ */
+static void* guac_terminal_typescript_writer_thread(void* data) {
+
+    guac_terminal_typescript* typescript = (guac_terminal_typescript*) data;
+    guac_terminal_typescript_record record;
+    char buffer[sizeof(typescript->buffer)];
+
+    size_t tail = typescript->ring_tail;
+
+    for (;;) {
+
+        /* The stop flag MUST be read before the head, such that all records
+         * pushed prior to stopping are visible */
+        int stopping = __atomic_load_n(&typescript->stopping, __ATOMIC_SEQ_CST);
+        size_t head = __atomic_load_n(&typescript->ring_head, __ATOMIC_SEQ_CST);
+
+        /* Wait for records if none are available */
+        if (head == tail) {
+
+            /* Done once all records have been written */
+            if (stopping)
+                break;
+
+            pthread_mutex_lock(&typescript->lock);
+            __atomic_store_n(&typescript->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+
+            /* Recheck only after advertising that we are waiting, such that
+             * the terminal is guaranteed to either see the flag or have
+             * already published its record */
+            if (__atomic_load_n(&typescript->ring_head, __ATOMIC_SEQ_CST) == tail
+                    && !__atomic_load_n(&typescript->stopping, __ATOMIC_SEQ_CST))
+                pthread_cond_wait(&typescript->data_available,
+                        &typescript->lock);
+
+            __atomic_store_n(&typescript->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&typescript->lock);
+            continue;
+
+        }
+
+        /* Read and write next record */
+        guac_terminal_typescript_ring_get(typescript, tail,
+                &record, sizeof(record));
+        guac_terminal_typescript_ring_get(typescript, tail + sizeof(record),
+                buffer, record.length);
+        guac_terminal_typescript_write_record(typescript, &record, buffer);
+
+        /* Release space occupied by record */
+        tail += sizeof(record) + record.length;
+        __atomic_store_n(&typescript->ring_tail, tail, __ATOMIC_SEQ_CST);
+
+        /* Wake terminal if it is waiting for space */
+        if (__atomic_load_n(&typescript->producer_waiting, __ATOMIC_SEQ_CST)) {
+            pthread_mutex_lock(&typescript->lock);
+            pthread_cond_signal(&typescript->space_available);
+            pthread_mutex_unlock(&typescript->lock);
+        }
+
+    }
+
+    return NULL;
+
+}
+
 guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
-        const char* name, int create_path) {
+        const char* name, int create_path, int compress) {
 
     /* Create path if it does not exist, fail if impossible */
     if (create_path && mkdir(path, S_IRWXU) && errno != EEXIST)
@@ -118,6 +404,8 @@ guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
     /* Allocate space for new typescript */
     guac_terminal_typescript* typescript =
         malloc(sizeof(guac_terminal_typescript));
+    if (typescript == NULL)
+        return NULL;
 
     /* Attempt to open typescript data file */
     typescript->data_fd = guac_terminal_typescript_open_data_file(
@@ -148,14 +436,70 @@ guac_terminal_typescript* guac_terminal_typescript_alloc(const char* path,
         return NULL;
     }
 
+    /* Compression is available only if built with zstd support */
+#ifdef ENABLE_ZSTD
+    typescript->compress = compress;
+    typescript->zstd = NULL;
+
+    if (compress) {
+
+        typescript->zstd = ZSTD_createCStream();
+        typescript->zstd_buffer_size = ZSTD_CStreamOutSize();
+        typescript->zstd_buffer = malloc(typescript->zstd_buffer_size);
+
+        if (typescript->zstd == NULL || typescript->zstd_buffer == NULL
+                || ZSTD_isError(ZSTD_CCtx_setParameter(typescript->zstd,
+                        ZSTD_c_compressionLevel,
+                        GUAC_TERMINAL_TYPESCRIPT_ZSTD_LEVEL))) {
+            ZSTD_freeCStream(typescript->zstd);
+            free(typescript->zstd_buffer);
+            close(typescript->data_fd);
+            close(typescript->timing_fd);
+            free(typescript);
+            errno = ENOMEM;
+            return NULL;
+        }
+
+    }
+#else
+    typescript->compress = 0;
+#endif
+
     /* Typescript starts out flushed */
     typescript->length = 0;
     typescript->last_flush = guac_timestamp_current();
 
-    /* Write header */
-    guac_common_write(typescript->data_fd, GUAC_TERMINAL_TYPESCRIPT_HEADER,
+    /* Ring buffer starts out empty */
+    typescript->ring_head = 0;
+    typescript->ring_tail = 0;
+    typescript->producer_waiting = 0;
+    typescript->consumer_waiting = 0;
+    typescript->stopping = 0;
+
+    /* Write header (the writer thread is not yet running) */
+    guac_terminal_typescript_write_data(typescript,
+            GUAC_TERMINAL_TYPESCRIPT_HEADER,
             sizeof(GUAC_TERMINAL_TYPESCRIPT_HEADER) - 1);
 
+    pthread_mutex_init(&typescript->lock, NULL);
+    pthread_cond_init(&typescript->space_available, NULL);
+    pthread_cond_init(&typescript->data_available, NULL);
+
+    /* Start writer thread */
+    int error = pthread_create(&typescript->writer_thread, NULL,
+            guac_terminal_typescript_writer_thread, typescript);
+    if (error) {
+        guac_terminal_typescript_end_data(typescript, NULL, 0);
+        pthread_cond_destroy(&typescript->data_available);
+        pthread_cond_destroy(&typescript->space_available);
+        pthread_mutex_destroy(&typescript->lock);
+        close(typescript->data_fd);
+        close(typescript->timing_fd);
+        free(typescript);
+        errno = error;
+        return NULL;
+    }
+
     return typescript;
 
 }
@@ -187,22 +531,48 @@ void guac_terminal_typescript_flush(guac_terminal_typescript* typescript) {
     if (elapsed_time > GUAC_TERMINAL_TYPESCRIPT_MAX_DELAY)
         elapsed_time = GUAC_TERMINAL_TYPESCRIPT_MAX_DELAY;
 
-    /* Produce single line of timestamp output */
-    char timestamp_buffer[32];
-    int timestamp_length = snprintf(timestamp_buffer, sizeof(timestamp_buffer),
-            "%0.6f %i\n", elapsed_time / 1000.0, typescript->length);
+    guac_terminal_typescript_record record = {
+        .elapsed = elapsed_time,
+        .length  = typescript->length
+    };
 
-    /* Calculate actual length of timestamp line */
-    if (timestamp_length > sizeof(timestamp_buffer))
-        timestamp_length = sizeof(timestamp_buffer);
+    size_t size = sizeof(record) + typescript->length;
+    size_t head = typescript->ring_head;
 
-    /* Write timestamp to timing file */
-    guac_common_write(typescript->timing_fd,
-            timestamp_buffer, timestamp_length);
+    /* Wait for space if the writer thread has fallen behind (typescript data
+     * is never dropped) */
+    while (GUAC_TERMINAL_TYPESCRIPT_RING_SIZE - (head
+                - __atomic_load_n(&typescript->ring_tail, __ATOMIC_SEQ_CST))
+            < size) {
+
+        pthread_mutex_lock(&typescript->lock);
+        __atomic_store_n(&typescript->producer_waiting, 1, __ATOMIC_SEQ_CST);
+
+        /* Recheck only after advertising that we are waiting */
+        if (GUAC_TERMINAL_TYPESCRIPT_RING_SIZE - (head
+                    - __atomic_load_n(&typescript->ring_tail, __ATOMIC_SEQ_CST))
+                < size)
+            pthread_cond_wait(&typescript->space_available,
+                    &typescript->lock);
 
-    /* Empty buffer into data file */
-    guac_common_write(typescript->data_fd,
+        __atomic_store_n(&typescript->producer_waiting, 0, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&typescript->lock);
+
+    }
+
+    /* Copy record into ring buffer and publish */
+    guac_terminal_typescript_ring_put(typescript, head,
+            &record, sizeof(record));
+    guac_terminal_typescript_ring_put(typescript, head + sizeof(record),
             typescript->buffer, typescript->length);
+    __atomic_store_n(&typescript->ring_head, head + size, __ATOMIC_SEQ_CST);
+
+    /* Wake writer thread if it is waiting for records */
+    if (__atomic_load_n(&typescript->consumer_waiting, __ATOMIC_SEQ_CST)) {
+        pthread_mutex_lock(&typescript->lock);
+        pthread_cond_signal(&typescript->data_available);
+        pthread_mutex_unlock(&typescript->lock);
+    }
 
     /* Buffer is now flushed */
     typescript->length = 0;
@@ -219,14 +589,27 @@ void guac_terminal_typescript_free(guac_terminal_typescript* typescript) {
     /* Flush any pending data */
     guac_terminal_typescript_flush(typescript);
 
+    /* Stop writer thread once all pending records are written */
+    pthread_mutex_lock(&typescript->lock);
+    __atomic_store_n(&typescript->stopping, 1, __ATOMIC_SEQ_CST);
+    pthread_cond_signal(&typescript->data_available);
+    pthread_mutex_unlock(&typescript->lock);
+
+    pthread_join(typescript->writer_thread, NULL);
+
     /* Write footer */
-    guac_common_write(typescript->data_fd, GUAC_TERMINAL_TYPESCRIPT_FOOTER,
+    guac_terminal_typescript_end_data(typescript,
+            GUAC_TERMINAL_TYPESCRIPT_FOOTER,
             sizeof(GUAC_TERMINAL_TYPESCRIPT_FOOTER) - 1);
 
     /* Close file descriptors */
     close(typescript->data_fd);
     close(typescript->timing_fd);
 
+    pthread_cond_destroy(&typescript->data_available);
+    pthread_cond_destroy(&typescript->space_available);
+    pthread_mutex_destroy(&typescript->lock);
+
     /* Free allocated typescript data */
     free(typescript);
 
@@ -44,8 +44,15 @@ int register_common_suite() {
     /* Add tests */
     if (
         CU_add_test(suite, "guac-iconv", test_guac_iconv)  == NULL
+     || CU_add_test(suite, "guac-iconv-crlf", test_guac_iconv_crlf) == NULL
+     || CU_add_test(suite, "guac-iconv-trailing-cr", test_guac_iconv_trailing_cr) == NULL
+     || CU_add_test(suite, "guac-iconv-bulk", test_guac_iconv_bulk) == NULL
      || CU_add_test(suite, "guac-string", test_guac_string) == NULL
      || CU_add_test(suite, "guac-rect", test_guac_rect) == NULL
+     || CU_add_test(suite, "guac-dircache", test_guac_dircache) == NULL
+     || CU_add_test(suite, "guac-damage", test_guac_damage) == NULL
+     || CU_add_test(suite, "guac-batch", test_guac_batch) == NULL
+     || CU_add_test(suite, "guac-surface-jpeg", test_guac_surface_jpeg) == NULL
        ) {
         CU_cleanup_registry();
         return CU_get_error();
@@ -46,10 +46,48 @@ void test_guac_string();
  */
 void test_guac_iconv();
 
+/**
+ * Unit test for CRLF normalization during character conversion.
+ */
+void test_guac_iconv_crlf();
+
+/**
+ * Unit test verifying that input ending with a carriage return is read
+ * without reading past the end of that input.
+ */
+void test_guac_iconv_trailing_cr();
+
+/**
+ * Unit test verifying that bulk conversion of ASCII runs is equivalent to
+ * conversion of individual characters.
+ */
+void test_guac_iconv_bulk();
+
 /**
  * Unit test for rectangle calculation functions.
  */
 void test_guac_rect();
 
+/**
+ * Unit test for the directory listing cache.
+ */
+void test_guac_dircache();
+
+/**
+ * Unit test for the tile-based damage map.
+ */
+void test_guac_damage();
+
+/**
+ * Unit test for the parallel batch processing of files.
+ */
+void test_guac_batch();
+
+/**
+ * Unit test verifying that JPEG images passed through a surface are not
+ * overwritten by pending updates expanded to the lossy block grid.
+ */
+void test_guac_surface_jpeg();
+
 #endif
 
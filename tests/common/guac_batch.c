@@ -0,0 +1,239 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "common_suite.h"
+#include "common/batch.h"
+
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <CUnit/Basic.h>
+
+/**
+ * The number of input files processed by the test batch.
+ */
+#define TEST_BATCH_FILES 8
+
+/**
+ * The maximum number of files the test batch may process at once.
+ */
+#define TEST_BATCH_JOBS 4
+
+/**
+ * The memory limit of the test batch, in bytes. This is small enough that
+ * not all files may be processed at once.
+ */
+#define TEST_BATCH_MEMORY_LIMIT 4096
+
+/**
+ * The memory required by each file of the test batch beyond its size, in
+ * bytes.
+ */
+#define TEST_BATCH_JOB_OVERHEAD 1024
+
+/**
+ * The state shared by all invocations of test_handler().
+ */
+typedef struct test_batch_state {
+
+    /**
+     * The number of times the handler has been invoked.
+     */
+    int calls;
+
+    /**
+     * The number of invocations of the handler currently in progress.
+     */
+    int running;
+
+    /**
+     * The largest number of invocations of the handler ever in progress at
+     * once.
+     */
+    int peak_running;
+
+    /**
+     * The memory accounted to all files currently being processed, in bytes.
+     */
+    size_t memory_used;
+
+    /**
+     * Whether the memory limit has ever been exceeded while more than one
+     * file was being processed.
+     */
+    int memory_exceeded;
+
+    /**
+     * Lock guarding all other members of this structure.
+     */
+    pthread_mutex_t lock;
+
+} test_batch_state;
+
+/**
+ * Batch handler which copies the name of the input file into the output
+ * file, failing for any input file whose name ends with "fail". The number
+ * of files processed at once and the memory accounted to those files are
+ * recorded while each file is processed.
+ */
+static int test_handler(const char* path, const char* out_path, void* data) {
+
+    test_batch_state* state = (test_batch_state*) data;
+
+    struct stat input;
+    size_t memory = TEST_BATCH_JOB_OVERHEAD;
+    if (stat(path, &input) == 0)
+        memory += input.st_size;
+
+    pthread_mutex_lock(&state->lock);
+    state->calls++;
+    state->running++;
+    state->memory_used += memory;
+
+    if (state->running > state->peak_running)
+        state->peak_running = state->running;
+
+    /* A single file may exceed the limit only if processed alone */
+    if (state->running > 1 && state->memory_used > TEST_BATCH_MEMORY_LIMIT)
+        state->memory_exceeded = 1;
+
+    pthread_mutex_unlock(&state->lock);
+
+    /* Allow other files to be processed concurrently */
+    usleep(10000);
+
+    int result = 1;
+    size_t length = strlen(path);
+    if (length < 4 || strcmp(path + length - 4, "fail") != 0) {
+        FILE* output = fopen(out_path, "w");
+        if (output != NULL) {
+            fputs(path, output);
+            result = fclose(output) != 0;
+        }
+    }
+
+    pthread_mutex_lock(&state->lock);
+    state->running--;
+    state->memory_used -= memory;
+    pthread_mutex_unlock(&state->lock);
+
+    return result;
+
+}
+
+/**
+ * Runs a new batch over the given input files, returning the number of
+ * times the handler was invoked.
+ */
+static int run_batch(char paths[][64], char out_paths[][128], int resume,
+        int* failed, int* skipped) {
+
+    int i;
+    test_batch_state state = { .calls = 0 };
+    pthread_mutex_init(&state.lock, NULL);
+
+    /* Limit memory such that only some files may be processed at once */
+    guac_common_batch* batch = guac_common_batch_alloc(TEST_BATCH_JOBS,
+            TEST_BATCH_MEMORY_LIMIT, TEST_BATCH_JOB_OVERHEAD, resume);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(batch);
+
+    for (i = 0; i < TEST_BATCH_FILES; i++)
+        CU_ASSERT_EQUAL(0, guac_common_batch_add(batch, paths[i],
+                    out_paths[i]));
+
+    *failed = guac_common_batch_run(batch, test_handler, &state);
+    *skipped = batch->skipped;
+
+    CU_ASSERT_EQUAL(TEST_BATCH_FILES,
+            batch->succeeded + batch->failed + batch->skipped);
+
+    /* Neither the number of jobs nor the memory limit may be exceeded */
+    CU_ASSERT_TRUE(state.peak_running <= TEST_BATCH_JOBS);
+    CU_ASSERT_FALSE(state.memory_exceeded);
+
+    for (i = 0; i < TEST_BATCH_FILES; i++)
+        CU_ASSERT_NOT_EQUAL(GUAC_COMMON_BATCH_PENDING,
+                batch->files[i].status);
+
+    guac_common_batch_free(batch);
+    pthread_mutex_destroy(&state.lock);
+    return state.calls;
+
+}
+
+void test_guac_batch() {
+
+    int i;
+    int failed;
+    int skipped;
+
+    char paths[TEST_BATCH_FILES][64];
+    char out_paths[TEST_BATCH_FILES][128];
+
+    /* Create input files of varying size, the last of which will fail */
+    for (i = 0; i < TEST_BATCH_FILES; i++) {
+
+        snprintf(paths[i], sizeof(paths[i]), "/tmp/guac-batch-%i-%i%s",
+                (int) getpid(), i, i == TEST_BATCH_FILES - 1 ? "-fail" : "");
+        snprintf(out_paths[i], sizeof(out_paths[i]), "%s.out", paths[i]);
+
+        FILE* input = fopen(paths[i], "w");
+        CU_ASSERT_PTR_NOT_NULL_FATAL(input);
+        fprintf(input, "%*s", i * 256, "");
+        fclose(input);
+
+    }
+
+    /* All files should be processed exactly once */
+    CU_ASSERT_EQUAL(TEST_BATCH_FILES, run_batch(paths, out_paths, 1,
+                &failed, &skipped));
+    CU_ASSERT_EQUAL(1, failed);
+    CU_ASSERT_EQUAL(0, skipped);
+
+    /* Successful outputs should be complete, and failed outputs absent */
+    for (i = 0; i < TEST_BATCH_FILES; i++) {
+
+        char partial_path[192];
+        snprintf(partial_path, sizeof(partial_path), "%s"
+                GUAC_COMMON_BATCH_PARTIAL_SUFFIX, out_paths[i]);
+        CU_ASSERT_NOT_EQUAL(0, access(partial_path, F_OK));
+
+        CU_ASSERT_EQUAL(i != TEST_BATCH_FILES - 1,
+                access(out_paths[i], F_OK) == 0);
+
+    }
+
+    /* Resuming should retry only the file which failed */
+    CU_ASSERT_EQUAL(1, run_batch(paths, out_paths, 1, &failed, &skipped));
+    CU_ASSERT_EQUAL(1, failed);
+    CU_ASSERT_EQUAL(TEST_BATCH_FILES - 1, skipped);
+
+    for (i = 0; i < TEST_BATCH_FILES; i++) {
+        unlink(paths[i]);
+        unlink(out_paths[i]);
+    }
+
+}
+
@@ -0,0 +1,179 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "common_suite.h"
+#include "common/damage.h"
+#include "common/rect.h"
+
+#include <stdlib.h>
+#include <CUnit/Basic.h>
+
+void test_guac_damage() {
+
+    guac_common_damage* damage;
+    guac_common_rect rect;
+
+    damage = guac_common_damage_alloc(64, 1000, 700);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(damage);
+    CU_ASSERT_EQUAL(16, damage->columns);
+    CU_ASSERT_EQUAL(11, damage->rows);
+
+    /* Nothing is initially modified */
+    CU_ASSERT_EQUAL(0, guac_common_damage_next(damage, &rect));
+
+    /*
+     * Updates at opposite corners remain separate
+     */
+    guac_common_rect_init(&rect, 2, 3, 10, 10);
+    guac_common_damage_add(damage, &rect);
+    guac_common_rect_init(&rect, 980, 690, 10, 10);
+    guac_common_damage_add(damage, &rect);
+
+    CU_ASSERT_EQUAL(1, guac_common_damage_next(damage, &rect));
+    CU_ASSERT_EQUAL(2, rect.x);
+    CU_ASSERT_EQUAL(3, rect.y);
+    CU_ASSERT_EQUAL(10, rect.width);
+    CU_ASSERT_EQUAL(10, rect.height);
+
+    CU_ASSERT_EQUAL(1, guac_common_damage_next(damage, &rect));
+    CU_ASSERT_EQUAL(980, rect.x);
+    CU_ASSERT_EQUAL(690, rect.y);
+    CU_ASSERT_EQUAL(10, rect.width);
+    CU_ASSERT_EQUAL(10, rect.height);
+
+    CU_ASSERT_EQUAL(0, guac_common_damage_next(damage, &rect));
+    CU_ASSERT_EQUAL(0, damage->modified);
+
+    /*
+     * Updates within adjacent cells are combined, and trimmed to the actual
+     * bounds of the modified regions
+     */
+    guac_common_rect_init(&rect, 100, 100, 50, 10);
+    guac_common_damage_add(damage, &rect);
+    guac_common_rect_init(&rect, 100, 110, 50, 40);
+    guac_common_damage_add(damage, &rect);
+
+    CU_ASSERT_EQUAL(1, guac_common_damage_next(damage, &rect));
+    CU_ASSERT_EQUAL(100, rect.x);
+    CU_ASSERT_EQUAL(100, rect.y);
+    CU_ASSERT_EQUAL(50, rect.width);
+    CU_ASSERT_EQUAL(50, rect.height);
+    CU_ASSERT_EQUAL(0, guac_common_damage_next(damage, &rect));
+
+    /*
+     * Updates outside the image are clipped or ignored
+     */
+    guac_common_rect_init(&rect, -10, -10, 20, 20);
+    guac_common_damage_add(damage, &rect);
+    guac_common_rect_init(&rect, 1000, 700, 20, 20);
+    guac_common_damage_add(damage, &rect);
+
+    CU_ASSERT_EQUAL(1, guac_common_damage_next(damage, &rect));
+    CU_ASSERT_EQUAL(0, rect.x);
+    CU_ASSERT_EQUAL(0, rect.y);
+    CU_ASSERT_EQUAL(10, rect.width);
+    CU_ASSERT_EQUAL(10, rect.height);
+    CU_ASSERT_EQUAL(0, guac_common_damage_next(damage, &rect));
+
+    /*
+     * Intersection tests consider only the modified regions of each cell
+     */
+    guac_common_rect_init(&rect, 10, 10, 5, 5);
+    guac_common_damage_add(damage, &rect);
+
+    guac_common_rect_init(&rect, 40, 40, 10, 10);
+    CU_ASSERT_EQUAL(0, guac_common_damage_intersects(damage, &rect));
+
+    guac_common_rect_init(&rect, 0, 0, 12, 12);
+    CU_ASSERT_NOT_EQUAL(0, guac_common_damage_intersects(damage, &rect));
+
+    /* Cost of adding a region is the growth of each cell's bounds */
+    guac_common_rect_init(&rect, 10, 10, 5, 5);
+    CU_ASSERT_EQUAL(0, guac_common_damage_cost(damage, &rect));
+
+    guac_common_rect_init(&rect, 10, 15, 5, 5);
+    CU_ASSERT_EQUAL(25, guac_common_damage_cost(damage, &rect));
+
+    guac_common_rect_init(&rect, 200, 200, 10, 10);
+    CU_ASSERT_EQUAL(100, guac_common_damage_cost(damage, &rect));
+
+    guac_common_damage_clear(damage);
+    CU_ASSERT_EQUAL(0, guac_common_damage_next(damage, &rect));
+
+    /*
+     * Rectangular blocks of modified cells are extracted as a single
+     * rectangle, with any remainder extracted separately
+     */
+    guac_common_rect_init(&rect, 64, 64, 192, 128);
+    guac_common_damage_add(damage, &rect);
+    guac_common_rect_init(&rect, 64, 192, 64, 64);
+    guac_common_damage_add(damage, &rect);
+
+    CU_ASSERT_EQUAL(1, guac_common_damage_next(damage, &rect));
+    CU_ASSERT_EQUAL(64, rect.x);
+    CU_ASSERT_EQUAL(64, rect.y);
+    CU_ASSERT_EQUAL(192, rect.width);
+    CU_ASSERT_EQUAL(128, rect.height);
+
+    CU_ASSERT_EQUAL(1, guac_common_damage_next(damage, &rect));
+    CU_ASSERT_EQUAL(64, rect.x);
+    CU_ASSERT_EQUAL(192, rect.y);
+    CU_ASSERT_EQUAL(64, rect.width);
+    CU_ASSERT_EQUAL(64, rect.height);
+
+    CU_ASSERT_EQUAL(0, guac_common_damage_next(damage, &rect));
+
+    /*
+     * Resizing preserves modified regions within the new bounds
+     */
+    guac_common_rect_init(&rect, 10, 10, 10, 10);
+    guac_common_damage_add(damage, &rect);
+    guac_common_rect_init(&rect, 500, 500, 100, 100);
+    guac_common_damage_add(damage, &rect);
+
+    CU_ASSERT_EQUAL(0, guac_common_damage_resize(damage, 550, 300));
+
+    CU_ASSERT_EQUAL(1, guac_common_damage_next(damage, &rect));
+    CU_ASSERT_EQUAL(10, rect.x);
+    CU_ASSERT_EQUAL(10, rect.y);
+    CU_ASSERT_EQUAL(10, rect.width);
+    CU_ASSERT_EQUAL(10, rect.height);
+    CU_ASSERT_EQUAL(0, guac_common_damage_next(damage, &rect));
+
+    /* Wide images span multiple words of the bitmap per row */
+    CU_ASSERT_EQUAL(0, guac_common_damage_resize(damage, 10000, 100));
+    CU_ASSERT_EQUAL(3, damage->words);
+
+    guac_common_rect_init(&rect, 4000, 0, 4500, 10);
+    guac_common_damage_add(damage, &rect);
+
+    CU_ASSERT_EQUAL(1, guac_common_damage_next(damage, &rect));
+    CU_ASSERT_EQUAL(4000, rect.x);
+    CU_ASSERT_EQUAL(0, rect.y);
+    CU_ASSERT_EQUAL(4500, rect.width);
+    CU_ASSERT_EQUAL(10, rect.height);
+    CU_ASSERT_EQUAL(0, guac_common_damage_next(damage, &rect));
+
+    guac_common_damage_free(damage);
+
+}
+
@@ -0,0 +1,124 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "common_suite.h"
+#include "common/dircache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <CUnit/Basic.h>
+
+/**
+ * Allocates a listing of the directory having the given path, containing a
+ * single file, and stores that listing within the given cache.
+ */
+static void put_listing(guac_common_dircache* cache, const char* path) {
+
+    guac_common_dircache_listing* listing =
+        guac_common_dircache_listing_alloc(path);
+
+    CU_ASSERT_EQUAL(0, guac_common_dircache_listing_add(listing, "file", 0));
+    guac_common_dircache_put(cache, listing);
+    guac_common_dircache_release(cache, listing);
+
+}
+
+/**
+ * Returns whether the given cache contains a listing for the directory having
+ * the given path.
+ */
+static int is_cached(guac_common_dircache* cache, const char* path) {
+
+    guac_common_dircache_listing* listing =
+        guac_common_dircache_get(cache, path);
+
+    if (listing == NULL)
+        return 0;
+
+    guac_common_dircache_release(cache, listing);
+    return 1;
+
+}
+
+void test_guac_dircache() {
+
+    int i;
+    guac_common_dircache_listing* listing;
+
+    guac_common_dircache* cache = guac_common_dircache_alloc(60000);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(cache);
+
+    /* Listings should be retrievable, ignoring trailing slashes */
+    put_listing(cache, "/a/b");
+    listing = guac_common_dircache_get(cache, "/a/b/");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(listing);
+    CU_ASSERT_EQUAL(1, listing->length);
+    CU_ASSERT_STRING_EQUAL("file", listing->entries[0].name);
+    CU_ASSERT_FALSE(listing->entries[0].directory);
+    CU_ASSERT_FALSE(is_cached(cache, "/a"));
+
+    /* Listings should remain valid while referenced, even if invalidated */
+    guac_common_dircache_invalidate(cache, "/a/b");
+    CU_ASSERT_FALSE(is_cached(cache, "/a/b"));
+    CU_ASSERT_STRING_EQUAL("file", listing->entries[0].name);
+    guac_common_dircache_release(cache, listing);
+
+    /* Changing a file should invalidate its parent and descendants only */
+    put_listing(cache, "/");
+    put_listing(cache, "/a");
+    put_listing(cache, "/a/b");
+    put_listing(cache, "/a/b/c");
+    put_listing(cache, "/a/bc");
+    guac_common_dircache_invalidate(cache, "/a/b");
+    CU_ASSERT_TRUE(is_cached(cache, "/"));
+    CU_ASSERT_FALSE(is_cached(cache, "/a"));
+    CU_ASSERT_FALSE(is_cached(cache, "/a/b"));
+    CU_ASSERT_FALSE(is_cached(cache, "/a/b/c"));
+    CU_ASSERT_TRUE(is_cached(cache, "/a/bc"));
+
+    /* Changing a file within the root should invalidate the root */
+    guac_common_dircache_invalidate(cache, "/x");
+    CU_ASSERT_FALSE(is_cached(cache, "/"));
+    CU_ASSERT_TRUE(is_cached(cache, "/a/bc"));
+
+    /* Relative paths should invalidate everything */
+    guac_common_dircache_invalidate(cache, "./x");
+    CU_ASSERT_FALSE(is_cached(cache, "/a/bc"));
+
+    /* Cache should never exceed its maximum size */
+    for (i = 0; i < GUAC_COMMON_DIRCACHE_SIZE * 2; i++) {
+        char path[32];
+        snprintf(path, sizeof(path), "/dir%i", i);
+        put_listing(cache, path);
+        CU_ASSERT_TRUE(is_cached(cache, path));
+    }
+
+    guac_common_dircache_free(cache);
+
+    /* Expired listings should not be returned */
+    cache = guac_common_dircache_alloc(0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(cache);
+    put_listing(cache, "/a");
+    CU_ASSERT_FALSE(is_cached(cache, "/a"));
+    guac_common_dircache_free(cache);
+
+}
+
@@ -22,7 +22,9 @@
 #include "common_suite.h"
 #include "common/iconv.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <CUnit/Basic.h>
 
 static void test_conversion(
@@ -126,3 +128,187 @@ void test_guac_iconv() {
 
 }
 
+void test_guac_iconv_crlf() {
+
+    /* UTF8 with mixed line endings */
+    unsigned char test_string_mixed[] = {
+        'a', '\r', '\n', 'b', '\n', 'c', '\r', 'd', '\r', '\n', 0x00
+    };
+
+    /* UTF8 with LF line endings */
+    unsigned char test_string_lf[] = {
+        'a', '\n', 'b', '\n', 'c', '\r', 'd', '\n', 0x00
+    };
+
+    /* UTF16 with CRLF line endings */
+    unsigned char test_string_utf16_crlf[] = {
+        'a', 0x00, '\r', 0x00, '\n', 0x00, 'b', 0x00, '\r', 0x00, '\n', 0x00,
+        'c', 0x00, '\r', 0x00, 'd', 0x00, '\r', 0x00, '\n', 0x00, 0x00, 0x00
+    };
+
+    /* Normalize mixed line endings */
+    test_conversion(
+            GUAC_READ_UTF8_NORMALIZED, test_string_mixed, sizeof(test_string_mixed),
+            GUAC_WRITE_UTF8,           test_string_lf,    sizeof(test_string_lf));
+
+    /* Produce CRLF line endings */
+    test_conversion(
+            GUAC_READ_UTF8_NORMALIZED, test_string_mixed,      sizeof(test_string_mixed),
+            GUAC_WRITE_UTF16_CRLF,     test_string_utf16_crlf, sizeof(test_string_utf16_crlf));
+
+    /* Normalize CRLF line endings */
+    test_conversion(
+            GUAC_READ_UTF16_NORMALIZED, test_string_utf16_crlf, sizeof(test_string_utf16_crlf),
+            GUAC_WRITE_UTF8,            test_string_lf,         sizeof(test_string_lf));
+
+}
+
+/**
+ * Verifies that the given normalizing reader translates input which ends
+ * with a carriage return without reading beyond the end of that input. The
+ * input is followed in memory by a line feed which must NOT be consumed.
+ *
+ * @param reader
+ *     The normalizing reader to test.
+ *
+ * @param input
+ *     The input to read, consisting of the character "a", a carriage return,
+ *     and a trailing line feed which lies beyond the end of the input.
+ *
+ * @param in_length
+ *     The number of bytes of input, excluding the trailing line feed.
+ */
+static void test_trailing_cr(guac_iconv_read* reader,
+        const unsigned char* input, int in_length) {
+
+    char output[8];
+    const char* current_input = (const char*) input;
+    char* current_output = output;
+
+    guac_iconv(reader, &current_input, in_length,
+            GUAC_WRITE_UTF8, &current_output, sizeof(output));
+
+    /* The carriage return must be read unchanged, and nothing else read */
+    CU_ASSERT_EQUAL(in_length, current_input - (const char*) input);
+    CU_ASSERT_EQUAL(2, current_output - output);
+    CU_ASSERT_EQUAL(0, memcmp(output, "a\r", 2));
+
+}
+
+void test_guac_iconv_trailing_cr() {
+
+    /* Single-byte encodings ending with CR, followed by an unread LF */
+    unsigned char test_string_8bit[] = { 'a', '\r', '\n' };
+
+    /* UTF16 ending with CR, followed by an unread LF */
+    unsigned char test_string_utf16[] = {
+        'a', 0x00, '\r', 0x00, '\n', 0x00
+    };
+
+    test_trailing_cr(GUAC_READ_UTF8_NORMALIZED,      test_string_8bit,  2);
+    test_trailing_cr(GUAC_READ_CP1252_NORMALIZED,    test_string_8bit,  2);
+    test_trailing_cr(GUAC_READ_ISO8859_1_NORMALIZED, test_string_8bit,  2);
+    test_trailing_cr(GUAC_READ_UTF16_NORMALIZED,     test_string_utf16, 4);
+
+}
+
+/**
+ * Reader which reads UTF8 exactly as GUAC_READ_UTF8, but which guac_iconv()
+ * does not recognize, forcing conversion one character at a time.
+ */
+static int test_read_utf8(const char** input, int remaining) {
+    return GUAC_READ_UTF8(input, remaining);
+}
+
+/**
+ * Reader which reads UTF8 exactly as GUAC_READ_UTF8_NORMALIZED, but which
+ * guac_iconv() does not recognize, forcing conversion one character at a
+ * time.
+ */
+static int test_read_utf8_normalized(const char** input, int remaining) {
+    return GUAC_READ_UTF8_NORMALIZED(input, remaining);
+}
+
+/**
+ * Verifies that converting the given input with the given writer produces
+ * identical results regardless of whether ASCII characters are converted in
+ * bulk, including when the output buffer is too small.
+ */
+static void test_bulk_conversion(const char* input, int in_length,
+        guac_iconv_read* reader, guac_iconv_read* reference_reader,
+        guac_iconv_write* writer) {
+
+    static char output[16384];
+    static char expected[16384];
+    int out_length;
+
+    for (out_length = 1; out_length <= sizeof(output); out_length += 997) {
+
+        const char* current_input = input;
+        const char* expected_input = input;
+        char* current_output = output;
+        char* expected_output = expected;
+
+        int result = guac_iconv(reader, &current_input, in_length,
+                writer, &current_output, out_length);
+
+        int expected_result = guac_iconv(reference_reader, &expected_input,
+                in_length, writer, &expected_output, out_length);
+
+        CU_ASSERT_EQUAL(expected_result, result);
+        CU_ASSERT_EQUAL(expected_input - input, current_input - input);
+        CU_ASSERT_EQUAL(expected_output - expected, current_output - output);
+        CU_ASSERT_EQUAL(0, memcmp(output, expected, current_output - output));
+
+    }
+
+}
+
+void test_guac_iconv_bulk() {
+
+    int i;
+    char input[8192];
+    int length = 0;
+
+    /* Long runs of ASCII, interrupted by line endings and non-ASCII */
+    for (i = 0; length < sizeof(input) - 16; i++) {
+
+        length += snprintf(input + length, sizeof(input) - length,
+                "line %i of some clipboard text", i);
+
+        if (i % 5 == 0)
+            length += snprintf(input + length, sizeof(input) - length,
+                    "\xC3\xA0\xE2\x82\xAC");
+
+        input[length++] = (i % 3 == 0) ? '\n' : '\r';
+        if (i % 3 != 1)
+            input[length++] = '\n';
+
+    }
+
+    input[length++] = '\0';
+
+    guac_iconv_write* writers[] = {
+        GUAC_WRITE_UTF8,       GUAC_WRITE_UTF8_CRLF,
+        GUAC_WRITE_UTF16,      GUAC_WRITE_UTF16_CRLF,
+        GUAC_WRITE_CP1252,     GUAC_WRITE_CP1252_CRLF,
+        GUAC_WRITE_ISO8859_1,  GUAC_WRITE_ISO8859_1_CRLF
+    };
+
+    for (i = 0; i < sizeof(writers) / sizeof(writers[0]); i++) {
+
+        test_bulk_conversion(input, length,
+                GUAC_READ_UTF8, test_read_utf8, writers[i]);
+
+        test_bulk_conversion(input, length,
+                GUAC_READ_UTF8_NORMALIZED, test_read_utf8_normalized,
+                writers[i]);
+
+        /* Begin at an offset to cover unaligned input */
+        test_bulk_conversion(input + 3, length - 3,
+                GUAC_READ_UTF8, test_read_utf8, writers[i]);
+
+    }
+
+}
+
@@ -0,0 +1,79 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "common_suite.h"
+#include "common/damage.h"
+#include "common/rect.h"
+#include "common/surface.h"
+
+#include <CUnit/Basic.h>
+#include <guacamole/client.h>
+#include <guacamole/layer.h>
+
+/**
+ * A 16x16 JPEG image in which every pixel is mid-gray (0x808080).
+ */
+static const unsigned char test_jpeg[] = {
+    0xFF, 0xD8, 0xFF, 0xDB, 0x00, 0x43, 0x00, 0x03, 0x02, 0x02, 0x03, 0x02,
+    0x02, 0x03, 0x03, 0x03, 0x03, 0x04, 0x03, 0x03, 0x04, 0x05, 0x08, 0x05,
+    0x05, 0x04, 0x04, 0x05, 0x0A, 0x07, 0x07, 0x06, 0x08, 0x0C, 0x0A, 0x0C,
+    0x0C, 0x0B, 0x0A, 0x0B, 0x0B, 0x0D, 0x0E, 0x12, 0x10, 0x0D, 0x0E, 0x11,
+    0x0E, 0x0B, 0x0B, 0x10, 0x16, 0x10, 0x11, 0x13, 0x14, 0x15, 0x15, 0x15,
+    0x0C, 0x0F, 0x17, 0x18, 0x16, 0x14, 0x18, 0x12, 0x14, 0x15, 0x14, 0xFF,
+    0xC0, 0x00, 0x0B, 0x08, 0x00, 0x10, 0x00, 0x10, 0x01, 0x01, 0x11, 0x00,
+    0xFF, 0xC4, 0x00, 0x14, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xC4,
+    0x00, 0x14, 0x10, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0xDA, 0x00, 0x08,
+    0x01, 0x01, 0x00, 0x00, 0x3F, 0x00, 0x00, 0xFF, 0xD9
+};
+
+void test_guac_surface_jpeg() {
+
+    guac_common_rect all;
+    guac_common_rect_init(&all, 0, 0, 64, 64);
+
+    guac_client* client = guac_client_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+
+    guac_common_surface* surface = guac_common_surface_alloc(client,
+            client->socket, GUAC_DEFAULT_LAYER, 64, 64);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(surface);
+
+    /* Unaligned update which does not overlap the JPEG, but which may reach
+     * into it once expanded to the JPEG block grid during flush (updates
+     * which are not opaque are always deferred until flush) */
+    guac_common_surface_set(surface, 5, 5, 6, 6, 0x80, 0x80, 0x80, 0x80);
+    CU_ASSERT_TRUE(guac_common_damage_intersects(surface->damage, &all));
+
+    /* Pass JPEG through next to the pending update */
+    CU_ASSERT_EQUAL(0, guac_common_surface_draw_jpeg(surface, 16, 0, 16, 16,
+                test_jpeg, sizeof(test_jpeg)));
+
+    /* The pending update must have been flushed before the JPEG was sent,
+     * such that it cannot later be drawn over the JPEG */
+    CU_ASSERT_FALSE(guac_common_damage_intersects(surface->damage, &all));
+    CU_ASSERT_EQUAL(1, surface->jpeg_queue_length);
+
+    guac_common_surface_free(surface);
+    guac_client_free(client);
+
+}
@@ -0,0 +1,116 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "suite.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <CUnit/Basic.h>
+#include <guacamole/error.h>
+#include <guacamole/parser.h>
+
+void test_instruction_parse_buffer() {
+
+    /* Allocate parser */
+    guac_parser* parser = guac_parser_alloc();
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser);
+
+    /* Instruction input, including ASCII runs longer than a SIMD block and
+     * multibyte characters */
+    char buffer[] =
+        "4.test,8.testdata,5.zxcvb,13.guacamoletest;"
+        "5.test2,40.this is a test of a longer ASCII element,8." UTF8_8 ";"
+        "4.test";
+
+    /* Copy of input for verifying that the input is never modified */
+    char original[sizeof(buffer)];
+    memcpy(original, buffer, sizeof(buffer));
+
+    const char* current = buffer;
+    int remaining = sizeof(buffer) - 1;
+
+    /* First instruction */
+    int parsed = guac_parser_parse(parser, current, remaining);
+    CU_ASSERT_EQUAL_FATAL(parsed, 43);
+    CU_ASSERT_EQUAL(parser->state, GUAC_PARSE_COMPLETE);
+    CU_ASSERT_EQUAL_FATAL(parser->argc, 3);
+    CU_ASSERT_STRING_EQUAL(parser->opcode,  "test");
+    CU_ASSERT_STRING_EQUAL(parser->argv[0], "testdata");
+    CU_ASSERT_STRING_EQUAL(parser->argv[1], "zxcvb");
+    CU_ASSERT_STRING_EQUAL(parser->argv[2], "guacamoletest");
+
+    /* Elements must not point into the input buffer */
+    CU_ASSERT_TRUE(parser->opcode < buffer
+            || parser->opcode >= buffer + sizeof(buffer));
+
+    current += parsed;
+    remaining -= parsed;
+
+    /* Second instruction */
+    parsed = guac_parser_parse(parser, current, remaining);
+    CU_ASSERT_EQUAL_FATAL(parsed, remaining - 6);
+    CU_ASSERT_EQUAL_FATAL(parser->argc, 2);
+    CU_ASSERT_STRING_EQUAL(parser->opcode,  "test2");
+    CU_ASSERT_STRING_EQUAL(parser->argv[0],
+            "this is a test of a longer ASCII element");
+    CU_ASSERT_STRING_EQUAL(parser->argv[1], UTF8_8);
+
+    current += parsed;
+    remaining -= parsed;
+
+    /* Incomplete instruction is not parsed */
+    CU_ASSERT_EQUAL(guac_parser_parse(parser, current, remaining), 0);
+
+    /* Input must be left untouched */
+    CU_ASSERT_EQUAL(memcmp(buffer, original, sizeof(buffer)), 0);
+
+    /* Truncated multibyte character is incomplete */
+    char truncated[] = "2." UTF8_1;
+    CU_ASSERT_EQUAL(guac_parser_parse(parser, truncated,
+                sizeof(truncated) - 2), 0);
+
+    /* Invalid data must be rejected */
+    char invalid[] = "4.test,3.abcd;";
+    CU_ASSERT_EQUAL(guac_parser_parse(parser, invalid,
+                sizeof(invalid) - 1), -1);
+    CU_ASSERT_EQUAL(guac_error, GUAC_STATUS_PROTOCOL_ERROR);
+
+    /* Instructions larger than the instruction buffer must be rejected */
+    static char too_long[5 * (GUAC_INSTRUCTION_MAX_LENGTH + 6)];
+    int length = 0;
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        length += sprintf(too_long + length, "%i.", GUAC_INSTRUCTION_MAX_LENGTH);
+        memset(too_long + length, 'x', GUAC_INSTRUCTION_MAX_LENGTH);
+        length += GUAC_INSTRUCTION_MAX_LENGTH;
+        too_long[length++] = (i == 4) ? ';' : ',';
+    }
+
+    CU_ASSERT_EQUAL(guac_parser_parse(parser, too_long, length), -1);
+    CU_ASSERT_EQUAL(guac_error, GUAC_STATUS_NO_MEMORY);
+
+    guac_parser_free(parser);
+
+}
+
@@ -45,6 +45,7 @@ int register_protocol_suite() {
     if (
         CU_add_test(suite, "base64-decode", test_base64_decode) == NULL
      || CU_add_test(suite, "instruction-parse", test_instruction_parse) == NULL
+     || CU_add_test(suite, "instruction-parse-buffer", test_instruction_parse_buffer) == NULL
      || CU_add_test(suite, "instruction-read", test_instruction_read) == NULL
      || CU_add_test(suite, "instruction-write", test_instruction_write) == NULL
      || CU_add_test(suite, "nest-write", test_nest_write) == NULL
@@ -35,6 +35,7 @@ int register_protocol_suite();
 
 void test_base64_decode();
 void test_instruction_parse();
+void test_instruction_parse_buffer();
 void test_instruction_read();
 void test_instruction_write();
 void test_nest_write();
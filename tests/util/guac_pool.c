@@ -87,3 +87,44 @@ void test_guac_pool() {
 
 }
 
+void test_guac_pool_reuse() {
+
+    int i;
+    guac_pool* pool = guac_pool_alloc(0);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pool);
+
+    CU_ASSERT_EQUAL(0, guac_pool_next_int(pool));
+    CU_ASSERT_EQUAL(1, guac_pool_next_int(pool));
+    CU_ASSERT_EQUAL(2, guac_pool_next_int(pool));
+
+    /* Freeing twice must not make an integer available twice */
+    guac_pool_free_int(pool, 1);
+    guac_pool_free_int(pool, 1);
+    CU_ASSERT_EQUAL(1, guac_pool_next_int(pool));
+    CU_ASSERT_EQUAL(3, guac_pool_next_int(pool));
+
+    /* Reuse continues after the integer most recently reused (1) rather
+     * than returning to the lowest freed integer */
+    guac_pool_free_int(pool, 0);
+    guac_pool_free_int(pool, 2);
+    CU_ASSERT_EQUAL(2, guac_pool_next_int(pool));
+    CU_ASSERT_EQUAL(0, guac_pool_next_int(pool));
+    CU_ASSERT_EQUAL(4, guac_pool_next_int(pool));
+
+    /* Active integers should be counted exactly once */
+    CU_ASSERT_EQUAL(5, pool->active);
+
+    /* Exhaust the pool, attempting further allocations beyond its end */
+    for (i = 5; i < GUAC_POOL_CHUNK_SIZE * GUAC_POOL_MAX_CHUNKS; i++)
+        CU_ASSERT_EQUAL_FATAL(i, guac_pool_next_int(pool));
+
+    CU_ASSERT_EQUAL(-1, guac_pool_next_int(pool));
+    CU_ASSERT_EQUAL(-1, guac_pool_next_int(pool));
+
+    /* Freed integers must remain claimable once the pool is exhausted */
+    guac_pool_free_int(pool, 7);
+    CU_ASSERT_EQUAL(7, guac_pool_next_int(pool));
+
+    guac_pool_free(pool);
+
+}
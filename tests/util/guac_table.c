@@ -0,0 +1,88 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "config.h"
+
+#include "util_suite.h"
+
+#include <CUnit/Basic.h>
+#include <guacamole/table.h>
+
+#define TABLE_CHUNK_SIZE 16
+#define TABLE_SIZE       128
+
+#define UNINITIALIZED    -1
+
+/**
+ * Initializes the given int as UNINITIALIZED. The signature of this function
+ * is dictated by guac_table_init_handler.
+ */
+static void init_element(void* element) {
+    *((int*) element) = UNINITIALIZED;
+}
+
+void test_guac_table() {
+
+    guac_table* table;
+
+    int i;
+    int* element;
+    int* elements[TABLE_SIZE];
+
+    /* Get table */
+    table = guac_table_alloc(sizeof(int), TABLE_CHUNK_SIZE, TABLE_SIZE,
+            init_element);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(table);
+
+    /* No storage should be allocated yet */
+    for (i=0; i<TABLE_SIZE; i++)
+        CU_ASSERT_PTR_NULL(guac_table_get(table, i));
+
+    /* Acquire every element, storing index within each */
+    for (i=0; i<TABLE_SIZE; i++) {
+
+        element = guac_table_acquire(table, i);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(element);
+
+        /* Each element should be initialized exactly once */
+        CU_ASSERT_EQUAL(UNINITIALIZED, *element);
+        *element = i;
+
+        elements[i] = element;
+
+    }
+
+    /* Elements should retain their values and never move */
+    for (i=0; i<TABLE_SIZE; i++) {
+        CU_ASSERT_PTR_EQUAL(elements[i], guac_table_get(table, i));
+        CU_ASSERT_PTR_EQUAL(elements[i], guac_table_acquire(table, i));
+        CU_ASSERT_EQUAL(i, *elements[i]);
+    }
+
+    /* Out-of-range indices should be rejected */
+    CU_ASSERT_PTR_NULL(guac_table_get(table, -1));
+    CU_ASSERT_PTR_NULL(guac_table_get(table, TABLE_SIZE));
+    CU_ASSERT_PTR_NULL(guac_table_acquire(table, -1));
+    CU_ASSERT_PTR_NULL(guac_table_acquire(table, TABLE_SIZE));
+
+    /* Free table */
+    guac_table_free(table);
+
+}
+
@@ -0,0 +1,150 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied.  See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+
+#include "config.h"
+
+#include "util_suite.h"
+
+#include <CUnit/Basic.h>
+#include <guacamole/timer.h>
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TIMER_COUNT     32
+#define TIMER_MAX_DELAY 1500
+#define TIMER_REPEATS   3
+
+/**
+ * State tracked for each timer within the test.
+ */
+typedef struct test_timer_state {
+
+    /**
+     * The time at which the timer was most recently scheduled, in
+     * milliseconds.
+     */
+    uint64_t scheduled;
+
+    /**
+     * The requested delay, in milliseconds.
+     */
+    int delay;
+
+    /**
+     * The time at which the timer most recently fired, in milliseconds.
+     */
+    uint64_t fired;
+
+    /**
+     * The number of times the timer has fired.
+     */
+    int count;
+
+    /**
+     * The number of times the timer should reschedule itself after firing.
+     */
+    int repeats;
+
+} test_timer_state;
+
+/**
+ * Returns the current time in milliseconds, as measured by the same clock
+ * used by the timer service.
+ */
+static uint64_t test_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/**
+ * Records the time the timer fired, rescheduling the timer if repeats
+ * remain. The signature of this function is dictated by guac_timer_callback.
+ */
+static void test_callback(guac_timer* timer, void* data) {
+
+    test_timer_state* state = (test_timer_state*) data;
+
+    state->fired = test_now();
+    state->count++;
+
+    /* Verify timer did not fire early */
+    CU_ASSERT_TRUE(state->fired >= state->scheduled + state->delay);
+
+    if (state->repeats > 0) {
+        state->repeats--;
+        state->scheduled = test_now();
+        guac_timer_schedule(timer, state->delay);
+    }
+
+}
+
+void test_guac_timer() {
+
+    int i;
+    guac_timer* timers[TIMER_COUNT];
+    test_timer_state states[TIMER_COUNT];
+
+    /* Schedule timers across several levels of the timer wheel */
+    for (i = 0; i < TIMER_COUNT; i++) {
+
+        states[i].delay = (i * 997) % TIMER_MAX_DELAY;
+        states[i].count = 0;
+        states[i].repeats = (i == 0) ? TIMER_REPEATS - 1 : 0;
+
+        timers[i] = guac_timer_alloc(test_callback, &states[i]);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(timers[i]);
+
+        states[i].scheduled = test_now();
+        CU_ASSERT_EQUAL(guac_timer_schedule(timers[i], states[i].delay), 0);
+
+    }
+
+    /* Cancel every third timer (other than the repeating timer) */
+    for (i = 3; i < TIMER_COUNT; i += 3)
+        guac_timer_cancel(timers[i]);
+
+    /* Wait for all remaining timers to fire */
+    usleep((TIMER_MAX_DELAY + 500) * 1000);
+
+    /* Freeing each timer guarantees its callback is no longer running */
+    for (i = 0; i < TIMER_COUNT; i++)
+        guac_timer_free(timers[i]);
+
+    for (i = 0; i < TIMER_COUNT; i++) {
+
+        /* Cancelled timers must never fire */
+        if (i != 0 && i % 3 == 0)
+            CU_ASSERT_EQUAL(states[i].count, 0);
+
+        /* The repeating timer fires once per repeat */
+        else if (i == 0)
+            CU_ASSERT_EQUAL(states[i].count, TIMER_REPEATS);
+
+        /* All others fire exactly once */
+        else
+            CU_ASSERT_EQUAL(states[i].count, 1);
+
+    }
+
+}
+
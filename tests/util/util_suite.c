@@ -44,6 +44,9 @@ int register_util_suite() {
     /* Add tests */
     if (
            CU_add_test(suite, "guac-pool",    test_guac_pool)    == NULL
+        || CU_add_test(suite, "guac-pool-reuse", test_guac_pool_reuse) == NULL
+        || CU_add_test(suite, "guac-table",   test_guac_table)   == NULL
+        || CU_add_test(suite, "guac-timer",   test_guac_timer)   == NULL
         || CU_add_test(suite, "guac-unicode", test_guac_unicode) == NULL
        ) {
         CU_cleanup_registry();
@@ -64,6 +64,30 @@ int register_util_suite();
  */
 void test_guac_pool();
 
+/**
+ * Unit test verifying that freed integers of a guac_pool are not reused
+ * immediately while other freed integers remain, that freeing an integer
+ * twice does not make it available twice, and that freed integers remain
+ * available once the pool is exhausted.
+ */
+void test_guac_pool_reuse();
+
+/**
+ * Unit test for the guac_table structure and related functions. The guac_table
+ * structure provides storage for indexed elements which is allocated only as
+ * needed. This unit test checks that elements are initialized, that storage
+ * is allocated only by guac_table_acquire(), and that elements never move.
+ */
+void test_guac_table();
+
+/**
+ * Unit test for the process-wide timer service. This unit test checks that
+ * timers spread across multiple levels of the timer wheel fire exactly once
+ * and never early, that timers may reschedule themselves, and that cancelled
+ * timers never fire.
+ */
+void test_guac_timer();
+
 /**
  * Unit test for libguac's Unicode convenience functions. This test checks that
  * the functions provided for determining string length, character length, and